@@ -1,9 +1,140 @@
 #pragma once
 
 #include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <deque>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include <type_traits>
+#include <cassert>
+
+// --- D3D11 support --------------------------------------
+//  On Windows the D3D11, WRL and DirectXMath headers of the
+//  Windows SDK are used and EZD3D11Backend is available.
+//  Elsewhere, or when EZREADBACK_NO_D3D11 is defined before
+//  including this file, EZReadbackShim.h (kept next to this
+//  file) supplies the types instead, and only backends that
+//  need no device, such as EZReferenceBackend, can be used.
+// --------------------------------------------------------
+#if !defined(_WIN32) && !defined(EZREADBACK_NO_D3D11)
+#define EZREADBACK_NO_D3D11 1
+#endif
+
+#if defined(EZREADBACK_NO_D3D11)
+#include "EZReadbackShim.h"
+#else
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <DirectXMath.h>
+#endif
+
+// --- SIMD support ---------------------------------------
+//  CPU-side kernels have SSE2/AVX2 versions on x86 and x64
+//  that are picked at runtime based on what the CPU 
+//  supports.  Other platforms use the scalar versions.
+// 
+//  Define EZREADBACK_NO_SIMD before including this file to
+//  force the scalar versions everywhere.
+// --------------------------------------------------------
+#if !defined(EZREADBACK_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define EZREADBACK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Lets GCC and Clang compile AVX2 kernels without enabling
+// AVX2 for the whole program; MSVC does not need this
+#if defined(EZREADBACK_X86) && !defined(_MSC_VER)
+#define EZREADBACK_TARGET(isa) __attribute__((target(isa)))
+#else
+#define EZREADBACK_TARGET(isa)
+#endif
+
+// --- EZCpuFeatures --------------------------------------
+//  Instruction set extensions the CPU supports, detected
+//  once on first use.  All false when SIMD is unavailable.
+// --------------------------------------------------------
+struct EZCpuFeatures
+{
+	bool SSE41;
+	bool AVX2;
+	bool F16C;
+
+	static inline const EZCpuFeatures& Get()
+	{
+		static const EZCpuFeatures features = Detect();
+		return features;
+	}
+
+private:
+
+	static inline EZCpuFeatures Detect()
+	{
+		EZCpuFeatures features = {};
+#if defined(EZREADBACK_X86)
+		unsigned int leaf1[4] = {};
+		unsigned int leaf7[4] = {};
+#if defined(_MSC_VER)
+		__cpuid(reinterpret_cast<int*>(leaf1), 1);
+		__cpuidex(reinterpret_cast<int*>(leaf7), 7, 0);
+#else
+		__cpuid(1, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+		__cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+		// AVX state must also be enabled by the OS
+		bool osAVX = false;
+		if ((leaf1[2] & (1u << 27)) && (leaf1[2] & (1u << 28)))
+		{
+#if defined(_MSC_VER)
+			osAVX = (_xgetbv(0) & 0x6) == 0x6;
+#else
+			unsigned int eax, edx;
+			__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			osAVX = (eax & 0x6) == 0x6;
+#endif
+		}
+
+		features.SSE41 = (leaf1[2] & (1u << 19)) != 0;
+		features.F16C  = osAVX && (leaf1[2] & (1u << 29)) != 0;
+		features.AVX2  = osAVX && (leaf7[1] & (1u << 5)) != 0;
+#endif
+		return features;
+	}
+};
+
+// --- EZMin / EZMax --------------------------------------
+//  Smaller or larger of two values of possibly different
+//  types, converted and compared exactly like the Windows
+//  min/max macros (so a NaN first operand gives the second
+//  one), without depending on those macros or NOMINMAX
+// --------------------------------------------------------
+template<typename A, typename B>
+inline constexpr typename std::common_type<A, B>::type EZMin(A a, B b)
+{
+	typedef typename std::common_type<A, B>::type Common;
+	return (Common)a < (Common)b ? (Common)a : (Common)b;
+}
+
+template<typename A, typename B>
+inline constexpr typename std::common_type<A, B>::type EZMax(A a, B b)
+{
+	typedef typename std::common_type<A, B>::type Common;
+	return (Common)a > (Common)b ? (Common)a : (Common)b;
+}
 
 // --- EZColor1 -------------------------------------------
 //  Represents a 1-component R color, which is an 8-bit 
@@ -100,291 +231,9996 @@ struct EZColor4
 	inline DirectX::XMFLOAT4 AsFloat4() { return DirectX::XMFLOAT4(RedInt / 255.0f, GreenInt / 255.0f, BlueInt / 255.0f, AlphaInt / 255.0f); }
 };
 
-class EZReadback
+// --- EZConvertUNorm8ToFloat -----------------------------
+//  Converts an array of 8-bit unsigned normalized values 
+//  (0-255) to floats in the 0.0 - 1.0 range.  This is the
+//  kernel behind the EZConvertToFloat functions below.
+// 
+//  Values are divided by 255 exactly like the AsFloat 
+//  methods of the EZColor structs, so every version 
+//  (scalar, SSE2 and AVX2) gives bit-identical results to
+//  them.  Multiplying by the reciprocal instead would be
+//  off by one ulp for about half of all values.
+// --------------------------------------------------------
+inline void EZConvertUNorm8ToFloatScalar(const unsigned char* values, size_t count, float* results)
 {
+	for (size_t i = 0; i < count; i++)
+		results[i] = values[i] / 255.0f;
+}
 
-public:
+#if defined(EZREADBACK_X86)
+inline void EZConvertUNorm8ToFloatSSE2(const unsigned char* values, size_t count, float* results)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(255.0f);
 
-	// --- Constructor ---------------------------------------
-	//  Creates the EZReadback object holding D3D objects
-	//
-	//  - device: the D3D device for creating resources
-	//  - context: the D3D context for copying resources
-	// -------------------------------------------------------
-	EZReadback(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
 	{
-		this->device = device;
-		this->context = context;
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		__m128i low = _mm_unpacklo_epi8(bytes, zero);
+		__m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_ps(results + i,      _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale));
+		_mm_storeu_ps(results + i + 4,  _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale));
+		_mm_storeu_ps(results + i + 8,  _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale));
+		_mm_storeu_ps(results + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale));
 	}
+	EZConvertUNorm8ToFloatScalar(values + i, count - i, results + i);
+}
 
-	// Read functions that populate a given vector
-	template<typename ElementType>
-	HRESULT Read(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+EZREADBACK_TARGET("avx2")
+inline void EZConvertUNorm8ToFloatAVX2(const unsigned char* values, size_t count, float* results)
+{
+	const __m256 scale = _mm256_set1_ps(255.0f);
 
-	template<typename ElementType>
-	HRESULT Read(ID3D11View* view, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+	size_t i = 0;
+	for (; i + 32 <= count; i += 32)
+	{
+		__m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		__m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 16));
 
-	// Read functions that return a new vector
-	template<typename ElementType>
-	std::vector<ElementType> Read(ID3D11Resource* resource, UINT mipLevel = 0, UINT arrayIndex = 0);
+		_mm256_storeu_ps(results + i,      _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(low)), scale));
+		_mm256_storeu_ps(results + i + 8,  _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(low, 8))), scale));
+		_mm256_storeu_ps(results + i + 16, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(high)), scale));
+		_mm256_storeu_ps(results + i + 24, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(high, 8))), scale));
+	}
+	EZConvertUNorm8ToFloatScalar(values + i, count - i, results + i);
+}
+#endif
 
-	template<typename ElementType>
-	std::vector<ElementType> Read(ID3D11View* view, UINT mipLevel = 0, UINT arrayIndex = 0);
+inline void EZConvertUNorm8ToFloat(const unsigned char* values, size_t count, float* results)
+{
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+		EZConvertUNorm8ToFloatAVX2(values, count, results);
+	else
+		EZConvertUNorm8ToFloatSSE2(values, count, results);
+#else
+	EZConvertUNorm8ToFloatScalar(values, count, results);
+#endif
+}
 
+// --- EZConvertToFloat1-4 --------------------------------
+//  Converts whole arrays of EZColors to arrays of floats
+//  or float vectors in which channel values are 0.0 - 1.0.
+//  Gives identical results to calling AsFloat1() through
+//  AsFloat4() on every element, but much faster.
+// 
+//  Parameters:
+//  - colors: array of colors to convert
+//  - count: number of colors in the array
+//  - results: array of at least count elements to fill
+// --------------------------------------------------------
+static_assert(sizeof(EZColor3) == 3 && sizeof(DirectX::XMFLOAT3) == 3 * sizeof(float), "Bulk conversion requires tightly packed colors and vectors");
 
-private:
+inline void EZConvertToFloat1(const EZColor1* colors, size_t count, float* results)
+{
+	EZConvertUNorm8ToFloat(reinterpret_cast<const unsigned char*>(colors), count, results);
+}
 
-	// D3D objects for resource creation and manipulation
-	Microsoft::WRL::ComPtr<ID3D11Device> device;
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+inline void EZConvertToFloat2(const EZColor2* colors, size_t count, DirectX::XMFLOAT2* results)
+{
+	EZConvertUNorm8ToFloat(reinterpret_cast<const unsigned char*>(colors), count * 2, reinterpret_cast<float*>(results));
+}
 
-	// Private helper to perform actual readback from GPU resource
-	template<typename ResourceType, typename DescriptionType, typename ElementType>
-	HRESULT StageAndCopyResource(
-		ResourceType* resource,
-		UINT mipLevel,
-		UINT arrayIndex,
-		std::vector<ElementType>& results);
+inline void EZConvertToFloat3(const EZColor3* colors, size_t count, DirectX::XMFLOAT3* results)
+{
+	EZConvertUNorm8ToFloat(reinterpret_cast<const unsigned char*>(colors), count * 3, reinterpret_cast<float*>(results));
+}
 
-	// Function overloads based on template type
-	inline HRESULT CreateResource(void* desc, ...) { return E_INVALIDARG; }
-	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Buffer>& result) { return device->CreateBuffer(static_cast<D3D11_BUFFER_DESC*>(desc), 0, result.GetAddressOf()); }
-	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture1D>& result) { return device->CreateTexture1D(static_cast<D3D11_TEXTURE1D_DESC*>(desc), 0, result.GetAddressOf()); }
-	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture2D>& result) { return device->CreateTexture2D(static_cast<D3D11_TEXTURE2D_DESC*>(desc), 0, result.GetAddressOf()); }
-	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture3D>& result) { return device->CreateTexture3D(static_cast<D3D11_TEXTURE3D_DESC*>(desc), 0, result.GetAddressOf()); }
+inline void EZConvertToFloat4(const EZColor4* colors, size_t count, DirectX::XMFLOAT4* results)
+{
+	EZConvertUNorm8ToFloat(reinterpret_cast<const unsigned char*>(colors), count * 4, reinterpret_cast<float*>(results));
+}
 
-	// Helpers for calculating the number of elements in a resource
-	template<typename DescriptionType> inline UINT CalcElementCount(DescriptionType* desc, size_t elementSize, UINT mipLevel);
-	template<> inline UINT CalcElementCount<D3D11_BUFFER_DESC>(D3D11_BUFFER_DESC* desc, size_t elementSize, UINT mipLevel);
-	template<> inline UINT CalcElementCount<D3D11_TEXTURE1D_DESC>(D3D11_TEXTURE1D_DESC* desc, size_t elementSize, UINT mipLevel);
-	template<> inline UINT CalcElementCount<D3D11_TEXTURE2D_DESC>(D3D11_TEXTURE2D_DESC* desc, size_t elementSize, UINT mipLevel);
-	template<> inline UINT CalcElementCount<D3D11_TEXTURE3D_DESC>(D3D11_TEXTURE3D_DESC* desc, size_t elementSize, UINT mipLevel);
+// --- EZConvertToFloat1-4 --------------------------------
+//  Converts whole vectors of EZColors and returns a new
+//  vector with the results
+// --------------------------------------------------------
+inline std::vector<float> EZConvertToFloat1(const std::vector<EZColor1>& colors)
+{
+	std::vector<float> results(colors.size());
+	if (!colors.empty()) EZConvertToFloat1(colors.data(), colors.size(), results.data());
+	return results;
+}
 
-	// Helpers for calculating subresource index of different resource types
-	template<typename DescriptionType> inline UINT CalcSubresourceIndex(DescriptionType* desc, UINT mipLevel, UINT arrayIndex);
-	template<> inline UINT CalcSubresourceIndex<D3D11_BUFFER_DESC>(D3D11_BUFFER_DESC* desc, UINT mipLevel, UINT arrayIndex);
+inline std::vector<DirectX::XMFLOAT2> EZConvertToFloat2(const std::vector<EZColor2>& colors)
+{
+	std::vector<DirectX::XMFLOAT2> results(colors.size());
+	if (!colors.empty()) EZConvertToFloat2(colors.data(), colors.size(), results.data());
+	return results;
+}
 
-	// Helper for size of formats
-	inline size_t BitsPerPixel(DXGI_FORMAT format);
-};
+inline std::vector<DirectX::XMFLOAT3> EZConvertToFloat3(const std::vector<EZColor3>& colors)
+{
+	std::vector<DirectX::XMFLOAT3> results(colors.size());
+	if (!colors.empty()) EZConvertToFloat3(colors.data(), colors.size(), results.data());
+	return results;
+}
 
+inline std::vector<DirectX::XMFLOAT4> EZConvertToFloat4(const std::vector<EZColor4>& colors)
+{
+	std::vector<DirectX::XMFLOAT4> results(colors.size());
+	if (!colors.empty()) EZConvertToFloat4(colors.data(), colors.size(), results.data());
+	return results;
+}
 
-// --- Read functions for resources ----------------------
-//  Reads data of the specified ElementType from a 
-//  specific subresource of the given resource and 
-//  populates the given vector with results.  Note that
-//  ID3D11Buffers do not have explicit subresources and
-//  will always read the entire resource (ignoring mipLevel
-//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
-//  resources do not support arrays, so arrayIndex is ignored.
-// 
-//  ElementType:
-//  - Expected data type to read from the resource.  Note that
-//    this must match the size of the actual elements in the
-//    resource or the function will fail.
+// --- Format decoding helpers ----------------------------
+//  Small conversions shared by the format decoders below.
+//  The half and packed-float conversions place the bits
+//  into a 32-bit float and rescale by 2^112, which handles
+//  denormals exactly; infinity and NaN are patched up
+//  afterwards.  The SIMD kernels use the same math, so
+//  every version gives identical results.
+// --------------------------------------------------------
+inline float EZBitsToFloat(unsigned int bits) { float value; memcpy(&value, &bits, sizeof(float)); return value; }
+
+inline float EZSmallFloatToFloat(unsigned int exponentAndMantissa, unsigned int mantissaBits, unsigned int exponentMax)
+{
+	// exponentAndMantissa holds the exponent and mantissa of
+	// a float with a 5-bit exponent, aligned to the bottom
+	unsigned int shift = 23 - mantissaBits;
+	if ((exponentAndMantissa >> mantissaBits) == exponentMax)
+		return EZBitsToFloat(0x7F800000u | ((exponentAndMantissa & ((1u << mantissaBits) - 1)) << shift));
+	return EZBitsToFloat(exponentAndMantissa << shift) * EZBitsToFloat(0x77800000u); // 2^112
+}
+
+inline float EZHalfToFloat(unsigned short half)
+{
+	// Signalling NaNs come out quiet, as they do from F16C
+	unsigned int exponentAndMantissa = half & 0x7FFFu;
+	if (exponentAndMantissa > 0x7C00u)
+		exponentAndMantissa |= 0x0200u;
+	float magnitude = EZSmallFloatToFloat(exponentAndMantissa, 10, 31);
+	return (half & 0x8000u) ? -magnitude : magnitude;
+}
+
+inline float EZUNormToFloat(unsigned int value, unsigned int bits) { return value / (float)((1u << bits) - 1); }
+inline float EZSNorm8ToFloat(signed char value) { return EZMax(value / 127.0f, -1.0f); }
+inline float EZSNorm16ToFloat(short value) { return EZMax(value / 32767.0f, -1.0f); }
+
+// --- EZSRGBToLinear -------------------------------------
+//  Converts an 8-bit sRGB encoded value to a linear float
+//  using a table built on first use
+// --------------------------------------------------------
+inline float EZSRGBToLinear(unsigned char value)
+{
+	struct Table
+	{
+		float Values[256];
+		Table()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				float c = i / 255.0f;
+				Values[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+		}
+	};
+	static const Table table;
+	return table.Values[value];
+}
+
+// --- EZDecodeChannels -----------------------------------
+//  Generic decoder for formats made of 1-4 equally sized
+//  channels in RGBA order.  Missing channels are filled
+//  with (0, 0, 0, 1), the same as sampling in a shader.
+// --------------------------------------------------------
+template<typename ChannelType, unsigned int Channels, typename OutputType, typename Convert>
+inline void EZDecodeChannels(const void* data, size_t count, OutputType* results, Convert convert)
+{
+	typedef decltype(results->x) OutputChannel;
+	const ChannelType* channels = static_cast<const ChannelType*>(data);
+	for (size_t i = 0; i < count; i++, channels += Channels)
+	{
+		results[i].x = convert(channels[0]);
+		results[i].y = Channels > 1 ? convert(channels[Channels > 1 ? 1 : 0]) : OutputChannel(0);
+		results[i].z = Channels > 2 ? convert(channels[Channels > 2 ? 2 : 0]) : OutputChannel(0);
+		results[i].w = Channels > 3 ? convert(channels[Channels > 3 ? 3 : 0]) : OutputChannel(1);
+	}
+}
+
+// --- EZDecodeHalf4 --------------------------------------
+//  Decodes 4-channel half floats, using F16C if available
+// --------------------------------------------------------
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx,f16c")
+inline void EZDecodeHalf4F16C(const unsigned short* halves, size_t count, DirectX::XMFLOAT4* results)
+{
+	float* out = reinterpret_cast<float*>(results);
+	size_t total = count * 4;
+	size_t i = 0;
+	for (; i + 8 <= total; i += 8)
+		_mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i))));
+	for (; i < total; i++)
+		out[i] = EZHalfToFloat(halves[i]);
+}
+#endif
+
+inline void EZDecodeHalf4(const void* data, size_t count, DirectX::XMFLOAT4* results)
+{
+	const unsigned short* halves = static_cast<const unsigned short*>(data);
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().F16C)
+	{
+		EZDecodeHalf4F16C(halves, count, results);
+		return;
+	}
+#endif
+	float* out = reinterpret_cast<float*>(results);
+	for (size_t i = 0; i < count * 4; i++)
+		out[i] = EZHalfToFloat(halves[i]);
+}
+
+// --- EZDecodeBGRA8 --------------------------------------
+//  Decodes 8-bit BGRA or BGRX texels by swizzling them to
+//  RGBA in small batches and then running the regular 
+//  unorm conversion (or the sRGB table) over each batch.
+// --------------------------------------------------------
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline void EZSwizzleBGRA8AVX2(const unsigned int* texels, size_t count, unsigned int* results, unsigned int alphaMask)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	const __m256i alpha = _mm256_set1_epi32((int)alphaMask);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i bgra = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(results + i), _mm256_or_si256(_mm256_shuffle_epi8(bgra, shuffle), alpha));
+	}
+	for (; i < count; i++)
+	{
+		unsigned int t = texels[i];
+		results[i] = ((t & 0xFF) << 16 | (t & 0xFF00) | (t >> 16 & 0xFF) | (t & 0xFF000000)) | alphaMask;
+	}
+}
+#endif
+
+inline void EZSwizzleBGRA8(const unsigned int* texels, size_t count, unsigned int* results, unsigned int alphaMask)
+{
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		EZSwizzleBGRA8AVX2(texels, count, results, alphaMask);
+		return;
+	}
+#endif
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int t = texels[i];
+		results[i] = ((t & 0xFF) << 16 | (t & 0xFF00) | (t >> 16 & 0xFF) | (t & 0xFF000000)) | alphaMask;
+	}
+}
+
+inline void EZDecodeUNorm8x4(const void* data, size_t count, DirectX::XMFLOAT4* results, bool bgra, bool noAlpha, bool srgb)
+{
+	const unsigned int* texels = static_cast<const unsigned int*>(data);
+	unsigned int alphaMask = noAlpha ? 0xFF000000u : 0;
+
+	// Batches are small enough to stay on the stack and in L1
+	const size_t batchSize = 256;
+	unsigned int batch[batchSize];
+	for (size_t start = 0; start < count; start += batchSize)
+	{
+		size_t batchCount = EZMin(batchSize, count - start);
+		const unsigned int* rgba = texels + start;
+		if (bgra || noAlpha)
+		{
+			if (bgra)
+				EZSwizzleBGRA8(rgba, batchCount, batch, alphaMask);
+			else
+				for (size_t i = 0; i < batchCount; i++) batch[i] = rgba[i] | alphaMask;
+			rgba = batch;
+		}
+
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(rgba);
+		if (!srgb)
+		{
+			EZConvertUNorm8ToFloat(bytes, batchCount * 4, &results[start].x);
+			continue;
+		}
+
+		for (size_t i = 0; i < batchCount; i++, bytes += 4)
+		{
+			results[start + i].x = EZSRGBToLinear(bytes[0]);
+			results[start + i].y = EZSRGBToLinear(bytes[1]);
+			results[start + i].z = EZSRGBToLinear(bytes[2]);
+			results[start + i].w = bytes[3] / 255.0f;
+		}
+	}
+}
+
+// --- EZDecodeR11G11B10 ----------------------------------
+//  Decodes the packed R11G11B10_FLOAT format, eight texels
+//  at a time with AVX2 if available
+// --------------------------------------------------------
+inline void EZDecodeR11G11B10Scalar(const unsigned int* texels, size_t count, DirectX::XMFLOAT4* results)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int t = texels[i];
+		results[i].x = EZSmallFloatToFloat(t & 0x7FF, 6, 31);
+		results[i].y = EZSmallFloatToFloat((t >> 11) & 0x7FF, 6, 31);
+		results[i].z = EZSmallFloatToFloat((t >> 22) & 0x3FF, 5, 31);
+		results[i].w = 1.0f;
+	}
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline __m256 EZSmallFloatToFloatAVX2(__m256i exponentAndMantissa, int mantissaBits)
+{
+	const __m256i count = _mm256_set1_epi32(mantissaBits);
+	__m256i shifted = _mm256_sll_epi32(exponentAndMantissa, _mm_cvtsi32_si128(23 - mantissaBits));
+	__m256 finite = _mm256_mul_ps(_mm256_castsi256_ps(shifted), _mm256_set1_ps(EZBitsToFloat(0x77800000u)));
+	__m256i special = _mm256_cmpeq_epi32(_mm256_srlv_epi32(exponentAndMantissa, count), _mm256_set1_epi32(31));
+	__m256i infNaN = _mm256_or_si256(_mm256_and_si256(shifted, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x7F800000));
+	return _mm256_blendv_ps(finite, _mm256_castsi256_ps(infNaN), _mm256_castsi256_ps(special));
+}
+
+EZREADBACK_TARGET("avx2")
+inline void EZDecodeR11G11B10AVX2(const unsigned int* texels, size_t count, DirectX::XMFLOAT4* results)
+{
+	const __m256i mask11 = _mm256_set1_epi32(0x7FF);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(texels + i));
+		__m256 r = EZSmallFloatToFloatAVX2(_mm256_and_si256(t, mask11), 6);
+		__m256 g = EZSmallFloatToFloatAVX2(_mm256_and_si256(_mm256_srli_epi32(t, 11), mask11), 6);
+		__m256 b = EZSmallFloatToFloatAVX2(_mm256_srli_epi32(t, 22), 5);
+
+		// Transpose the channel vectors into RGBA texels
+		__m256 rg0 = _mm256_unpacklo_ps(r, g);
+		__m256 rg1 = _mm256_unpackhi_ps(r, g);
+		__m256 ba0 = _mm256_unpacklo_ps(b, one);
+		__m256 ba1 = _mm256_unpackhi_ps(b, one);
+		__m256 t0 = _mm256_shuffle_ps(rg0, ba0, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 t1 = _mm256_shuffle_ps(rg0, ba0, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 t2 = _mm256_shuffle_ps(rg1, ba1, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 t3 = _mm256_shuffle_ps(rg1, ba1, _MM_SHUFFLE(3, 2, 3, 2));
+
+		float* out = &results[i].x;
+		_mm256_storeu_ps(out,      _mm256_permute2f128_ps(t0, t1, 0x20));
+		_mm256_storeu_ps(out + 8,  _mm256_permute2f128_ps(t2, t3, 0x20));
+		_mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(t0, t1, 0x31));
+		_mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(t2, t3, 0x31));
+	}
+	EZDecodeR11G11B10Scalar(texels + i, count - i, results + i);
+}
+#endif
+
+inline void EZDecodeR11G11B10(const void* data, size_t count, DirectX::XMFLOAT4* results)
+{
+	const unsigned int* texels = static_cast<const unsigned int*>(data);
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		EZDecodeR11G11B10AVX2(texels, count, results);
+		return;
+	}
+#endif
+	EZDecodeR11G11B10Scalar(texels, count, results);
+}
+
+// --- EZDecodePacked -------------------------------------
+//  Generic decoder for formats packed into one 16 or 32-bit
+//  value per texel.  The convert function receives the 
+//  packed value and the texel to fill.
+// --------------------------------------------------------
+template<typename PackedType, typename OutputType, typename Convert>
+inline void EZDecodePacked(const void* data, size_t count, OutputType* results, Convert convert)
+{
+	const PackedType* texels = static_cast<const PackedType*>(data);
+	for (size_t i = 0; i < count; i++)
+		convert(texels[i], results[i]);
+}
+
+// --- EZDecodeToFloat4 -----------------------------------
+//  Decodes texels of the given format into float4 values.
+//  UNORM/SNORM channels become 0-1 or -1-1 floats, sRGB
+//  channels are converted to linear, integer channels are
+//  converted to their float value and missing channels are
+//  filled with (0, 0, 0, 1).  Depth/stencil formats put
+//  depth in x and the stencil value in y.
 // 
-//  Valid resource types are: 
-//  - ID3D11Buffer
-//  - ID3D11Texture1D
-//  - ID3D11Texture2D
-//  - ID3D11Texture3D
+//  This is a CPU-only operation and does not touch D3D.
+//  Passing a count of zero just checks whether the format
+//  is supported.
 // 
 //  Parameters:
-//  - resource: GPU resource to read
-//  - results: vector to fill with data
-//  - mipLevel: mip level to read (for texture resources)
-//  - arrayIndex: array element to read (for 1D/2D textures)
+//  - format: format of the texels
+//  - data: tightly packed texels to decode
+//  - count: number of texels
+//  - results: array of at least count elements to fill
 // 
 // 	Returns:
-//  - Return value is an HRESULT from any failed D3D calls 
-//    or S_OK if all D3D calls were successful.
-// -------------------------------------------------------
-template<typename ElementType>
-HRESULT EZReadback::Read(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+//  - E_INVALIDARG if the format is not supported (such as
+//    block compressed, video and typeless formats), or
+//    S_OK otherwise.  Block compressed formats are handled
+//    by EZDecodeBCToFloat4() instead.
+// --------------------------------------------------------
+inline HRESULT EZDecodeToFloat4(DXGI_FORMAT format, const void* data, size_t count, DirectX::XMFLOAT4* results)
 {
-	D3D11_RESOURCE_DIMENSION type;
-	resource->GetType(&type);
-	switch (type)
+	using DirectX::XMFLOAT4;
+	auto asFloat = [](auto value) { return (float)value; };
+	auto unorm8 = [](unsigned char value) { return value / 255.0f; };
+	auto unorm16 = [](unsigned short value) { return value / 65535.0f; };
+	auto half = [](unsigned short value) { return EZHalfToFloat(value); };
+
+	switch (format)
 	{
-	case D3D11_RESOURCE_DIMENSION_BUFFER: 
-		return StageAndCopyResource<ID3D11Buffer, D3D11_BUFFER_DESC, ElementType>(static_cast<ID3D11Buffer*>(resource), mipLevel, arrayIndex, results);
+	// 32-bit channels
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: if (count) memcpy(results, data, count * sizeof(XMFLOAT4)); return S_OK;
+	case DXGI_FORMAT_R32G32B32A32_UINT:  EZDecodeChannels<unsigned int, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32B32A32_SINT:  EZDecodeChannels<int, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32B32_FLOAT:    EZDecodeChannels<float, 3>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32B32_UINT:     EZDecodeChannels<unsigned int, 3>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32B32_SINT:     EZDecodeChannels<int, 3>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32_FLOAT:       EZDecodeChannels<float, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32_UINT:        EZDecodeChannels<unsigned int, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32G32_SINT:        EZDecodeChannels<int, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_D32_FLOAT:          EZDecodeChannels<float, 1>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32_UINT:           EZDecodeChannels<unsigned int, 1>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R32_SINT:           EZDecodeChannels<int, 1>(data, count, results, asFloat); return S_OK;
 
-	case D3D11_RESOURCE_DIMENSION_TEXTURE1D: 
-		return StageAndCopyResource<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, ElementType>(static_cast<ID3D11Texture1D*>(resource), mipLevel, arrayIndex, results);
+	// 16-bit channels
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: EZDecodeHalf4(data, count, results); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_UNORM: EZDecodeChannels<unsigned short, 4>(data, count, results, unorm16); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_SNORM: EZDecodeChannels<short, 4>(data, count, results, EZSNorm16ToFloat); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_UINT:  EZDecodeChannels<unsigned short, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_SINT:  EZDecodeChannels<short, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R16G16_FLOAT:       EZDecodeChannels<unsigned short, 2>(data, count, results, half); return S_OK;
+	case DXGI_FORMAT_R16G16_UNORM:       EZDecodeChannels<unsigned short, 2>(data, count, results, unorm16); return S_OK;
+	case DXGI_FORMAT_R16G16_SNORM:       EZDecodeChannels<short, 2>(data, count, results, EZSNorm16ToFloat); return S_OK;
+	case DXGI_FORMAT_R16G16_UINT:        EZDecodeChannels<unsigned short, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R16G16_SINT:        EZDecodeChannels<short, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R16_FLOAT:          EZDecodeChannels<unsigned short, 1>(data, count, results, half); return S_OK;
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_D16_UNORM:          EZDecodeChannels<unsigned short, 1>(data, count, results, unorm16); return S_OK;
+	case DXGI_FORMAT_R16_SNORM:          EZDecodeChannels<short, 1>(data, count, results, EZSNorm16ToFloat); return S_OK;
+	case DXGI_FORMAT_R16_UINT:           EZDecodeChannels<unsigned short, 1>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R16_SINT:           EZDecodeChannels<short, 1>(data, count, results, asFloat); return S_OK;
 
-	case D3D11_RESOURCE_DIMENSION_TEXTURE2D: 
-		return StageAndCopyResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, ElementType>(static_cast<ID3D11Texture2D*>(resource), mipLevel, arrayIndex, results);
+	// 8-bit channels
+	case DXGI_FORMAT_R8G8B8A8_UNORM:      EZDecodeUNorm8x4(data, count, results, false, false, false); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: EZDecodeUNorm8x4(data, count, results, false, false, true); return S_OK;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:      EZDecodeUNorm8x4(data, count, results, true, false, false); return S_OK;
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: EZDecodeUNorm8x4(data, count, results, true, false, true); return S_OK;
+	case DXGI_FORMAT_B8G8R8X8_UNORM:      EZDecodeUNorm8x4(data, count, results, true, true, false); return S_OK;
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB: EZDecodeUNorm8x4(data, count, results, true, true, true); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_SNORM:      EZDecodeChannels<signed char, 4>(data, count, results, EZSNorm8ToFloat); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_UINT:       EZDecodeChannels<unsigned char, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_SINT:       EZDecodeChannels<signed char, 4>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R8G8_UNORM:          EZDecodeChannels<unsigned char, 2>(data, count, results, unorm8); return S_OK;
+	case DXGI_FORMAT_R8G8_SNORM:          EZDecodeChannels<signed char, 2>(data, count, results, EZSNorm8ToFloat); return S_OK;
+	case DXGI_FORMAT_R8G8_UINT:           EZDecodeChannels<unsigned char, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R8G8_SINT:           EZDecodeChannels<signed char, 2>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R8_UNORM:            EZDecodeChannels<unsigned char, 1>(data, count, results, unorm8); return S_OK;
+	case DXGI_FORMAT_R8_SNORM:            EZDecodeChannels<signed char, 1>(data, count, results, EZSNorm8ToFloat); return S_OK;
+	case DXGI_FORMAT_R8_UINT:             EZDecodeChannels<unsigned char, 1>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_R8_SINT:             EZDecodeChannels<signed char, 1>(data, count, results, asFloat); return S_OK;
+	case DXGI_FORMAT_A8_UNORM:
+		EZDecodePacked<unsigned char>(data, count, results, [](unsigned char t, XMFLOAT4& out) { out = XMFLOAT4(0, 0, 0, t / 255.0f); });
+		return S_OK;
 
-	case D3D11_RESOURCE_DIMENSION_TEXTURE3D: 
-		return StageAndCopyResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, ElementType>(static_cast<ID3D11Texture3D*>(resource), mipLevel, arrayIndex, results);
+	// Packed formats
+	case DXGI_FORMAT_R11G11B10_FLOAT: EZDecodeR11G11B10(data, count, results); return S_OK;
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZUNormToFloat(t & 0x3FF, 10), EZUNormToFloat((t >> 10) & 0x3FF, 10), EZUNormToFloat((t >> 20) & 0x3FF, 10), EZUNormToFloat(t >> 30, 2)); });
+		return S_OK;
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMFLOAT4& out) {
+			out = XMFLOAT4((float)(t & 0x3FF), (float)((t >> 10) & 0x3FF), (float)((t >> 20) & 0x3FF), (float)(t >> 30)); });
+		return S_OK;
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMFLOAT4& out) {
+			float scale = EZBitsToFloat(((t >> 27) + 127 - 15 - 9) << 23); // 2^(exponent - bias - mantissa bits)
+			out = XMFLOAT4((t & 0x1FF) * scale, ((t >> 9) & 0x1FF) * scale, ((t >> 18) & 0x1FF) * scale, 1.0f); });
+		return S_OK;
+	case DXGI_FORMAT_B5G6R5_UNORM:
+		EZDecodePacked<unsigned short>(data, count, results, [](unsigned short t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZUNormToFloat(t >> 11, 5), EZUNormToFloat((t >> 5) & 0x3F, 6), EZUNormToFloat(t & 0x1F, 5), 1.0f); });
+		return S_OK;
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+		EZDecodePacked<unsigned short>(data, count, results, [](unsigned short t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZUNormToFloat((t >> 10) & 0x1F, 5), EZUNormToFloat((t >> 5) & 0x1F, 5), EZUNormToFloat(t & 0x1F, 5), (float)(t >> 15)); });
+		return S_OK;
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		EZDecodePacked<unsigned short>(data, count, results, [](unsigned short t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZUNormToFloat((t >> 8) & 0xF, 4), EZUNormToFloat((t >> 4) & 0xF, 4), EZUNormToFloat(t & 0xF, 4), EZUNormToFloat(t >> 12, 4)); });
+		return S_OK;
+
+	// Depth/stencil formats
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZUNormToFloat(t & 0xFFFFFF, 24), (float)(t >> 24), 0.0f, 1.0f); });
+		return S_OK;
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+		EZDecodePacked<unsigned long long>(data, count, results, [](unsigned long long t, XMFLOAT4& out) {
+			out = XMFLOAT4(EZBitsToFloat((unsigned int)t), (float)((t >> 32) & 0xFF), 0.0f, 1.0f); });
+		return S_OK;
+
+	default:
+		break;
 	}
 
 	return E_INVALIDARG;
 }
 
-
-// --- Read functions for views ---------------------------
-//  Reads data of the specified ElementType from a 
-//  specific subresource the resource in the given view and 
-//  populates the given vector with results.  Note that
-//  ID3D11Buffers do not have explicit subresources and
-//  will always read the entire resource (ignoring mipLevel
-//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
-//  resources do not support arrays, so arrayIndex is ignored.
-// 
-//  ElementType:
-//  - Expected data type to read from the resource.  Note that
-//    this must match the size of the actual elements in the
-//    resource or the function will fail.
+// --- EZDecodeToUInt4 ------------------------------------
+//  Decodes texels of an integer format into uint4 values.
+//  Signed channels are sign extended, so casting back to
+//  int gives their value.  Missing channels are filled 
+//  with (0, 0, 0, 1).  Depth/stencil formats put the raw
+//  depth bits in x and the stencil value in y.
 // 
-//  Valid view types are: 
-//  - ID3D11ShaderResourceView
-//  - ID3D11UnorderedAccessView
+//  This is a CPU-only operation and does not touch D3D.
+//  Passing a count of zero just checks whether the format
+//  is supported.
 // 
 //  Parameters:
-//  - resource: GPU resource to read
-//  - results: vector to fill with data
-//  - mipLevel: mip level to read (for texture resources)
-//  - arrayIndex: array element to read (for 1D/2D textures)
+//  - format: format of the texels
+//  - data: tightly packed texels to decode
+//  - count: number of texels
+//  - results: array of at least count elements to fill
 // 
 // 	Returns:
-//  - Return value is an HRESULT from any failed D3D calls 
-//    or S_OK if all D3D calls were successful.
-// -------------------------------------------------------
-template<typename ElementType>
-HRESULT EZReadback::Read(ID3D11View* view, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+//  - E_INVALIDARG if the format is not an integer format,
+//    or S_OK otherwise.
+// --------------------------------------------------------
+inline HRESULT EZDecodeToUInt4(DXGI_FORMAT format, const void* data, size_t count, DirectX::XMUINT4* results)
 {
-	ID3D11Resource* resource;
-	view->GetResource(&resource);
-	return Read(resource, results, mipLevel, arrayIndex);
+	using DirectX::XMUINT4;
+	auto asUInt = [](auto value) { return (unsigned int)value; };
+
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT: if (count) memcpy(results, data, count * sizeof(XMUINT4)); return S_OK;
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:    EZDecodeChannels<unsigned int, 3>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:       EZDecodeChannels<unsigned int, 2>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_R32_SINT:          EZDecodeChannels<unsigned int, 1>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_UINT: EZDecodeChannels<unsigned short, 4>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16G16B16A16_SINT: EZDecodeChannels<short, 4>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16G16_UINT:       EZDecodeChannels<unsigned short, 2>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16G16_SINT:       EZDecodeChannels<short, 2>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16_UINT:          EZDecodeChannels<unsigned short, 1>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R16_SINT:          EZDecodeChannels<short, 1>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_UINT:     EZDecodeChannels<unsigned char, 4>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8G8B8A8_SINT:     EZDecodeChannels<signed char, 4>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8G8_UINT:         EZDecodeChannels<unsigned char, 2>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8G8_SINT:         EZDecodeChannels<signed char, 2>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8_UINT:           EZDecodeChannels<unsigned char, 1>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R8_SINT:           EZDecodeChannels<signed char, 1>(data, count, results, asUInt); return S_OK;
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMUINT4& out) {
+			out = XMUINT4(t & 0x3FF, (t >> 10) & 0x3FF, (t >> 20) & 0x3FF, t >> 30); });
+		return S_OK;
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+		EZDecodePacked<unsigned int>(data, count, results, [](unsigned int t, XMUINT4& out) {
+			out = XMUINT4(t & 0xFFFFFF, t >> 24, 0, 1); });
+		return S_OK;
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+		EZDecodePacked<unsigned long long>(data, count, results, [](unsigned long long t, XMUINT4& out) {
+			out = XMUINT4((unsigned int)t, (unsigned int)(t >> 32) & 0xFF, 0, 1); });
+		return S_OK;
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+// --- EZDepthOptions -------------------------------------
+//  Settings for EZDecodeDepthStencil() and ReadDepth().
+//  Linearizing turns 0-1 depth from a standard D3D 
+//  perspective projection back into view-space distance.
+//  For reversed Z, swap the near and far planes.
+// --------------------------------------------------------
+struct EZDepthOptions
+{
+	bool Linearize;  // Whether to convert depth to view-space distance
+	float NearPlane; // Distance to the near plane, for linearizing
+	float FarPlane;  // Distance to the far plane, for linearizing
+
+	EZDepthOptions() : Linearize{ false }, NearPlane{ 0.1f }, FarPlane{ 1000.0f } {}
+};
+
+// --- EZDepthLayout --------------------------------------
+//  How depth and stencil are packed in each texel of a
+//  depth/stencil format, or EZDepthLayoutNone for formats
+//  that hold no depth or stencil.  Typeless formats count
+//  when they can only be depth/stencil.
+// --------------------------------------------------------
+enum EZDepthLayout
+{
+	EZDepthLayoutNone,
+	EZDepthLayoutD16,    // 16-bit UNORM depth
+	EZDepthLayoutD24S8,  // 24-bit UNORM depth in the low bits, stencil in the top byte
+	EZDepthLayoutD32,    // 32-bit float depth
+	EZDepthLayoutD32S8,  // 32-bit float depth, then stencil in the next byte and 24 unused bits
+};
+
+inline EZDepthLayout EZGetDepthLayout(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_D16_UNORM:
+		return EZDepthLayoutD16;
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+		return EZDepthLayoutD24S8;
+	case DXGI_FORMAT_D32_FLOAT:
+		return EZDepthLayoutD32;
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+		return EZDepthLayoutD32S8;
+	default:
+		break;
+	}
+	return EZDepthLayoutNone;
+}
+
+inline bool EZHasStencil(EZDepthLayout layout) { return layout == EZDepthLayoutD24S8 || layout == EZDepthLayoutD32S8; }
+
+// --- EZDecodeDepthStencil -------------------------------
+//  Splits depth/stencil texels into a plane of float depth
+//  and a plane of 8-bit stencil values in one pass.  Either
+//  plane can be skipped by passing null.  UNORM depth is
+//  converted the same way as EZDecodeToFloat4() does, and
+//  the AVX2 version does the same math as the scalar one.
+//  This is a CPU-only operation and does not touch D3D.
+// 
+//  Parameters:
+//  - layout: how the texels are packed
+//  - data: tightly packed texels
+//  - count: number of texels
+//  - depth: count floats to fill, or null
+//  - stencil: count bytes to fill, or null
+//  - options: linearizing settings
+// --------------------------------------------------------
+inline void EZDecodeDepthStencilScalar(EZDepthLayout layout, const unsigned char* data, size_t count, float* depth, unsigned char* stencil, const EZDepthOptions& options)
+{
+	// Linear depth is near * far / (far - depth * (far - near))
+	float numerator = options.NearPlane * options.FarPlane;
+	float range = options.FarPlane - options.NearPlane;
+	for (size_t i = 0; i < count; i++)
+	{
+		float value = 0.0f;
+		unsigned char stencilValue = 0;
+		unsigned int bits;
+		unsigned short bits16;
+		switch (layout)
+		{
+		case EZDepthLayoutD16:
+			memcpy(&bits16, data + i * 2, 2);
+			value = bits16 / 65535.0f;
+			break;
+		case EZDepthLayoutD24S8:
+			memcpy(&bits, data + i * 4, 4);
+			value = (bits & 0xFFFFFF) / 16777215.0f;
+			stencilValue = (unsigned char)(bits >> 24);
+			break;
+		case EZDepthLayoutD32:
+			memcpy(&value, data + i * 4, 4);
+			break;
+		case EZDepthLayoutD32S8:
+			memcpy(&value, data + i * 8, 4);
+			stencilValue = data[i * 8 + 4];
+			break;
+		default:
+			break;
+		}
+
+		if (depth)
+			depth[i] = options.Linearize ? numerator / (options.FarPlane - value * range) : value;
+		if (stencil)
+			stencil[i] = stencilValue;
+	}
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline void EZDecodeDepthStencilAVX2(EZDepthLayout layout, const unsigned char* data, size_t count, float* depth, unsigned char* stencil, const EZDepthOptions& options)
+{
+	const __m256i mask24 = _mm256_set1_epi32(0xFFFFFF);
+	const __m256 max24 = _mm256_set1_ps(16777215.0f);
+	const __m256 max16 = _mm256_set1_ps(65535.0f);
+	const __m256 numerator = _mm256_set1_ps(options.NearPlane * options.FarPlane);
+	const __m256 farPlane = _mm256_set1_ps(options.FarPlane);
+	const __m256 range = _mm256_set1_ps(options.FarPlane - options.NearPlane);
+
+	// Gathers byte 3 (or byte 0) of each dword into the low dword of each half
+	const __m256i pickByte3 = _mm256_setr_epi8(3, 7, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	                                           3, 7, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i pickByte0 = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	                                           0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m256i joinHalves = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+	const __m256i evenOdd = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 value;
+		__m256i stencilBytes = _mm256_setzero_si256();
+		switch (layout)
+		{
+		case EZDepthLayoutD16:
+			value = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 2)))), max16);
+			break;
+		case EZDepthLayoutD24S8:
+		{
+			__m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 4));
+			value = _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texels, mask24)), max24);
+			stencilBytes = _mm256_shuffle_epi8(texels, pickByte3);
+			break;
+		}
+		case EZDepthLayoutD32:
+			value = _mm256_loadu_ps(reinterpret_cast<const float*>(data + i * 4));
+			break;
+		default:
+		{
+			// Split eight 64-bit texels into their depth and stencil dwords
+			__m256i first = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 8)), evenOdd);
+			__m256i second = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 8 + 32)), evenOdd);
+			value = _mm256_castsi256_ps(_mm256_permute2x128_si256(first, second, 0x20));
+			stencilBytes = _mm256_shuffle_epi8(_mm256_permute2x128_si256(first, second, 0x31), pickByte0);
+			break;
+		}
+		}
+
+		if (depth)
+		{
+			if (options.Linearize)
+				value = _mm256_div_ps(numerator, _mm256_sub_ps(farPlane, _mm256_mul_ps(value, range)));
+			_mm256_storeu_ps(depth + i, value);
+		}
+		if (stencil)
+		{
+			stencilBytes = _mm256_permutevar8x32_epi32(stencilBytes, joinHalves);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(stencil + i), _mm256_castsi256_si128(stencilBytes));
+		}
+	}
+
+	size_t texelSize = layout == EZDepthLayoutD16 ? 2 : layout == EZDepthLayoutD32S8 ? 8 : 4;
+	EZDecodeDepthStencilScalar(layout, data + i * texelSize, count - i, depth ? depth + i : nullptr, stencil ? stencil + i : nullptr, options);
+}
+#endif
+
+inline void EZDecodeDepthStencil(EZDepthLayout layout, const void* data, size_t count, float* depth, unsigned char* stencil, const EZDepthOptions& options = EZDepthOptions())
+{
+	if (layout == EZDepthLayoutNone)
+		return;
+
+	const unsigned char* texels = static_cast<const unsigned char*>(data);
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		EZDecodeDepthStencilAVX2(layout, texels, count, depth, stencil, options);
+		return;
+	}
+#endif
+	EZDecodeDepthStencilScalar(layout, texels, count, depth, stencil, options);
+}
+
+// --- EZThreadPool ---------------------------------------
+//  Worker threads kept alive between calls, so that
+//  EZParallelFor() and background work such as capture
+//  compression do not start and join threads every time.
+//  Get() returns the pool they share.  Threads are started
+//  on demand and live until the pool is destroyed.
+// 
+//  Tasks are counted in a caller-owned counter that Wait()
+//  blocks on.  A waiting thread runs queued tasks itself,
+//  so tasks may wait on tasks of their own, and work that
+//  no thread could be started for still gets done.
+// --------------------------------------------------------
+class EZThreadPool
+{
+public:
+
+	EZThreadPool() : stopping{ false } {}
+	inline ~EZThreadPool();
+	EZThreadPool(const EZThreadPool&) = delete;
+	EZThreadPool& operator=(const EZThreadPool&) = delete;
+
+	static inline EZThreadPool& Get()
+	{
+		static EZThreadPool pool;
+		return pool;
+	}
+
+	inline void Reserve(size_t threadCount);
+	inline void Submit(std::function<void()> task, std::atomic<size_t>& pending);
+	inline void Wait(std::atomic<size_t>& pending);
+
+	inline size_t GetThreadCount() { std::lock_guard<std::mutex> guard(lock); return threads.size(); }
+
+private:
+
+	struct Task
+	{
+		std::function<void()> Function;
+		std::atomic<size_t>* Pending;
+	};
+
+	std::vector<std::thread> threads;
+	std::deque<Task> tasks;
+	std::mutex lock;
+	std::condition_variable wake;   // Workers wait here for tasks
+	std::condition_variable done;   // Wait() waits here for tasks to finish
+	bool stopping;
+
+	inline void RunTask(Task& task);
+	inline void Run();
+};
+
+
+// --- EZThreadPool::~EZThreadPool ------------------------
+//  Runs the tasks still queued and joins the threads
+// --------------------------------------------------------
+inline EZThreadPool::~EZThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+
+// --- EZThreadPool::Reserve ------------------------------
+//  Starts threads until the pool has at least threadCount.
+//  Threads that cannot be started are simply left out.
+// --------------------------------------------------------
+inline void EZThreadPool::Reserve(size_t threadCount)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	while (threads.size() < threadCount)
+	{
+		try { threads.emplace_back(&EZThreadPool::Run, this); }
+		catch (...) { return; }
+	}
+}
+
+
+// --- EZThreadPool::Submit -------------------------------
+//  Queues a task for the next free thread, counting it in
+//  pending until it has run.  If it cannot be queued, it
+//  runs on the calling thread instead.
+// --------------------------------------------------------
+inline void EZThreadPool::Submit(std::function<void()> task, std::atomic<size_t>& pending)
+{
+	pending++;
+	Task queued{ std::move(task), &pending };
+	try
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		tasks.push_back(std::move(queued));
+	}
+	catch (...)
+	{
+		// push_back() leaves the task alone when it throws
+		RunTask(queued);
+		return;
+	}
+	wake.notify_one();
+}
+
+
+// --- EZThreadPool::Wait ---------------------------------
+//  Blocks until every task counted in pending has run,
+//  running queued tasks (of any caller) meanwhile
+// --------------------------------------------------------
+inline void EZThreadPool::Wait(std::atomic<size_t>& pending)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (pending.load() > 0)
+	{
+		if (tasks.empty())
+		{
+			done.wait(guard);
+			continue;
+		}
+
+		Task task = std::move(tasks.front());
+		tasks.pop_front();
+		guard.unlock();
+		RunTask(task);
+		guard.lock();
+	}
+}
+
+
+// --- EZThreadPool::RunTask ------------------------------
+//  Private helper that runs a task and wakes the threads
+//  waiting on its counter once it has run
+// --------------------------------------------------------
+inline void EZThreadPool::RunTask(Task& task)
+{
+	task.Function();
+	task.Function = nullptr;
+
+	// Waiters check the counter under the lock, so they
+	// cannot miss the notification
+	if (--*task.Pending == 0)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		done.notify_all();
+	}
+}
+
+
+// --- EZThreadPool::Run ----------------------------------
+//  Body of each worker thread
+// --------------------------------------------------------
+inline void EZThreadPool::Run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;)
+	{
+		wake.wait(guard, [this] { return !tasks.empty() || stopping; });
+		if (tasks.empty())
+			return;
+
+		Task task = std::move(tasks.front());
+		tasks.pop_front();
+		guard.unlock();
+		RunTask(task);
+		guard.lock();
+	}
+}
+
+
+// --- EZParallelFor --------------------------------------
+//  Splits the range [0, count) into contiguous chunks and
+//  calls function(begin, end) once per chunk, using up to
+//  threadCount threads including the calling thread.  A
+//  threadCount of zero uses every hardware thread.  Each
+//  chunk gets at least minimumPerThread items, so small
+//  jobs simply run on the calling thread.
+//
+//  The other chunks run on EZThreadPool::Get(), which 
+//  keeps its threads between calls.
+// --------------------------------------------------------
+template<typename Function>
+inline void EZParallelFor(size_t count, unsigned int threadCount, size_t minimumPerThread, Function function)
+{
+	if (count == 0)
+		return;
+
+	if (threadCount == 0)
+		threadCount = EZMax(std::thread::hardware_concurrency(), 1u);
+
+	size_t threads = EZMin((size_t)threadCount, EZMax(count / EZMax(minimumPerThread, (size_t)1), (size_t)1));
+	if (threads == 1)
+	{
+		function((size_t)0, count);
+		return;
+	}
+
+	// Hand out chunks, keeping the last one for this thread
+	EZThreadPool& pool = EZThreadPool::Get();
+	pool.Reserve(threads - 1);
+	std::atomic<size_t> pending{ 0 };
+	size_t chunk = count / threads;
+	size_t extra = count % threads;
+	size_t begin = 0;
+	for (size_t t = 0; t < threads; t++)
+	{
+		size_t end = begin + chunk + (t < extra ? 1 : 0);
+		if (t + 1 < threads)
+			pool.Submit([&function, begin, end] { function(begin, end); }, pending);
+		else
+			function(begin, end);
+		begin = end;
+	}
+
+	pool.Wait(pending);
+}
+
+// --- EZBlock8 / EZBlock16 -------------------------------
+//  Raw 4x4 texel blocks of block compressed formats.
+//  Reading a BC texture with one of these as the element
+//  type returns its blocks exactly as stored, in rows of
+//  blocks.  BC1 and BC4 use 8 byte blocks, all other BC
+//  formats use 16 byte blocks.
+// --------------------------------------------------------
+struct EZBlock8 { unsigned char Bytes[8]; };
+struct EZBlock16 { unsigned char Bytes[16]; };
+
+// --- EZIsBlockCompressed --------------------------------
+//  Checks whether a format is one of the BC1-BC7 formats
+// --------------------------------------------------------
+inline constexpr bool EZIsBlockCompressed(DXGI_FORMAT format)
+{
+	return
+		(format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+		(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+// --- EZIsPlanar -----------------------------------------
+//  Checks whether a format is a planar video format, with
+//  separate luma and chroma planes in each subresource
+// --------------------------------------------------------
+inline constexpr bool EZIsPlanar(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_NV11:
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+	case DXGI_FORMAT_420_OPAQUE:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+// --- EZPlaneLayout --------------------------------------
+//  Size of one plane of a planar video format.  The chroma
+//  plane holds interleaved U/V pairs, so each of its rows
+//  has Width pairs of samples.
+// --------------------------------------------------------
+struct EZPlaneLayout
+{
+	UINT Width;      // Samples per row, or U/V pairs per row for chroma
+	UINT Height;     // Rows
+	UINT RowBytes;   // Bytes in each row, tightly packed
+	UINT SampleSize; // Bytes per Y, U or V sample
+};
+
+// --- EZGetPlaneLayouts ----------------------------------
+//  Lays out the luma and chroma planes of a 4:2:0 planar
+//  format (NV12, P010 or P016) of the given size.  When
+//  such a texture is mapped, its chroma plane follows the
+//  luma plane, starting Height rows into the mapped data
+//  and using the same row pitch.  P010 keeps its 10 bits
+//  in the top of each 16-bit sample.
+// 
+// 	Returns:
+//  - false for other formats, including NV11 and opaque
+//    formats whose layout is up to the driver
+// --------------------------------------------------------
+inline bool EZGetPlaneLayouts(DXGI_FORMAT format, UINT width, UINT height, EZPlaneLayout& luma, EZPlaneLayout& chroma)
+{
+	UINT sampleSize;
+	switch (format)
+	{
+	case DXGI_FORMAT_NV12: sampleSize = 1; break;
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016: sampleSize = 2; break;
+	default: return false;
+	}
+
+	luma.Width = width;
+	luma.Height = height;
+	luma.RowBytes = width * sampleSize;
+	luma.SampleSize = sampleSize;
+	chroma.Width = (width + 1) / 2;
+	chroma.Height = (height + 1) / 2;
+	chroma.RowBytes = chroma.Width * 2 * sampleSize;
+	chroma.SampleSize = sampleSize;
+	return true;
+}
+
+// --- EZBytesPerBlock ------------------------------------
+//  Returns the size of one 4x4 block of a BC format, or
+//  zero for formats that are not block compressed
+// --------------------------------------------------------
+inline constexpr size_t EZBytesPerBlock(DXGI_FORMAT format)
+{
+	if (!EZIsBlockCompressed(format))
+		return 0;
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 8;
+	default:
+		break;
+	}
+	return 16;
+}
+
+// --- EZBlockBits ----------------------------------------
+//  Reads bit fields, lowest bit first, out of a 16 byte
+//  BC6H or BC7 block
+// --------------------------------------------------------
+struct EZBlockBits
+{
+	unsigned long long Low;
+	unsigned long long High;
+	unsigned int Position;
+
+	EZBlockBits(const unsigned char* block) : Position{ 0 }
+	{
+		memcpy(&Low, block, sizeof(Low));
+		memcpy(&High, block + 8, sizeof(High));
+	}
+
+	inline unsigned int Read(unsigned int count)
+	{
+		unsigned long long bits;
+		if (Position >= 64) bits = High >> (Position - 64);
+		else if (Position + count <= 64) bits = Low >> Position;
+		else bits = (Low >> Position) | (High << (64 - Position));
+		Position += count;
+		return (unsigned int)bits & ((1u << count) - 1);
+	}
+};
+
+// --- BC partition tables --------------------------------
+//  Partition shapes and anchor texels shared by BC6H and
+//  BC7, as listed in the D3D11 BC7 format specification.
+//  Two-subset shapes are stored as one bit per texel;
+//  three-subset shapes as one subset index per texel.
+// --------------------------------------------------------
+static const unsigned short EZBCPartitions2[64] =
+{
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+static const unsigned char EZBCPartitions3[64][16] =
+{
+	{ 0,0,1,1, 0,0,1,1, 0,2,2,1, 2,2,2,2 }, { 0,0,0,1, 0,0,1,1, 2,2,1,1, 2,2,2,1 }, { 0,0,0,0, 2,0,0,1, 2,2,1,1, 2,2,1,1 }, { 0,2,2,2, 0,0,2,2, 0,0,1,1, 0,1,1,1 },
+	{ 0,0,0,0, 0,0,0,0, 1,1,2,2, 1,1,2,2 }, { 0,0,1,1, 0,0,1,1, 0,0,2,2, 0,0,2,2 }, { 0,0,2,2, 0,0,2,2, 1,1,1,1, 1,1,1,1 }, { 0,0,1,1, 0,0,1,1, 2,2,1,1, 2,2,1,1 },
+	{ 0,0,0,0, 0,0,0,0, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 2,2,2,2, 2,2,2,2 }, { 0,0,1,2, 0,0,1,2, 0,0,1,2, 0,0,1,2 },
+	{ 0,1,1,2, 0,1,1,2, 0,1,1,2, 0,1,1,2 }, { 0,1,2,2, 0,1,2,2, 0,1,2,2, 0,1,2,2 }, { 0,0,1,1, 0,1,1,2, 1,1,2,2, 1,2,2,2 }, { 0,0,1,1, 2,0,0,1, 2,2,0,0, 2,2,2,0 },
+	{ 0,0,0,1, 0,0,1,1, 0,1,1,2, 1,1,2,2 }, { 0,1,1,1, 0,0,1,1, 2,0,0,1, 2,2,0,0 }, { 0,0,0,0, 1,1,2,2, 1,1,2,2, 1,1,2,2 }, { 0,0,2,2, 0,0,2,2, 0,0,2,2, 1,1,1,1 },
+	{ 0,1,1,1, 0,1,1,1, 0,2,2,2, 0,2,2,2 }, { 0,0,0,1, 0,0,0,1, 2,2,2,1, 2,2,2,1 }, { 0,0,0,0, 0,0,1,1, 0,1,2,2, 0,1,2,2 }, { 0,0,0,0, 1,1,0,0, 2,2,1,0, 2,2,1,0 },
+	{ 0,1,2,2, 0,1,2,2, 0,0,1,1, 0,0,0,0 }, { 0,0,1,2, 0,0,1,2, 1,1,2,2, 2,2,2,2 }, { 0,1,1,0, 1,2,2,1, 1,2,2,1, 0,1,1,0 }, { 0,0,0,0, 0,1,1,0, 1,2,2,1, 1,2,2,1 },
+	{ 0,0,2,2, 1,1,0,2, 1,1,0,2, 0,0,2,2 }, { 0,1,1,0, 0,1,1,0, 2,0,0,2, 2,2,2,2 }, { 0,0,1,1, 0,1,2,2, 0,1,2,2, 0,0,1,1 }, { 0,0,0,0, 2,0,0,0, 2,2,1,1, 2,2,2,1 },
+	{ 0,0,0,0, 0,0,0,2, 1,1,2,2, 1,2,2,2 }, { 0,2,2,2, 0,0,2,2, 0,0,1,2, 0,0,1,1 }, { 0,0,1,1, 0,0,1,2, 0,0,2,2, 0,2,2,2 }, { 0,1,2,0, 0,1,2,0, 0,1,2,0, 0,1,2,0 },
+	{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 0,0,0,0 }, { 0,1,2,0, 1,2,0,1, 2,0,1,2, 0,1,2,0 }, { 0,1,2,0, 2,0,1,2, 1,2,0,1, 0,1,2,0 }, { 0,0,1,1, 2,2,0,0, 1,1,2,2, 0,0,1,1 },
+	{ 0,0,1,1, 1,1,2,2, 2,2,0,0, 0,0,1,1 }, { 0,1,0,1, 0,1,0,1, 2,2,2,2, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,2,1, 2,1,2,1 }, { 0,0,2,2, 1,1,2,2, 0,0,2,2, 1,1,2,2 },
+	{ 0,0,2,2, 0,0,1,1, 0,0,2,2, 0,0,1,1 }, { 0,2,2,0, 1,2,2,1, 0,2,2,0, 1,2,2,1 }, { 0,1,0,1, 2,2,2,2, 2,2,2,2, 0,1,0,1 }, { 0,0,0,0, 2,1,2,1, 2,1,2,1, 2,1,2,1 },
+	{ 0,1,0,1, 0,1,0,1, 0,1,0,1, 2,2,2,2 }, { 0,2,2,2, 0,1,1,1, 0,2,2,2, 0,1,1,1 }, { 0,0,0,2, 1,1,1,2, 0,0,0,2, 1,1,1,2 }, { 0,0,0,0, 2,1,1,2, 2,1,1,2, 2,1,1,2 },
+	{ 0,2,2,2, 0,1,1,1, 0,1,1,1, 0,2,2,2 }, { 0,0,0,2, 1,1,1,2, 1,1,1,2, 0,0,0,2 }, { 0,1,1,0, 0,1,1,0, 0,1,1,0, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,1,2, 2,1,1,2 },
+	{ 0,1,1,0, 0,1,1,0, 2,2,2,2, 2,2,2,2 }, { 0,0,2,2, 0,0,1,1, 0,0,1,1, 0,0,2,2 }, { 0,0,2,2, 1,1,2,2, 1,1,2,2, 0,0,2,2 }, { 0,0,0,0, 0,0,0,0, 0,0,0,0, 2,1,1,2 },
+	{ 0,0,0,2, 0,0,0,1, 0,0,0,2, 0,0,0,1 }, { 0,2,2,2, 1,2,2,2, 0,2,2,2, 1,2,2,2 }, { 0,1,0,1, 2,2,2,2, 2,2,2,2, 2,2,2,2 }, { 0,1,1,1, 2,0,1,1, 2,2,0,1, 2,2,2,0 },
+};
+
+// Anchor texel of the second subset of two-subset shapes
+static const unsigned char EZBCAnchors2[64] =
+{
+	15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15, 15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+	15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,  6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+};
+
+// Anchor texels of the second and third subsets of
+// three-subset shapes
+static const unsigned char EZBCAnchors3[2][64] =
+{
+	{
+		 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,  3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+		 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,  3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+	},
+	{
+		15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8, 15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+		15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8, 15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+	},
+};
+
+// Interpolation weights for 2, 3 and 4 bit indices
+static const unsigned char EZBCWeights2[4] = { 0, 21, 43, 64 };
+static const unsigned char EZBCWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const unsigned char EZBCWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline const unsigned char* EZBCWeights(unsigned int indexBits)
+{
+	return indexBits == 2 ? EZBCWeights2 : (indexBits == 3 ? EZBCWeights3 : EZBCWeights4);
+}
+
+inline int EZBCInterpolate(int endpoint0, int endpoint1, unsigned int weight)
+{
+	return ((64 - (int)weight) * endpoint0 + (int)weight * endpoint1 + 32) >> 6;
+}
+
+// --- EZDecodeBC1Block -----------------------------------
+//  Decodes the 8 byte color block used by BC1, BC2 and
+//  BC3.  BC1 switches to three colors plus transparent
+//  black when the first color is not greater than the
+//  second; BC2 and BC3 always use four colors.
+// --------------------------------------------------------
+inline void EZDecodeBC1Block(const unsigned char* block, EZColor4* texels, bool allowTransparent)
+{
+	unsigned int color0 = block[0] | (block[1] << 8);
+	unsigned int color1 = block[2] | (block[3] << 8);
+
+	// Expand 5:6:5 to 8 bits per channel
+	int palette[4][4];
+	const unsigned int colors[2] = { color0, color1 };
+	for (int c = 0; c < 2; c++)
+	{
+		unsigned int r = (colors[c] >> 11) & 31, g = (colors[c] >> 5) & 63, b = colors[c] & 31;
+		palette[c][0] = (r << 3) | (r >> 2);
+		palette[c][1] = (g << 2) | (g >> 4);
+		palette[c][2] = (b << 3) | (b >> 2);
+		palette[c][3] = 255;
+	}
+
+	for (int ch = 0; ch < 4; ch++)
+	{
+		if (color0 > color1 || !allowTransparent)
+		{
+			palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3;
+			palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3;
+		}
+		else
+		{
+			palette[2][ch] = (palette[0][ch] + palette[1][ch]) / 2;
+			palette[3][ch] = 0;
+		}
+	}
+
+	unsigned int indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+	for (int i = 0; i < 16; i++, indices >>= 2)
+	{
+		const int* color = palette[indices & 3];
+		texels[i] = EZColor4((unsigned char)color[0], (unsigned char)color[1], (unsigned char)color[2], (unsigned char)color[3]);
+	}
+}
+
+// --- EZDecodeBC4Block -----------------------------------
+//  Decodes the 8 byte single channel block used by BC3
+//  alpha, BC4 and BC5.  Values are written to every
+//  stride-th element of the output.  The signed version
+//  produces SNORM values in the -127 to 127 range.
+// --------------------------------------------------------
+template<typename ValueType>
+inline void EZDecodeBC4Block(const unsigned char* block, ValueType* values, size_t stride, bool isSigned)
+{
+	int value0 = isSigned ? EZMax((int)(signed char)block[0], -127) : block[0];
+	int value1 = isSigned ? EZMax((int)(signed char)block[1], -127) : block[1];
+
+	int palette[8] = { value0, value1 };
+	if (value0 > value1)
+	{
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * value0 + i * value1) / 5;
+		palette[6] = isSigned ? -127 : 0;
+		palette[7] = isSigned ? 127 : 255;
+	}
+
+	unsigned long long indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (unsigned long long)block[2 + i] << (8 * i);
+	for (int i = 0; i < 16; i++, indices >>= 3)
+		values[i * stride] = (ValueType)palette[indices & 7];
+}
+
+// --- EZDecodeBC7Block -----------------------------------
+//  Decodes a 16 byte BC7 block.  Blocks with an invalid
+//  mode decode to transparent black, as they do on the GPU.
+// --------------------------------------------------------
+inline void EZDecodeBC7Block(const unsigned char* block, EZColor4* texels)
+{
+	struct ModeInfo { unsigned char Subsets, PartitionBits, RotationBits, IndexSelectionBits, ColorBits, AlphaBits, EndpointPBits, SharedPBits, IndexBits, IndexBits2; };
+	static const ModeInfo modes[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+	};
+
+	// The mode is the position of the lowest set bit
+	unsigned int mode = 0;
+	while (mode < 8 && !(block[0] & (1 << mode)))
+		mode++;
+	if (mode == 8)
+	{
+		for (int i = 0; i < 16; i++)
+			texels[i] = EZColor4();
+		return;
+	}
+
+	const ModeInfo& info = modes[mode];
+	EZBlockBits bits(block);
+	bits.Read(mode + 1);
+	unsigned int partition = bits.Read(info.PartitionBits);
+	unsigned int rotation = bits.Read(info.RotationBits);
+	unsigned int indexSelection = bits.Read(info.IndexSelectionBits);
+
+	// Endpoints are stored channel by channel, then the
+	// p-bits that extend every channel by one more bit
+	int endpoints[6][4];
+	unsigned int endpointCount = info.Subsets * 2;
+	for (int ch = 0; ch < 4; ch++)
+	{
+		unsigned int channelBits = ch < 3 ? info.ColorBits : info.AlphaBits;
+		for (unsigned int e = 0; e < endpointCount; e++)
+			endpoints[e][ch] = bits.Read(channelBits);
+	}
+
+	unsigned int precision[4] = { info.ColorBits, info.ColorBits, info.ColorBits, info.AlphaBits };
+	if (info.EndpointPBits || info.SharedPBits)
+	{
+		unsigned int pBits[6];
+		for (unsigned int e = 0; e < endpointCount; e++)
+			pBits[e] = info.SharedPBits ? ((e & 1) ? pBits[e - 1] : bits.Read(1)) : bits.Read(1);
+		for (unsigned int e = 0; e < endpointCount; e++)
+		{
+			for (int ch = 0; ch < 4; ch++)
+			{
+				if (precision[ch])
+					endpoints[e][ch] = (endpoints[e][ch] << 1) | pBits[e];
+			}
+		}
+		for (int ch = 0; ch < 4; ch++)
+			precision[ch] += precision[ch] ? 1 : 0;
+	}
+
+	// Expand to 8 bits by replicating the high bits
+	for (unsigned int e = 0; e < endpointCount; e++)
+	{
+		for (int ch = 0; ch < 4; ch++)
+		{
+			if (precision[ch] == 0)
+				endpoints[e][ch] = 255;
+			else
+			{
+				endpoints[e][ch] <<= 8 - precision[ch];
+				endpoints[e][ch] |= endpoints[e][ch] >> precision[ch];
+			}
+		}
+	}
+
+	// Subset of each texel, and which texels are anchors
+	// (stored with one less index bit)
+	unsigned char subsets[16] = {};
+	unsigned int anchors[3] = { 0, 0, 0 };
+	if (info.Subsets == 2)
+	{
+		for (int i = 0; i < 16; i++)
+			subsets[i] = (EZBCPartitions2[partition] >> i) & 1;
+		anchors[1] = EZBCAnchors2[partition];
+	}
+	else if (info.Subsets == 3)
+	{
+		memcpy(subsets, EZBCPartitions3[partition], 16);
+		anchors[1] = EZBCAnchors3[0][partition];
+		anchors[2] = EZBCAnchors3[1][partition];
+	}
+
+	unsigned int indices[16];
+	for (unsigned int i = 0; i < 16; i++)
+		indices[i] = bits.Read(info.IndexBits - (i == anchors[subsets[i]] ? 1 : 0));
+
+	unsigned int indices2[16] = {};
+	if (info.IndexBits2)
+	{
+		for (unsigned int i = 0; i < 16; i++)
+			indices2[i] = bits.Read(info.IndexBits2 - (i == 0 ? 1 : 0));
+	}
+
+	// Modes 4 and 5 interpolate alpha with the second set of
+	// indices, and mode 4 can swap which set is which
+	const unsigned int* colorIndices = indices;
+	const unsigned int* alphaIndices = info.IndexBits2 ? indices2 : indices;
+	unsigned int colorIndexBits = info.IndexBits;
+	unsigned int alphaIndexBits = info.IndexBits2 ? info.IndexBits2 : info.IndexBits;
+	if (indexSelection)
+	{
+		colorIndices = indices2;
+		alphaIndices = indices;
+		colorIndexBits = info.IndexBits2;
+		alphaIndexBits = info.IndexBits;
+	}
+	const unsigned char* colorWeights = EZBCWeights(colorIndexBits);
+	const unsigned char* alphaWeights = EZBCWeights(alphaIndexBits);
+
+	for (int i = 0; i < 16; i++)
+	{
+		const int* e0 = endpoints[subsets[i] * 2];
+		const int* e1 = endpoints[subsets[i] * 2 + 1];
+		unsigned char channels[4];
+		for (int ch = 0; ch < 3; ch++)
+			channels[ch] = (unsigned char)EZBCInterpolate(e0[ch], e1[ch], colorWeights[colorIndices[i]]);
+		channels[3] = (unsigned char)EZBCInterpolate(e0[3], e1[3], alphaWeights[alphaIndices[i]]);
+
+		// Rotation swaps alpha with one of the color channels
+		if (rotation)
+		{
+			unsigned char swap = channels[3];
+			channels[3] = channels[rotation - 1];
+			channels[rotation - 1] = swap;
+		}
+		texels[i] = EZColor4(channels[0], channels[1], channels[2], channels[3]);
+	}
+}
+
+// --- EZDecodeBC6HBlock ----------------------------------
+//  Decodes a 16 byte BC6H block into half floats, three
+//  per texel.  Blocks using a reserved mode decode to
+//  black, as they do on the GPU.
+// --------------------------------------------------------
+inline void EZDecodeBC6HBlock(const unsigned char* block, unsigned short* halves, bool isSigned)
+{
+	// Endpoint fields: w, x, y and z are the four endpoints,
+	// and D is the partition index of two-region modes
+	enum { RW, GW, BW, RX, GX, BX, RY, GY, BY, RZ, GZ, BZ, D };
+
+	// Header layout of each mode as runs of bits, in the
+	// order they are stored: field, lowest bit, bit count.
+	// A negative count marks a run stored highest bit first.
+	struct Run { signed char Field, Low, Count; };
+	struct ModeInfo { unsigned char Regions, EndpointBits, DeltaBits[3]; bool Transformed; Run Runs[24]; };
+	static const ModeInfo modes[14] =
+	{
+		{ 2, 10, { 5, 5, 5 }, true,  { {GY,4,1},{BY,4,1},{BZ,4,1},{RW,0,10},{GW,0,10},{BW,0,10},{RX,0,5},{GZ,4,1},{GY,0,4},{GX,0,5},{BZ,0,1},{GZ,0,4},{BX,0,5},{BZ,1,1},{BY,0,4},{RY,0,5},{BZ,2,1},{RZ,0,5},{BZ,3,1},{D,0,5} } },
+		{ 2, 7,  { 6, 6, 6 }, true,  { {GY,5,1},{GZ,4,2},{RW,0,7},{BZ,0,2},{BY,4,1},{GW,0,7},{BY,5,1},{BZ,2,1},{GY,4,1},{BW,0,7},{BZ,3,1},{BZ,5,1},{BZ,4,1},{RX,0,6},{GY,0,4},{GX,0,6},{GZ,0,4},{BX,0,6},{BY,0,4},{RY,0,6},{RZ,0,6},{D,0,5} } },
+		{ 2, 11, { 5, 4, 4 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,5},{RW,10,1},{GY,0,4},{GX,0,4},{GW,10,1},{BZ,0,1},{GZ,0,4},{BX,0,4},{BW,10,1},{BZ,1,1},{BY,0,4},{RY,0,5},{BZ,2,1},{RZ,0,5},{BZ,3,1},{D,0,5} } },
+		{ 2, 11, { 4, 5, 4 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,4},{RW,10,1},{GZ,4,1},{GY,0,4},{GX,0,5},{GW,10,1},{GZ,0,4},{BX,0,4},{BW,10,1},{BZ,1,1},{BY,0,4},{RY,0,4},{BZ,0,1},{BZ,2,1},{RZ,0,4},{GY,4,1},{BZ,3,1},{D,0,5} } },
+		{ 2, 11, { 4, 4, 5 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,4},{RW,10,1},{BY,4,1},{GY,0,4},{GX,0,4},{GW,10,1},{BZ,0,1},{GZ,0,4},{BX,0,5},{BW,10,1},{BY,0,4},{RY,0,4},{BZ,1,2},{RZ,0,4},{BZ,4,1},{BZ,3,1},{D,0,5} } },
+		{ 2, 9,  { 5, 5, 5 }, true,  { {RW,0,9},{BY,4,1},{GW,0,9},{GY,4,1},{BW,0,9},{BZ,4,1},{RX,0,5},{GZ,4,1},{GY,0,4},{GX,0,5},{BZ,0,1},{GZ,0,4},{BX,0,5},{BZ,1,1},{BY,0,4},{RY,0,5},{BZ,2,1},{RZ,0,5},{BZ,3,1},{D,0,5} } },
+		{ 2, 8,  { 6, 5, 5 }, true,  { {RW,0,8},{GZ,4,1},{BY,4,1},{GW,0,8},{BZ,2,1},{GY,4,1},{BW,0,8},{BZ,3,2},{RX,0,6},{GY,0,4},{GX,0,5},{BZ,0,1},{GZ,0,4},{BX,0,5},{BZ,1,1},{BY,0,4},{RY,0,6},{RZ,0,6},{D,0,5} } },
+		{ 2, 8,  { 5, 6, 5 }, true,  { {RW,0,8},{BZ,0,1},{BY,4,1},{GW,0,8},{GY,5,1},{GY,4,1},{BW,0,8},{GZ,5,1},{BZ,4,1},{RX,0,5},{GZ,4,1},{GY,0,4},{GX,0,6},{GZ,0,4},{BX,0,5},{BZ,1,1},{BY,0,4},{RY,0,5},{BZ,2,1},{RZ,0,5},{BZ,3,1},{D,0,5} } },
+		{ 2, 8,  { 5, 5, 6 }, true,  { {RW,0,8},{BZ,1,1},{BY,4,1},{GW,0,8},{BY,5,1},{GY,4,1},{BW,0,8},{BZ,5,1},{BZ,4,1},{RX,0,5},{GZ,4,1},{GY,0,4},{GX,0,5},{BZ,0,1},{GZ,0,4},{BX,0,6},{BY,0,4},{RY,0,5},{BZ,2,1},{RZ,0,5},{BZ,3,1},{D,0,5} } },
+		{ 2, 6,  { 6, 6, 6 }, false, { {RW,0,6},{GZ,4,1},{BZ,0,2},{BY,4,1},{GW,0,6},{GY,5,1},{BY,5,1},{BZ,2,1},{GY,4,1},{BW,0,6},{GZ,5,1},{BZ,3,1},{BZ,5,1},{BZ,4,1},{RX,0,6},{GY,0,4},{GX,0,6},{GZ,0,4},{BX,0,6},{BY,0,4},{RY,0,6},{RZ,0,6},{D,0,5} } },
+		{ 1, 10, { 10, 10, 10 }, false, { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,10},{GX,0,10},{BX,0,10} } },
+		{ 1, 11, { 9, 9, 9 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,9},{RW,10,1},{GX,0,9},{GW,10,1},{BX,0,9},{BW,10,1} } },
+		{ 1, 12, { 8, 8, 8 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,8},{RW,10,-2},{GX,0,8},{GW,10,-2},{BX,0,8},{BW,10,-2} } },
+		{ 1, 16, { 4, 4, 4 }, true,  { {RW,0,10},{GW,0,10},{BW,0,10},{RX,0,4},{RW,10,-6},{GX,0,4},{GW,10,-6},{BX,0,4},{BW,10,-6} } },
+	};
+
+	// Two bit modes, then five bit modes with the high three
+	// bits picking one of eight (or four, for one region)
+	EZBlockBits bits(block);
+	unsigned int modeBits = bits.Read(2);
+	int mode = (int)modeBits;
+	if (modeBits >= 2)
+	{
+		unsigned int high = bits.Read(3);
+		mode = modeBits == 2 ? 2 + (int)high : (high < 4 ? 10 + (int)high : -1);
+	}
+	if (mode < 0)
+	{
+		for (int i = 0; i < 48; i++)
+			halves[i] = 0;
+		return;
+	}
+
+	// Gather the header fields
+	const ModeInfo& info = modes[mode];
+	int fields[13] = {};
+	for (const Run& run : info.Runs)
+	{
+		if (run.Count == 0)
+			break;
+		if (run.Count > 0)
+			fields[run.Field] |= bits.Read(run.Count) << run.Low;
+		else
+		{
+			for (int b = -run.Count - 1; b >= 0; b--)
+				fields[run.Field] |= bits.Read(1) << (run.Low + b);
+		}
+	}
+
+	auto signExtend = [](int value, unsigned int bitCount) {
+		int sign = 1 << (bitCount - 1);
+		return ((value & ((1 << bitCount) - 1)) ^ sign) - sign; };
+
+	// Endpoints w, x, y, z as rgb.  Transformed modes store
+	// x, y and z as signed deltas from w.
+	int endpoints[4][3];
+	unsigned int endpointCount = info.Regions * 2;
+	unsigned int mask = (1u << info.EndpointBits) - 1;
+	for (unsigned int e = 0; e < endpointCount; e++)
+	{
+		for (int ch = 0; ch < 3; ch++)
+		{
+			int value = fields[e * 3 + ch];
+			if (e > 0 && info.Transformed)
+				value = (fields[ch] + signExtend(value, info.DeltaBits[ch])) & mask;
+			else if (e > 0 && isSigned)
+				value = signExtend(value, info.DeltaBits[ch]);
+			if (isSigned)
+				value = signExtend(value, info.EndpointBits);
+			endpoints[e][ch] = value;
+		}
+	}
+
+	// Unquantize to the full 16 bit range
+	for (unsigned int e = 0; e < endpointCount; e++)
+	{
+		for (int ch = 0; ch < 3; ch++)
+		{
+			int value = endpoints[e][ch];
+			unsigned int bitCount = info.EndpointBits;
+			if (!isSigned)
+			{
+				if (bitCount >= 15) {}
+				else if (value == 0) {}
+				else if (value == (int)mask) value = 0xFFFF;
+				else value = ((value << 16) + 0x8000) >> bitCount;
+			}
+			else if (bitCount < 16)
+			{
+				bool negative = value < 0;
+				int magnitude = negative ? -value : value;
+				if (magnitude == 0) {}
+				else if (magnitude >= (1 << (bitCount - 1)) - 1) magnitude = 0x7FFF;
+				else magnitude = ((magnitude << 15) + 0x4000) >> (bitCount - 1);
+				value = negative ? -magnitude : magnitude;
+			}
+			endpoints[e][ch] = value;
+		}
+	}
+
+	// Partition and indices
+	unsigned int partition = fields[D];
+	unsigned int indexBits = info.Regions == 2 ? 3 : 4;
+	const unsigned char* weights = EZBCWeights(indexBits);
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		unsigned int region = info.Regions == 2 ? (EZBCPartitions2[partition] >> i) & 1 : 0;
+		bool anchor = i == 0 || (info.Regions == 2 && i == EZBCAnchors2[partition]);
+		unsigned int index = bits.Read(indexBits - (anchor ? 1 : 0));
+
+		// Interpolate, then scale to the final half float bits
+		for (int ch = 0; ch < 3; ch++)
+		{
+			int value = EZBCInterpolate(endpoints[region * 2][ch], endpoints[region * 2 + 1][ch], weights[index]);
+			if (!isSigned)
+				halves[i * 3 + ch] = (unsigned short)((value * 31) >> 6);
+			else if (value < 0)
+				halves[i * 3 + ch] = (unsigned short)(0x8000 | (((-value) * 31) >> 5));
+			else
+				halves[i * 3 + ch] = (unsigned short)((value * 31) >> 5);
+		}
+	}
+}
+
+// --- EZDecodeBlocks -------------------------------------
+//  Runs a block decoder over every block of a BC image,
+//  spreading rows of blocks across threads.  Blocks along
+//  the right and bottom edges are clipped to the image.
+// --------------------------------------------------------
+template<typename OutputType, typename DecodeBlock>
+inline void EZDecodeBlocks(const void* blocks, size_t blockBytes, size_t rowPitch, UINT width, UINT height, OutputType* results, UINT threadCount, DecodeBlock decodeBlock)
+{
+	size_t blocksWide = (width + 3) / 4;
+	size_t blocksHigh = (height + 3) / 4;
+	if (rowPitch == 0)
+		rowPitch = blocksWide * blockBytes;
+
+	// Rows of blocks are split between threads, with enough
+	// rows per thread to be worth starting it
+	const unsigned char* data = static_cast<const unsigned char*>(blocks);
+	size_t rowsPerThread = EZMax((size_t)16384 / EZMax(blocksWide, (size_t)1), (size_t)1);
+	EZParallelFor(blocksHigh, threadCount, rowsPerThread, [=](size_t begin, size_t end)
+	{
+		OutputType texels[16];
+		for (size_t by = begin; by < end; by++)
+		{
+			const unsigned char* row = data + by * rowPitch;
+			size_t rows = EZMin((size_t)4, height - by * 4);
+			for (size_t bx = 0; bx < blocksWide; bx++)
+			{
+				decodeBlock(row + bx * blockBytes, texels);
+				size_t columns = EZMin((size_t)4, width - bx * 4);
+				for (size_t y = 0; y < rows; y++)
+					memcpy(&results[(by * 4 + y) * width + bx * 4], &texels[y * 4], columns * sizeof(OutputType));
+			}
+		}
+	});
+}
+
+// --- EZDecodeBC -----------------------------------------
+//  Decompresses a BC1, BC2, BC3, BC4, BC5 or BC7 image
+//  into RGBA8 colors.  BC4 fills red and BC5 fills red
+//  and green, with blue set to 0 and alpha to 255.  sRGB
+//  formats are returned still sRGB encoded.
+//
+//  Decoding is split across threads by rows of blocks.
+//  This is a CPU-only operation and does not touch D3D.
+//
+//  Parameters:
+//  - format: format of the blocks
+//  - blocks: the compressed blocks, in rows of blocks
+//  - rowPitch: bytes between rows of blocks, or zero if
+//    they are tightly packed
+//  - width, height: size of the image in texels
+//  - results: array of at least width * height colors
+//  - threadCount: threads to use, or zero to use all
+//
+// 	Returns:
+//  - E_INVALIDARG if the format cannot be decoded to RGBA8
+//    (BC6H, signed BC4/BC5 and typeless formats), or
+//    S_OK otherwise.
+// --------------------------------------------------------
+inline HRESULT EZDecodeBC(DXGI_FORMAT format, const void* blocks, size_t rowPitch, UINT width, UINT height, EZColor4* results, UINT threadCount = 0)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		EZDecodeBlocks(blocks, 8, rowPitch, width, height, results, threadCount, [](const unsigned char* block, EZColor4* texels) {
+			EZDecodeBC1Block(block, texels, true); });
+		return S_OK;
+
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+		EZDecodeBlocks(blocks, 16, rowPitch, width, height, results, threadCount, [](const unsigned char* block, EZColor4* texels) {
+			EZDecodeBC1Block(block + 8, texels, false);
+			for (int i = 0; i < 16; i++)
+			{
+				unsigned int alpha = (block[i / 2] >> (4 * (i & 1))) & 15;
+				texels[i].AlphaInt = (unsigned char)(alpha * 17);
+			}
+		});
+		return S_OK;
+
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		EZDecodeBlocks(blocks, 16, rowPitch, width, height, results, threadCount, [](const unsigned char* block, EZColor4* texels) {
+			EZDecodeBC1Block(block + 8, texels, false);
+			EZDecodeBC4Block(block, &texels[0].AlphaInt, sizeof(EZColor4), false); });
+		return S_OK;
+
+	case DXGI_FORMAT_BC4_UNORM:
+		EZDecodeBlocks(blocks, 8, rowPitch, width, height, results, threadCount, [](const unsigned char* block, EZColor4* texels) {
+			for (int i = 0; i < 16; i++)
+				texels[i] = EZColor4(0, 0, 0, 255);
+			EZDecodeBC4Block(block, &texels[0].RedInt, sizeof(EZColor4), false); });
+		return S_OK;
+
+	case DXGI_FORMAT_BC5_UNORM:
+		EZDecodeBlocks(blocks, 16, rowPitch, width, height, results, threadCount, [](const unsigned char* block, EZColor4* texels) {
+			for (int i = 0; i < 16; i++)
+				texels[i] = EZColor4(0, 0, 0, 255);
+			EZDecodeBC4Block(block, &texels[0].RedInt, sizeof(EZColor4), false);
+			EZDecodeBC4Block(block + 8, &texels[0].GreenInt, sizeof(EZColor4), false); });
+		return S_OK;
+
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		EZDecodeBlocks(blocks, 16, rowPitch, width, height, results, threadCount, EZDecodeBC7Block);
+		return S_OK;
+
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+// --- EZDecodeBCToFloat4 ---------------------------------
+//  Decompresses any BC image into float4 values.  This
+//  covers everything EZDecodeBC() does, with sRGB formats
+//  converted to linear, plus BC6H and signed BC4/BC5.
+//
+//  Decoding is split across threads by rows of blocks.
+//  This is a CPU-only operation and does not touch D3D.
+//
+//  Parameters:
+//  - format: format of the blocks
+//  - blocks: the compressed blocks, in rows of blocks
+//  - rowPitch: bytes between rows of blocks, or zero if
+//    they are tightly packed
+//  - width, height: size of the image in texels
+//  - results: array of at least width * height elements
+//  - threadCount: threads to use, or zero to use all
+//
+// 	Returns:
+//  - E_INVALIDARG if the format is not a BC format or is
+//    typeless, or S_OK otherwise.
+// --------------------------------------------------------
+inline HRESULT EZDecodeBCToFloat4(DXGI_FORMAT format, const void* blocks, size_t rowPitch, UINT width, UINT height, DirectX::XMFLOAT4* results, UINT threadCount = 0)
+{
+	using DirectX::XMFLOAT4;
+	size_t blockBytes = EZBytesPerBlock(format);
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC4_SNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+		EZDecodeBlocks(blocks, blockBytes, rowPitch, width, height, results, threadCount, [format](const unsigned char* block, XMFLOAT4* texels) {
+			float values[2][16] = {};
+			EZDecodeBC4Block(block, values[0], 1, true);
+			if (format == DXGI_FORMAT_BC5_SNORM)
+				EZDecodeBC4Block(block + 8, values[1], 1, true);
+			for (int i = 0; i < 16; i++)
+				texels[i] = XMFLOAT4(EZMax(values[0][i] / 127.0f, -1.0f), EZMax(values[1][i] / 127.0f, -1.0f), 0.0f, 1.0f);
+		});
+		return S_OK;
+
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		EZDecodeBlocks(blocks, blockBytes, rowPitch, width, height, results, threadCount, [format](const unsigned char* block, XMFLOAT4* texels) {
+			unsigned short halves[48];
+			EZDecodeBC6HBlock(block, halves, format == DXGI_FORMAT_BC6H_SF16);
+			for (int i = 0; i < 16; i++)
+				texels[i] = XMFLOAT4(EZHalfToFloat(halves[i * 3]), EZHalfToFloat(halves[i * 3 + 1]), EZHalfToFloat(halves[i * 3 + 2]), 1.0f);
+		});
+		return S_OK;
+
+	default:
+		break;
+	}
+
+	// Everything else goes through RGBA8
+	bool srgb = format == DXGI_FORMAT_BC1_UNORM_SRGB || format == DXGI_FORMAT_BC2_UNORM_SRGB || format == DXGI_FORMAT_BC3_UNORM_SRGB || format == DXGI_FORMAT_BC7_UNORM_SRGB;
+	auto decode = [&](const unsigned char* block, XMFLOAT4* texels)
+	{
+		EZColor4 colors[16];
+		EZDecodeBC(format, block, 0, 4, 4, colors, 1);
+		for (int i = 0; i < 16; i++)
+		{
+			if (srgb)
+				texels[i] = XMFLOAT4(EZSRGBToLinear(colors[i].RedInt), EZSRGBToLinear(colors[i].GreenInt), EZSRGBToLinear(colors[i].BlueInt), colors[i].AlphaInt / 255.0f);
+			else
+				texels[i] = colors[i].AsFloat4();
+		}
+	};
+
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		EZDecodeBlocks(blocks, blockBytes, rowPitch, width, height, results, threadCount, decode);
+		return S_OK;
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+// Pitched copies at least this large use non-temporal 
+// stores, see EZCopyPitched()
+const size_t EZReadbackStreamingThreshold = 8 * 1024 * 1024;
+
+// Row copy kernels used by EZCopyPitched()
+inline void EZCopyRowScalar(unsigned char* destination, const unsigned char* source, size_t bytes)
+{
+	memcpy(destination, source, bytes);
+}
+
+#if defined(EZREADBACK_X86)
+inline void EZCopyRowSSE2(unsigned char* destination, const unsigned char* source, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 64 <= bytes; i += 64)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 48));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), a);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 16), b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 32), c);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 48), d);
+	}
+	for (; i + 16 <= bytes; i += 16)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+	memcpy(destination + i, source + i, bytes - i);
+}
+
+EZREADBACK_TARGET("avx2")
+inline void EZCopyRowAVX2(unsigned char* destination, const unsigned char* source, size_t bytes)
+{
+	size_t i = 0;
+	for (; i + 128 <= bytes; i += 128)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 32));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 64));
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 96));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), a);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i + 32), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i + 64), c);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i + 96), d);
+	}
+	for (; i + 32 <= bytes; i += 32)
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+	memcpy(destination + i, source + i, bytes - i);
+}
+
+// Non-temporal version: the destination is aligned first,
+// since streaming stores require aligned addresses
+inline void EZCopyRowStreamSSE2(unsigned char* destination, const unsigned char* source, size_t bytes)
+{
+	size_t head = (16 - (reinterpret_cast<size_t>(destination) & 15)) & 15;
+	if (head > bytes)
+		head = bytes;
+	memcpy(destination, source, head);
+
+	size_t i = head;
+	for (; i + 64 <= bytes; i += 64)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i + 48), d);
+	}
+	for (; i + 16 <= bytes; i += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(destination + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+	memcpy(destination + i, source + i, bytes - i);
+}
+
+EZREADBACK_TARGET("avx2")
+inline void EZCopyRowStreamAVX2(unsigned char* destination, const unsigned char* source, size_t bytes)
+{
+	size_t head = (32 - (reinterpret_cast<size_t>(destination) & 31)) & 31;
+	if (head > bytes)
+		head = bytes;
+	memcpy(destination, source, head);
+
+	size_t i = head;
+	for (; i + 128 <= bytes; i += 128)
+	{
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 32));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 64));
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 96));
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i), a);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i + 32), b);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i + 64), c);
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i + 96), d);
+	}
+	for (; i + 32 <= bytes; i += 32)
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+	memcpy(destination + i, source + i, bytes - i);
+}
+#endif
+
+// --- EZCopyPitched --------------------------------------
+//  Copies rows of bytes between two buffers that may each
+//  have their own row and depth pitch, such as the mapped
+//  data of a texture and a tightly packed array.  This is
+//  a CPU-only operation and does not touch D3D.
+// 
+//  When both sides are tightly packed the whole thing is a
+//  single memcpy.  Otherwise rows are copied one at a time
+//  with SIMD when available, and surfaces larger than
+//  EZReadbackStreamingThreshold use non-temporal stores so
+//  the destination does not push everything else out of
+//  the cache.
+// 
+//  Parameters:
+//  - destination: where to copy to
+//  - destinationRowPitch: bytes between destination rows
+//  - destinationDepthPitch: bytes between destination slices
+//  - source: where to copy from
+//  - sourceRowPitch: bytes between source rows
+//  - sourceDepthPitch: bytes between source slices
+//  - rowBytes: bytes of actual data in each row
+//  - rowCount: rows per slice
+//  - sliceCount: number of slices
+// --------------------------------------------------------
+inline void EZCopyPitched(
+	void* destination, size_t destinationRowPitch, size_t destinationDepthPitch,
+	const void* source, size_t sourceRowPitch, size_t sourceDepthPitch,
+	size_t rowBytes, size_t rowCount, size_t sliceCount)
+{
+	unsigned char* dst = static_cast<unsigned char*>(destination);
+	const unsigned char* src = static_cast<const unsigned char*>(source);
+	size_t sliceBytes = rowBytes * rowCount;
+	if (sliceBytes == 0 || sliceCount == 0)
+		return;
+
+	// Pitches only matter when there is more than one row or slice
+	bool packedRows = rowCount == 1 || (sourceRowPitch == rowBytes && destinationRowPitch == rowBytes);
+	bool packedSlices = sliceCount == 1 || (sourceDepthPitch == sliceBytes && destinationDepthPitch == sliceBytes);
+
+	// Fast path: both sides are tightly packed
+	if (packedRows && packedSlices)
+	{
+		memcpy(dst, src, sliceBytes * sliceCount);
+		return;
+	}
+
+	// Pick a row kernel
+	void (*copyRow)(unsigned char*, const unsigned char*, size_t) = EZCopyRowScalar;
+#if defined(EZREADBACK_X86)
+	bool streaming = sliceBytes * sliceCount >= EZReadbackStreamingThreshold;
+	if (EZCpuFeatures::Get().AVX2)
+		copyRow = streaming ? EZCopyRowStreamAVX2 : EZCopyRowAVX2;
+	else
+		copyRow = streaming ? EZCopyRowStreamSSE2 : EZCopyRowSSE2;
+#endif
+
+	for (size_t slice = 0; slice < sliceCount; slice++)
+	{
+		unsigned char* dstSlice = dst + slice * destinationDepthPitch;
+		const unsigned char* srcSlice = src + slice * sourceDepthPitch;
+
+		// Slices may still be packed even if the rows are not
+		if (packedRows)
+		{
+			copyRow(dstSlice, srcSlice, sliceBytes);
+			continue;
+		}
+
+		for (size_t row = 0; row < rowCount; row++)
+			copyRow(dstSlice + row * destinationRowPitch, srcSlice + row * sourceRowPitch, rowBytes);
+	}
+
+#if defined(EZREADBACK_X86)
+	// Make streamed stores visible before anyone reads them
+	if (streaming)
+		_mm_sfence();
+#endif
+}
+
+// --- EZCopyPitched --------------------------------------
+//  Copies pitched rows into a tightly packed destination,
+//  which is the common case when reading mapped data
+// --------------------------------------------------------
+inline void EZCopyPitched(
+	void* destination, const void* source, size_t sourceRowPitch, size_t sourceDepthPitch,
+	size_t rowBytes, size_t rowCount, size_t sliceCount)
+{
+	EZCopyPitched(destination, rowBytes, rowBytes * rowCount, source, sourceRowPitch, sourceDepthPitch, rowBytes, rowCount, sliceCount);
+}
+
+// --- EZBufferField --------------------------------------
+//  One field of a buffer's structs to pull out into its own
+//  array, such as offsetof(Particle, Mass) and sizeof(float).
+//  The destination gets the field of each struct, back to
+//  back.
+// --------------------------------------------------------
+struct EZBufferField
+{
+	size_t Offset;     // Bytes from the start of the struct
+	size_t Size;       // Bytes in the field
+	void* Destination; // Room for Size bytes per struct
+};
+
+// --- EZProjectFields ------------------------------------
+//  Transposes an array of structs into one array per field
+//  (AoS to SoA).  4- and 8-byte fields are gathered 8 or 4
+//  structs at a time with AVX2; other sizes are copied one
+//  struct at a time.  Structs are split across threads in
+//  blocks.  This is a CPU-only operation and does not 
+//  touch D3D.
+// 
+//  Parameters:
+//  - elements: first struct
+//  - stride: bytes from one struct to the next
+//  - count: number of structs
+//  - fields: the fields to pull out, which must lie inside
+//    the struct
+//  - fieldCount: number of fields
+//  - threadCount: threads to use, or zero for every 
+//    hardware thread
+// --------------------------------------------------------
+template<size_t Size>
+inline void EZProjectFieldFixed(const unsigned char* source, size_t stride, size_t first, size_t count, unsigned char* destination)
+{
+	for (size_t i = first; i < first + count; i++)
+		memcpy(destination + i * Size, source + i * stride, Size);
+}
+
+inline void EZProjectFieldScalar(const unsigned char* elements, size_t stride, size_t first, size_t count, const EZBufferField& field)
+{
+	// Fixed sizes let the copies become plain loads and stores
+	unsigned char* destination = static_cast<unsigned char*>(field.Destination);
+	const unsigned char* source = elements + field.Offset;
+	switch (field.Size)
+	{
+	case 1: EZProjectFieldFixed<1>(source, stride, first, count, destination); break;
+	case 2: EZProjectFieldFixed<2>(source, stride, first, count, destination); break;
+	case 4: EZProjectFieldFixed<4>(source, stride, first, count, destination); break;
+	case 8: EZProjectFieldFixed<8>(source, stride, first, count, destination); break;
+	case 12: EZProjectFieldFixed<12>(source, stride, first, count, destination); break;
+	case 16: EZProjectFieldFixed<16>(source, stride, first, count, destination); break;
+	default:
+		for (size_t i = first; i < first + count; i++)
+			memcpy(destination + i * field.Size, source + i * stride, field.Size);
+		break;
+	}
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline void EZProjectFieldAVX2(const unsigned char* elements, size_t stride, size_t first, size_t count, const EZBufferField& field)
+{
+	// Struct offsets within one step; 7 strides must fit in
+	// an int, which the caller checks
+	const int step = (int)stride;
+	const __m256i offsets = _mm256_setr_epi32(0, step, step * 2, step * 3, step * 4, step * 5, step * 6, step * 7);
+	unsigned char* destination = static_cast<unsigned char*>(field.Destination);
+	const unsigned char* source = elements + field.Offset;
+
+	size_t i = first;
+	if (field.Size == 4)
+	{
+		for (; i + 8 <= first + count; i += 8)
+		{
+			__m256i gathered = _mm256_i32gather_epi32(reinterpret_cast<const int*>(source + i * stride), offsets, 1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), gathered);
+		}
+	}
+	else if (field.Size == 8)
+	{
+		const __m128i offsets4 = _mm256_castsi256_si128(offsets);
+		for (; i + 4 <= first + count; i += 4)
+		{
+			__m256i gathered = _mm256_i32gather_epi64(reinterpret_cast<const long long*>(source + i * stride), offsets4, 1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 8), gathered);
+		}
+	}
+	EZProjectFieldScalar(elements, stride, i, first + count - i, field);
+}
+#endif
+
+inline void EZProjectFields(const void* elements, size_t stride, size_t count, const EZBufferField* fields, size_t fieldCount, UINT threadCount = 0)
+{
+	const unsigned char* source = static_cast<const unsigned char*>(elements);
+#if defined(EZREADBACK_X86)
+	bool avx2 = EZCpuFeatures::Get().AVX2 && stride <= (size_t)(std::numeric_limits<int>::max)() / 8;
+#endif
+
+	// Each block does every field, so its structs are only 
+	// pulled into the cache once
+	EZParallelFor(count, threadCount, EZMax((size_t)65536 / EZMax(stride, (size_t)1), (size_t)1), [&](size_t begin, size_t end)
+	{
+		for (size_t block = begin; block < end; block += 1024)
+		{
+			size_t blockCount = EZMin(end - block, (size_t)1024);
+			for (size_t f = 0; f < fieldCount; f++)
+			{
+#if defined(EZREADBACK_X86)
+				if (avx2 && (fields[f].Size == 4 || fields[f].Size == 8))
+				{
+					EZProjectFieldAVX2(source, stride, block, blockCount, fields[f]);
+					continue;
+				}
+#endif
+				EZProjectFieldScalar(source, stride, block, blockCount, fields[f]);
+			}
+		}
+	});
+}
+
+// --- EZYUVMatrix ----------------------------------------
+//  Color matrices that YUV video is encoded with: BT.601
+//  for standard definition, BT.709 for HD and BT.2020 for
+//  UHD and HDR.
+// --------------------------------------------------------
+enum EZYUVMatrix
+{
+	EZYUVMatrixBT601,
+	EZYUVMatrixBT709,
+	EZYUVMatrixBT2020,
+};
+
+// --- EZYUVOptions ---------------------------------------
+//  Settings for converting planar YUV to RGB.  The 
+//  defaults are BT.709 limited (video) range on every
+//  hardware thread.
+// --------------------------------------------------------
+struct EZYUVOptions
+{
+	EZYUVMatrix Matrix; // Color matrix the video was encoded with
+	bool FullRange;     // Whether samples use the full range instead of 16-235/240
+	UINT ThreadCount;   // Threads to use, or zero for every hardware thread
+
+	EZYUVOptions() : Matrix{ EZYUVMatrixBT709 }, FullRange{ false }, ThreadCount{ 0 } {}
+};
+
+// --- EZYUVCoefficients ----------------------------------
+//  Offsets, scales and matrix terms for EZConvertYUV(),
+//  worked out once per conversion.  Samples are offset
+//  and scaled to 0-1 luma and -0.5-0.5 chroma, then:
+//    R = Y + RCr * Cr
+//    G = Y - GCb * Cb - GCr * Cr
+//    B = Y + BCb * Cb
+//  16-bit samples use the same ranges scaled by 256, which
+//  covers P010 as well since its bits are at the top.
+// --------------------------------------------------------
+struct EZYUVCoefficients
+{
+	float YOffset, YScale;
+	float COffset, CScale;
+	float RCr, GCb, GCr, BCb;
+};
+
+inline EZYUVCoefficients EZGetYUVCoefficients(const EZYUVOptions& options, UINT sampleSize)
+{
+	float kr = 0.2126f, kb = 0.0722f;
+	if (options.Matrix == EZYUVMatrixBT601)
+	{
+		kr = 0.299f;
+		kb = 0.114f;
+	}
+	else if (options.Matrix == EZYUVMatrixBT2020)
+	{
+		kr = 0.2627f;
+		kb = 0.0593f;
+	}
+	float kg = 1.0f - kr - kb;
+
+	float unit = sampleSize == 2 ? 256.0f : 1.0f;
+	EZYUVCoefficients k;
+	k.YOffset = options.FullRange ? 0.0f : 16.0f * unit;
+	k.YScale = 1.0f / ((options.FullRange ? 255.0f : 219.0f) * unit);
+	k.COffset = 128.0f * unit;
+	k.CScale = 1.0f / ((options.FullRange ? 255.0f : 224.0f) * unit);
+	k.RCr = 2.0f * (1.0f - kr);
+	k.GCb = 2.0f * kb * (1.0f - kb) / kg;
+	k.GCr = 2.0f * kr * (1.0f - kr) / kg;
+	k.BCb = 2.0f * (1.0f - kb);
+	return k;
+}
+
+// --- EZStoreYUV -----------------------------------------
+//  Stores pixels converted by EZConvertYUVRow as float4 or
+//  rounded to 8 bits, with alpha set to 1.  The AVX2 
+//  versions store eight pixels from planes of red, green
+//  and blue.
+// --------------------------------------------------------
+inline void EZStoreYUV(DirectX::XMFLOAT4& result, float r, float g, float b) { result = DirectX::XMFLOAT4(r, g, b, 1.0f); }
+inline void EZStoreYUV(EZColor4& result, float r, float g, float b)
+{
+	result = EZColor4((unsigned char)(r * 255.0f + 0.5f), (unsigned char)(g * 255.0f + 0.5f), (unsigned char)(b * 255.0f + 0.5f), 255);
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline void EZStoreYUVAVX2(DirectX::XMFLOAT4* results, __m256 r, __m256 g, __m256 b)
+{
+	// Transpose four planes of eight into eight RGBA texels
+	__m256 a = _mm256_set1_ps(1.0f);
+	__m256 rgLow = _mm256_unpacklo_ps(r, g);
+	__m256 rgHigh = _mm256_unpackhi_ps(r, g);
+	__m256 baLow = _mm256_unpacklo_ps(b, a);
+	__m256 baHigh = _mm256_unpackhi_ps(b, a);
+	__m256 texel04 = _mm256_shuffle_ps(rgLow, baLow, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 texel15 = _mm256_shuffle_ps(rgLow, baLow, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 texel26 = _mm256_shuffle_ps(rgHigh, baHigh, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 texel37 = _mm256_shuffle_ps(rgHigh, baHigh, _MM_SHUFFLE(3, 2, 3, 2));
+	float* out = reinterpret_cast<float*>(results);
+	_mm256_storeu_ps(out, _mm256_permute2f128_ps(texel04, texel15, 0x20));
+	_mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(texel26, texel37, 0x20));
+	_mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(texel04, texel15, 0x31));
+	_mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(texel26, texel37, 0x31));
+}
+
+EZREADBACK_TARGET("avx2")
+inline void EZStoreYUVAVX2(EZColor4* results, __m256 r, __m256 g, __m256 b)
+{
+	const __m256 scale = _mm256_set1_ps(255.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	__m256i red = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r, scale), half));
+	__m256i green = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g, scale), half));
+	__m256i blue = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b, scale), half));
+	__m256i texels = _mm256_or_si256(_mm256_or_si256(red, _mm256_slli_epi32(green, 8)), _mm256_or_si256(_mm256_slli_epi32(blue, 16), _mm256_set1_epi32((int)0xFF000000u)));
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(results), texels);
+}
+#endif
+
+// --- EZConvertYUVRow ------------------------------------
+//  Converts one row of 4:2:0 samples to RGB, with each
+//  chroma pair covering two pixels of the row (and of the
+//  row below).  Results are clamped to 0-1 and stored with
+//  EZStoreYUV().  The AVX2 version does the same math as
+//  the scalar one.
+// --------------------------------------------------------
+template<typename SampleType, typename OutputType>
+inline void EZConvertYUVRowScalar(const SampleType* luma, const SampleType* chroma, size_t first, size_t count, OutputType* results, const EZYUVCoefficients& k)
+{
+	for (size_t x = first; x < first + count; x++)
+	{
+		float y = ((float)luma[x] - k.YOffset) * k.YScale;
+		float cb = ((float)chroma[x / 2 * 2] - k.COffset) * k.CScale;
+		float cr = ((float)chroma[x / 2 * 2 + 1] - k.COffset) * k.CScale;
+		float r = y + k.RCr * cr;
+		float g = y - k.GCb * cb - k.GCr * cr;
+		float b = y + k.BCb * cb;
+		EZStoreYUV(results[x], EZMin(EZMax(r, 0.0f), 1.0f), EZMin(EZMax(g, 0.0f), 1.0f), EZMin(EZMax(b, 0.0f), 1.0f));
+	}
+}
+
+#if defined(EZREADBACK_X86)
+template<typename SampleType, typename OutputType>
+EZREADBACK_TARGET("avx2")
+inline void EZConvertYUVRowAVX2(const SampleType* luma, const SampleType* chroma, size_t count, OutputType* results, const EZYUVCoefficients& k)
+{
+	const __m256 yOffset = _mm256_set1_ps(k.YOffset);
+	const __m256 yScale = _mm256_set1_ps(k.YScale);
+	const __m256 cOffset = _mm256_set1_ps(k.COffset);
+	const __m256 cScale = _mm256_set1_ps(k.CScale);
+	const __m256 rCr = _mm256_set1_ps(k.RCr);
+	const __m256 gCb = _mm256_set1_ps(k.GCb);
+	const __m256 gCr = _mm256_set1_ps(k.GCr);
+	const __m256 bCb = _mm256_set1_ps(k.BCb);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i pickU = _mm256_setr_epi32(0, 0, 2, 2, 4, 4, 6, 6);
+	const __m256i pickV = _mm256_setr_epi32(1, 1, 3, 3, 5, 5, 7, 7);
+
+	size_t x = 0;
+	for (; x + 8 <= count; x += 8)
+	{
+		// Eight luma samples and the four U/V pairs that cover them
+		__m256i lumaSamples, chromaSamples;
+		if (sizeof(SampleType) == 1)
+		{
+			lumaSamples = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + x)));
+			chromaSamples = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma + x)));
+		}
+		else
+		{
+			lumaSamples = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x)));
+			chromaSamples = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma + x)));
+		}
+
+		__m256 y = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(lumaSamples), yOffset), yScale);
+		__m256 cb = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_permutevar8x32_epi32(chromaSamples, pickU)), cOffset), cScale);
+		__m256 cr = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_permutevar8x32_epi32(chromaSamples, pickV)), cOffset), cScale);
+		__m256 r = _mm256_add_ps(y, _mm256_mul_ps(rCr, cr));
+		__m256 g = _mm256_sub_ps(_mm256_sub_ps(y, _mm256_mul_ps(gCb, cb)), _mm256_mul_ps(gCr, cr));
+		__m256 b = _mm256_add_ps(y, _mm256_mul_ps(bCb, cb));
+		r = _mm256_min_ps(_mm256_max_ps(r, zero), one);
+		g = _mm256_min_ps(_mm256_max_ps(g, zero), one);
+		b = _mm256_min_ps(_mm256_max_ps(b, zero), one);
+		EZStoreYUVAVX2(results + x, r, g, b);
+	}
+	EZConvertYUVRowScalar(luma, chroma, x, count - x, results, k);
+}
+#endif
+
+// --- EZConvertYUV ---------------------------------------
+//  Converts a planar NV12, P010 or P016 image to RGBA, 
+//  such as a mapped video texture.  Rows are converted in
+//  parallel.  This is a CPU-only operation and does not
+//  touch D3D.
+// 
+//  Parameters:
+//  - format: NV12, P010 or P016
+//  - luma: first row of the luma plane
+//  - lumaPitch: bytes between luma rows
+//  - chroma: first row of the chroma plane
+//  - chromaPitch: bytes between chroma rows
+//  - width, height: size of the image in pixels
+//  - results: width * height texels to fill
+//  - options: color matrix, range and threading
+// 
+// 	Returns:
+//  - E_INVALIDARG for other formats, or S_OK
+// --------------------------------------------------------
+template<typename OutputType>
+inline HRESULT EZConvertYUV(DXGI_FORMAT format, const void* luma, size_t lumaPitch, const void* chroma, size_t chromaPitch,
+	UINT width, UINT height, OutputType* results, const EZYUVOptions& options = EZYUVOptions())
+{
+	EZPlaneLayout lumaLayout, chromaLayout;
+	if (!EZGetPlaneLayouts(format, width, height, lumaLayout, chromaLayout))
+		return E_INVALIDARG;
+
+	EZYUVCoefficients k = EZGetYUVCoefficients(options, lumaLayout.SampleSize);
+	const unsigned char* lumaRows = static_cast<const unsigned char*>(luma);
+	const unsigned char* chromaRows = static_cast<const unsigned char*>(chroma);
+#if defined(EZREADBACK_X86)
+	bool avx2 = EZCpuFeatures::Get().AVX2;
+#endif
+
+	// Rows are independent; give each thread at least 64K pixels
+	EZParallelFor(height, options.ThreadCount, EZMax((size_t)65536 / EZMax(width, 1u), (size_t)1), [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			const unsigned char* lumaRow = lumaRows + row * lumaPitch;
+			const unsigned char* chromaRow = chromaRows + row / 2 * chromaPitch;
+			OutputType* resultRow = results + row * width;
+			if (lumaLayout.SampleSize == 1)
+			{
+#if defined(EZREADBACK_X86)
+				if (avx2) { EZConvertYUVRowAVX2(lumaRow, chromaRow, width, resultRow, k); continue; }
+#endif
+				EZConvertYUVRowScalar(lumaRow, chromaRow, 0, width, resultRow, k);
+			}
+			else
+			{
+				const unsigned short* lumaRow16 = reinterpret_cast<const unsigned short*>(lumaRow);
+				const unsigned short* chromaRow16 = reinterpret_cast<const unsigned short*>(chromaRow);
+#if defined(EZREADBACK_X86)
+				if (avx2) { EZConvertYUVRowAVX2(lumaRow16, chromaRow16, width, resultRow, k); continue; }
+#endif
+				EZConvertYUVRowScalar(lumaRow16, chromaRow16, 0, width, resultRow, k);
+			}
+		}
+	});
+	return S_OK;
+}
+
+// --- EZBitsPerPixel -------------------------------------
+//  Returns the bits per pixel of the specified format, or
+//  zero for unknown formats.  Block compressed formats 
+//  return their average bits per texel.
+// --------------------------------------------------------
+inline constexpr size_t EZBitsPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+	case DXGI_FORMAT_Y416:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		return 64;
+
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_R32_SINT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_AYUV:
+	case DXGI_FORMAT_Y410:
+	case DXGI_FORMAT_YUY2:
+		return 32;
+
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		return 24;
+
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_A8P8:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_420_OPAQUE:
+	case DXGI_FORMAT_NV11:
+		return 12;
+
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_AI44:
+	case DXGI_FORMAT_IA44:
+	case DXGI_FORMAT_P8:
+		return 8;
+
+	case DXGI_FORMAT_R1_UNORM:
+		return 1;
+
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	default:
+		return 0;
+	}
+}
+
+// --- Element traits -------------------------------------
+//  Compile-time description of the element types reads 
+//  are usually done with, and of the channels of each 
+//  format, so that EZIsElementCompatible() can tell 
+//  whether a type can hold a format's texels without a
+//  resource in sight.  Reads through typed handles 
+//  (EZTypedTexture2D<EZColor4> and friends) use this to
+//  check the format once, when a resource is bound.
+// 
+//  Types without traits, such as user structs, are only
+//  checked by size.  Half precision formats are read into
+//  unsigned shorts (see EZHalfToFloat()), and packed and
+//  block compressed formats into a single unsigned integer
+//  or an EZBlock8/EZBlock16 of the right size.
+// --------------------------------------------------------
+enum EZChannelKind
+{
+	EZChannelUnknown,  // No traits, or a format without a fixed layout
+	EZChannelUnsigned, // UNORM, UNORM_SRGB and UINT
+	EZChannelSigned,   // SNORM and SINT
+	EZChannelFloat,    // FLOAT
+	EZChannelTypeless, // TYPELESS, which any matching channels can read
+	EZChannelPacked,   // Channels not on byte boundaries, or whole blocks
+	EZChannelRaw,      // Bytes that can hold anything of the right size
+};
+
+struct EZFormatChannels
+{
+	EZChannelKind Kind;
+	UINT Count; // Channels per element
+	UINT Bits;  // Bits per channel
+};
+
+// --- EZGetFormatChannels --------------------------------
+//  Returns the channels of a format.  Packed and block 
+//  compressed formats have a single channel covering the
+//  whole texel or block.  Video and palettized formats 
+//  are unknown.
+// --------------------------------------------------------
+inline constexpr EZFormatChannels EZGetFormatChannels(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS: return { EZChannelTypeless, 4, 32 };
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:    return { EZChannelFloat, 4, 32 };
+	case DXGI_FORMAT_R32G32B32A32_UINT:     return { EZChannelUnsigned, 4, 32 };
+	case DXGI_FORMAT_R32G32B32A32_SINT:     return { EZChannelSigned, 4, 32 };
+	case DXGI_FORMAT_R32G32B32_TYPELESS:    return { EZChannelTypeless, 3, 32 };
+	case DXGI_FORMAT_R32G32B32_FLOAT:       return { EZChannelFloat, 3, 32 };
+	case DXGI_FORMAT_R32G32B32_UINT:        return { EZChannelUnsigned, 3, 32 };
+	case DXGI_FORMAT_R32G32B32_SINT:        return { EZChannelSigned, 3, 32 };
+	case DXGI_FORMAT_R32G32_TYPELESS:       return { EZChannelTypeless, 2, 32 };
+	case DXGI_FORMAT_R32G32_FLOAT:          return { EZChannelFloat, 2, 32 };
+	case DXGI_FORMAT_R32G32_UINT:           return { EZChannelUnsigned, 2, 32 };
+	case DXGI_FORMAT_R32G32_SINT:           return { EZChannelSigned, 2, 32 };
+	case DXGI_FORMAT_R32_TYPELESS:          return { EZChannelTypeless, 1, 32 };
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_D32_FLOAT:             return { EZChannelFloat, 1, 32 };
+	case DXGI_FORMAT_R32_UINT:              return { EZChannelUnsigned, 1, 32 };
+	case DXGI_FORMAT_R32_SINT:              return { EZChannelSigned, 1, 32 };
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS: return { EZChannelTypeless, 4, 16 };
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:    return { EZChannelFloat, 4, 16 };
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:     return { EZChannelUnsigned, 4, 16 };
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:     return { EZChannelSigned, 4, 16 };
+	case DXGI_FORMAT_R16G16_TYPELESS:       return { EZChannelTypeless, 2, 16 };
+	case DXGI_FORMAT_R16G16_FLOAT:          return { EZChannelFloat, 2, 16 };
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:           return { EZChannelUnsigned, 2, 16 };
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:           return { EZChannelSigned, 2, 16 };
+	case DXGI_FORMAT_R16_TYPELESS:          return { EZChannelTypeless, 1, 16 };
+	case DXGI_FORMAT_R16_FLOAT:             return { EZChannelFloat, 1, 16 };
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UINT:              return { EZChannelUnsigned, 1, 16 };
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:              return { EZChannelSigned, 1, 16 };
+
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:     return { EZChannelTypeless, 4, 8 };
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:   return { EZChannelUnsigned, 4, 8 };
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:         return { EZChannelSigned, 4, 8 };
+	case DXGI_FORMAT_R8G8_TYPELESS:         return { EZChannelTypeless, 2, 8 };
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:             return { EZChannelUnsigned, 2, 8 };
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:             return { EZChannelSigned, 2, 8 };
+	case DXGI_FORMAT_R8_TYPELESS:           return { EZChannelTypeless, 1, 8 };
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_A8_UNORM:              return { EZChannelUnsigned, 1, 8 };
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:               return { EZChannelSigned, 1, 8 };
+
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT: return { EZChannelPacked, 1, 64 };
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:  return { EZChannelPacked, 1, 32 };
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:        return { EZChannelPacked, 1, 16 };
+	default: break;
+	}
+
+	if (EZIsBlockCompressed(format))
+		return { EZChannelPacked, 1, (UINT)EZBytesPerBlock(format) * 8 };
+	return { EZChannelUnknown, 0, 0 };
+}
+
+// --- EZElementTraits ------------------------------------
+//  Channels of an element type.  Types without a 
+//  specialization have Known set to false.
+// --------------------------------------------------------
+template<EZChannelKind ChannelKind, UINT ChannelCount, UINT ChannelBits>
+struct EZElementTraitsOf
+{
+	static constexpr bool Known = true;
+	static constexpr EZChannelKind Kind = ChannelKind;
+	static constexpr UINT Count = ChannelCount;
+	static constexpr UINT Bits = ChannelBits;
+};
+
+template<typename ElementType>
+struct EZElementTraits
+{
+	static constexpr bool Known = false;
+	static constexpr EZChannelKind Kind = EZChannelUnknown;
+	static constexpr UINT Count = 0;
+	static constexpr UINT Bits = 0;
+};
+
+template<> struct EZElementTraits<unsigned char> : EZElementTraitsOf<EZChannelUnsigned, 1, 8> {};
+template<> struct EZElementTraits<signed char> : EZElementTraitsOf<EZChannelSigned, 1, 8> {};
+template<> struct EZElementTraits<EZColor1> : EZElementTraitsOf<EZChannelUnsigned, 1, 8> {};
+template<> struct EZElementTraits<EZColor2> : EZElementTraitsOf<EZChannelUnsigned, 2, 8> {};
+template<> struct EZElementTraits<EZColor3> : EZElementTraitsOf<EZChannelUnsigned, 3, 8> {};
+template<> struct EZElementTraits<EZColor4> : EZElementTraitsOf<EZChannelUnsigned, 4, 8> {};
+template<> struct EZElementTraits<unsigned short> : EZElementTraitsOf<EZChannelUnsigned, 1, 16> {};
+template<> struct EZElementTraits<short> : EZElementTraitsOf<EZChannelSigned, 1, 16> {};
+template<> struct EZElementTraits<unsigned int> : EZElementTraitsOf<EZChannelUnsigned, 1, 32> {};
+template<> struct EZElementTraits<int> : EZElementTraitsOf<EZChannelSigned, 1, 32> {};
+template<> struct EZElementTraits<unsigned long long> : EZElementTraitsOf<EZChannelUnsigned, 1, 64> {};
+template<> struct EZElementTraits<float> : EZElementTraitsOf<EZChannelFloat, 1, 32> {};
+template<> struct EZElementTraits<DirectX::XMFLOAT2> : EZElementTraitsOf<EZChannelFloat, 2, 32> {};
+template<> struct EZElementTraits<DirectX::XMFLOAT3> : EZElementTraitsOf<EZChannelFloat, 3, 32> {};
+template<> struct EZElementTraits<DirectX::XMFLOAT4> : EZElementTraitsOf<EZChannelFloat, 4, 32> {};
+template<> struct EZElementTraits<DirectX::XMUINT2> : EZElementTraitsOf<EZChannelUnsigned, 2, 32> {};
+template<> struct EZElementTraits<DirectX::XMUINT3> : EZElementTraitsOf<EZChannelUnsigned, 3, 32> {};
+template<> struct EZElementTraits<DirectX::XMUINT4> : EZElementTraitsOf<EZChannelUnsigned, 4, 32> {};
+template<> struct EZElementTraits<DirectX::XMINT2> : EZElementTraitsOf<EZChannelSigned, 2, 32> {};
+template<> struct EZElementTraits<DirectX::XMINT3> : EZElementTraitsOf<EZChannelSigned, 3, 32> {};
+template<> struct EZElementTraits<DirectX::XMINT4> : EZElementTraitsOf<EZChannelSigned, 4, 32> {};
+template<> struct EZElementTraits<EZBlock8> : EZElementTraitsOf<EZChannelRaw, 1, 64> {};
+template<> struct EZElementTraits<EZBlock16> : EZElementTraitsOf<EZChannelRaw, 1, 128> {};
+
+// --- EZIsElementCompatible ------------------------------
+//  Checks at compile time (or at run time, for a format
+//  that is only known then) whether ElementType can hold 
+//  one texel of the format, or one 4x4 block of a block 
+//  compressed format.  The sizes have to match, and for
+//  types with traits, so do the channels:
+//  - TYPELESS formats take any type with the same channels
+//  - FLOAT formats of 16-bit channels take unsigned shorts
+//  - Packed and block formats take one unsigned integer or
+//    an EZBlock8/EZBlock16
+// --------------------------------------------------------
+template<typename ElementType>
+inline constexpr bool EZIsElementCompatible(DXGI_FORMAT format)
+{
+	typedef EZElementTraits<ElementType> Traits;
+	size_t bits = EZIsBlockCompressed(format) ? EZBytesPerBlock(format) * 8 : EZBitsPerPixel(format);
+	if (bits == 0 || bits != sizeof(ElementType) * 8)
+		return false;
+	if (!Traits::Known || Traits::Kind == EZChannelRaw)
+		return true;
+
+	EZFormatChannels channels = EZGetFormatChannels(format);
+	if (channels.Kind == EZChannelPacked)
+		return Traits::Kind == EZChannelUnsigned && Traits::Count == 1;
+	if (channels.Count != Traits::Count || channels.Bits != Traits::Bits)
+		return false;
+	return channels.Kind == Traits::Kind || channels.Kind == EZChannelTypeless ||
+		(channels.Kind == EZChannelFloat && channels.Bits == 16 && Traits::Kind == EZChannelUnsigned);
+}
+
+// --- EZReductionOptions ---------------------------------
+//  Settings for EZReduce(), EZCopyAndReduce() and 
+//  EZReadback::ReadReduced().  The defaults skip the 
+//  histogram and use every hardware thread.
+// --------------------------------------------------------
+struct EZReductionOptions
+{
+	UINT HistogramBins;  // Bins per channel, or zero to skip the histogram
+	float HistogramMin;  // Value at the start of the first bin
+	float HistogramMax;  // Value at the end of the last bin
+	UINT ThreadCount;    // Threads to use, or zero for every hardware thread
+	DXGI_FORMAT Format;  // Format to decode for ReadReduced(), or unknown to use the resource's format
+
+	EZReductionOptions() : HistogramBins{ 0 }, HistogramMin{ 0.0f }, HistogramMax{ 1.0f }, ThreadCount{ 0 }, Format{ DXGI_FORMAT_UNKNOWN } {}
+};
+
+// --- EZReduction ----------------------------------------
+//  Per-channel statistics of a set of texels, gathered by
+//  EZReduce() and friends.  Texels are decoded to float4 
+//  first (see EZDecodeToFloat4()), so channels a format
+//  does not have read as 0 (or 1 for alpha).
+// 
+//  Min and Max ignore NaNs but include infinities, and are
+//  +inf and -inf if a channel had nothing but NaNs.  Sum 
+//  only includes finite values, so GetMean() is the mean
+//  of the finite values.  Values outside the histogram 
+//  range are counted in the first or last bin, and NaNs
+//  are not counted at all.
+// 
+//  The checksum covers the raw bytes of the texels and 
+//  their position, so any change to the data changes it
+//  (barring collisions).  It is meant for comparing 
+//  against golden images, not for security, and does not
+//  depend on the thread count or whether it was fused
+//  with a copy.
+// --------------------------------------------------------
+struct EZReduction
+{
+	size_t Count;                    // Texels reduced
+	float Min[4];                    // Smallest value per channel
+	float Max[4];                    // Largest value per channel
+	double Sum[4];                   // Sum of the finite values per channel
+	size_t NaNCount[4];              // NaNs per channel
+	size_t InfCount[4];              // Infinities per channel
+	unsigned long long Checksum;     // Position dependent checksum of the raw data
+	std::vector<size_t> Histogram;   // HistogramBins counts for each channel in turn
+
+	EZReduction() { Reset(); }
+
+	inline void Reset()
+	{
+		Count = 0;
+		for (int c = 0; c < 4; c++)
+		{
+			Min[c] = std::numeric_limits<float>::infinity();
+			Max[c] = -std::numeric_limits<float>::infinity();
+			Sum[c] = 0.0;
+			NaNCount[c] = 0;
+			InfCount[c] = 0;
+		}
+		Checksum = 0;
+		Histogram.clear();
+	}
+
+	inline void Merge(const EZReduction& other)
+	{
+		Count += other.Count;
+		for (int c = 0; c < 4; c++)
+		{
+			Min[c] = other.Min[c] < Min[c] ? other.Min[c] : Min[c];
+			Max[c] = other.Max[c] > Max[c] ? other.Max[c] : Max[c];
+			Sum[c] += other.Sum[c];
+			NaNCount[c] += other.NaNCount[c];
+			InfCount[c] += other.InfCount[c];
+		}
+		Checksum += other.Checksum;
+
+		if (Histogram.size() < other.Histogram.size())
+			Histogram.resize(other.Histogram.size(), 0);
+		for (size_t i = 0; i < other.Histogram.size(); i++)
+			Histogram[i] += other.Histogram[i];
+	}
+
+	inline double GetMean(UINT channel) const
+	{
+		size_t finite = Count - NaNCount[channel] - InfCount[channel];
+		return finite ? Sum[channel] / finite : 0.0;
+	}
+
+	inline size_t GetHistogramCount(UINT channel, UINT bin) const
+	{
+		return Histogram[channel * (Histogram.size() / 4) + bin];
+	}
+};
+
+// --- EZHistogramRange -----------------------------------
+//  Where EZReduceFloat4 counts a histogram: Bins counters
+//  per channel, starting at Min and Scale bins per unit 
+//  wide.  Values outside the range land in the first or 
+//  last bin.
+// --------------------------------------------------------
+struct EZHistogramRange
+{
+	size_t* Counts; // Null to skip the histogram
+	UINT Bins;
+	float Min;
+	float Scale;    // Bins per unit
+};
+
+
+// --- EZReduceFloat4 -------------------------------------
+//  Adds float4 values to a running reduction.  This is the
+//  kernel behind EZReduce(), which handles threading and
+//  decoding.
+// 
+//  The AVX2 version works on two texels at a time and 
+//  gives the same results as the scalar version, except
+//  that sums may differ in the last few bits since they
+//  are added in a different order.
+// --------------------------------------------------------
+inline void EZReduceFloat4Scalar(const DirectX::XMFLOAT4* values, size_t count, EZReduction& result, const EZHistogramRange& histogram)
+{
+	const float infinity = std::numeric_limits<float>::infinity();
+	const float lastBin = (float)histogram.Bins - 1.0f;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float* texel = &values[i].x;
+		for (int c = 0; c < 4; c++)
+		{
+			float value = texel[c];
+			if (value != value)
+			{
+				result.NaNCount[c]++;
+				continue;
+			}
+
+			if (value < result.Min[c])
+				result.Min[c] = value;
+			if (value > result.Max[c])
+				result.Max[c] = value;
+
+			if (value == infinity || value == -infinity)
+				result.InfCount[c]++;
+			else
+				result.Sum[c] += value;
+
+			if (histogram.Counts)
+			{
+				float position = (value - histogram.Min) * histogram.Scale;
+				position = position > 0.0f ? position : 0.0f;
+				position = position < lastBin ? position : lastBin;
+				histogram.Counts[c * histogram.Bins + (UINT)position]++;
+			}
+		}
+	}
+	result.Count += count;
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline void EZReduceFloat4AVX2(const DirectX::XMFLOAT4* values, size_t count, EZReduction& result, const EZHistogramRange& histogram)
+{
+	const float* data = &values[0].x;
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	const __m256 infinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 histogramMin = _mm256_set1_ps(histogram.Min);
+	const __m256 histogramScale = _mm256_set1_ps(histogram.Scale);
+	const __m256 lastBin = _mm256_set1_ps((float)histogram.Bins - 1.0f);
+
+	__m256 minimum = infinity;
+	__m256 maximum = _mm256_sub_ps(zero, infinity);
+	__m256d sum = _mm256_setzero_pd();
+	__m256i nans = _mm256_setzero_si256();
+	__m256i infs = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2)
+	{
+		__m256 value = _mm256_loadu_ps(data + i * 4);
+		__m256 magnitude = _mm256_and_ps(value, absMask);
+		__m256 nan = _mm256_cmp_ps(value, value, _CMP_UNORD_Q);
+		__m256 inf = _mm256_cmp_ps(magnitude, infinity, _CMP_EQ_OQ);
+		__m256 finite = _mm256_cmp_ps(magnitude, infinity, _CMP_LT_OQ);
+
+		// min/max return the second operand when the first is NaN
+		minimum = _mm256_min_ps(value, minimum);
+		maximum = _mm256_max_ps(value, maximum);
+
+		// Masks are -1 where set
+		nans = _mm256_sub_epi32(nans, _mm256_castps_si256(nan));
+		infs = _mm256_sub_epi32(infs, _mm256_castps_si256(inf));
+
+		// Sum in double so large surfaces do not lose precision
+		__m256 kept = _mm256_and_ps(value, finite);
+		sum = _mm256_add_pd(sum, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(kept)), _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1))));
+
+		if (histogram.Counts)
+		{
+			__m256 position = _mm256_mul_ps(_mm256_sub_ps(value, histogramMin), histogramScale);
+			position = _mm256_min_ps(_mm256_max_ps(position, zero), lastBin);
+			alignas(32) int bins[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(bins), _mm256_cvttps_epi32(position));
+			int skip = _mm256_movemask_ps(nan);
+			for (int lane = 0; lane < 8; lane++)
+			{
+				if (!(skip & (1 << lane)))
+					histogram.Counts[(lane & 3) * histogram.Bins + bins[lane]]++;
+			}
+		}
+	}
+
+	// Fold the two texels in each register into the results
+	alignas(32) float minimums[8];
+	alignas(32) float maximums[8];
+	alignas(32) int nanCounts[8];
+	alignas(32) int infCounts[8];
+	alignas(32) double sums[4];
+	_mm256_store_ps(minimums, minimum);
+	_mm256_store_ps(maximums, maximum);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(nanCounts), nans);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(infCounts), infs);
+	_mm256_store_pd(sums, sum);
+	for (int c = 0; c < 4; c++)
+	{
+		float low = minimums[c] < minimums[c + 4] ? minimums[c] : minimums[c + 4];
+		float high = maximums[c] > maximums[c + 4] ? maximums[c] : maximums[c + 4];
+		result.Min[c] = low < result.Min[c] ? low : result.Min[c];
+		result.Max[c] = high > result.Max[c] ? high : result.Max[c];
+		result.Sum[c] += sums[c];
+		result.NaNCount[c] += (size_t)(unsigned int)nanCounts[c] + (unsigned int)nanCounts[c + 4];
+		result.InfCount[c] += (size_t)(unsigned int)infCounts[c] + (unsigned int)infCounts[c + 4];
+	}
+	result.Count += i;
+
+	EZReduceFloat4Scalar(values + i, count - i, result, histogram);
+}
+#endif
+
+inline void EZReduceFloat4(const DirectX::XMFLOAT4* values, size_t count, EZReduction& result, const EZHistogramRange& histogram)
+{
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		EZReduceFloat4AVX2(values, count, result, histogram);
+		return;
+	}
+#endif
+	EZReduceFloat4Scalar(values, count, result, histogram);
+}
+
+// --- EZChecksum -----------------------------------------
+//  Checksums raw data as a sum of hashed units, where each
+//  unit's hash also depends on its index.  Since the sum
+//  does not care about order, pieces of a surface can be
+//  checksummed separately (and in parallel) and added up,
+//  as long as each piece passes the index of its first 
+//  unit.  Units are 4 bytes, or 2 or 1 for data whose 
+//  elements are not a multiple of 4 bytes.
+// --------------------------------------------------------
+inline unsigned int EZChecksumHash(unsigned int value, unsigned int index)
+{
+	unsigned int hash = value ^ (index * 0x9E3779B9u);
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+template<typename UnitType>
+inline unsigned long long EZChecksumScalar(const unsigned char* data, size_t count, size_t firstUnit)
+{
+	unsigned long long sum = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		UnitType unit;
+		memcpy(&unit, data + i * sizeof(UnitType), sizeof(UnitType));
+		sum += EZChecksumHash(unit, (unsigned int)(firstUnit + i));
+	}
+	return sum;
+}
+
+#if defined(EZREADBACK_X86)
+template<typename UnitType>
+EZREADBACK_TARGET("avx2")
+inline unsigned long long EZChecksumAVX2(const unsigned char* data, size_t count, size_t firstUnit)
+{
+	const __m256i golden = _mm256_set1_epi32((int)0x9E3779B9u);
+	const __m256i multiply1 = _mm256_set1_epi32((int)0x85EBCA6Bu);
+	const __m256i multiply2 = _mm256_set1_epi32((int)0xC2B2AE35u);
+	const __m256i step = _mm256_set1_epi32(8);
+	__m256i index = _mm256_add_epi32(_mm256_set1_epi32((int)(unsigned int)firstUnit), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256i sum = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		// Widen eight units to 32 bits each
+		const unsigned char* units = data + i * sizeof(UnitType);
+		__m256i value;
+		if (sizeof(UnitType) == 4)
+			value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(units));
+		else if (sizeof(UnitType) == 2)
+			value = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(units)));
+		else
+			value = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(units)));
+
+		__m256i hash = _mm256_xor_si256(value, _mm256_mullo_epi32(index, golden));
+		hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 16));
+		hash = _mm256_mullo_epi32(hash, multiply1);
+		hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 13));
+		hash = _mm256_mullo_epi32(hash, multiply2);
+		hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 16));
+
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(hash)));
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(hash, 1)));
+		index = _mm256_add_epi32(index, step);
+	}
+
+	alignas(32) unsigned long long sums[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum);
+	return sums[0] + sums[1] + sums[2] + sums[3] + EZChecksumScalar<UnitType>(data + i * sizeof(UnitType), count - i, firstUnit + i);
+}
+#endif
+
+inline size_t EZChecksumUnitSize(size_t elementSize)
+{
+	return elementSize % 4 == 0 ? 4 : elementSize % 2 == 0 ? 2 : 1;
+}
+
+inline unsigned long long EZChecksum(const void* data, size_t bytes, size_t unitSize, size_t firstUnit)
+{
+	const unsigned char* units = static_cast<const unsigned char*>(data);
+	size_t count = bytes / unitSize;
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		switch (unitSize)
+		{
+		case 4: return EZChecksumAVX2<unsigned int>(units, count, firstUnit);
+		case 2: return EZChecksumAVX2<unsigned short>(units, count, firstUnit);
+		default: return EZChecksumAVX2<unsigned char>(units, count, firstUnit);
+		}
+	}
+#endif
+	switch (unitSize)
+	{
+	case 4: return EZChecksumScalar<unsigned int>(units, count, firstUnit);
+	case 2: return EZChecksumScalar<unsigned short>(units, count, firstUnit);
+	default: return EZChecksumScalar<unsigned char>(units, count, firstUnit);
+	}
+}
+
+// Texels decoded at a time by the reductions, small enough
+// that the decoded texels stay in the L1 cache
+const size_t EZReductionBlockSize = 512;
+
+// Texels per unit of work handed to a thread.  Work is
+// split on these boundaries regardless of the thread 
+// count, so results are the same for any thread count.
+const size_t EZReductionGroupSize = 64 * 1024;
+
+// --- EZReduceItems --------------------------------------
+//  Does the work for all reductions.  The data is made of
+//  items (rows of a pitched surface, or spans of a packed
+//  array) that locate(index, source, firstElement, count)
+//  finds.  Each item is optionally copied to destination
+//  at its first element, then decoded to float4 in blocks
+//  and reduced while it is still in the cache.
+// --------------------------------------------------------
+template<typename LocateFunction, typename DecodeFunction>
+inline void EZReduceItems(
+	size_t itemCount, size_t elementsPerItem, size_t elementSize,
+	LocateFunction locate, DecodeFunction decode, void* destination,
+	EZReduction& result, const EZReductionOptions& options)
+{
+	result.Reset();
+	UINT bins = options.HistogramBins;
+	if (bins > 0)
+		result.Histogram.assign((size_t)bins * 4, 0);
+
+	// Pick a row kernel for copies
+	void (*copyRow)(unsigned char*, const unsigned char*, size_t) = EZCopyRowScalar;
+#if defined(EZREADBACK_X86)
+	copyRow = EZCpuFeatures::Get().AVX2 ? EZCopyRowAVX2 : EZCopyRowSSE2;
+#endif
+
+	// Reduce each group of items separately
+	size_t groupItems = EZMax(EZReductionGroupSize / EZMax(elementsPerItem, (size_t)1), (size_t)1);
+	size_t groupCount = (itemCount + groupItems - 1) / groupItems;
+	std::vector<EZReduction> groups(groupCount);
+	size_t unitSize = EZChecksumUnitSize(elementSize);
+	EZParallelFor(groupCount, options.ThreadCount, 4, [&](size_t begin, size_t end)
+	{
+		std::vector<DirectX::XMFLOAT4> scratch(EZReductionBlockSize);
+		std::vector<size_t> counts((size_t)bins * 4, 0);
+		EZHistogramRange histogram = { bins ? counts.data() : nullptr, bins, options.HistogramMin, bins / (options.HistogramMax - options.HistogramMin) };
+
+		for (size_t group = begin; group < end; group++)
+		{
+			EZReduction& partial = groups[group];
+			size_t lastItem = EZMin((group + 1) * groupItems, itemCount);
+			for (size_t item = group * groupItems; item < lastItem; item++)
+			{
+				const unsigned char* source;
+				size_t firstElement, count;
+				locate(item, source, firstElement, count);
+
+				for (size_t done = 0; done < count; done += EZReductionBlockSize)
+				{
+					size_t blockCount = EZMin(EZReductionBlockSize, count - done);
+					size_t blockBytes = blockCount * elementSize;
+					size_t offset = (firstElement + done) * elementSize;
+					const unsigned char* block = source + done * elementSize;
+					if (destination)
+						copyRow(static_cast<unsigned char*>(destination) + offset, block, blockBytes);
+
+					EZReduceFloat4(decode(block, blockCount, scratch.data()), blockCount, partial, histogram);
+					partial.Checksum += EZChecksum(block, blockBytes, unitSize, offset / unitSize);
+				}
+			}
+		}
+
+		// Each call keeps one histogram, in its first group
+		groups[begin].Histogram.swap(counts);
+	});
+
+	// Merge in order so sums do not depend on timing
+	for (const EZReduction& group : groups)
+		result.Merge(group);
+}
+
+// --- EZReductionDecoder ---------------------------------
+//  Returns a decoder for EZReduceItems() that decodes 
+//  texels of the given format to float4, or uses the data
+//  as-is when it already is float4
+// --------------------------------------------------------
+inline std::function<const DirectX::XMFLOAT4*(const unsigned char*, size_t, DirectX::XMFLOAT4*)> EZReductionDecoder(DXGI_FORMAT format)
+{
+	if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+		return [](const unsigned char* data, size_t /*count*/, DirectX::XMFLOAT4* /*scratch*/) { return reinterpret_cast<const DirectX::XMFLOAT4*>(data); };
+
+	return [format](const unsigned char* data, size_t count, DirectX::XMFLOAT4* scratch)
+	{
+		EZDecodeToFloat4(format, data, count, scratch);
+		return const_cast<const DirectX::XMFLOAT4*>(scratch);
+	};
+}
+
+// --- EZIsReductionValid ---------------------------------
+//  Checks that texels of the given format can be reduced
+//  with the given options
+// --------------------------------------------------------
+inline bool EZIsReductionValid(DXGI_FORMAT format, const EZReductionOptions& options)
+{
+	size_t bits = EZBitsPerPixel(format);
+	if (bits == 0 || bits % 8 != 0 || FAILED(EZDecodeToFloat4(format, nullptr, 0, nullptr)))
+		return false;
+
+	return options.HistogramBins == 0 || options.HistogramMax > options.HistogramMin;
+}
+
+// --- EZReduce -------------------------------------------
+//  Gathers per-channel statistics (min, max, sum, NaN and
+//  infinity counts, an optional histogram and a checksum)
+//  of an array of texels, such as the results of Read(), 
+//  split across threads and using AVX2 when available.
+//  Overwrites anything already in the result.
+//  This is a CPU-only operation and does not touch D3D.
+// 
+//  Parameters:
+//  - format: format of the texels, which must be supported
+//    by EZDecodeToFloat4()
+//  - data: tightly packed texels to reduce
+//  - count: number of texels
+//  - result: filled with the statistics
+//  - options: histogram and threading settings
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not supported or the
+//    histogram range is empty, or S_OK otherwise.
+// --------------------------------------------------------
+inline HRESULT EZReduce(DXGI_FORMAT format, const void* data, size_t count, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	if (!EZIsReductionValid(format, options))
+		return E_INVALIDARG;
+
+	// Split the array into spans of one block each
+	size_t elementSize = EZBitsPerPixel(format) / 8;
+	const unsigned char* texels = static_cast<const unsigned char*>(data);
+	EZReduceItems((count + EZReductionBlockSize - 1) / EZReductionBlockSize, EZReductionBlockSize, elementSize,
+		[&](size_t item, const unsigned char*& source, size_t& firstElement, size_t& elements)
+		{
+			firstElement = item * EZReductionBlockSize;
+			elements = EZMin(EZReductionBlockSize, count - firstElement);
+			source = texels + firstElement * elementSize;
+		},
+		EZReductionDecoder(format), nullptr, result, options);
+	return S_OK;
+}
+
+// --- EZReduce -------------------------------------------
+//  Overloads for arrays of EZColors, whose channels are
+//  reduced as 0.0 - 1.0 floats like AsFloat4() returns
+// --------------------------------------------------------
+inline HRESULT EZReduce(const EZColor1* colors, size_t count, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	return EZReduce(DXGI_FORMAT_R8_UNORM, colors, count, result, options);
+}
+
+inline HRESULT EZReduce(const EZColor2* colors, size_t count, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	return EZReduce(DXGI_FORMAT_R8G8_UNORM, colors, count, result, options);
+}
+
+inline HRESULT EZReduce(const EZColor3* colors, size_t count, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	// There is no RGB8 format, so decode it by hand
+	if (!EZIsReductionValid(DXGI_FORMAT_R8_UNORM, options))
+		return E_INVALIDARG;
+
+	const unsigned char* texels = reinterpret_cast<const unsigned char*>(colors);
+	EZReduceItems((count + EZReductionBlockSize - 1) / EZReductionBlockSize, EZReductionBlockSize, sizeof(EZColor3),
+		[&](size_t item, const unsigned char*& source, size_t& firstElement, size_t& elements)
+		{
+			firstElement = item * EZReductionBlockSize;
+			elements = EZMin(EZReductionBlockSize, count - firstElement);
+			source = texels + firstElement * sizeof(EZColor3);
+		},
+		[](const unsigned char* data, size_t blockCount, DirectX::XMFLOAT4* scratch)
+		{
+			EZDecodeChannels<unsigned char, 3>(data, blockCount, scratch, [](unsigned char value) { return value / 255.0f; });
+			return const_cast<const DirectX::XMFLOAT4*>(scratch);
+		},
+		nullptr, result, options);
+	return S_OK;
+}
+
+inline HRESULT EZReduce(const EZColor4* colors, size_t count, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	return EZReduce(DXGI_FORMAT_R8G8B8A8_UNORM, colors, count, result, options);
+}
+
+template<typename ColorType>
+inline HRESULT EZReduce(const std::vector<ColorType>& colors, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	return EZReduce(colors.data(), colors.size(), result, options);
+}
+
+// --- EZCopyAndReduce ------------------------------------
+//  Fused version of EZCopyPitched() and EZReduce(): copies
+//  pitched rows (such as mapped data) into a tightly 
+//  packed destination and reduces each piece right after
+//  copying it, so the data is only pulled through the 
+//  cache once.  Results are identical to copying first and
+//  calling EZReduce() on the copy, apart from the last few
+//  bits of the sums.  Also works on a MappedView without
+//  copying anything by passing a null destination.
+//  This is a CPU-only operation and does not touch D3D.
+// 
+//  Parameters:
+//  - format: format of the texels, which must be supported
+//    by EZDecodeToFloat4()
+//  - destination: where to copy to, or null to only reduce
+//  - source: where to copy from
+//  - sourceRowPitch: bytes between source rows
+//  - sourceDepthPitch: bytes between source slices
+//  - rowElements: texels in each row
+//  - rowCount: rows per slice
+//  - sliceCount: number of slices
+//  - result: filled with the statistics
+//  - options: histogram and threading settings
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not supported or the
+//    histogram range is empty, or S_OK otherwise.
+// --------------------------------------------------------
+inline HRESULT EZCopyAndReduce(
+	DXGI_FORMAT format, void* destination, const void* source, size_t sourceRowPitch, size_t sourceDepthPitch,
+	size_t rowElements, size_t rowCount, size_t sliceCount, EZReduction& result, const EZReductionOptions& options = EZReductionOptions())
+{
+	if (!EZIsReductionValid(format, options))
+		return E_INVALIDARG;
+
+	// Each row is one item
+	const unsigned char* rows = static_cast<const unsigned char*>(source);
+	EZReduceItems(rowCount * sliceCount, rowElements, EZBitsPerPixel(format) / 8,
+		[&](size_t item, const unsigned char*& row, size_t& firstElement, size_t& elements)
+		{
+			row = rows + (item / rowCount) * sourceDepthPitch + (item % rowCount) * sourceRowPitch;
+			firstElement = item * rowElements;
+			elements = rowElements;
+		},
+		EZReductionDecoder(format), destination, result, options);
+	return S_OK;
+}
+
+// --- EZTileHash -----------------------------------------
+//  64-bit hash of a block of pitched rows, such as a tile
+//  of mapped texture data, in the style of xxHash3.  Rows
+//  are read in 32-byte stripes that are mixed into four
+//  64-bit lanes with 32x32->64 bit multiplies, and the
+//  lanes are scrambled at the end of every row so rows 
+//  cannot trade places without changing the hash.  The
+//  AVX2 and scalar versions give identical results.
+//  Meant for spotting changes, not for security.
+// 
+//  Parameters:
+//  - data: first byte of the first row
+//  - rowBytes: bytes to hash in each row
+//  - rowCount: number of rows
+//  - rowPitch: bytes between rows
+// --------------------------------------------------------
+const unsigned long long EZTileHashSeed[4] = { 0x00000000C2B2AE3Dull, 0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull };
+const unsigned long long EZTileHashKeys[4] = { 0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull };
+const unsigned long long EZTileHashScramble = 0x78E5C0CC4EE679CBull;
+const unsigned long long EZTileHashPrime32 = 0x9E3779B1ull;
+const unsigned long long EZTileHashPrime64 = 0x9E3779B185EBCA87ull;
+
+inline unsigned long long EZTileHashFinish(const unsigned long long* lanes, size_t rowBytes, size_t rowCount)
+{
+	unsigned long long hash = ((unsigned long long)rowBytes * EZTileHashPrime64) ^ (unsigned long long)rowCount;
+	for (int i = 0; i < 4; i++)
+	{
+		unsigned long long lane = lanes[i];
+		lane ^= lane >> 33;
+		lane *= 0xFF51AFD7ED558CCDull;
+		lane ^= lane >> 33;
+		lane *= 0xC4CEB9FE1A85EC53ull;
+		lane ^= lane >> 33;
+		hash = (hash ^ lane) * EZTileHashPrime64;
+	}
+	hash ^= hash >> 37;
+	hash *= 0x165667919E3779F9ull;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+inline unsigned long long EZTileHashScalar(const unsigned char* data, size_t rowBytes, size_t rowCount, size_t rowPitch)
+{
+	unsigned long long lanes[4] = { EZTileHashSeed[0], EZTileHashSeed[1], EZTileHashSeed[2], EZTileHashSeed[3] };
+	size_t stripes = (rowBytes + 31) / 32;
+	for (size_t y = 0; y < rowCount; y++)
+	{
+		const unsigned char* row = data + y * rowPitch;
+		for (size_t s = 0; s < stripes; s++)
+		{
+			// The last stripe of a row is padded with zeros
+			unsigned long long words[4] = {};
+			memcpy(words, row + s * 32, EZMin(rowBytes - s * 32, (size_t)32));
+			for (int i = 0; i < 4; i++)
+			{
+				unsigned long long keyed = words[i] ^ EZTileHashKeys[i];
+				lanes[i] += words[i ^ 1] + (keyed & 0xFFFFFFFFull) * (keyed >> 32);
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			unsigned long long lane = lanes[i];
+			lane ^= lane >> 47;
+			lane ^= EZTileHashScramble;
+			lanes[i] = lane * EZTileHashPrime32;
+		}
+	}
+	return EZTileHashFinish(lanes, rowBytes, rowCount);
+}
+
+#if defined(EZREADBACK_X86)
+EZREADBACK_TARGET("avx2")
+inline unsigned long long EZTileHashAVX2(const unsigned char* data, size_t rowBytes, size_t rowCount, size_t rowPitch)
+{
+	const __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(EZTileHashKeys));
+	const __m256i scramble = _mm256_set1_epi64x((long long)EZTileHashScramble);
+	const __m256i prime = _mm256_set1_epi64x((long long)EZTileHashPrime32);
+	__m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(EZTileHashSeed));
+	size_t fullStripes = rowBytes / 32;
+	size_t tail = rowBytes % 32;
+	for (size_t y = 0; y < rowCount; y++)
+	{
+		const unsigned char* row = data + y * rowPitch;
+		for (size_t s = 0; s <= fullStripes; s++)
+		{
+			// The last stripe of a row is padded with zeros
+			__m256i words;
+			if (s < fullStripes)
+			{
+				words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + s * 32));
+			}
+			else if (tail != 0)
+			{
+				alignas(32) unsigned char last[32] = {};
+				memcpy(last, row + s * 32, tail);
+				words = _mm256_load_si256(reinterpret_cast<const __m256i*>(last));
+			}
+			else
+			{
+				break;
+			}
+
+			// lanes += swapped words + low(keyed) * high(keyed)
+			__m256i keyed = _mm256_xor_si256(words, keys);
+			__m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+			__m256i swapped = _mm256_shuffle_epi32(words, _MM_SHUFFLE(1, 0, 3, 2));
+			lanes = _mm256_add_epi64(lanes, _mm256_add_epi64(swapped, product));
+		}
+
+		// 64-bit multiply by a 32-bit prime, from two 32x32 multiplies
+		lanes = _mm256_xor_si256(lanes, _mm256_srli_epi64(lanes, 47));
+		lanes = _mm256_xor_si256(lanes, scramble);
+		__m256i low = _mm256_mul_epu32(lanes, prime);
+		__m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lanes, 32), prime);
+		lanes = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+	}
+
+	alignas(32) unsigned long long result[4];
+	_mm256_store_si256(reinterpret_cast<__m256i*>(result), lanes);
+	return EZTileHashFinish(result, rowBytes, rowCount);
+}
+#endif
+
+inline unsigned long long EZTileHash(const void* data, size_t rowBytes, size_t rowCount, size_t rowPitch)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+		return EZTileHashAVX2(bytes, rowBytes, rowCount, rowPitch);
+#endif
+	return EZTileHashScalar(bytes, rowBytes, rowCount, rowPitch);
+}
+
+// Bytes of tiles each thread should hash at least, so that
+// small frames are not split across threads for nothing
+const size_t EZTileHashBytesPerThread = 256 * 1024;
+
+// --- EZDirtyTile ----------------------------------------
+//  A tile that changed since the previous frame.  The 
+//  rectangle is in elements (texels, or blocks of block
+//  compressed formats) with exclusive right and bottom
+//  edges, and is clipped to the edge of the surface.
+// --------------------------------------------------------
+struct EZDirtyTile
+{
+	UINT TileX;
+	UINT TileY;
+	UINT Left;
+	UINT Top;
+	UINT Right;
+	UINT Bottom;
+};
+
+// --- EZTileTracker --------------------------------------
+//  Finds which tiles of a surface changed between two
+//  successive frames.  Each frame is split into tiles that
+//  are hashed with EZTileHash() in parallel, and the 
+//  hashes are compared with the ones kept from the frame
+//  before.  The first frame, and any frame whose size or
+//  element size differs from the one before, reports
+//  every tile as dirty.
+// 
+//  This is a CPU-only operation and does not touch D3D;
+//  EZReadback::ReadDirtyTiles() feeds it from a texture.
+//  A tracker follows one surface and is not thread safe.
+// --------------------------------------------------------
+class EZTileTracker
+{
+public:
+	EZTileTracker(UINT tileWidth = 64, UINT tileHeight = 64, UINT threadCount = 0) :
+		tileWidth{ EZMax(tileWidth, 1u) }, tileHeight{ EZMax(tileHeight, 1u) }, threadCount{ threadCount },
+		frameWidth{ 0 }, frameHeight{ 0 }, frameElementSize{ 0 }, valid{ false } {}
+
+	// Hashes a frame of pitched rows and finds the tiles that changed
+	HRESULT Update(const void* data, UINT width, UINT height, size_t rowPitch, size_t elementSize, std::vector<EZDirtyTile>& dirtyTiles)
+	{
+		return Update(data, width, height, rowPitch, elementSize, dirtyTiles, nullptr, 0);
+	}
+
+	// Also copies the tiles that changed to the same place in destination
+	inline HRESULT Update(const void* data, UINT width, UINT height, size_t rowPitch, size_t elementSize, std::vector<EZDirtyTile>& dirtyTiles, void* destination, size_t destinationPitch);
+
+	// Forgets the previous frame, so the next one is all dirty
+	void Reset() { valid = false; }
+
+	UINT GetTileWidth() const { return tileWidth; }
+	UINT GetTileHeight() const { return tileHeight; }
+	UINT GetTilesWide() const { return valid ? (frameWidth + tileWidth - 1) / tileWidth : 0; }
+	UINT GetTilesHigh() const { return valid ? (frameHeight + tileHeight - 1) / tileHeight : 0; }
+
+	// Hashes of the last frame's tiles, one row of tiles after another
+	const std::vector<unsigned long long>& GetHashes() const { return hashes; }
+
+private:
+
+	UINT tileWidth;
+	UINT tileHeight;
+	UINT threadCount;
+	UINT frameWidth;
+	UINT frameHeight;
+	size_t frameElementSize;
+	bool valid;
+	std::vector<unsigned long long> hashes;
+	std::vector<unsigned long long> previous;
+};
+
+
+// --- EZTileTracker::Update ------------------------------
+//  Hashes every tile of a frame and fills dirtyTiles with
+//  the tiles whose hash differs from the previous frame,
+//  in row order.  The frame becomes the one that the next
+//  call compares against.
+// 
+//  With a destination, each tile that changed is also
+//  copied there as soon as it is hashed, while it is still
+//  in the cache.  Keeping the previous frame in the
+//  destination then brings it up to date without copying
+//  the tiles that did not change.
+// 
+//  Parameters:
+//  - data: first element of the frame
+//  - width: elements in each row
+//  - height: number of rows
+//  - rowPitch: bytes between rows
+//  - elementSize: bytes per element
+//  - dirtyTiles: filled with the tiles that changed
+//  - destination: where to copy the tiles that changed, 
+//    laid out like the frame, or null
+//  - destinationPitch: bytes between rows of destination
+// 
+// 	Returns:
+//  - E_INVALIDARG for an empty frame or a row pitch that is
+//    smaller than a row, leaving the previous frame as is
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZTileTracker::Update(const void* data, UINT width, UINT height, size_t rowPitch, size_t elementSize, std::vector<EZDirtyTile>& dirtyTiles, void* destination, size_t destinationPitch)
+{
+	dirtyTiles.clear();
+	if (!data || width == 0 || height == 0 || elementSize == 0 || rowPitch < (size_t)width * elementSize ||
+		(destination && destinationPitch < (size_t)width * elementSize))
+		return E_INVALIDARG;
+
+	bool changedShape = !valid || width != frameWidth || height != frameHeight || elementSize != frameElementSize;
+	UINT tilesWide = (width + tileWidth - 1) / tileWidth;
+	UINT tilesHigh = (height + tileHeight - 1) / tileHeight;
+
+	// Keep the last frame's hashes to compare against
+	previous.swap(hashes);
+	hashes.resize((size_t)tilesWide * tilesHigh);
+
+	// Each row of tiles is one item
+	const unsigned char* rows = static_cast<const unsigned char*>(data);
+	unsigned char* copies = static_cast<unsigned char*>(destination);
+	size_t bytesPerTileRow = (size_t)width * tileHeight * elementSize;
+	size_t minimumPerThread = EZMax(EZTileHashBytesPerThread / bytesPerTileRow, (size_t)1);
+	EZParallelFor(tilesHigh, threadCount, minimumPerThread, [&](size_t begin, size_t end)
+	{
+		for (size_t tileY = begin; tileY < end; tileY++)
+		{
+			size_t top = tileY * tileHeight;
+			size_t rowCount = EZMin((size_t)tileHeight, height - top);
+			for (size_t tileX = 0; tileX < tilesWide; tileX++)
+			{
+				size_t left = tileX * tileWidth;
+				size_t columns = EZMin((size_t)tileWidth, width - left);
+				size_t index = tileY * tilesWide + tileX;
+				const unsigned char* tile = rows + top * rowPitch + left * elementSize;
+				hashes[index] = EZTileHash(tile, columns * elementSize, rowCount, rowPitch);
+
+				if (copies && (changedShape || hashes[index] != previous[index]))
+				{
+					for (size_t row = 0; row < rowCount; row++)
+						memcpy(copies + (top + row) * destinationPitch + left * elementSize, tile + row * rowPitch, columns * elementSize);
+				}
+			}
+		}
+	});
+
+	// Report the tiles that differ
+	for (UINT tileY = 0; tileY < tilesHigh; tileY++)
+	{
+		for (UINT tileX = 0; tileX < tilesWide; tileX++)
+		{
+			size_t index = (size_t)tileY * tilesWide + tileX;
+			if (!changedShape && hashes[index] == previous[index])
+				continue;
+
+			EZDirtyTile tile;
+			tile.TileX = tileX;
+			tile.TileY = tileY;
+			tile.Left = tileX * tileWidth;
+			tile.Top = tileY * tileHeight;
+			tile.Right = (UINT)EZMin((size_t)tile.Left + tileWidth, (size_t)width);
+			tile.Bottom = (UINT)EZMin((size_t)tile.Top + tileHeight, (size_t)height);
+			dirtyTiles.push_back(tile);
+		}
+	}
+
+	frameWidth = width;
+	frameHeight = height;
+	frameElementSize = elementSize;
+	valid = true;
+	return S_OK;
+}
+
+// --- Instrumentation ------------------------------------
+//  Once EZReadback::EnableProfiling() is called, every read
+//  is timed stage by stage (see EZReadbackStage) and can
+//  be exported as a Chrome trace; see GetReadbackStats()
+//  and ExportChromeTrace().  It is off by default, so reads
+//  nobody profiles never take the profiler's lock.
+// 
+//  Define EZREADBACK_NO_INSTRUMENTATION before including
+//  this file to strip all of it.  The functions remain but
+//  do nothing, so calling code does not need to change.
+// --------------------------------------------------------
+#if !defined(EZREADBACK_NO_INSTRUMENTATION)
+#define EZREADBACK_INSTRUMENTATION 1
+#endif
+
+// Stages of a read that are timed separately
+enum EZReadbackStage
+{
+	EZReadbackStageCreate, // Creating staging resources (pool misses only)
+	EZReadbackStageCopy,   // Recording copies into staging resources
+	EZReadbackStageMap,    // Mapping staging resources, including any wait on the GPU
+	EZReadbackStageRead,   // Copying or decoding out of mapped memory
+	EZReadbackStageCount
+};
+
+inline const char* EZReadbackStageName(EZReadbackStage stage)
+{
+	static const char* names[EZReadbackStageCount] = { "Create", "Copy", "Map", "Read" };
+	return stage < EZReadbackStageCount ? names[stage] : "Unknown";
+}
+
+// Blocking maps that take at least this long count as stalls
+const double EZReadbackStallMilliseconds = 0.1;
+
+// Percentiles are taken over this many of the most recent
+// samples of each stage
+const size_t EZReadbackStatsSamples = 1024;
+
+// --- EZReadbackStageStats -------------------------------
+//  Timing and byte counts of one stage of every read since
+//  the stats were last reset.  Copy times only cover 
+//  recording the copy on the CPU, since the GPU side runs
+//  later; time the GPU spends on it shows up as stalls in
+//  the map stage instead.
+// --------------------------------------------------------
+struct EZReadbackStageStats
+{
+	unsigned long long Count;
+	unsigned long long Bytes;  // Bytes created, copied or read
+	double TotalMilliseconds;
+	double MaxMilliseconds;
+	double P50Milliseconds;    // Percentiles over recent samples
+	double P90Milliseconds;
+	double P99Milliseconds;
+};
+
+// --- EZReadbackStats ------------------------------------
+//  Snapshot of the instrumentation of an EZReadback, 
+//  covering every kind of read, including the worker 
+//  thread.  All zero when instrumentation is stripped.
+// --------------------------------------------------------
+struct EZReadbackStats
+{
+	EZReadbackStageStats Stages[EZReadbackStageCount];
+	unsigned long long StillDrawingCount; // Non-blocking maps that found the GPU busy
+	unsigned long long StallCount;        // Blocking maps of at least EZReadbackStallMilliseconds
+	double StallMilliseconds;             // Total time of those maps
+};
+
+#if defined(EZREADBACK_INSTRUMENTATION)
+
+// --- EZReadbackProfiler ---------------------------------
+//  Collects the stage timings of an EZReadback, and trace 
+//  events while tracing is on.  Safe to use from several
+//  threads; recording takes a short lock, so it is meant
+//  for per-read events rather than per-row ones.
+// --------------------------------------------------------
+class EZReadbackProfiler
+{
+public:
+
+	typedef std::chrono::steady_clock Clock;
+
+	EZReadbackProfiler() : stats{}, nextSample{}, tracing{ false }, maxEvents{ 0 }, droppedEvents{ 0 } {}
+
+	// Recording
+	inline void Record(EZReadbackStage stage, Clock::time_point start, Clock::time_point end, size_t bytes);
+	inline void RecordStall(double milliseconds);
+	inline void RecordStillDrawing();
+
+	// Results
+	inline EZReadbackStats GetStats();
+	inline void Reset();
+	inline void SetTracing(bool enabled, size_t maxEvents);
+	inline std::string ExportChromeTrace();
+
+private:
+
+	// One timed stage, for the trace
+	struct TraceEvent
+	{
+		EZReadbackStage Stage;
+		unsigned int Thread;
+		long long StartMicroseconds;
+		long long DurationMicroseconds;
+		size_t Bytes;
+	};
+
+	std::mutex lock;
+	EZReadbackStats stats;
+	std::vector<double> samples[EZReadbackStageCount]; // Ring of recent durations
+	size_t nextSample[EZReadbackStageCount];
+	bool tracing;
+	size_t maxEvents;
+	size_t droppedEvents;
+	std::vector<TraceEvent> events;
+};
+
+// --- EZReadbackStageTimer -------------------------------
+//  Times a stage from construction to destruction.  Does
+//  nothing when the profiler is null.
+// --------------------------------------------------------
+class EZReadbackStageTimer
+{
+public:
+
+	EZReadbackStageTimer(EZReadbackProfiler* profiler, EZReadbackStage stage) :
+		profiler{ profiler }, stage{ stage }, bytes{ 0 }, start{ profiler ? EZReadbackProfiler::Clock::now() : EZReadbackProfiler::Clock::time_point() } {}
+	EZReadbackStageTimer(const EZReadbackStageTimer&) = delete;
+	EZReadbackStageTimer& operator=(const EZReadbackStageTimer&) = delete;
+
+	~EZReadbackStageTimer()
+	{
+		if (profiler)
+			profiler->Record(stage, start, EZReadbackProfiler::Clock::now(), bytes);
+	}
+
+	inline void SetBytes(size_t bytes) { this->bytes = bytes; }
+
+private:
+
+	EZReadbackProfiler* profiler;
+	EZReadbackStage stage;
+	size_t bytes;
+	EZReadbackProfiler::Clock::time_point start;
+};
+
+
+// --- EZReadbackProfiler::Record -------------------------
+//  Adds the timing of one stage to the stats, and to the
+//  trace if tracing is on
+// --------------------------------------------------------
+inline void EZReadbackProfiler::Record(EZReadbackStage stage, Clock::time_point start, Clock::time_point end, size_t bytes)
+{
+	double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	std::lock_guard<std::mutex> guard(lock);
+	EZReadbackStageStats& stageStats = stats.Stages[stage];
+	stageStats.Count++;
+	stageStats.Bytes += bytes;
+	stageStats.TotalMilliseconds += milliseconds;
+	stageStats.MaxMilliseconds = EZMax(stageStats.MaxMilliseconds, milliseconds);
+
+	// Keep recent samples for the percentiles
+	std::vector<double>& recent = samples[stage];
+	if (recent.size() < EZReadbackStatsSamples)
+		recent.push_back(milliseconds);
+	else
+		recent[nextSample[stage]] = milliseconds;
+	nextSample[stage] = (nextSample[stage] + 1) % EZReadbackStatsSamples;
+
+	if (!tracing)
+		return;
+
+	if (events.size() >= maxEvents)
+	{
+		droppedEvents++;
+		return;
+	}
+
+	TraceEvent event;
+	event.Stage = stage;
+	event.Thread = (unsigned int)std::hash<std::thread::id>()(std::this_thread::get_id());
+	event.StartMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(start.time_since_epoch()).count();
+	event.DurationMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	event.Bytes = bytes;
+	events.push_back(event);
+}
+
+
+// --- EZReadbackProfiler::RecordStall --------------------
+//  Counts a blocking map that waited on the GPU
+// --------------------------------------------------------
+inline void EZReadbackProfiler::RecordStall(double milliseconds)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	stats.StallCount++;
+	stats.StallMilliseconds += milliseconds;
+}
+
+
+// --- EZReadbackProfiler::RecordStillDrawing -------------
+//  Counts a non-blocking map that found the GPU busy
+// --------------------------------------------------------
+inline void EZReadbackProfiler::RecordStillDrawing()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	stats.StillDrawingCount++;
+}
+
+
+// --- EZReadbackProfiler::GetStats -----------------------
+//  Returns a snapshot of the stats, with the percentiles
+//  worked out from the recent samples
+// --------------------------------------------------------
+inline EZReadbackStats EZReadbackProfiler::GetStats()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	EZReadbackStats snapshot = stats;
+	for (int stage = 0; stage < EZReadbackStageCount; stage++)
+	{
+		std::vector<double> sorted = samples[stage];
+		if (sorted.empty())
+			continue;
+
+		// Nearest rank
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&](double p) { return sorted[(size_t)std::ceil(p * sorted.size()) - 1]; };
+		snapshot.Stages[stage].P50Milliseconds = percentile(0.50);
+		snapshot.Stages[stage].P90Milliseconds = percentile(0.90);
+		snapshot.Stages[stage].P99Milliseconds = percentile(0.99);
+	}
+	return snapshot;
+}
+
+
+// --- EZReadbackProfiler::Reset --------------------------
+//  Clears the stats and any recorded trace events
+// --------------------------------------------------------
+inline void EZReadbackProfiler::Reset()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	stats = EZReadbackStats();
+	for (int stage = 0; stage < EZReadbackStageCount; stage++)
+	{
+		samples[stage].clear();
+		nextSample[stage] = 0;
+	}
+	events.clear();
+	droppedEvents = 0;
+}
+
+
+// --- EZReadbackProfiler::SetTracing ---------------------
+//  Turns recording of trace events on or off.  Recording
+//  stops once maxEvents events are held, until the trace
+//  is cleared with Reset().
+// --------------------------------------------------------
+inline void EZReadbackProfiler::SetTracing(bool enabled, size_t maxEvents)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	tracing = enabled;
+	this->maxEvents = maxEvents;
+}
+
+
+// --- EZReadbackProfiler::ExportChromeTrace --------------
+//  Returns the recorded events as Chrome trace event JSON
+//  (for chrome://tracing or Perfetto), one complete event
+//  per stage with the bytes as an argument.  Timestamps 
+//  are microseconds of std::chrono::steady_clock, which 
+//  is QueryPerformanceCounter on Windows, so the events 
+//  line up with other traces that use the same clock.
+// --------------------------------------------------------
+inline std::string EZReadbackProfiler::ExportChromeTrace()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	unsigned long processId = (unsigned long)GetCurrentProcessId();
+
+	std::string json = "{\"traceEvents\":[";
+	char buffer[256];
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		const TraceEvent& event = events[i];
+		snprintf(buffer, sizeof(buffer),
+			"%s\n{\"name\":\"%s\",\"cat\":\"EZReadback\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%u,\"ts\":%lld,\"dur\":%lld,\"args\":{\"bytes\":%llu}}",
+			i ? "," : "", EZReadbackStageName(event.Stage), processId, event.Thread,
+			event.StartMicroseconds, event.DurationMicroseconds, (unsigned long long)event.Bytes);
+		json += buffer;
+	}
+	snprintf(buffer, sizeof(buffer), "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%llu}}\n", (unsigned long long)droppedEvents);
+	json += buffer;
+	return json;
+}
+
+#else
+
+// Stripped versions that compile away to nothing
+class EZReadbackProfiler
+{
+public:
+	inline EZReadbackStats GetStats() { return EZReadbackStats(); }
+	inline void Reset() {}
+	inline void SetTracing(bool /*enabled*/, size_t /*maxEvents*/) {}
+	inline std::string ExportChromeTrace() { return std::string(); }
+};
+
+class EZReadbackStageTimer
+{
+public:
+	EZReadbackStageTimer(EZReadbackProfiler* /*profiler*/, EZReadbackStage /*stage*/) {}
+	inline void SetBytes(size_t /*bytes*/) {}
+};
+
+#endif
+
+// --- EZStagingKey ---------------------------------------
+//  Identifies a staging resource by its dimension and its
+//  full (already normalized) staging description.  Two
+//  keys compare equal only if a resource created from one
+//  can be reused for the other.
+// --------------------------------------------------------
+struct EZStagingKey
+{
+	D3D11_RESOURCE_DIMENSION Dimension;
+	union
+	{
+		D3D11_BUFFER_DESC Buffer;
+		D3D11_TEXTURE1D_DESC Texture1D;
+		D3D11_TEXTURE2D_DESC Texture2D;
+		D3D11_TEXTURE3D_DESC Texture3D;
+	};
+
+	EZStagingKey() { memset(static_cast<void*>(this), 0, sizeof(EZStagingKey)); }
+	EZStagingKey(const D3D11_BUFFER_DESC& desc) : EZStagingKey() { Dimension = D3D11_RESOURCE_DIMENSION_BUFFER; Buffer = desc; }
+	EZStagingKey(const D3D11_TEXTURE1D_DESC& desc) : EZStagingKey() { Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE1D; Texture1D = desc; }
+	EZStagingKey(const D3D11_TEXTURE2D_DESC& desc) : EZStagingKey() { Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D; Texture2D = desc; }
+	EZStagingKey(const D3D11_TEXTURE3D_DESC& desc) : EZStagingKey() { Dimension = D3D11_RESOURCE_DIMENSION_TEXTURE3D; Texture3D = desc; }
+
+	inline bool operator==(const EZStagingKey& other) const { return memcmp(this, &other, sizeof(EZStagingKey)) == 0; }
+};
+
+// --- EZStagingPoolStats ---------------------------------
+//  Counters describing how well the staging pool is
+//  doing.  A hit is a reused resource, a miss is a newly
+//  created one and an eviction is a pooled resource that
+//  was released to stay under the byte budget.
+// --------------------------------------------------------
+struct EZStagingPoolStats
+{
+	unsigned long long Hits;
+	unsigned long long Misses;
+	unsigned long long Evictions;
+	size_t BytesPooled;   // Total size of all resources the pool holds
+	size_t BytesInUse;    // Portion of the above currently handed out
+	size_t ResourceCount; // Number of resources the pool holds
+};
+
+// --- EZStagingPool --------------------------------------
+//  Keeps staging resources alive between reads so they
+//  can be reused instead of created and destroyed on every
+//  call.  Idle resources are evicted in least-recently-used
+//  order whenever the pool grows past its byte budget.  A
+//  budget of zero disables pooling entirely.
+// 
+//  The pool never talks to a device itself; creation goes
+//  through the function handed to Acquire(), so the pool
+//  can be driven by any device (or a fake one).
+// --------------------------------------------------------
+class EZStagingPool
+{
+public:
+	typedef std::function<HRESULT(Microsoft::WRL::ComPtr<ID3D11Resource>&)> CreateFunction;
+
+	EZStagingPool(size_t budgetInBytes = 256 * 1024 * 1024) :
+		budget{ budgetInBytes }, tick{ 0 }, stats{} {}
+
+	// Gets an idle resource matching the key or creates a new one
+	HRESULT Acquire(const EZStagingKey& key, size_t sizeInBytes, const CreateFunction& create, Microsoft::WRL::ComPtr<ID3D11Resource>& result);
+
+	// Returns a resource from Acquire() to the pool
+	void Release(ID3D11Resource* resource);
+
+	// Budget and housekeeping
+	void SetBudget(size_t budgetInBytes);
+	size_t GetBudget() const { return budget; }
+	void Clear();
+	EZStagingPoolStats GetStats() const { return stats; }
+	void ResetCounters() { stats.Hits = 0; stats.Misses = 0; stats.Evictions = 0; }
+
+private:
+
+	struct Entry
+	{
+		EZStagingKey Key;
+		Microsoft::WRL::ComPtr<ID3D11Resource> Resource;
+		size_t SizeInBytes;
+		unsigned long long LastUsed;
+		bool InUse;
+	};
+
+	std::vector<Entry> entries;
+	size_t budget;
+	unsigned long long tick;
+	EZStagingPoolStats stats;
+
+	void Trim();
+	void RemoveEntry(size_t index);
+};
+
+
+// --- Acquire --------------------------------------------
+//  Looks for an idle pooled resource with exactly the 
+//  given key and hands it out.  If there is none, a new
+//  resource is made with the create function and tracked
+//  by the pool from then on.
+// 
+//  Parameters:
+//  - key: normalized staging description to match
+//  - sizeInBytes: approximate size of the resource
+//  - create: creates a new resource on a miss
+//  - result: receives the resource
+// 
+// 	Returns:
+//  - The HRESULT from the create function on a miss, or 
+//    S_OK on a hit.
+// --------------------------------------------------------
+inline HRESULT EZStagingPool::Acquire(const EZStagingKey& key, size_t sizeInBytes, const CreateFunction& create, Microsoft::WRL::ComPtr<ID3D11Resource>& result)
+{
+	// Reuse an idle resource if one matches
+	for (Entry& entry : entries)
+	{
+		if (!entry.InUse && entry.Key == key)
+		{
+			entry.InUse = true;
+			entry.LastUsed = ++tick;
+			stats.Hits++;
+			stats.BytesInUse += entry.SizeInBytes;
+			result = entry.Resource;
+			return S_OK;
+		}
+	}
+
+	// Nothing to reuse, so make a new one
+	stats.Misses++;
+	Microsoft::WRL::ComPtr<ID3D11Resource> created;
+	HRESULT hr = create(created);
+	if (FAILED(hr))
+		return hr;
+
+	Entry entry = {};
+	entry.Key = key;
+	entry.Resource = created;
+	entry.SizeInBytes = sizeInBytes;
+	entry.LastUsed = ++tick;
+	entry.InUse = true;
+	entries.push_back(entry);
+
+	stats.BytesPooled += sizeInBytes;
+	stats.BytesInUse += sizeInBytes;
+	stats.ResourceCount = entries.size();
+
+	// Make room for the new resource if necessary
+	Trim();
+
+	result = created;
+	return S_OK;
+}
+
+// --- Release --------------------------------------------
+//  Marks a resource as idle so later reads can reuse it.
+//  Resources the pool does not know about are ignored.
+// --------------------------------------------------------
+inline void EZStagingPool::Release(ID3D11Resource* resource)
+{
+	for (Entry& entry : entries)
+	{
+		if (entry.InUse && entry.Resource.Get() == resource)
+		{
+			entry.InUse = false;
+			entry.LastUsed = ++tick;
+			stats.BytesInUse -= entry.SizeInBytes;
+			break;
+		}
+	}
+
+	Trim();
+}
+
+// --- SetBudget ------------------------------------------
+//  Changes the byte budget, evicting idle resources right
+//  away if the pool is now over it
+// --------------------------------------------------------
+inline void EZStagingPool::SetBudget(size_t budgetInBytes)
+{
+	budget = budgetInBytes;
+	Trim();
+}
+
+// --- Clear ----------------------------------------------
+//  Drops every idle resource.  Resources that are still
+//  handed out stay tracked until they are released.
+// --------------------------------------------------------
+inline void EZStagingPool::Clear()
+{
+	for (size_t i = entries.size(); i > 0; i--)
+	{
+		if (!entries[i - 1].InUse)
+			RemoveEntry(i - 1);
+	}
+}
+
+// --- Trim -----------------------------------------------
+//  Evicts idle resources, least recently used first, 
+//  until the pool is within its budget or only in-use
+//  resources remain
+// --------------------------------------------------------
+inline void EZStagingPool::Trim()
+{
+	while (stats.BytesPooled > budget)
+	{
+		// Find the least recently used idle entry
+		size_t oldest = entries.size();
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			if (!entries[i].InUse && (oldest == entries.size() || entries[i].LastUsed < entries[oldest].LastUsed))
+				oldest = i;
+		}
+
+		// Everything left is in use
+		if (oldest == entries.size())
+			return;
+
+		RemoveEntry(oldest);
+		stats.Evictions++;
+	}
+}
+
+// --- RemoveEntry ----------------------------------------
+//  Removes an entry and updates the size counters
+// --------------------------------------------------------
+inline void EZStagingPool::RemoveEntry(size_t index)
+{
+	stats.BytesPooled -= entries[index].SizeInBytes;
+	entries.erase(entries.begin() + index);
+	stats.ResourceCount = entries.size();
+}
+
+// --- EZSPSCQueue ----------------------------------------
+//  Bounded lock-free queue for handing items from exactly
+//  one producer thread to exactly one consumer thread, as
+//  used by the worker thread of EZReadback.  Push() fails
+//  when the queue is full and Pop() fails when it is 
+//  empty; neither ever blocks or takes a lock.
+// --------------------------------------------------------
+template<typename ItemType>
+class EZSPSCQueue
+{
+public:
+
+	explicit EZSPSCQueue(size_t capacity) : items(capacity + 1), head{ 0 }, tail{ 0 } {}
+	EZSPSCQueue(const EZSPSCQueue&) = delete;
+	EZSPSCQueue& operator=(const EZSPSCQueue&) = delete;
+
+	// Producer only: moves the item in, unless the queue is full
+	inline bool Push(ItemType&& item)
+	{
+		size_t current = tail.load(std::memory_order_relaxed);
+		size_t next = (current + 1) % items.size();
+		if (next == head.load(std::memory_order_acquire))
+			return false;
+
+		items[current] = std::move(item);
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only: moves the oldest item out, unless the queue is empty
+	inline bool Pop(ItemType& item)
+	{
+		size_t current = head.load(std::memory_order_relaxed);
+		if (current == tail.load(std::memory_order_acquire))
+			return false;
+
+		// Reset the slot so it does not hold on to anything
+		item = std::move(items[current]);
+		items[current] = ItemType();
+		head.store((current + 1) % items.size(), std::memory_order_release);
+		return true;
+	}
+
+	inline size_t GetCapacity() const { return items.size() - 1; }
+
+private:
+
+	std::vector<ItemType> items; // One slot always stays empty
+	std::atomic<size_t> head;    // Next item to pop, only written by the consumer
+	char padding[64];            // Keeps head and tail on separate cache lines
+	std::atomic<size_t> tail;    // Next slot to fill, only written by the producer
+};
+
+// How long the worker thread of EZReadback sleeps between
+// checks on a copy the GPU has not finished
+const unsigned int EZReadbackWorkerPollMicroseconds = 250;
+
+// --- EZReadbackBackend ----------------------------------
+//  Everything EZReadback needs from the device and context:
+//  creating staging resources, copying into them, mapping
+//  them and flushing.  EZD3D11Backend forwards to D3D11,
+//  and EZReferenceBackend emulates it all on the CPU so
+//  the read paths can run and be measured without a GPU.
+// 
+//  Resources handed to a backend must have come from the
+//  same kind of backend.  Map(), Unmap() and Flush() are
+//  called from the worker thread (see StartWorker()) while
+//  it runs, so a backend used that way must allow it.
+// --------------------------------------------------------
+class EZReadbackBackend
+{
+public:
+
+	virtual ~EZReadbackBackend() {}
+
+	// Resource creation, as on ID3D11Device
+	virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** result) = 0;
+	virtual HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** result) = 0;
+	virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** result) = 0;
+	virtual HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** result) = 0;
+
+	// Copies and mapping, as on ID3D11DeviceContext
+	virtual void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) = 0;
+	virtual void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z, 
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* region) = 0;
+	virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) = 0;
+	virtual void Unmap(ID3D11Resource* resource, UINT subresource) = 0;
+	virtual void Flush() = 0;
+};
+
+
+#if !defined(EZREADBACK_NO_D3D11)
+// --- EZD3D11Backend -------------------------------------
+//  Backend that forwards to a D3D11 device and immediate 
+//  context.  For the worker thread, the context must be 
+//  made thread-safe with 
+//  ID3D11Multithread::SetMultithreadProtected().
+// --------------------------------------------------------
+class EZD3D11Backend : public EZReadbackBackend
+{
+public:
+
+	EZD3D11Backend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) : device{ device }, context{ context } {}
+
+	inline ID3D11Device* GetDevice() { return device.Get(); }
+	inline ID3D11DeviceContext* GetContext() { return context.Get(); }
+
+	HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** result) override { return device->CreateBuffer(desc, initialData, result); }
+	HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** result) override { return device->CreateTexture1D(desc, initialData, result); }
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** result) override { return device->CreateTexture2D(desc, initialData, result); }
+	HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** result) override { return device->CreateTexture3D(desc, initialData, result); }
+
+	void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override { context->CopyResource(destination, source); }
+	void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* region) override
+	{
+		context->CopySubresourceRegion(destination, destinationSubresource, x, y, z, source, sourceSubresource, region);
+	}
+	HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override { return context->Map(resource, subresource, mapType, mapFlags, mapped); }
+	void Unmap(ID3D11Resource* resource, UINT subresource) override { context->Unmap(resource, subresource); }
+	void Flush() override { context->Flush(); }
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+};
+#endif
+
+
+// Row pitch alignment of EZReferenceBackend resources,
+// a common choice of D3D11 drivers for staging textures
+const UINT EZReferenceRowPitchAlignment = 256;
+
+// --- EZReferenceBackendStats ----------------------------
+//  Counts of what an EZReferenceBackend has been asked to
+//  do since it was created or its stats were reset
+// --------------------------------------------------------
+struct EZReferenceBackendStats
+{
+	unsigned long long Creates;
+	unsigned long long Copies;            // CopyResource() and CopySubresourceRegion() calls
+	unsigned long long BytesCopied;
+	unsigned long long Maps;              // Successful maps only
+	unsigned long long StillDrawingCount; // Non-blocking maps made before a copy was "done"
+	unsigned long long Flushes;
+};
+
+// --- EZReferenceSubresource -----------------------------
+//  Memory of one subresource of an EZReferenceBackend 
+//  resource, laid out like a mapped D3D11 subresource.
+//  Rows are rows of blocks for block compressed formats.
+// --------------------------------------------------------
+struct EZReferenceSubresource
+{
+	std::vector<unsigned char> Data;
+	UINT RowPitch;
+	UINT DepthPitch;
+	UINT Width;      // Texels, or bytes for buffers
+	UINT Height;
+	UINT RowBytes;   // Bytes of data in each row, before padding
+	UINT RowCount;   // Rows per slice
+	UINT SliceCount;
+};
+
+// --- EZReferenceStorage ---------------------------------
+//  Everything an EZReferenceBackend resource holds besides
+//  its description
+// --------------------------------------------------------
+struct EZReferenceStorage
+{
+	std::vector<EZReferenceSubresource> Subresources;
+	DXGI_FORMAT Format;       // DXGI_FORMAT_UNKNOWN for buffers
+	UINT MipLevels;
+	bool Readable;            // Staging with CPU read access
+	std::chrono::steady_clock::time_point ReadyTime; // When the last copy into it is "done"
+	unsigned long long ReadyFrame;                   // Frame from which the last copy into it is "done"
+};
+
+// Private IID that only resources created by an 
+// EZReferenceBackend answer, handing out their storage
+const GUID EZReferenceStorageId = { 0x6c1f3b9e, 0x2d47, 0x4e8a, { 0x9b, 0x15, 0x3a, 0x7e, 0xc2, 0x58, 0x94, 0x0d } };
+
+// --- EZReferenceResource --------------------------------
+//  CPU-side implementation of a D3D11 resource interface,
+//  created by EZReferenceBackend.  Only reference counting,
+//  GetType() and GetDesc() do anything, besides handing 
+//  out the storage for EZReferenceStorageId.
+// --------------------------------------------------------
+template<typename InterfaceType, typename DescriptionType, D3D11_RESOURCE_DIMENSION Dimension>
+class EZReferenceResource final : public InterfaceType
+{
+public:
+
+	EZReferenceResource(const DescriptionType& desc) : desc(desc), references{ 1 } {}
+	EZReferenceResource(const EZReferenceResource&) = delete;
+	EZReferenceResource& operator=(const EZReferenceResource&) = delete;
+
+	EZReferenceStorage Storage;
+
+	// IUnknown
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID id, void** result) override
+	{
+		if (!result)
+			return E_POINTER;
+
+		*result = nullptr;
+		if (id == EZReferenceStorageId)
+		{
+			AddRef();
+			*result = &Storage;
+			return S_OK;
+		}
+		if (!(id == __uuidof(IUnknown) || id == __uuidof(ID3D11DeviceChild) || id == __uuidof(ID3D11Resource) || id == __uuidof(InterfaceType)))
+			return E_NOINTERFACE;
+
+		AddRef();
+		*result = static_cast<InterfaceType*>(this);
+		return S_OK;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++references; }
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		ULONG count = --references;
+		if (count == 0)
+			delete this;
+		return count;
+	}
+
+	// ID3D11DeviceChild; there is no device to hand out
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override { *device = nullptr; }
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID /*guid*/, UINT* /*dataSize*/, void* /*data*/) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID /*guid*/, UINT /*dataSize*/, const void* /*data*/) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID /*guid*/, const IUnknown* /*data*/) override { return E_NOTIMPL; }
+
+	// ID3D11Resource
+	void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* type) override { *type = Dimension; }
+	void STDMETHODCALLTYPE SetEvictionPriority(UINT /*priority*/) override {}
+	UINT STDMETHODCALLTYPE GetEvictionPriority() override { return 0; }
+
+	// ID3D11Buffer and ID3D11TextureXD
+	void STDMETHODCALLTYPE GetDesc(DescriptionType* result) override { *result = desc; }
+
+private:
+
+	~EZReferenceResource() {}
+
+	DescriptionType desc;
+	std::atomic<ULONG> references;
+};
+
+
+// --- EZReferenceBackend ---------------------------------
+//  Backend that keeps every resource in CPU memory, for 
+//  running and benchmarking reads headless.  Subresources 
+//  are padded like a driver would, to a configurable row 
+//  pitch alignment, and copies can be given a latency: 
+//  until it has passed, non-blocking maps of the 
+//  destination return DXGI_ERROR_WAS_STILL_DRAWING.
+// 
+//  SetCopyLatency() sets a wall clock latency, which 
+//  blocking maps sleep through.  SetCopyLatencyFrames()
+//  sets one in frames, which pass only when AdvanceFrame()
+//  is called, so tests can step a simulated frame clock;
+//  a blocking map finishes such a copy at once, as if the
+//  GPU caught up.  Without a wall clock latency (the 
+//  default) everything is deterministic.
+// 
+//  Only resources created by an EZReferenceBackend can be
+//  used with it; others are treated as invalid arguments.
+//  All calls are safe from any thread.  Copies are done
+//  immediately, under a lock.
+// --------------------------------------------------------
+class EZReferenceBackend : public EZReadbackBackend
+{
+public:
+
+	EZReferenceBackend() : rowPitchAlignment{ EZReferenceRowPitchAlignment }, copyLatency{ 0 }, copyLatencyFrames{ 0 }, frame{ 0 }, stats{} {}
+
+	// Emulation settings, which apply to resources created
+	// and copies made from then on
+	inline void SetRowPitchAlignment(UINT alignment) { std::lock_guard<std::mutex> guard(lock); rowPitchAlignment = EZMax(alignment, 1u); }
+	inline void SetCopyLatency(std::chrono::microseconds latency) { std::lock_guard<std::mutex> guard(lock); copyLatency = latency; }
+	inline void SetCopyLatencyFrames(UINT frames) { std::lock_guard<std::mutex> guard(lock); copyLatencyFrames = frames; }
+
+	// Simulated frame clock for SetCopyLatencyFrames()
+	inline void AdvanceFrame() { std::lock_guard<std::mutex> guard(lock); frame++; }
+	inline unsigned long long GetFrame() { std::lock_guard<std::mutex> guard(lock); return frame; }
+
+	inline EZReferenceBackendStats GetStats() { std::lock_guard<std::mutex> guard(lock); return stats; }
+	inline void ResetStats() { std::lock_guard<std::mutex> guard(lock); stats = EZReferenceBackendStats(); }
+
+	// Replaces the contents of a subresource, like 
+	// ID3D11DeviceContext::UpdateSubresource() 
+	inline HRESULT UpdateSubresource(ID3D11Resource* resource, UINT subresource, const void* data, UINT rowPitch, UINT depthPitch);
+
+	// EZReadbackBackend
+	inline HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** result) override;
+	inline HRESULT CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** result) override;
+	inline HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** result) override;
+	inline HRESULT CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** result) override;
+
+	inline void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override;
+	inline void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+		ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* region) override;
+	inline HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override;
+	inline void Unmap(ID3D11Resource* /*resource*/, UINT /*subresource*/) override {}
+	inline void Flush() override { std::lock_guard<std::mutex> guard(lock); stats.Flushes++; }
+
+private:
+
+	typedef EZReferenceResource<ID3D11Buffer, D3D11_BUFFER_DESC, D3D11_RESOURCE_DIMENSION_BUFFER> Buffer;
+	typedef EZReferenceResource<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE1D> Texture1D;
+	typedef EZReferenceResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE2D> Texture2D;
+	typedef EZReferenceResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE3D> Texture3D;
+
+	std::mutex lock;
+	UINT rowPitchAlignment;
+	std::chrono::microseconds copyLatency;
+	UINT copyLatencyFrames;
+	unsigned long long frame;
+	EZReferenceBackendStats stats;
+
+	inline HRESULT CreateStorage(EZReferenceStorage& storage, DXGI_FORMAT format, UINT width, UINT height, UINT depth, 
+		UINT& mipLevels, UINT arraySize, D3D11_USAGE usage, UINT cpuAccessFlags, const D3D11_SUBRESOURCE_DATA* initialData);
+	inline bool CopySubresource(EZReferenceStorage& destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+		const EZReferenceStorage& source, UINT sourceSubresource, const D3D11_BOX* region);
+	static inline void WriteSubresource(EZReferenceSubresource& subresource, const void* data, UINT rowPitch, UINT depthPitch);
+	static inline EZReferenceStorage* GetStorage(ID3D11Resource* resource);
+
+	template<typename ResourceType, typename InterfaceType, typename DescriptionType>
+	HRESULT CreateResource(const DescriptionType* desc, DXGI_FORMAT format, UINT width, UINT height, UINT depth, UINT mipLevels, UINT arraySize,
+		const D3D11_SUBRESOURCE_DATA* initialData, InterfaceType** result);
+
+	// Overloads for filling in the mip count of each description type
+	static inline void SetMipLevels(D3D11_BUFFER_DESC& /*desc*/, UINT /*mipLevels*/) {}
+	static inline void SetMipLevels(D3D11_TEXTURE1D_DESC& desc, UINT mipLevels) { desc.MipLevels = mipLevels; }
+	static inline void SetMipLevels(D3D11_TEXTURE2D_DESC& desc, UINT mipLevels) { desc.MipLevels = mipLevels; }
+	static inline void SetMipLevels(D3D11_TEXTURE3D_DESC& desc, UINT mipLevels) { desc.MipLevels = mipLevels; }
+};
+
+
+// --- EZReferenceBackend::CreateBuffer -------------------
+//  Creates a buffer, or a texture in the functions after 
+//  it, with the same validation D3D11 does of the parts
+//  that matter to reads.  A MipLevels of zero means the 
+//  full mip chain, as in D3D11.
+// --------------------------------------------------------
+inline HRESULT EZReferenceBackend::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** result)
+{
+	if (!desc || !result)
+		return E_INVALIDARG;
+
+	return CreateResource<Buffer>(desc, DXGI_FORMAT_UNKNOWN, desc->ByteWidth, 1, 1, 1, 1, initialData, result);
+}
+
+inline HRESULT EZReferenceBackend::CreateTexture1D(const D3D11_TEXTURE1D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture1D** result)
+{
+	if (!desc || !result || desc->Format == DXGI_FORMAT_UNKNOWN)
+		return E_INVALIDARG;
+
+	return CreateResource<Texture1D>(desc, desc->Format, desc->Width, 1, 1, desc->MipLevels, desc->ArraySize, initialData, result);
+}
+
+inline HRESULT EZReferenceBackend::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** result)
+{
+	if (!desc || !result || desc->Format == DXGI_FORMAT_UNKNOWN)
+		return E_INVALIDARG;
+
+	return CreateResource<Texture2D>(desc, desc->Format, desc->Width, desc->Height, 1, desc->MipLevels, desc->ArraySize, initialData, result);
+}
+
+inline HRESULT EZReferenceBackend::CreateTexture3D(const D3D11_TEXTURE3D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture3D** result)
+{
+	if (!desc || !result || desc->Format == DXGI_FORMAT_UNKNOWN)
+		return E_INVALIDARG;
+
+	return CreateResource<Texture3D>(desc, desc->Format, desc->Width, desc->Height, desc->Depth, desc->MipLevels, 1, initialData, result);
+}
+
+
+// --- EZReferenceBackend::CreateResource -----------------
+//  Private helper that creates a resource of any type and
+//  fills in the mip count of its description
+// --------------------------------------------------------
+template<typename ResourceType, typename InterfaceType, typename DescriptionType>
+HRESULT EZReferenceBackend::CreateResource(const DescriptionType* desc, DXGI_FORMAT format, UINT width, UINT height, UINT depth, UINT mipLevels, UINT arraySize,
+	const D3D11_SUBRESOURCE_DATA* initialData, InterfaceType** result)
+{
+	DescriptionType resolved = *desc;
+	EZReferenceStorage storage;
+	HRESULT create = CreateStorage(storage, format, width, height, depth, mipLevels, arraySize, desc->Usage, desc->CPUAccessFlags, initialData);
+	if (FAILED(create))
+		return create;
+	SetMipLevels(resolved, mipLevels);
+
+	ResourceType* resource = new (std::nothrow) ResourceType(resolved);
+	if (!resource)
+		return E_OUTOFMEMORY;
+
+	resource->Storage = std::move(storage);
+	*result = resource;
+	return S_OK;
+}
+
+
+// --- EZReferenceBackend::CreateStorage ------------------
+//  Private helper that lays out and allocates every 
+//  subresource of a new resource, in D3D11 subresource
+//  order, and fills them from any initial data.  Buffers
+//  are given a format of DXGI_FORMAT_UNKNOWN and are laid 
+//  out as a single row of bytes.
+// --------------------------------------------------------
+inline HRESULT EZReferenceBackend::CreateStorage(EZReferenceStorage& storage, DXGI_FORMAT format, UINT width, UINT height, UINT depth,
+	UINT& mipLevels, UINT arraySize, D3D11_USAGE usage, UINT cpuAccessFlags, const D3D11_SUBRESOURCE_DATA* initialData)
+{
+	if (width == 0 || height == 0 || depth == 0 || arraySize == 0)
+		return E_INVALIDARG;
+
+	// Of the planar video formats, only 4:2:0 ones with a
+	// single mip are emulated, as the luma plane followed by
+	// the chroma plane at the same pitch
+	EZPlaneLayout luma = {}, chroma = {};
+	bool planar = EZIsPlanar(format);
+	if (planar)
+	{
+		if (!EZGetPlaneLayouts(format, width, height, luma, chroma) || depth != 1 || mipLevels > 1)
+			return E_INVALIDARG;
+		mipLevels = 1;
+	}
+
+	size_t bitsPerPixel = format == DXGI_FORMAT_UNKNOWN ? 8 : EZBitsPerPixel(format);
+	if (bitsPerPixel == 0)
+		return E_INVALIDARG;
+
+	// Zero mips means the full chain
+	UINT fullChain = 1;
+	for (UINT largest = EZMax(EZMax(width, height), depth); largest > 1; largest >>= 1)
+		fullChain++;
+	if (mipLevels == 0)
+		mipLevels = fullChain;
+	if (mipLevels > fullChain)
+		return E_INVALIDARG;
+
+	UINT alignment;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		alignment = rowPitchAlignment;
+		stats.Creates++;
+	}
+
+	bool compressed = EZIsBlockCompressed(format);
+	storage.Format = format;
+	storage.MipLevels = mipLevels;
+	storage.Readable = usage == D3D11_USAGE_STAGING && (cpuAccessFlags & D3D11_CPU_ACCESS_READ) != 0;
+	storage.ReadyFrame = 0;
+	storage.Subresources.resize((size_t)mipLevels * arraySize);
+	for (UINT slice = 0; slice < arraySize; slice++)
+	{
+		for (UINT mip = 0; mip < mipLevels; mip++)
+		{
+			EZReferenceSubresource& subresource = storage.Subresources[(size_t)slice * mipLevels + mip];
+			subresource.Width = EZMax(width >> mip, 1u);
+			subresource.Height = EZMax(height >> mip, 1u);
+			subresource.SliceCount = EZMax(depth >> mip, 1u);
+			if (planar)
+			{
+				subresource.RowBytes = EZMax(luma.RowBytes, chroma.RowBytes);
+				subresource.RowCount = luma.Height + chroma.Height;
+			}
+			else if (compressed)
+			{
+				subresource.RowBytes = (UINT)(((subresource.Width + 3) / 4) * EZBytesPerBlock(format));
+				subresource.RowCount = (subresource.Height + 3) / 4;
+			}
+			else
+			{
+				subresource.RowBytes = (UINT)(((size_t)subresource.Width * bitsPerPixel + 7) / 8);
+				subresource.RowCount = subresource.Height;
+			}
+
+			// Buffers are never padded
+			subresource.RowPitch = format == DXGI_FORMAT_UNKNOWN ? subresource.RowBytes : (subresource.RowBytes + alignment - 1) / alignment * alignment;
+			subresource.DepthPitch = subresource.RowPitch * subresource.RowCount;
+			subresource.Data.resize((size_t)subresource.DepthPitch * subresource.SliceCount);
+
+			if (initialData)
+			{
+				const D3D11_SUBRESOURCE_DATA& data = initialData[(size_t)slice * mipLevels + mip];
+				WriteSubresource(subresource, data.pSysMem, data.SysMemPitch, data.SysMemSlicePitch);
+			}
+		}
+	}
+
+	return S_OK;
+}
+
+
+// --- EZReferenceBackend::WriteSubresource ---------------
+//  Private helper that copies tightly or loosely pitched
+//  data into a subresource, row by row
+// --------------------------------------------------------
+inline void EZReferenceBackend::WriteSubresource(EZReferenceSubresource& subresource, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	const unsigned char* source = static_cast<const unsigned char*>(data);
+	for (UINT slice = 0; slice < subresource.SliceCount; slice++)
+	{
+		for (UINT row = 0; row < subresource.RowCount; row++)
+		{
+			memcpy(
+				subresource.Data.data() + (size_t)slice * subresource.DepthPitch + (size_t)row * subresource.RowPitch,
+				source + (size_t)slice * depthPitch + (size_t)row * rowPitch,
+				subresource.RowBytes);
+		}
+	}
+}
+
+
+// --- EZReferenceBackend::UpdateSubresource --------------
+//  Replaces the whole contents of a subresource with the
+//  given data, which is pitched like initial data
+// --------------------------------------------------------
+inline HRESULT EZReferenceBackend::UpdateSubresource(ID3D11Resource* resource, UINT subresource, const void* data, UINT rowPitch, UINT depthPitch)
+{
+	EZReferenceStorage* storage = GetStorage(resource);
+	if (!storage || !data || subresource >= storage->Subresources.size())
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> guard(lock);
+	WriteSubresource(storage->Subresources[subresource], data, rowPitch, depthPitch);
+	return S_OK;
+}
+
+
+// --- EZReferenceBackend::CopyResource -------------------
+//  Copies every subresource between two resources of the
+//  same shape.  Like D3D11, mismatched copies are dropped.
+// --------------------------------------------------------
+inline void EZReferenceBackend::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+	EZReferenceStorage* to = GetStorage(destination);
+	EZReferenceStorage* from = GetStorage(source);
+	if (!to || !from || to == from || to->Subresources.size() != from->Subresources.size())
+		return;
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (size_t i = 0; i < from->Subresources.size(); i++)
+	{
+		if (to->Subresources[i].Width != from->Subresources[i].Width ||
+			to->Subresources[i].Height != from->Subresources[i].Height ||
+			to->Subresources[i].SliceCount != from->Subresources[i].SliceCount)
+			return;
+	}
+
+	for (UINT i = 0; i < (UINT)from->Subresources.size(); i++)
+		CopySubresource(*to, i, 0, 0, 0, *from, i, nullptr);
+
+	stats.Copies++;
+	to->ReadyTime = std::chrono::steady_clock::now() + copyLatency;
+	to->ReadyFrame = frame + copyLatencyFrames;
+}
+
+
+// --- EZReferenceBackend::CopySubresourceRegion ----------
+//  Copies a box of one subresource, or all of it, into
+//  another.  Like D3D11, invalid copies are dropped.
+// --------------------------------------------------------
+inline void EZReferenceBackend::CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+	ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* region)
+{
+	EZReferenceStorage* to = GetStorage(destination);
+	EZReferenceStorage* from = GetStorage(source);
+	if (!to || !from || destinationSubresource >= to->Subresources.size() || sourceSubresource >= from->Subresources.size())
+		return;
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (!CopySubresource(*to, destinationSubresource, x, y, z, *from, sourceSubresource, region))
+		return;
+
+	stats.Copies++;
+	to->ReadyTime = std::chrono::steady_clock::now() + copyLatency;
+	to->ReadyFrame = frame + copyLatencyFrames;
+}
+
+
+// --- EZReferenceBackend::CopySubresource ----------------
+//  Private helper that does the copying for the functions
+//  above, after checking the box is inside the source and
+//  fits the destination.  Boxes are in texels (bytes for
+//  buffers) and are rounded out to whole blocks for block
+//  compressed formats.  Returns false if nothing was 
+//  copied.  Called with the lock held.
+// --------------------------------------------------------
+inline bool EZReferenceBackend::CopySubresource(EZReferenceStorage& destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+	const EZReferenceStorage& source, UINT sourceSubresource, const D3D11_BOX* region)
+{
+	EZReferenceSubresource& to = destination.Subresources[destinationSubresource];
+	const EZReferenceSubresource& from = source.Subresources[sourceSubresource];
+
+	D3D11_BOX box = { 0, 0, 0, from.Width, from.Height, from.SliceCount };
+	if (region)
+		box = *region;
+	if (box.left >= box.right || box.top >= box.bottom || box.front >= box.back || 
+		box.right > from.Width || box.bottom > from.Height || box.back > from.SliceCount)
+		return false;
+
+	// Work in whole columns (texels, blocks or bytes) and 
+	// rows.  Formats of less than a byte per texel, and
+	// planar formats, can only be copied whole.
+	UINT blockSize = EZIsBlockCompressed(source.Format) ? 4 : 1;
+	UINT fromColumns = (from.Width + blockSize - 1) / blockSize;
+	UINT toColumns = (to.Width + blockSize - 1) / blockSize;
+	size_t columnBytes = from.RowBytes / fromColumns;
+	bool whole = !region && x == 0 && y == 0 && z == 0 && 
+		to.RowBytes == from.RowBytes && to.RowCount == from.RowCount && to.SliceCount == from.SliceCount;
+	if (!whole && (columnBytes == 0 || columnBytes * fromColumns != from.RowBytes || columnBytes * toColumns != to.RowBytes))
+		return false;
+
+	UINT left = box.left / blockSize;
+	UINT top = box.top / blockSize;
+	UINT columns = (box.right + blockSize - 1) / blockSize - left;
+	UINT rows = (box.bottom + blockSize - 1) / blockSize - top;
+	UINT slices = box.back - box.front;
+
+	// Planar formats can only be copied whole, both planes
+	if (EZIsPlanar(source.Format))
+	{
+		if (!whole)
+			return false;
+		rows = from.RowCount;
+	}
+	UINT toLeft = x / blockSize;
+	UINT toTop = y / blockSize;
+	if (!whole && (toLeft + columns > toColumns || toTop + rows > to.RowCount || z + slices > to.SliceCount))
+		return false;
+
+	size_t rowBytes = whole ? from.RowBytes : columns * columnBytes;
+	for (UINT slice = 0; slice < slices; slice++)
+	{
+		for (UINT row = 0; row < rows; row++)
+		{
+			memcpy(
+				to.Data.data() + (size_t)(z + slice) * to.DepthPitch + (size_t)(toTop + row) * to.RowPitch + toLeft * columnBytes,
+				from.Data.data() + (size_t)(box.front + slice) * from.DepthPitch + (size_t)(top + row) * from.RowPitch + left * columnBytes,
+				rowBytes);
+		}
+	}
+
+	stats.BytesCopied += (unsigned long long)rowBytes * rows * slices;
+	return true;
+}
+
+
+// --- EZReferenceBackend::Map ----------------------------
+//  Maps a subresource of a CPU-readable staging resource.
+//  If the last copy into it is still "running", returns
+//  DXGI_ERROR_WAS_STILL_DRAWING for non-blocking maps.
+//  Blocking maps sleep out any wall clock latency and 
+//  finish the copy right away if it is waiting on frames.
+// --------------------------------------------------------
+inline HRESULT EZReferenceBackend::Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped)
+{
+	EZReferenceStorage* storage = GetStorage(resource);
+	if (!storage || !mapped || mapType != D3D11_MAP_READ || !storage->Readable || subresource >= storage->Subresources.size())
+		return E_INVALIDARG;
+
+	std::chrono::steady_clock::time_point ready;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		ready = storage->ReadyTime;
+		bool running = std::chrono::steady_clock::now() < ready || frame < storage->ReadyFrame;
+		if (running && (mapFlags & D3D11_MAP_FLAG_DO_NOT_WAIT))
+		{
+			stats.StillDrawingCount++;
+			return DXGI_ERROR_WAS_STILL_DRAWING;
+		}
+		storage->ReadyFrame = EZMin(storage->ReadyFrame, frame);
+	}
+	std::this_thread::sleep_until(ready);
+
+	std::lock_guard<std::mutex> guard(lock);
+	EZReferenceSubresource& mappedSubresource = storage->Subresources[subresource];
+	mapped->pData = mappedSubresource.Data.data();
+	mapped->RowPitch = mappedSubresource.RowPitch;
+	mapped->DepthPitch = mappedSubresource.DepthPitch;
+	stats.Maps++;
+	return S_OK;
+}
+
+
+// --- EZReferenceBackend::GetStorage ---------------------
+//  Private helper that finds the storage of a resource 
+//  created by an EZReferenceBackend.  Other resources, 
+//  such as real D3D11 ones, do not answer 
+//  EZReferenceStorageId and give null.
+// --------------------------------------------------------
+inline EZReferenceStorage* EZReferenceBackend::GetStorage(ID3D11Resource* resource)
+{
+	void* storage = nullptr;
+	if (!resource || FAILED(resource->QueryInterface(EZReferenceStorageId, &storage)))
+		return nullptr;
+
+	// The caller holds a reference of its own
+	resource->Release();
+	return static_cast<EZReferenceStorage*>(storage);
+}
+
+// --- Capture files --------------------------------------
+//  EZCaptureWriter streams reads straight from mapped
+//  memory to disk, without an intermediate vector.  Data
+//  is copied into fixed-size buffers that a background
+//  thread writes out in order, so the reading thread only
+//  waits on the disk when more than the queue size is
+//  still unwritten.  Memory stays bounded by the queue 
+//  size no matter how much is captured.
+// 
+//  See EZReadback::ReadToDDS() and ReadToRaw(), which 
+//  make room for a whole subresource before mapping it so
+//  that they never wait on the disk while it is mapped.
+// --------------------------------------------------------
+
+// Default size of each buffer of an EZCaptureWriter
+const size_t EZCaptureBufferSize = 4 << 20;
+
+// Default bytes an EZCaptureWriter queues before Write()
+// waits for the disk: four 4K RGBA8 frames
+const size_t EZCaptureQueueSize = 128 << 20;
+
+// --- EZCaptureWriter ------------------------------------
+//  Queued file writer.  Write(), Reserve() and Close() 
+//  must be called from one thread at a time.
+// --------------------------------------------------------
+class EZCaptureWriter
+{
+public:
+
+	EZCaptureWriter() : file{ nullptr }, bufferSize{ 0 }, used{ 0 }, bytesWritten{ 0 }, queuedBytes{ 0 }, queueSize{ 0 }, stopping{ false }, error{ S_OK } {}
+	~EZCaptureWriter() { Close(); }
+	EZCaptureWriter(const EZCaptureWriter&) = delete;
+	EZCaptureWriter& operator=(const EZCaptureWriter&) = delete;
+
+	inline HRESULT Open(const char* path, size_t bufferSize = EZCaptureBufferSize, size_t queueSize = EZCaptureQueueSize);
+	inline HRESULT Reserve(size_t bytes);
+	inline HRESULT Write(const void* data, size_t bytes);
+	inline HRESULT Close();
+
+	inline bool IsOpen() const { return file != nullptr; }
+	inline unsigned long long GetBytesWritten() const { return bytesWritten; } // Including bytes still buffered
+
+private:
+
+	FILE* file;
+	size_t bufferSize;
+	std::vector<unsigned char> filling; // Buffer being filled by Write()
+	size_t used;                        // Bytes used in that buffer
+	unsigned long long bytesWritten;
+
+	// Shared with the writing thread
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<std::vector<unsigned char>> queue; // Full buffers waiting to be written, in order
+	std::vector<std::vector<unsigned char>> spare; // Written buffers, for reuse
+	size_t queuedBytes;                 // Bytes in the queue, including the buffer being written
+	size_t queueSize;
+	bool stopping;
+	HRESULT error;                      // First failed write
+
+	inline HRESULT Submit();
+	inline void Run();
+};
+
+
+// --- EZCaptureWriter::Open ------------------------------
+//  Creates (or truncates) a file and starts the thread 
+//  that writes to it
+// 
+//  Parameters:
+//  - path: the file to write
+//  - bufferSize: size of each buffer
+//  - queueSize: bytes that can wait to be written before
+//    Write() waits for the disk
+// 
+// 	Returns:
+//  - E_INVALIDARG if the writer is already open or the
+//    buffer size is zero
+//  - E_FAIL if the file could not be created or the thread
+//    could not be started
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureWriter::Open(const char* path, size_t bufferSize, size_t queueSize)
+{
+	if (file || bufferSize == 0)
+		return E_INVALIDARG;
+
+#if defined(_MSC_VER)
+	if (fopen_s(&file, path, "wb") != 0)
+		file = nullptr;
+#else
+	file = fopen(path, "wb");
+#endif
+	if (!file)
+		return E_FAIL;
+
+	// Everything is already buffered here
+	setvbuf(file, nullptr, _IONBF, 0);
+
+	this->bufferSize = bufferSize;
+	this->queueSize = EZMax(queueSize, bufferSize);
+	filling.clear();
+	used = 0;
+	queuedBytes = 0;
+	stopping = false;
+	error = S_OK;
+	bytesWritten = 0;
+
+	try { thread = std::thread(&EZCaptureWriter::Run, this); }
+	catch (...)
+	{
+		fclose(file);
+		file = nullptr;
+		return E_FAIL;
+	}
+	return S_OK;
+}
+
+
+// --- EZCaptureWriter::Reserve ---------------------------
+//  Waits until the next bytes written can be queued 
+//  without waiting for the disk, first growing the queue
+//  if it is smaller than that.  Lets a caller do all its
+//  waiting before it starts writing, for instance before
+//  it maps what it is about to write.
+// 
+// 	Returns:
+//  - E_INVALIDARG if the writer is not open
+//  - E_FAIL if an earlier write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureWriter::Reserve(size_t bytes)
+{
+	if (!file)
+		return E_INVALIDARG;
+
+	// Whole buffers are queued, so round up to them
+	size_t needed = used + bytes + bufferSize;
+	std::unique_lock<std::mutex> guard(lock);
+	queueSize = EZMax(queueSize, needed);
+	wake.wait(guard, [&] { return queuedBytes + needed <= queueSize || FAILED(error); });
+	return error;
+}
+
+
+// --- EZCaptureWriter::Write -----------------------------
+//  Copies data into the current buffer, queueing full 
+//  buffers for the writing thread.  Only waits if the
+//  queue is full.
+// 
+// 	Returns:
+//  - E_INVALIDARG if the writer is not open
+//  - E_FAIL if an earlier write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureWriter::Write(const void* data, size_t bytes)
+{
+	if (!file)
+		return E_INVALIDARG;
+
+	const unsigned char* source = static_cast<const unsigned char*>(data);
+	while (bytes > 0)
+	{
+		// Start a buffer, reusing a written one if there is one
+		if (filling.empty())
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!spare.empty())
+			{
+				filling.swap(spare.back());
+				spare.pop_back();
+			}
+		}
+		filling.resize(bufferSize);
+
+		size_t chunk = EZMin(bytes, bufferSize - used);
+		memcpy(filling.data() + used, source, chunk);
+		used += chunk;
+		source += chunk;
+		bytes -= chunk;
+		bytesWritten += chunk;
+
+		if (used == bufferSize)
+		{
+			HRESULT submit = Submit();
+			if (FAILED(submit))
+				return submit;
+		}
+	}
+	return S_OK;
+}
+
+
+// --- EZCaptureWriter::Close -----------------------------
+//  Writes anything still buffered, waits for the writing
+//  thread to finish and closes the file.  Does nothing if
+//  the writer is not open.
+// 
+// 	Returns:
+//  - E_FAIL if any write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureWriter::Close()
+{
+	if (!file)
+		return S_OK;
+
+	if (used > 0)
+		Submit();
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	thread.join();
+
+	HRESULT result = error;
+	if (fclose(file) != 0)
+		result = E_FAIL;
+	file = nullptr;
+	filling = std::vector<unsigned char>();
+	queue.clear();
+	spare.clear();
+	return result;
+}
+
+
+// --- EZCaptureWriter::Submit ----------------------------
+//  Private helper that waits for room in the queue, then
+//  queues the current buffer
+// --------------------------------------------------------
+inline HRESULT EZCaptureWriter::Submit()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	wake.wait(guard, [this] { return queuedBytes + used <= queueSize || FAILED(error); });
+	if (FAILED(error))
+		return error;
+
+	filling.resize(used);
+	queue.push_back(std::move(filling));
+	queuedBytes += used;
+	filling = std::vector<unsigned char>();
+	used = 0;
+	guard.unlock();
+	wake.notify_all();
+	return S_OK;
+}
+
+
+// --- EZCaptureWriter::Run -------------------------------
+//  Body of the writing thread.  Writes queued buffers in
+//  order and hands them back for reuse.
+// --------------------------------------------------------
+inline void EZCaptureWriter::Run()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;)
+	{
+		wake.wait(guard, [this] { return !queue.empty() || stopping; });
+		if (queue.empty())
+			return;
+
+		// Write without holding the lock; the buffer stays
+		// counted in queuedBytes until it is written
+		std::vector<unsigned char> buffer = std::move(queue.front());
+		queue.pop_front();
+		guard.unlock();
+		bool written = fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+		guard.lock();
+
+		if (!written && SUCCEEDED(error))
+			error = E_FAIL;
+		queuedBytes -= buffer.size();
+		spare.push_back(std::move(buffer));
+		wake.notify_all();
+	}
+}
+
+
+// --- EZDDSHeader ----------------------------------------
+//  DDS file header, followed by the DX10 extension header
+//  so that any DXGI_FORMAT can be described.  Laid out as
+//  in the DDS documentation; everything is 32-bit.
+// --------------------------------------------------------
+struct EZDDSHeader
+{
+	UINT Magic;         // "DDS "
+	UINT Size;          // 124, not counting the magic
+	UINT Flags;
+	UINT Height;
+	UINT Width;
+	UINT PitchOrLinearSize;
+	UINT Depth;
+	UINT MipMapCount;
+	UINT Reserved1[11];
+	UINT PixelFormatSize; // 32
+	UINT PixelFormatFlags;
+	UINT FourCC;          // "DX10"
+	UINT RGBBitCount;
+	UINT RBitMask;
+	UINT GBitMask;
+	UINT BBitMask;
+	UINT ABitMask;
+	UINT Caps;
+	UINT Caps2;
+	UINT Caps3;
+	UINT Caps4;
+	UINT Reserved2;
+
+	// DX10 extension
+	UINT DXGIFormat;
+	UINT ResourceDimension; // D3D10_RESOURCE_DIMENSION, which matches D3D11's
+	UINT MiscFlag;
+	UINT ArraySize;
+	UINT MiscFlags2;
+};
+
+// --- EZCaptureChunkHeader -------------------------------
+//  Header of each chunk of a raw capture file, written by
+//  EZReadback::ReadToRaw().  A raw file is just chunks 
+//  back to back, each header followed by PayloadBytes of
+//  tightly packed rows (of blocks, for block compressed
+//  formats), slice after slice.
+// --------------------------------------------------------
+struct EZCaptureChunkHeader
+{
+	UINT Magic;         // "EZRC"
+	UINT HeaderSize;    // sizeof(EZCaptureChunkHeader), for skipping newer headers
+	UINT Format;        // DXGI_FORMAT, or DXGI_FORMAT_UNKNOWN for buffers
+	UINT Dimension;     // D3D11_RESOURCE_DIMENSION
+	UINT Width;         // Texels, or bytes for buffers
+	UINT Height;
+	UINT Depth;
+	UINT MipLevel;
+	UINT ArrayIndex;
+	UINT RowBytes;
+	UINT RowCount;      // Rows per slice
+	UINT SliceCount;
+	UINT64 PayloadBytes;
+};
+
+const UINT EZDDSMagic = 0x20534444;          // "DDS "
+const UINT EZDDSFourCCDX10 = 0x30315844;     // "DX10"
+const UINT EZCaptureChunkMagic = 0x43525A45; // "EZRC"
+
+// --- Compressed captures --------------------------------
+//  EZCaptureEncoder records a sequence of frames (any
+//  tightly packed readback results) into one compressed,
+//  seekable file, and EZCaptureDecoder plays it back.
+// 
+//  Each frame is cut into chunks that are filtered and
+//  compressed in parallel, on EZThreadPool while the 
+//  caller moves on to the next frame.  The filter takes
+//  the delta or XOR of every channel against the same 
+//  channel of the previous frame, so the parts of a frame
+//  that did not change turn into runs of zeros.  Frames 
+//  that were not filtered are keyframes, which decoding 
+//  can start from.
+//  Chunks are compressed with EZLZCompress(), a fast LZ77
+//  codec that writes the LZ4 block format.
+// 
+//  The file is a EZCaptureFileHeader, then each frame as
+//  an EZCaptureFrameHeader, the compressed size of every
+//  chunk and the chunks themselves, and finally an index
+//  with an EZCaptureIndexEntry per frame and a footer
+//  pointing at the index.
+// --------------------------------------------------------
+
+// Default bytes of a frame compressed as one chunk
+const size_t EZCaptureChunkSize = 256 * 1024;
+
+// --- EZLZCompress ---------------------------------------
+//  Compresses data into an LZ4 block: greedy matching
+//  with a single-entry hash table of 4-byte sequences and
+//  matches up to 64KB back.  Searching speeds up over data
+//  that does not compress.  The output can be read with
+//  EZLZDecompress() or LZ4's own block decoder.
+// 
+//  Parameters:
+//  - source: the data to compress
+//  - sourceSize: bytes of data
+//  - destination: where to write the block
+//  - capacity: bytes available at the destination
+//  - table: EZLZTableSize entries of scratch space
+// 
+// 	Returns:
+//  - The size of the block, or zero if it did not fit
+// --------------------------------------------------------
+const size_t EZLZTableBits = 14;
+const size_t EZLZTableSize = (size_t)1 << EZLZTableBits;
+const size_t EZLZMinimumMatch = 4;
+const size_t EZLZLastLiterals = 5;   // Blocks end with at least this many literals
+const size_t EZLZMatchLimit = 12;    // Matches start at least this far from the end
+const size_t EZLZMaximumOffset = 65535;
+
+inline size_t EZLZBound(size_t sourceSize) { return sourceSize + sourceSize / 255 + 16; }
+
+inline unsigned int EZLZRead32(const unsigned char* data) { unsigned int value; memcpy(&value, data, 4); return value; }
+inline unsigned long long EZLZRead64(const unsigned char* data) { unsigned long long value; memcpy(&value, data, 8); return value; }
+
+inline unsigned char* EZLZWriteLength(unsigned char* output, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		*output++ = 255;
+	*output++ = (unsigned char)length;
+	return output;
+}
+
+inline size_t EZLZCompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t capacity, unsigned int* table)
+{
+	unsigned char* output = destination;
+	unsigned char* outputEnd = destination + capacity;
+	size_t anchor = 0;
+
+	if (sourceSize > EZLZMatchLimit)
+	{
+		// Table entries are positions plus one, so zero is empty
+		memset(table, 0, EZLZTableSize * sizeof(unsigned int));
+		size_t position = 0;
+		size_t misses = 0;
+		while (position + EZLZMatchLimit < sourceSize)
+		{
+			unsigned int sequence = EZLZRead32(source + position);
+			unsigned int& entry = table[(sequence * 2654435761u) >> (32 - EZLZTableBits)];
+			size_t candidate = (size_t)entry - 1;
+			bool found = entry != 0 && position - candidate <= EZLZMaximumOffset && EZLZRead32(source + candidate) == sequence;
+			entry = (unsigned int)(position + 1);
+			if (!found)
+			{
+				position += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			// Grow the match backwards over literals, then forwards
+			while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+			{
+				position--;
+				candidate--;
+			}
+			size_t length = EZLZMinimumMatch;
+			size_t matchEnd = sourceSize - EZLZLastLiterals;
+			while (position + length + 8 <= matchEnd && EZLZRead64(source + position + length) == EZLZRead64(source + candidate + length))
+				length += 8;
+			while (position + length < matchEnd && source[position + length] == source[candidate + length])
+				length++;
+
+			// Token, literals, offset, then the rest of the match length
+			size_t literals = position - anchor;
+			size_t matchCode = length - EZLZMinimumMatch;
+			if ((size_t)(outputEnd - output) < 1 + literals / 255 + 1 + literals + 2 + matchCode / 255 + 1)
+				return 0;
+
+			unsigned char* token = output++;
+			*token = (unsigned char)((EZMin(literals, (size_t)15) << 4) | EZMin(matchCode, (size_t)15));
+			if (literals >= 15)
+				output = EZLZWriteLength(output, literals - 15);
+			memcpy(output, source + anchor, literals);
+			output += literals;
+			size_t offset = position - candidate;
+			*output++ = (unsigned char)(offset & 0xFF);
+			*output++ = (unsigned char)(offset >> 8);
+			if (matchCode >= 15)
+				output = EZLZWriteLength(output, matchCode - 15);
+
+			position += length;
+			anchor = position;
+		}
+	}
+
+	// Whatever is left goes out as literals
+	size_t literals = sourceSize - anchor;
+	if ((size_t)(outputEnd - output) < 1 + literals / 255 + 1 + literals)
+		return 0;
+	*output++ = (unsigned char)(EZMin(literals, (size_t)15) << 4);
+	if (literals >= 15)
+		output = EZLZWriteLength(output, literals - 15);
+	if (literals > 0)
+		memcpy(output, source + anchor, literals);
+	output += literals;
+	return output - destination;
+}
+
+// --- EZLZDecompress -------------------------------------
+//  Decompresses an LZ4 block, checking every length and
+//  offset against both buffers so that a damaged block
+//  cannot read or write out of bounds.
+// 
+// 	Returns:
+//  - true if the block decoded to exactly destinationSize
+//    bytes, false if it is damaged
+// --------------------------------------------------------
+inline bool EZLZDecompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize)
+{
+	const unsigned char* input = source;
+	const unsigned char* inputEnd = source + sourceSize;
+	unsigned char* output = destination;
+	unsigned char* outputEnd = destination + destinationSize;
+
+	while (input < inputEnd)
+	{
+		unsigned int token = *input++;
+
+		// Literals
+		size_t literals = token >> 4;
+		if (literals == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (input == inputEnd)
+					return false;
+				extra = *input++;
+				literals += extra;
+			} while (extra == 255);
+		}
+		if (literals > (size_t)(inputEnd - input) || literals > (size_t)(outputEnd - output))
+			return false;
+		memcpy(output, input, literals);
+		input += literals;
+		output += literals;
+
+		// The last sequence has no match
+		if (input == inputEnd)
+			break;
+
+		// Match
+		if (inputEnd - input < 2)
+			return false;
+		size_t offset = input[0] | ((size_t)input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > (size_t)(output - destination))
+			return false;
+
+		size_t length = token & 15;
+		if (length == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (input == inputEnd)
+					return false;
+				extra = *input++;
+				length += extra;
+			} while (extra == 255);
+		}
+		length += EZLZMinimumMatch;
+		if (length > (size_t)(outputEnd - output))
+			return false;
+
+		// Overlapping matches repeat the last offset bytes;
+		// copy in pieces that double each time
+		const unsigned char* match = output - offset;
+		for (size_t copied = 0; copied < length; )
+		{
+			size_t piece = EZMin(length - copied, (size_t)(output + copied - match));
+			memcpy(output + copied, match, piece);
+			copied += piece;
+		}
+		output += length;
+	}
+
+	return output == outputEnd;
+}
+
+// --- EZCaptureFilter ------------------------------------
+//  How a frame is stored relative to the previous frame
+// --------------------------------------------------------
+enum EZCaptureFilter
+{
+	EZCaptureFilterNone,  // Stored as is; a keyframe
+	EZCaptureFilterDelta, // Each channel minus the previous frame's, wrapping around
+	EZCaptureFilterXor,   // Each byte XOR the previous frame's
+};
+
+// --- EZCaptureFilterData --------------------------------
+//  Applies or undoes a filter: destination = source minus,
+//  plus or XOR previous, per channel of channelSize bytes.
+//  Trailing bytes that do not fill a channel are filtered
+//  a byte at a time.  The destination may be the same as
+//  source or previous.
+// --------------------------------------------------------
+template<typename UnitType>
+inline void EZCaptureFilterScalar(EZCaptureFilter filter, bool undo, unsigned char* destination, const unsigned char* source, const unsigned char* previous, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		UnitType value, reference;
+		memcpy(&value, source + i * sizeof(UnitType), sizeof(UnitType));
+		memcpy(&reference, previous + i * sizeof(UnitType), sizeof(UnitType));
+		UnitType result = (UnitType)(filter == EZCaptureFilterXor ? value ^ reference : undo ? value + reference : value - reference);
+		memcpy(destination + i * sizeof(UnitType), &result, sizeof(UnitType));
+	}
+}
+
+#if defined(EZREADBACK_X86)
+template<typename UnitType>
+EZREADBACK_TARGET("avx2")
+inline void EZCaptureFilterAVX2(EZCaptureFilter filter, bool undo, unsigned char* destination, const unsigned char* source, const unsigned char* previous, size_t count)
+{
+	size_t bytes = count * sizeof(UnitType);
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32)
+	{
+		__m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+		__m256i reference = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+		__m256i result;
+		if (filter == EZCaptureFilterXor)
+			result = _mm256_xor_si256(value, reference);
+		else if (sizeof(UnitType) == 4)
+			result = undo ? _mm256_add_epi32(value, reference) : _mm256_sub_epi32(value, reference);
+		else if (sizeof(UnitType) == 2)
+			result = undo ? _mm256_add_epi16(value, reference) : _mm256_sub_epi16(value, reference);
+		else
+			result = undo ? _mm256_add_epi8(value, reference) : _mm256_sub_epi8(value, reference);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), result);
+	}
+	EZCaptureFilterScalar<UnitType>(filter, undo, destination + i, source + i, previous + i, count - i / sizeof(UnitType));
+}
+#endif
+
+inline void EZCaptureFilterData(EZCaptureFilter filter, bool undo, size_t channelSize, void* destination, const void* source, const void* previous, size_t bytes)
+{
+	unsigned char* output = static_cast<unsigned char*>(destination);
+	const unsigned char* input = static_cast<const unsigned char*>(source);
+	const unsigned char* reference = static_cast<const unsigned char*>(previous);
+	if (filter == EZCaptureFilterNone)
+	{
+		if (output != input)
+			memmove(output, input, bytes);
+		return;
+	}
+
+	if (filter == EZCaptureFilterXor || (channelSize != 2 && channelSize != 4))
+		channelSize = 1;
+	size_t count = bytes / channelSize;
+	size_t whole = count * channelSize;
+
+	void (*kernel)(EZCaptureFilter, bool, unsigned char*, const unsigned char*, const unsigned char*, size_t) =
+		channelSize == 4 ? EZCaptureFilterScalar<unsigned int> : channelSize == 2 ? EZCaptureFilterScalar<unsigned short> : EZCaptureFilterScalar<unsigned char>;
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+		kernel = channelSize == 4 ? EZCaptureFilterAVX2<unsigned int> : channelSize == 2 ? EZCaptureFilterAVX2<unsigned short> : EZCaptureFilterAVX2<unsigned char>;
+#endif
+	kernel(filter, undo, output, input, reference, count);
+	EZCaptureFilterScalar<unsigned char>(filter, undo, output + whole, input + whole, reference + whole, bytes - whole);
+}
+
+// --- EZCaptureChannelSize -------------------------------
+//  Bytes per channel of a format, for the delta filter.
+//  Formats with 8 or 16-bit channels are listed; anything
+//  else falls back on the element size, so 32-bit float
+//  channels come out as 4.
+// --------------------------------------------------------
+inline size_t EZCaptureChannelSize(DXGI_FORMAT format, size_t elementSize)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+		return 1;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:
+		return 2;
+
+	default:
+		break;
+	}
+
+	return EZChecksumUnitSize(elementSize);
+}
+
+// The EZColor types have 8-bit channels whatever the format says
+template<typename ElementType>
+inline size_t EZCaptureChannelSize(DXGI_FORMAT format) { return EZCaptureChannelSize(format, sizeof(ElementType)); }
+template<> inline size_t EZCaptureChannelSize<EZColor1>(DXGI_FORMAT /*format*/) { return 1; }
+template<> inline size_t EZCaptureChannelSize<EZColor2>(DXGI_FORMAT /*format*/) { return 1; }
+template<> inline size_t EZCaptureChannelSize<EZColor3>(DXGI_FORMAT /*format*/) { return 1; }
+template<> inline size_t EZCaptureChannelSize<EZColor4>(DXGI_FORMAT /*format*/) { return 1; }
+
+// --- EZCaptureEncoderOptions ----------------------------
+//  Settings for EZCaptureEncoder.  The defaults use the
+//  delta filter with a keyframe every 60 frames and every
+//  hardware thread.
+// --------------------------------------------------------
+struct EZCaptureEncoderOptions
+{
+	EZCaptureFilter Filter; // Filter for frames that are not keyframes
+	UINT KeyframeInterval;  // Frames from one keyframe to the next, or zero for only the first
+	size_t ChunkSize;       // Bytes of a frame compressed as one chunk
+	UINT ThreadCount;       // Threads to use, or zero for every hardware thread
+
+	EZCaptureEncoderOptions() : Filter{ EZCaptureFilterDelta }, KeyframeInterval{ 60 }, ChunkSize{ EZCaptureChunkSize }, ThreadCount{ 0 } {}
+};
+
+// --- Compressed capture file structures -----------------
+//  See "Compressed captures" above for the layout.  Chunk
+//  sizes with EZCaptureChunkStored set are chunks that 
+//  did not compress and were stored as is.
+// --------------------------------------------------------
+struct EZCaptureFileHeader
+{
+	UINT Magic;         // "EZCF"
+	UINT HeaderSize;    // sizeof(EZCaptureFileHeader)
+	UINT Version;
+	UINT Reserved;
+};
+
+struct EZCaptureFrameHeader
+{
+	UINT Magic;         // "EZCR"
+	UINT HeaderSize;    // sizeof(EZCaptureFrameHeader), for skipping newer headers
+	UINT FrameIndex;
+	UINT Filter;        // EZCaptureFilter against the previous frame
+	UINT ChannelSize;   // Bytes per channel for the delta filter
+	UINT Format;        // DXGI_FORMAT given by the caller, for reference
+	UINT Width;         // Given by the caller, for reference
+	UINT Height;
+	UINT ChunkSize;     // Uncompressed bytes per chunk, except the last
+	UINT ChunkCount;    // Followed by this many compressed chunk sizes
+	UINT64 RawBytes;    // Uncompressed size of the frame
+};
+
+struct EZCaptureIndexEntry
+{
+	UINT64 Offset;      // Where the frame header starts
+	UINT64 RawBytes;
+	UINT Filter;        // EZCaptureFilterNone for keyframes
+	UINT Format;
+	UINT Width;
+	UINT Height;
+};
+
+struct EZCaptureFileFooter
+{
+	UINT Magic;         // "EZCI"
+	UINT FrameCount;
+	UINT64 IndexOffset; // Where the first EZCaptureIndexEntry starts
+};
+
+const UINT EZCaptureFileMagic = 0x46435A45;   // "EZCF"
+const UINT EZCaptureFrameMagic = 0x52435A45;  // "EZCR"
+const UINT EZCaptureIndexMagic = 0x49435A45;  // "EZCI"
+const UINT EZCaptureFileVersion = 1;
+const UINT EZCaptureChunkStored = 0x80000000u;
+
+// --- EZCaptureEncoder -----------------------------------
+//  Writes frames into a compressed capture file.  AddFrame
+//  copies a frame and returns; the copy is filtered and
+//  compressed chunk by chunk by up to ThreadCount tasks on
+//  EZThreadPool, then handed to the background thread of
+//  an EZCaptureWriter by the next AddFrame(), Flush() or
+//  Close().  So one frame is compressed while the caller
+//  produces the next.  One thread at a time only.
+// --------------------------------------------------------
+class EZCaptureEncoder
+{
+public:
+
+	EZCaptureEncoder() : frameCount{ 0 }, rawBytes{ 0 }, header{}, entry{}, compressing{ false }, pending{ 0 } {}
+	~EZCaptureEncoder() { Close(); }
+	EZCaptureEncoder(const EZCaptureEncoder&) = delete;
+	EZCaptureEncoder& operator=(const EZCaptureEncoder&) = delete;
+
+	inline HRESULT Open(const char* path, const EZCaptureEncoderOptions& options = EZCaptureEncoderOptions());
+	inline HRESULT Flush();
+	inline HRESULT Close();
+
+	// Adds a frame of tightly packed data; width, height and format are only recorded
+	inline HRESULT AddFrame(const void* data, size_t bytes, size_t channelSize, UINT width = 0, UINT height = 0, DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN);
+
+	template<typename ElementType>
+	HRESULT AddFrame(const std::vector<ElementType>& frame, UINT width = 0, UINT height = 0, DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN)
+	{
+		return AddFrame(frame.data(), frame.size() * sizeof(ElementType), EZCaptureChannelSize<ElementType>(format), width, height, format);
+	}
+
+	inline bool IsOpen() const { return writer.IsOpen(); }
+	inline UINT GetFrameCount() const { return frameCount; }
+	inline unsigned long long GetRawBytes() const { return rawBytes; }
+	inline unsigned long long GetBytesWritten() const { return writer.GetBytesWritten(); } // Excluding the frame being compressed
+
+private:
+
+	EZCaptureWriter writer;
+	EZCaptureEncoderOptions options;
+	UINT frameCount;
+	unsigned long long rawBytes;
+	std::vector<unsigned char> frames[2];    // Copies of the last two frames, by frame index
+	std::vector<std::vector<unsigned char>> chunks;
+	std::vector<UINT> chunkSizes;
+	std::vector<EZCaptureIndexEntry> index;
+
+	// The frame being compressed
+	EZCaptureFrameHeader header;
+	EZCaptureIndexEntry entry;
+	bool compressing;
+	std::atomic<size_t> pending;             // Its tasks still on the pool
+
+	inline void CompressChunks(size_t begin, size_t end);
+};
+
+
+// --- EZCaptureEncoder::Open -----------------------------
+//  Creates (or truncates) a capture file and writes its 
+//  header
+// 
+// 	Returns:
+//  - E_INVALIDARG if the encoder is already open or the
+//    chunk size is zero or 2GB or more
+//  - E_FAIL if the file could not be created
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureEncoder::Open(const char* path, const EZCaptureEncoderOptions& options)
+{
+	if (writer.IsOpen() || options.ChunkSize == 0 || options.ChunkSize >= EZCaptureChunkStored)
+		return E_INVALIDARG;
+
+	HRESULT open = writer.Open(path);
+	if (FAILED(open))
+		return open;
+
+	this->options = options;
+	frameCount = 0;
+	rawBytes = 0;
+	frames[0].clear();
+	frames[1].clear();
+	index.clear();
+
+	EZCaptureFileHeader header = {};
+	header.Magic = EZCaptureFileMagic;
+	header.HeaderSize = sizeof(header);
+	header.Version = EZCaptureFileVersion;
+	return writer.Write(&header, sizeof(header));
+}
+
+
+// --- EZCaptureEncoder::AddFrame -------------------------
+//  Copies a frame and starts compressing it, after 
+//  handing the frame before it to the writer.  A frame is
+//  a keyframe when the interval says so, when filtering
+//  is off, or when its size differs from the last frame.
+// 
+//  Parameters:
+//  - data: the frame, tightly packed; only read before
+//    AddFrame() returns
+//  - bytes: size of the frame
+//  - channelSize: bytes per channel for the delta filter
+//  - width, height, format: recorded for the decoder
+// 
+// 	Returns:
+//  - E_INVALIDARG if the encoder is not open
+//  - E_FAIL if an earlier write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureEncoder::AddFrame(const void* data, size_t bytes, size_t channelSize, UINT width, UINT height, DXGI_FORMAT format)
+{
+	if (!writer.IsOpen() || (!data && bytes > 0))
+		return E_INVALIDARG;
+
+	// The last frame's chunks are reused below
+	HRESULT flush = Flush();
+	if (FAILED(flush))
+		return flush;
+
+	bool keyframe = options.Filter == EZCaptureFilterNone || bytes != frames[(frameCount & 1) ^ 1].size() || frameCount == 0 ||
+		(options.KeyframeInterval != 0 && frameCount % options.KeyframeInterval == 0);
+	EZCaptureFilter filter = keyframe ? EZCaptureFilterNone : options.Filter;
+
+	// The copy outlives the call and is the next frame's
+	// reference for the filter
+	std::vector<unsigned char>& frame = frames[frameCount & 1];
+	frame.resize(bytes);
+	if (bytes > 0)
+		memcpy(frame.data(), data, bytes);
+
+	size_t chunkSize = options.ChunkSize;
+	size_t chunkCount = (bytes + chunkSize - 1) / chunkSize;
+	if (chunks.size() < chunkCount)
+		chunks.resize(chunkCount);
+	chunkSizes.resize(chunkCount);
+
+	entry = EZCaptureIndexEntry();
+	entry.RawBytes = bytes;
+	entry.Filter = filter;
+	entry.Format = format;
+	entry.Width = width;
+	entry.Height = height;
+
+	header = EZCaptureFrameHeader();
+	header.Magic = EZCaptureFrameMagic;
+	header.HeaderSize = sizeof(header);
+	header.FrameIndex = frameCount;
+	header.Filter = filter;
+	header.ChannelSize = (UINT)channelSize;
+	header.Format = format;
+	header.Width = width;
+	header.Height = height;
+	header.ChunkSize = (UINT)chunkSize;
+	header.ChunkCount = (UINT)chunkCount;
+	header.RawBytes = bytes;
+
+	// Split the chunks between the tasks
+	size_t threadCount = options.ThreadCount ? options.ThreadCount : EZMax(std::thread::hardware_concurrency(), 1u);
+	size_t tasks = EZMin(threadCount, chunkCount);
+	EZThreadPool& pool = EZThreadPool::Get();
+	pool.Reserve(tasks);
+	for (size_t t = 0; t < tasks; t++)
+	{
+		size_t begin = chunkCount * t / tasks;
+		size_t end = chunkCount * (t + 1) / tasks;
+		pool.Submit([this, begin, end] { CompressChunks(begin, end); }, pending);
+	}
+
+	compressing = true;
+	frameCount++;
+	rawBytes += bytes;
+	return S_OK;
+}
+
+
+// --- EZCaptureEncoder::Flush ----------------------------
+//  Waits for the frame being compressed, if any, and 
+//  hands it to the writer
+// 
+// 	Returns:
+//  - E_FAIL if a write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureEncoder::Flush()
+{
+	if (!compressing)
+		return S_OK;
+
+	EZThreadPool::Get().Wait(pending);
+	compressing = false;
+
+	entry.Offset = writer.GetBytesWritten();
+	size_t chunkCount = header.ChunkCount;
+	HRESULT write = writer.Write(&header, sizeof(header));
+	if (SUCCEEDED(write) && chunkCount > 0)
+		write = writer.Write(chunkSizes.data(), chunkCount * sizeof(UINT));
+	for (size_t c = 0; c < chunkCount && SUCCEEDED(write); c++)
+		write = writer.Write(chunks[c].data(), chunkSizes[c] & ~EZCaptureChunkStored);
+	if (FAILED(write))
+		return write;
+
+	index.push_back(entry);
+	return S_OK;
+}
+
+
+// --- EZCaptureEncoder::Close ----------------------------
+//  Writes the last frame, the frame index and footer and
+//  closes the file.  Does nothing if the encoder is not
+//  open.
+// 
+// 	Returns:
+//  - E_FAIL if any write to the file failed
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureEncoder::Close()
+{
+	if (!writer.IsOpen())
+		return S_OK;
+
+	// A failed write also fails writer.Close()
+	Flush();
+
+	EZCaptureFileFooter footer = {};
+	footer.Magic = EZCaptureIndexMagic;
+	footer.FrameCount = (UINT)index.size();
+	footer.IndexOffset = writer.GetBytesWritten();
+
+	writer.Write(index.data(), index.size() * sizeof(EZCaptureIndexEntry));
+	writer.Write(&footer, sizeof(footer));
+	HRESULT close = writer.Close();
+
+	frames[0] = std::vector<unsigned char>();
+	frames[1] = std::vector<unsigned char>();
+	chunks = std::vector<std::vector<unsigned char>>();
+	index = std::vector<EZCaptureIndexEntry>();
+	return close;
+}
+
+
+// --- EZCaptureEncoder::CompressChunks -------------------
+//  Private helper run by the pool tasks of AddFrame().
+//  Filters and compresses chunks [begin, end) of the frame
+//  being compressed.
+// --------------------------------------------------------
+inline void EZCaptureEncoder::CompressChunks(size_t begin, size_t end)
+{
+	EZCaptureFilter filter = (EZCaptureFilter)header.Filter;
+	size_t chunkSize = header.ChunkSize;
+	size_t bytes = (size_t)header.RawBytes;
+	const unsigned char* frame = frames[header.FrameIndex & 1].data();
+	const unsigned char* previous = frames[(header.FrameIndex & 1) ^ 1].data();
+
+	std::vector<unsigned char> filtered(filter != EZCaptureFilterNone ? chunkSize : 0);
+	std::vector<unsigned int> table(EZLZTableSize);
+	for (size_t c = begin; c < end; c++)
+	{
+		size_t offset = c * chunkSize;
+		size_t size = EZMin(chunkSize, bytes - offset);
+		const unsigned char* input = frame + offset;
+		if (filter != EZCaptureFilterNone)
+		{
+			EZCaptureFilterData(filter, false, header.ChannelSize, filtered.data(), input, previous + offset, size);
+			input = filtered.data();
+		}
+
+		// Chunks that do not shrink are stored
+		std::vector<unsigned char>& chunk = chunks[c];
+		if (chunk.size() < size)
+			chunk.resize(size);
+		size_t compressed = EZLZCompress(input, size, chunk.data(), size - 1, table.data());
+		if (compressed == 0)
+		{
+			memcpy(chunk.data(), input, size);
+			chunkSizes[c] = (UINT)size | EZCaptureChunkStored;
+		}
+		else
+		{
+			chunkSizes[c] = (UINT)compressed;
+		}
+	}
+}
+
+// --- EZCaptureDecoder -----------------------------------
+//  Reads frames back out of a compressed capture file.
+//  Frames can be read in any order: a frame is decoded
+//  starting from the keyframe before it, or from the last
+//  frame read if that is closer, so playing forwards only
+//  decodes each frame once.  Chunks are decompressed on
+//  up to threadCount threads.  One thread at a time only.
+// --------------------------------------------------------
+class EZCaptureDecoder
+{
+public:
+
+	EZCaptureDecoder(UINT threadCount = 0) : file{ nullptr }, threadCount{ threadCount }, currentFrame{ 0 }, hasCurrent{ false } {}
+	~EZCaptureDecoder() { Close(); }
+	EZCaptureDecoder(const EZCaptureDecoder&) = delete;
+	EZCaptureDecoder& operator=(const EZCaptureDecoder&) = delete;
+
+	inline HRESULT Open(const char* path);
+	inline void Close();
+
+	inline HRESULT ReadFrame(UINT frame, std::vector<unsigned char>& results);
+
+	template<typename ElementType>
+	HRESULT ReadFrame(UINT frame, std::vector<ElementType>& results);
+
+	inline bool IsOpen() const { return file != nullptr; }
+	inline UINT GetFrameCount() const { return (UINT)index.size(); }
+	inline const EZCaptureIndexEntry& GetFrameInfo(UINT frame) const { return index[frame]; }
+
+private:
+
+	FILE* file;
+	UINT threadCount;
+	std::vector<EZCaptureIndexEntry> index;
+	std::vector<unsigned char> current;    // Last frame decoded
+	UINT currentFrame;
+	bool hasCurrent;
+	std::vector<unsigned char> payload;
+	std::vector<UINT> chunkSizes;
+
+	inline HRESULT DecodeFrame(UINT frame);
+	inline bool ReadAt(unsigned long long offset, void* data, size_t bytes);
+};
+
+
+// --- EZCaptureDecoder::Open -----------------------------
+//  Opens a capture file and loads its frame index
+// 
+// 	Returns:
+//  - E_INVALIDARG if the decoder is already open
+//  - E_FAIL if the file could not be opened or is not a
+//    complete capture file
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureDecoder::Open(const char* path)
+{
+	if (file)
+		return E_INVALIDARG;
+
+#if defined(_MSC_VER)
+	if (fopen_s(&file, path, "rb") != 0)
+		file = nullptr;
+#else
+	file = fopen(path, "rb");
+#endif
+	if (!file)
+		return E_FAIL;
+
+	// The footer is at the very end, right after the index
+	EZCaptureFileHeader header = {};
+	EZCaptureFileFooter footer = {};
+	bool valid = ReadAt(0, &header, sizeof(header)) && header.Magic == EZCaptureFileMagic && header.Version == EZCaptureFileVersion;
+#if defined(_MSC_VER)
+	valid = valid && _fseeki64(file, -(long long)sizeof(footer), SEEK_END) == 0;
+	unsigned long long footerOffset = valid ? (unsigned long long)_ftelli64(file) : 0;
+#else
+	valid = valid && fseeko(file, -(off_t)sizeof(footer), SEEK_END) == 0;
+	unsigned long long footerOffset = valid ? (unsigned long long)ftello(file) : 0;
+#endif
+	valid = valid && fread(&footer, sizeof(footer), 1, file) == 1 && footer.Magic == EZCaptureIndexMagic &&
+		footer.IndexOffset + (unsigned long long)footer.FrameCount * sizeof(EZCaptureIndexEntry) == footerOffset;
+	if (valid)
+	{
+		index.resize(footer.FrameCount);
+		valid = ReadAt(footer.IndexOffset, index.data(), index.size() * sizeof(EZCaptureIndexEntry));
+	}
+
+	if (!valid)
+	{
+		Close();
+		return E_FAIL;
+	}
+	hasCurrent = false;
+	return S_OK;
+}
+
+
+// --- EZCaptureDecoder::Close ----------------------------
+//  Closes the file and frees the decoded frame
+// --------------------------------------------------------
+inline void EZCaptureDecoder::Close()
+{
+	if (file)
+		fclose(file);
+	file = nullptr;
+	hasCurrent = false;
+	index = std::vector<EZCaptureIndexEntry>();
+	current = std::vector<unsigned char>();
+	payload = std::vector<unsigned char>();
+}
+
+
+// --- EZCaptureDecoder::ReadFrame ------------------------
+//  Decodes a frame into results, as bytes or as elements
+//  of the given type
+// 
+// 	Returns:
+//  - E_INVALIDARG if the decoder is not open, there is no
+//    such frame, or the frame is not a whole number of 
+//    ElementType
+//  - E_FAIL if the file is damaged
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZCaptureDecoder::ReadFrame(UINT frame, std::vector<unsigned char>& results)
+{
+	return ReadFrame<unsigned char>(frame, results);
+}
+
+template<typename ElementType>
+HRESULT EZCaptureDecoder::ReadFrame(UINT frame, std::vector<ElementType>& results)
+{
+	if (!file || frame >= index.size() || index[frame].RawBytes % sizeof(ElementType) != 0)
+		return E_INVALIDARG;
+
+	// Start from the keyframe, unless the last frame read is closer
+	UINT start = frame;
+	while (start > 0 && index[start].Filter != EZCaptureFilterNone)
+		start--;
+	if (hasCurrent && currentFrame <= frame && currentFrame >= start)
+		start = currentFrame + 1;
+
+	for (UINT f = start; f <= frame; f++)
+	{
+		HRESULT decode = DecodeFrame(f);
+		if (FAILED(decode))
+			return decode;
+	}
+
+	results.resize(current.size() / sizeof(ElementType));
+	if (!current.empty())
+		memcpy(results.data(), current.data(), current.size());
+	return S_OK;
+}
+
+
+// --- EZCaptureDecoder::DecodeFrame ----------------------
+//  Private helper that decodes a frame over the last one,
+//  which must be the frame before it unless it is a
+//  keyframe
+// --------------------------------------------------------
+inline HRESULT EZCaptureDecoder::DecodeFrame(UINT frame)
+{
+	const EZCaptureIndexEntry& entry = index[frame];
+	hasCurrent = false;
+
+	EZCaptureFrameHeader header = {};
+	if (!ReadAt(entry.Offset, &header, sizeof(header)) || header.Magic != EZCaptureFrameMagic || header.HeaderSize < sizeof(header) ||
+		header.RawBytes != entry.RawBytes || header.ChunkSize == 0 || header.ChunkCount != (header.RawBytes + header.ChunkSize - 1) / header.ChunkSize)
+		return E_FAIL;
+
+	EZCaptureFilter filter = (EZCaptureFilter)header.Filter;
+	if (header.Filter > EZCaptureFilterXor || (filter != EZCaptureFilterNone && current.size() != header.RawBytes))
+		return E_FAIL;
+
+	// Read every chunk at once, then find where each starts
+	chunkSizes.resize(header.ChunkCount);
+	if (!ReadAt(entry.Offset + header.HeaderSize, chunkSizes.data(), chunkSizes.size() * sizeof(UINT)))
+		return E_FAIL;
+	std::vector<size_t> offsets(header.ChunkCount + 1, 0);
+	for (size_t c = 0; c < chunkSizes.size(); c++)
+	{
+		size_t size = chunkSizes[c] & ~EZCaptureChunkStored;
+		if (size > header.ChunkSize)
+			return E_FAIL;
+		offsets[c + 1] = offsets[c] + size;
+	}
+	payload.resize(offsets.back());
+	if (!ReadAt(entry.Offset + header.HeaderSize + chunkSizes.size() * sizeof(UINT), payload.data(), payload.size()))
+		return E_FAIL;
+
+	current.resize((size_t)header.RawBytes);
+	std::atomic<bool> damaged{ false };
+	EZParallelFor(header.ChunkCount, threadCount, 1, [&](size_t begin, size_t end)
+	{
+		std::vector<unsigned char> filtered(filter != EZCaptureFilterNone ? header.ChunkSize : 0);
+		for (size_t c = begin; c < end; c++)
+		{
+			size_t offset = c * header.ChunkSize;
+			size_t size = EZMin((size_t)header.ChunkSize, current.size() - offset);
+			unsigned char* output = filter != EZCaptureFilterNone ? filtered.data() : current.data() + offset;
+			const unsigned char* input = payload.data() + offsets[c];
+			size_t inputSize = offsets[c + 1] - offsets[c];
+
+			bool decoded;
+			if (chunkSizes[c] & EZCaptureChunkStored)
+			{
+				decoded = inputSize == size;
+				if (decoded)
+					memcpy(output, input, size);
+			}
+			else
+			{
+				decoded = EZLZDecompress(input, inputSize, output, size);
+			}
+
+			if (!decoded)
+				damaged = true;
+			else if (filter != EZCaptureFilterNone)
+				EZCaptureFilterData(filter, true, header.ChannelSize, current.data() + offset, output, current.data() + offset, size);
+		}
+	});
+
+	if (damaged)
+		return E_FAIL;
+	currentFrame = frame;
+	hasCurrent = true;
+	return S_OK;
+}
+
+
+// --- EZCaptureDecoder::ReadAt ---------------------------
+//  Private helper that reads bytes from an offset in the
+//  file
+// --------------------------------------------------------
+inline bool EZCaptureDecoder::ReadAt(unsigned long long offset, void* data, size_t bytes)
+{
+#if defined(_MSC_VER)
+	if (_fseeki64(file, (long long)offset, SEEK_SET) != 0)
+		return false;
+#else
+	if (fseeko(file, (off_t)offset, SEEK_SET) != 0)
+		return false;
+#endif
+	return bytes == 0 || fread(data, 1, bytes, file) == bytes;
+}
+
+
+
+// --- EZReadbackTicket -----------------------------------
+//  Identifies an asynchronous read started by ReadAsync()
+//  or ReadThreaded().
+//  Zero is never handed out and marks a read that could 
+//  not be started.
+// --------------------------------------------------------
+typedef unsigned long long EZReadbackTicket;
+const EZReadbackTicket EZReadbackInvalidTicket = 0;
+
+// --- EZSubresourceLayout -------------------------------
+//  Where one subresource lives in the results of
+//  EZReadback::ReadAllSubresources().  Layouts are ordered
+//  by subresource index, so the layout of a given mip and
+//  array slice is at D3D11CalcSubresource(mip, slice, 
+//  mipLevels).  Sizes are in texels (bytes for buffers),
+//  while Offset and ElementCount are in elements of the
+//  type that was read (4x4 blocks for block compressed
+//  formats).
+// --------------------------------------------------------
+struct EZSubresourceLayout
+{
+	UINT MipLevel;
+	UINT ArrayIndex;
+	UINT Width;
+	UINT Height;
+	UINT Depth;
+	size_t Offset;       // First element of the subresource
+	size_t ElementCount; // Elements in the subresource
+};
+
+// --- EZReadbackBatchStats -------------------------------
+//  Timing and size of one EZReadback::Batch, for comparing
+//  a batch against the same reads done one at a time.
+//  Times are wall clock milliseconds.
+// --------------------------------------------------------
+struct EZReadbackBatchStats
+{
+	UINT ReadCount;           // Reads in the batch
+	size_t BytesRead;         // Bytes copied into results
+	double RecordMilliseconds; // Spent queuing copies in Add()
+	double WaitMilliseconds;   // Spent waiting on the GPU in Submit()
+	double ReadMilliseconds;   // Spent mapping and copying in Submit()
+	double TotalMilliseconds;  // All of the above
+
+	EZReadbackBatchStats() :
+		ReadCount{ 0 }, BytesRead{ 0 }, RecordMilliseconds{ 0 },
+		WaitMilliseconds{ 0 }, ReadMilliseconds{ 0 }, TotalMilliseconds{ 0 } {}
+};
+
+// --- EZSchedulerOptions ---------------------------------
+//  Settings for an EZReadback::Scheduler.  FrameBudget 
+//  caps the bytes copied to staging in each Update(); 
+//  reads bigger than MaxPieceBytes are cut into several
+//  copies so they can be spread over frames.
+// --------------------------------------------------------
+struct EZSchedulerOptions
+{
+	size_t FrameBudget;   // Bytes copied per Update()
+	size_t MaxPieceBytes; // Largest single copy, or zero to use FrameBudget
+
+	EZSchedulerOptions() : FrameBudget{ 8 * 1024 * 1024 }, MaxPieceBytes{ 0 } {}
+};
+
+// --- EZScheduledReadOptions -----------------------------
+//  Settings for one read added to an EZReadback::Scheduler.
+//  Reads with a higher priority are copied first, then 
+//  those with the earliest deadline.  A deadline of N
+//  frames asks for the results by the Nth Update() after
+//  the read was added; missing it is only counted.
+// --------------------------------------------------------
+struct EZScheduledReadOptions
+{
+	int Priority;  // Higher is copied first
+	UINT Deadline; // Frames until the results are wanted, or zero for none
+
+	EZScheduledReadOptions() : Priority{ 0 }, Deadline{ 0 } {}
+};
+
+// --- EZSchedulerStats -----------------------------------
+//  Where an EZReadback::Scheduler is at.  The frame stats
+//  describe the last Update().
+// --------------------------------------------------------
+struct EZSchedulerStats
+{
+	unsigned long long Frame;      // Update() calls so far
+	size_t FrameBytes;             // Bytes copied in the last frame
+	UINT FramePieces;              // Copies made in the last frame
+	size_t PeakFrameBytes;         // Most bytes copied in any frame
+	unsigned long long TotalBytes; // Bytes copied in every frame
+	UINT PendingReads;             // Reads added but not yet delivered
+	UINT PiecesInFlight;           // Copies waiting on the GPU
+	UINT CompletedReads;           // Reads delivered, including failures
+	UINT MissedDeadlines;          // Reads delivered after their deadline
+
+	EZSchedulerStats() :
+		Frame{ 0 }, FrameBytes{ 0 }, FramePieces{ 0 }, PeakFrameBytes{ 0 }, TotalBytes{ 0 },
+		PendingReads{ 0 }, PiecesInFlight{ 0 }, CompletedReads{ 0 }, MissedDeadlines{ 0 } {}
+};
+
+// --- EZReadbackPiece ------------------------------------
+//  One copy that makes up part of a scheduled read: a box
+//  of one subresource, and where its rows go in results
+//  laid out like EZReadback::ReadAllSubresources().
+//  Offsets and strides are in elements of the type being
+//  read (4x4 blocks for block compressed formats).
+// --------------------------------------------------------
+struct EZReadbackPiece
+{
+	UINT Subresource;   // Index into the layouts
+	UINT MipLevel;
+	UINT ArrayIndex;
+	bool Whole;         // Copies the whole subresource; Box is unused
+	D3D11_BOX Box;      // Texels (bytes for buffers)
+	size_t Bytes;       // Bytes copied
+	size_t Offset;      // Where the first row goes
+	size_t RowStride;   // Elements between rows
+	size_t SliceStride; // Elements between depth slices
+};
+
+// --- EZPlanReadbackPieces -------------------------------
+//  Cuts a read of every subresource, as laid out in the
+//  given layouts, into copies of at most maxPieceBytes, in
+//  subresource order.  Each subresource is cut into runs
+//  of whole depth slices if one fits, then bands of whole
+//  rows, then pieces of a single row.  Block compressed 
+//  data is cut on whole blocks.  Formats that cannot be
+//  copied by region (planar and packed 4:2:2 video, and 
+//  less than a byte per texel) are always copied whole, so
+//  their pieces can be bigger.  The same inputs always 
+//  give the same pieces.
+// 
+//  Parameters:
+//  - format: format of the resource, DXGI_FORMAT_UNKNOWN
+//    for buffers
+//  - elementSize: size of the elements being read
+//  - layouts: one layout per subresource, in index order
+//  - maxPieceBytes: the most bytes to copy at once
+//  - pieces: filled with the copies to make
+// --------------------------------------------------------
+inline void EZPlanReadbackPieces(DXGI_FORMAT format, size_t elementSize, const std::vector<EZSubresourceLayout>& layouts,
+	size_t maxPieceBytes, std::vector<EZReadbackPiece>& pieces)
+{
+	pieces.clear();
+	maxPieceBytes = EZMax(maxPieceBytes, elementSize);
+
+	bool buffer = format == DXGI_FORMAT_UNKNOWN;
+	bool blocks = EZIsBlockCompressed(format);
+	size_t bits = buffer ? 8 : EZBitsPerPixel(format);
+	bool splittable = buffer || blocks || (bits >= 8 && bits % 8 == 0 && !EZIsPlanar(format));
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_YUY2:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		splittable = false;
+		break;
+	default:
+		break;
+	}
+
+	for (UINT subresource = 0; subresource < (UINT)layouts.size(); subresource++)
+	{
+		const EZSubresourceLayout& layout = layouts[subresource];
+
+		// Columns and rows are elements and rows of elements
+		UINT blockSize = blocks ? 4 : 1;
+		size_t columns = buffer ? layout.ElementCount : (layout.Width + blockSize - 1) / blockSize;
+		size_t rows = buffer ? 1 : (layout.Height + blockSize - 1) / blockSize;
+		size_t slices = buffer ? 1 : layout.Depth;
+		size_t rowBytes = columns * elementSize;
+		size_t sliceBytes = rowBytes * rows;
+
+		EZReadbackPiece piece = {};
+		piece.Subresource = subresource;
+		piece.MipLevel = layout.MipLevel;
+		piece.ArrayIndex = layout.ArrayIndex;
+		piece.RowStride = columns;
+		piece.SliceStride = columns * rows;
+
+		// Small enough, or not cut up at all
+		if (!splittable || columns * rows * slices != layout.ElementCount || sliceBytes * slices <= maxPieceBytes)
+		{
+			piece.Whole = true;
+			piece.Bytes = layout.ElementCount * elementSize;
+			piece.Offset = layout.Offset;
+			pieces.push_back(piece);
+			continue;
+		}
+
+		// Work out how much of a slice, row or column each
+		// piece takes
+		size_t slicesPer = sliceBytes <= maxPieceBytes ? maxPieceBytes / sliceBytes : 1;
+		size_t rowsPer = sliceBytes <= maxPieceBytes ? rows : rowBytes <= maxPieceBytes ? maxPieceBytes / rowBytes : 1;
+		size_t columnsPer = rowBytes <= maxPieceBytes ? columns : maxPieceBytes / elementSize;
+		size_t columnUnit = buffer ? elementSize : blockSize;
+		for (size_t z = 0; z < slices; z += slicesPer)
+		{
+			for (size_t y = 0; y < rows; y += rowsPer)
+			{
+				for (size_t x = 0; x < columns; x += columnsPer)
+				{
+					size_t pieceSlices = EZMin(slicesPer, slices - z);
+					size_t pieceRows = EZMin(rowsPer, rows - y);
+					size_t pieceColumns = EZMin(columnsPer, columns - x);
+					piece.Whole = false;
+					piece.Box.left = (UINT)(x * columnUnit);
+					piece.Box.right = buffer ? (UINT)((x + pieceColumns) * columnUnit) : EZMin((UINT)((x + pieceColumns) * blockSize), layout.Width);
+					piece.Box.top = (UINT)(y * blockSize);
+					piece.Box.bottom = buffer ? 1 : EZMin((UINT)((y + pieceRows) * blockSize), layout.Height);
+					piece.Box.front = (UINT)z;
+					piece.Box.back = (UINT)(z + pieceSlices);
+					piece.Bytes = pieceColumns * pieceRows * pieceSlices * elementSize;
+					piece.Offset = layout.Offset + z * piece.SliceStride + y * piece.RowStride + x;
+					pieces.push_back(piece);
+				}
+			}
+		}
+	}
+}
+
+// --- EZTypedResource ------------------------------------
+//  A resource paired with the element type it is read as,
+//  so that the dimension is fixed at compile time and the
+//  format is checked once, when the resource is bound, 
+//  instead of on every read.  Textures must pass
+//  EZIsElementCompatible(); buffers must be a whole number
+//  of elements, and structured buffers must have a stride
+//  of exactly one element.
+// 
+//  Use one of the aliases below, such as 
+//  EZTypedTexture2D<EZColor4>, and read it with 
+//  EZReadback::Read().  Holds a reference to the resource
+//  until it is reset or destroyed.
+// --------------------------------------------------------
+template<typename ResourceType, typename DescriptionType, typename ElementType>
+class EZTypedResource
+{
+	static_assert(std::is_trivially_copyable<ElementType>::value, "Elements are copied straight out of mapped memory");
+
+public:
+	EZTypedResource() : desc{} {}
+	explicit EZTypedResource(ResourceType* resource) : desc{} { Bind(resource); }
+
+	// Checks the resource against the element type and holds on to it
+	HRESULT Bind(ResourceType* resource)
+	{
+		Reset();
+		if (!resource)
+			return E_INVALIDARG;
+
+		DescriptionType bound;
+		resource->GetDesc(&bound);
+		if (!IsCompatible(bound))
+			return E_INVALIDARG;
+
+		this->resource = resource;
+		desc = bound;
+		return S_OK;
+	}
+
+	void Reset() { resource.Reset(); desc = DescriptionType{}; }
+
+	ResourceType* Get() const { return resource.Get(); }
+	const DescriptionType& GetDesc() const { return desc; }
+	explicit operator bool() const { return resource.Get() != nullptr; }
+
+private:
+
+	static bool IsCompatible(const D3D11_BUFFER_DESC& bound)
+	{
+		return bound.ByteWidth % sizeof(ElementType) == 0 &&
+			(bound.StructureByteStride == 0 || bound.StructureByteStride == sizeof(ElementType));
+	}
+
+	template<typename TextureDescription>
+	static bool IsCompatible(const TextureDescription& bound)
+	{
+		return EZIsElementCompatible<ElementType>(bound.Format);
+	}
+
+	Microsoft::WRL::ComPtr<ResourceType> resource;
+	DescriptionType desc;
+};
+
+template<typename ElementType>
+using EZTypedBuffer = EZTypedResource<ID3D11Buffer, D3D11_BUFFER_DESC, ElementType>;
+template<typename ElementType>
+using EZTypedTexture1D = EZTypedResource<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, ElementType>;
+template<typename ElementType>
+using EZTypedTexture2D = EZTypedResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, ElementType>;
+template<typename ElementType>
+using EZTypedTexture3D = EZTypedResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, ElementType>;
+
+class EZReadback
+{
+
+public:
+
+#if !defined(EZREADBACK_NO_D3D11)
+	// --- Constructor ---------------------------------------
+	//  Creates the EZReadback object holding D3D objects
+	//
+	//  - device: the D3D device for creating resources
+	//  - context: the D3D context for copying resources
+	// -------------------------------------------------------
+	EZReadback(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+		EZReadback(std::make_shared<EZD3D11Backend>(device, context)) {}
+#endif
+
+	// --- Constructor ---------------------------------------
+	//  Creates the EZReadback object on any backend, such as
+	//  an EZReferenceBackend for reading without a GPU
+	//
+	//  - backend: creates, copies and maps resources
+	// -------------------------------------------------------
+	EZReadback(std::shared_ptr<EZReadbackBackend> backend)
+	{
+		this->backend = backend;
+		this->asyncRing.resize(3);
+		this->asyncNext = 0;
+		this->lastTicket = EZReadbackInvalidTicket;
+	}
+
+	// Read functions that populate a given vector
+	template<typename ElementType>
+	HRESULT Read(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	HRESULT Read(ID3D11View* view, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions that return a new vector
+	template<typename ElementType>
+	std::vector<ElementType> Read(ID3D11Resource* resource, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	std::vector<ElementType> Read(ID3D11View* view, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read function for a typed resource, checked when it was bound
+	template<typename ResourceType, typename DescriptionType, typename ElementType>
+	HRESULT Read(const EZTypedResource<ResourceType, DescriptionType, ElementType>& resource, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions that fill caller-provided memory
+	template<typename ElementType>
+	HRESULT ReadInto(ID3D11Resource* resource, ElementType* buffer, size_t bufferCount, size_t& elementCount, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	HRESULT ReadInto(ID3D11Resource* resource, std::function<ElementType*(size_t)> allocate, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read function that maps the data without copying it
+	template<typename ElementType>
+	class MappedView;
+
+	template<typename ElementType>
+	HRESULT ReadMapped(ID3D11Resource* resource, MappedView<ElementType>& view, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions for a region of a single subresource
+	template<typename ElementType>
+	HRESULT ReadRegion(ID3D11Resource* resource, const D3D11_BOX& region, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	std::vector<ElementType> ReadRegion(ID3D11Resource* resource, const D3D11_BOX& region, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions for a range of a buffer, whole or split into fields
+	template<typename ElementType>
+	HRESULT ReadBufferRange(ID3D11Buffer* buffer, UINT byteOffset, UINT elementCount, std::vector<ElementType>& results);
+
+	template<typename ElementType>
+	HRESULT ReadBufferFields(ID3D11Buffer* buffer, UINT byteOffset, UINT elementCount, const EZBufferField* fields, size_t fieldCount, UINT threadCount = 0);
+
+	// Read function for every mip and array slice at once
+	template<typename ElementType>
+	HRESULT ReadAllSubresources(ID3D11Resource* resource, std::vector<ElementType>& results, std::vector<EZSubresourceLayout>& layouts);
+
+	// Read functions that decode any supported format
+	inline HRESULT ReadAsFloat4(ID3D11Resource* resource, std::vector<DirectX::XMFLOAT4>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadAsUInt4(ID3D11Resource* resource, std::vector<DirectX::XMUINT4>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadAsFloat4(ID3D11View* view, std::vector<DirectX::XMFLOAT4>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadAsUInt4(ID3D11View* view, std::vector<DirectX::XMUINT4>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read function that decompresses block compressed textures
+	inline HRESULT ReadDecompressed(ID3D11Resource* resource, std::vector<EZColor4>& results, UINT mipLevel = 0, UINT arrayIndex = 0, UINT threadCount = 0);
+
+	// Read functions that split depth/stencil textures into separate planes
+	inline HRESULT ReadDepth(ID3D11Resource* resource, std::vector<float>& depth, const EZDepthOptions& options = EZDepthOptions(), UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadStencil(ID3D11Resource* resource, std::vector<unsigned char>& stencil, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadDepthStencil(ID3D11Resource* resource, std::vector<float>& depth, std::vector<unsigned char>& stencil, const EZDepthOptions& options = EZDepthOptions(), UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions for planar video textures (NV12, P010 and P016)
+	template<typename SampleType>
+	HRESULT ReadPlanes(ID3D11Resource* resource, std::vector<SampleType>& luma, std::vector<SampleType>& chroma, EZPlaneLayout& lumaLayout, EZPlaneLayout& chromaLayout, UINT arrayIndex = 0);
+
+	inline HRESULT ReadYUVAsRGBA8(ID3D11Resource* resource, std::vector<EZColor4>& results, const EZYUVOptions& options = EZYUVOptions(), UINT arrayIndex = 0);
+	inline HRESULT ReadYUVAsFloat4(ID3D11Resource* resource, std::vector<DirectX::XMFLOAT4>& results, const EZYUVOptions& options = EZYUVOptions(), UINT arrayIndex = 0);
+
+	// Read function that gathers statistics while copying the data
+	template<typename ElementType>
+	HRESULT ReadReduced(ID3D11Resource* resource, std::vector<ElementType>& results, EZReduction& reduction, const EZReductionOptions& options = EZReductionOptions(), UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read function that also finds which tiles changed since the last read
+	template<typename ElementType>
+	HRESULT ReadDirtyTiles(ID3D11Resource* resource, std::vector<ElementType>& results, EZTileTracker& tracker, std::vector<EZDirtyTile>& dirtyTiles, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Read functions that stream straight to a file
+	inline HRESULT ReadToDDS(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline HRESULT ReadToRaw(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	// Asynchronous read functions that do not stall the CPU
+	template<typename ElementType>
+	EZReadbackTicket ReadAsync(ID3D11Resource* resource, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	EZReadbackTicket ReadAsync(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<ElementType>&)> callback, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	template<typename ElementType>
+	HRESULT TryGet(EZReadbackTicket ticket, std::vector<ElementType>& results);
+
+	template<typename ElementType>
+	HRESULT Wait(EZReadbackTicket ticket, std::vector<ElementType>& results);
+
+	inline HRESULT Wait(EZReadbackTicket ticket);
+	inline UINT UpdateAsync();
+
+	// Async ring controls
+	inline HRESULT SetAsyncRingSize(UINT slotCount);
+	inline UINT GetAsyncRingSize() { return (UINT)asyncRing.size(); }
+	inline UINT GetPendingAsyncCount();
+
+	// Staging pool controls
+	inline void SetStagingBudget(size_t budgetInBytes) { stagingPool.SetBudget(budgetInBytes); }
+	inline void ClearStagingPool() { stagingPool.Clear(); }
+	inline EZStagingPoolStats GetStagingPoolStats() { return stagingPool.GetStats(); }
+
+	// Batched reads that share a single wait on the GPU
+	class Batch;
+	inline Batch CreateBatch();
+
+	// Reads spread over several frames under a per-frame copy budget
+	class Scheduler;
+	inline Scheduler CreateScheduler(const EZSchedulerOptions& options = EZSchedulerOptions());
+
+	// Threaded reads, where a worker thread waits on the GPU and copies the results
+	inline HRESULT StartWorker(UINT queueSize = 16);
+	inline void StopWorker();
+	inline bool IsWorkerRunning() { return worker && worker->Thread.joinable(); }
+
+	template<typename ElementType>
+	EZReadbackTicket ReadThreaded(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<ElementType>&)> callback, UINT mipLevel = 0, UINT arrayIndex = 0);
+	inline EZReadbackTicket ReadThreadedAsFloat4(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<DirectX::XMFLOAT4>&)> callback, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	inline UINT DeliverThreaded();
+	inline UINT GetPendingThreadedCount() { return worker ? worker->Pending.load() : 0; }
+
+	// Instrumentation, which is off until enabled and does nothing if EZREADBACK_NO_INSTRUMENTATION is defined
+	inline void EnableProfiling();
+	inline bool IsProfiling() { return profiler != nullptr; }
+	inline EZReadbackStats GetReadbackStats() { return profiler ? profiler->GetStats() : EZReadbackStats(); }
+	inline void ResetReadbackStats() { if (profiler) profiler->Reset(); }
+	inline void SetTracing(bool enabled, size_t maxEvents = 65536) { if (enabled) EnableProfiling(); if (profiler) profiler->SetTracing(enabled, maxEvents); }
+	inline std::string ExportChromeTrace() { return profiler ? profiler->ExportChromeTrace() : std::string(); }
+
+	// The backend everything goes through
+	inline EZReadbackBackend* GetBackend() { return backend.get(); }
+
+private:
+
+	// Backend for resource creation and manipulation; shared
+	// with the worker thread
+	std::shared_ptr<EZReadbackBackend> backend;
+
+	// Staging resources kept around between reads
+	EZStagingPool stagingPool;
+
+	// Stage timings, shared with the worker thread; null until
+	// EnableProfiling() and always null when stripped
+	std::unique_ptr<EZReadbackProfiler> profiler;
+
+	// A copy into a pooled staging resource, ready to be mapped
+	struct StagedCopy
+	{
+		Microsoft::WRL::ComPtr<ID3D11Resource> Staging;
+		UINT Subresource;
+		size_t ElementCount;
+		size_t ElementSize;
+		UINT RowCount;   // Rows per slice
+		UINT SliceCount; // Slices (depth) of 3D data
+	};
+
+	// What a view covers of its resource, made absolute
+	struct ViewSubresource
+	{
+		Microsoft::WRL::ComPtr<ID3D11Resource> Resource;
+		DXGI_FORMAT Format; // The view's format; unknown for structured buffers
+		UINT MipLevel;
+		UINT ArrayIndex;
+		bool Whole;         // False when only Region is covered
+		D3D11_BOX Region;   // Bytes of a buffer, or depth slices of a 3D texture
+	};
+
+	// One in-flight asynchronous read
+	struct AsyncSlot
+	{
+		EZReadbackTicket Ticket; // Invalid when the slot is free
+		StagedCopy Copy;
+		size_t ElementSize;
+		bool Flushed;
+		std::function<HRESULT(UINT)> Resolve; // Only set for reads with a callback
+	};
+
+	// Ring of in-flight asynchronous reads
+	std::vector<AsyncSlot> asyncRing;
+	size_t asyncNext;
+	EZReadbackTicket lastTicket;
+
+	// One threaded read, from the render thread to the worker
+	struct WorkerJob
+	{
+		EZReadbackTicket Ticket;
+		StagedCopy Copy;
+		std::function<HRESULT(const StagedCopy&, const D3D11_MAPPED_SUBRESOURCE&)> Read; // Runs on the worker while mapped
+		std::function<void(HRESULT)> Deliver;                                           // Runs in DeliverThreaded()
+	};
+
+	// A finished threaded read, from the worker to DeliverThreaded()
+	struct WorkerCompletion
+	{
+		HRESULT Result;
+		std::function<void(HRESULT)> Deliver;
+	};
+
+	// Everything shared with the worker thread.  Kept on the
+	// heap so it stays put if the EZReadback is moved.
+	struct WorkerState
+	{
+		WorkerState(UINT queueSize) : Stopping{ false }, Completed(queueSize), Returned(queueSize), Pending{ 0 }, Staged{ 0 }, Profiler{ nullptr } {}
+		~WorkerState() { Stop(); }
+		inline void Stop();
+
+		std::thread Thread;
+		std::mutex Lock;                   // Guards Submitted and Stopping
+		std::condition_variable Wake;
+		std::deque<WorkerJob> Submitted;
+		bool Stopping;
+		EZSPSCQueue<WorkerCompletion> Completed;                          // Worker to DeliverThreaded()
+		EZSPSCQueue<Microsoft::WRL::ComPtr<ID3D11Resource>> Returned;    // Worker to render thread, for the pool
+		std::atomic<UINT> Pending;         // Submitted but not yet delivered
+		UINT Staged;                       // Staging resources not yet back in the pool, only used by the render thread
+		std::atomic<EZReadbackProfiler*> Profiler; // Set when profiling is enabled, even while running
+	};
+	std::unique_ptr<WorkerState> worker;
+
+	// Private helper to perform actual readback from GPU resource
+	template<typename ResourceType, typename DescriptionType, typename ElementType>
+	HRESULT StageAndCopyResource(
+		ResourceType* resource,
+		UINT mipLevel,
+		UINT arrayIndex,
+		std::vector<ElementType>& results,
+		const DescriptionType* bound = nullptr);
+
+	// Private helpers for copying into staging resources and reading them back
+	template<typename ResourceType, typename DescriptionType>
+	HRESULT CopyToStaging(ResourceType* resource, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, size_t elementSize, StagedCopy& staged, const DescriptionType* bound = nullptr);
+	inline HRESULT CopyToStaging(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, size_t elementSize, StagedCopy& staged);
+
+	template<typename ResourceType, typename DescriptionType>
+	HRESULT CopyAllToStaging(ResourceType* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts);
+	inline HRESULT CopyAllToStaging(ID3D11Resource* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts);
+
+	template<typename DescriptionType>
+	void CalcSubresourceLayouts(DescriptionType* desc, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts);
+	inline HRESULT CalcSubresourceLayouts(ID3D11Resource* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts);
+	template<typename DescriptionType>
+	void SetStagingFlags(DescriptionType* desc);
+
+	template<typename ElementType>
+	HRESULT ReadStagedCopy(const StagedCopy& staged, UINT mapFlags, std::vector<ElementType>& results);
+	inline HRESULT ReadStagedCopy(const StagedCopy& staged, UINT mapFlags, size_t elementSize, void* destination);
+
+	template<typename RowFunction>
+	HRESULT ReadStagedRows(const StagedCopy& staged, UINT mapFlags, RowFunction rowFunction);
+
+	template<typename MappedFunction>
+	HRESULT ReadStagedMapped(const StagedCopy& staged, UINT mapFlags, MappedFunction mappedFunction);
+
+	static inline HRESULT MapStaged(EZReadbackBackend* backend, EZReadbackProfiler* profiler, const StagedCopy& staged, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE& gpu);
+	static inline void CopyMapped(const StagedCopy& staged, const D3D11_MAPPED_SUBRESOURCE& gpu, size_t elementSize, void* destination);
+	template<typename RowFunction>
+	static void ForEachMappedRow(const StagedCopy& staged, const D3D11_MAPPED_SUBRESOURCE& gpu, RowFunction rowFunction);
+
+	inline HRESULT ReadToWriter(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel, UINT arrayIndex, bool dds);
+	inline HRESULT ReadDepthPlanes(ID3D11Resource* resource, std::vector<float>* depth, std::vector<unsigned char>* stencil, const EZDepthOptions& options, UINT mipLevel, UINT arrayIndex);
+
+	template<typename OutputType>
+	HRESULT ReadYUV(ID3D11Resource* resource, std::vector<OutputType>& results, const EZYUVOptions& options, UINT arrayIndex);
+
+	template<typename OutputType, typename DecodeFunction>
+	HRESULT ReadDecoded(ID3D11Resource* resource, DXGI_FORMAT format, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, std::vector<OutputType>& results, DecodeFunction decode);
+
+	template<typename OutputType, typename DecodeFunction>
+	HRESULT ReadBlockCompressed(ID3D11Resource* resource, DXGI_FORMAT format, UINT mipLevel, UINT arrayIndex, std::vector<OutputType>& results, DecodeFunction decode);
+
+	// Private helpers for the worker thread
+	inline EZReadbackTicket StartWorkerJob(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, size_t elementSize, 
+		std::function<HRESULT(const StagedCopy&, const D3D11_MAPPED_SUBRESOURCE&)> read, std::function<void(HRESULT)> deliver);
+	inline void ReturnWorkerStaging();
+	static inline void RunWorker(WorkerState* state, std::shared_ptr<EZReadbackBackend> backend);
+
+	// Private helpers for the async ring
+	inline AsyncSlot* StartAsyncSlot(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, size_t elementSize);
+	inline AsyncSlot* FindAsyncSlot(EZReadbackTicket ticket);
+	inline HRESULT FinishAsyncSlot(AsyncSlot* slot, HRESULT result);
+
+	// Function overloads based on template type
+	inline HRESULT CreateResource(void* desc, ...) { return E_INVALIDARG; }
+	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Buffer>& result) { return backend->CreateBuffer(static_cast<D3D11_BUFFER_DESC*>(desc), nullptr, result.GetAddressOf()); }
+	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture1D>& result) { return backend->CreateTexture1D(static_cast<D3D11_TEXTURE1D_DESC*>(desc), nullptr, result.GetAddressOf()); }
+	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture2D>& result) { return backend->CreateTexture2D(static_cast<D3D11_TEXTURE2D_DESC*>(desc), nullptr, result.GetAddressOf()); }
+	inline HRESULT CreateResource(void* desc, Microsoft::WRL::ComPtr<ID3D11Texture3D>& result) { return backend->CreateTexture3D(static_cast<D3D11_TEXTURE3D_DESC*>(desc), nullptr, result.GetAddressOf()); }
+
+	// Helpers for calculating the number of elements in a resource
+	template<typename DescriptionType> inline UINT CalcElementCount(DescriptionType* desc, size_t elementSize, UINT mipLevel);
+
+	// Helpers for calculating the rows and slices of a mip, for pitched copies
+	template<typename DescriptionType> inline void CalcRowAndSliceCount(DescriptionType* desc, UINT mipLevel, UINT& rowCount, UINT& sliceCount);
+
+	// Helpers for calculating subresource index of different resource types
+	template<typename DescriptionType> inline UINT CalcSubresourceIndex(DescriptionType* desc, UINT mipLevel, UINT arrayIndex);
+
+	// Helpers for shrinking a description down to a single subresource or region
+	template<typename DescriptionType> inline HRESULT CalcStagingDesc(DescriptionType* desc, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region);
+	inline bool IsRegionInside(const D3D11_BOX* region, UINT width, UINT height, UINT depth);
+	inline bool IsRegionBlockAligned(const D3D11_BOX* region, UINT width, UINT height);
+	inline bool CalcBufferRange(UINT byteOffset, UINT elementCount, size_t elementSize, D3D11_BOX& region);
+	inline HRESULT ResolveView(ID3D11View* view, UINT mipLevel, UINT arrayIndex, ViewSubresource& resolved);
+
+	// Overloads for the mip and array counts and sizes of each description type
+	inline UINT GetMipLevels(D3D11_BUFFER_DESC* /*desc*/) { return 1; }
+	inline UINT GetMipLevels(D3D11_TEXTURE1D_DESC* desc) { return desc->MipLevels; }
+	inline UINT GetMipLevels(D3D11_TEXTURE2D_DESC* desc) { return desc->MipLevels; }
+	inline UINT GetMipLevels(D3D11_TEXTURE3D_DESC* desc) { return desc->MipLevels; }
+	inline UINT GetArraySize(D3D11_BUFFER_DESC* /*desc*/) { return 1; }
+	inline UINT GetArraySize(D3D11_TEXTURE1D_DESC* desc) { return desc->ArraySize; }
+	inline UINT GetArraySize(D3D11_TEXTURE2D_DESC* desc) { return desc->ArraySize; }
+	inline UINT GetArraySize(D3D11_TEXTURE3D_DESC* /*desc*/) { return 1; }
+	inline void CalcMipSize(D3D11_BUFFER_DESC* desc, UINT /*mipLevel*/, UINT& width, UINT& height, UINT& depth) { width = desc->ByteWidth; height = 1; depth = 1; }
+	inline void CalcMipSize(D3D11_TEXTURE1D_DESC* desc, UINT mipLevel, UINT& width, UINT& height, UINT& depth) { width = EZMax(desc->Width >> mipLevel, 1); height = 1; depth = 1; }
+	inline void CalcMipSize(D3D11_TEXTURE2D_DESC* desc, UINT mipLevel, UINT& width, UINT& height, UINT& depth) { width = EZMax(desc->Width >> mipLevel, 1); height = EZMax(desc->Height >> mipLevel, 1); depth = 1; }
+	inline void CalcMipSize(D3D11_TEXTURE3D_DESC* desc, UINT mipLevel, UINT& width, UINT& height, UINT& depth) { width = EZMax(desc->Width >> mipLevel, 1); height = EZMax(desc->Height >> mipLevel, 1); depth = EZMax(desc->Depth >> mipLevel, 1); }
+	inline void CalcMipSize(ID3D11Resource* resource, UINT mipLevel, UINT& width, UINT& height, UINT& depth);
+
+	// Helpers for estimating the total size of a resource in bytes
+	template<typename DescriptionType> inline size_t CalcResourceSize(DescriptionType* desc);
+
+	// Helpers for getting the format of a resource
+	template<typename DescriptionType> inline DXGI_FORMAT GetFormat(DescriptionType* desc);
+	inline DXGI_FORMAT GetFormat(ID3D11Resource* resource);
+
+	// Helper for size of formats
+	inline size_t BitsPerPixel(DXGI_FORMAT format) { return EZBitsPerPixel(format); }
+	inline bool IsElementSizeValid(DXGI_FORMAT format, size_t elementSize);
+};
+
+
+// --- EZReadback::MappedView -----------------------------
+//  A subresource read with ReadMapped(), left mapped so it
+//  can be used in place without copying it anywhere.  Rows
+//  keep the row and depth pitch of the mapped memory, so 
+//  use Row() or At() to find elements rather than assuming
+//  they are tightly packed.
+// 
+//  The staging resource stays checked out of the pool and
+//  mapped until the view is destroyed, moved from or 
+//  Unmap() is called.  Views must not outlive the 
+//  EZReadback that filled them.
+// --------------------------------------------------------
+template<typename ElementType>
+class EZReadback::MappedView
+{
+
+public:
+
+	MappedView() : owner{ nullptr }, copy{}, mapped{}, width{ 0 } {}
+	MappedView(MappedView&& other) : MappedView() { *this = std::move(other); }
+	MappedView(const MappedView&) = delete;
+	MappedView& operator=(const MappedView&) = delete;
+	inline MappedView& operator=(MappedView&& other);
+	inline ~MappedView() { Unmap(); }
+
+	inline bool IsMapped() const { return owner != nullptr; }
+	inline void Unmap();
+
+	// Size in elements (4x4 blocks for block compressed data)
+	inline UINT GetWidth() const { return width; }
+	inline UINT GetHeight() const { return copy.RowCount; }
+	inline UINT GetDepth() const { return copy.SliceCount; }
+	inline size_t GetElementCount() const { return copy.ElementCount; }
+
+	// Layout of the mapped memory in bytes
+	inline const void* GetData() const { return mapped.pData; }
+	inline UINT GetRowPitch() const { return mapped.RowPitch; }
+	inline UINT GetDepthPitch() const { return mapped.DepthPitch; }
+
+	// Element access that respects the pitches
+	inline const ElementType* Row(UINT y, UINT z = 0) const
+	{
+		return reinterpret_cast<const ElementType*>(static_cast<const unsigned char*>(mapped.pData) + (size_t)z * mapped.DepthPitch + (size_t)y * mapped.RowPitch);
+	}
+	inline const ElementType& At(UINT x, UINT y = 0, UINT z = 0) const { return Row(y, z)[x]; }
+
+private:
+
+	friend class EZReadback;
+
+	EZReadback* owner; // Null when nothing is mapped
+	StagedCopy copy;
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	UINT width;
+};
+
+
+// --- EZReadback::Batch ----------------------------------
+//  Groups several reads so they share one wait on the GPU.
+//  Each Add() queues its copy right away; Submit() then
+//  flushes once, waits for the last copy (the GPU runs the
+//  copies in order, so the rest are done by then) and maps
+//  every staging resource in turn without stalling again.
+// 
+//  Created with EZReadback::CreateBatch().  A batch can be
+//  reused after Submit(), and must not outlive the 
+//  EZReadback that created it.
+// --------------------------------------------------------
+class EZReadback::Batch
+{
+
+public:
+
+	Batch(Batch&& other) = default;
+	Batch(const Batch&) = delete;
+	Batch& operator=(const Batch&) = delete;
+	inline ~Batch() { Clear(); }
+
+	template<typename ElementType>
+	HRESULT Add(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel = 0, UINT arrayIndex = 0);
+
+	inline HRESULT Submit();
+	inline void Clear();
+
+	inline UINT GetCount() { return (UINT)entries.size(); }
+	inline EZReadbackBatchStats GetStats() { return stats; }
+
+private:
+
+	friend class EZReadback;
+	Batch(EZReadback* owner) : owner{ owner } {}
+
+	// One queued copy and how to read it into its results
+	struct Entry
+	{
+		StagedCopy Copy;
+		size_t ElementSize;
+		std::function<HRESULT(const StagedCopy&, UINT)> Read;
+	};
+
+	EZReadback* owner;
+	std::vector<Entry> entries;
+	EZReadbackBatchStats stats;
+};
+
+
+// --- EZReadback::Scheduler ------------------------------
+//  Spreads big reads over several frames so that no frame
+//  copies more than a fixed budget.  Each read added is cut
+//  into copies with EZPlanReadbackPieces(); every Update()
+//  (once per frame) reads back the copies the GPU has
+//  finished, then starts as many more as the budget allows,
+//  highest priority and earliest deadline first.  When the
+//  last piece of a read is in, its callback gets the whole
+//  resource, laid out like ReadAllSubresources().
+// 
+//  Frames are counted in Update() calls and nothing here
+//  depends on wall clock time, so the schedule is as 
+//  deterministic as the backend's copies.  With an 
+//  EZReferenceBackend that has no latency, or a latency
+//  in frames stepped by AdvanceFrame() once per Update(),
+//  it is fully deterministic.
+// 
+//  Created with EZReadback::CreateScheduler().  Callbacks
+//  run inside Update() and may add more reads.  A 
+//  scheduler must not outlive the EZReadback that created
+//  it.
+// --------------------------------------------------------
+class EZReadback::Scheduler
+{
+
+public:
+
+	Scheduler(Scheduler&& other) = default;
+	Scheduler(const Scheduler&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+	inline ~Scheduler() { Clear(); }
+
+	template<typename ElementType>
+	EZReadbackTicket Add(ID3D11Resource* resource, 
+		std::function<void(HRESULT, std::vector<ElementType>&, const std::vector<EZSubresourceLayout>&)> callback,
+		const EZScheduledReadOptions& options = EZScheduledReadOptions());
+
+	inline UINT Update();
+	inline bool Cancel(EZReadbackTicket ticket);
+	inline void Clear();
+
+	inline void SetOptions(const EZSchedulerOptions& options) { this->options = options; }
+	inline EZSchedulerOptions GetOptions() { return options; }
+	inline EZSchedulerStats GetStats();
+
+private:
+
+	friend class EZReadback;
+	Scheduler(EZReadback* owner, const EZSchedulerOptions& options) : owner{ owner }, options(options) {}
+
+	// One read, cut into pieces
+	struct Job
+	{
+		EZReadbackTicket Ticket;
+		Microsoft::WRL::ComPtr<ID3D11Resource> Resource;
+		int Priority;
+		unsigned long long DueFrame; // Zero for no deadline
+		size_t ElementSize;
+		unsigned char* Results;      // Owned by Deliver
+		std::vector<EZReadbackPiece> Pieces;
+		size_t NextPiece;            // First piece not yet copied
+		size_t PiecesDone;           // Pieces read back
+		UINT InFlight;               // Pieces copied but not read back
+		HRESULT Result;
+		std::function<void(HRESULT)> Deliver;
+	};
+
+	// One piece copied to staging, waiting on the GPU
+	struct Copy
+	{
+		EZReadbackTicket Ticket;
+		size_t Piece;
+		StagedCopy Staged;
+	};
+
+	EZReadback* owner;
+	EZSchedulerOptions options;
+	std::vector<Job> jobs;
+	std::deque<Copy> copies; // In the order they were made
+	EZSchedulerStats stats;
+
+	inline Job* FindJob(EZReadbackTicket ticket);
+	inline void ReadFinishedCopies();
+	inline void StartCopies();
+};
+
+
+// --- Read functions for resources ----------------------
+//  Reads data of the specified ElementType from a 
+//  specific subresource of the given resource and 
+//  populates the given vector with results.  Note that
+//  ID3D11Buffers do not have explicit subresources and
+//  will always read the entire resource (ignoring mipLevel
+//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
+//  resources do not support arrays, so arrayIndex is ignored.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource.  Note that
+//    this must match the size of the actual elements in the
+//    resource or the function will fail.
+// 
+//  Valid resource types are: 
+//  - ID3D11Buffer
+//  - ID3D11Texture1D
+//  - ID3D11Texture2D
+//  - ID3D11Texture3D
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - Return value is an HRESULT from any failed D3D calls 
+//    or S_OK if all D3D calls were successful.
+// -------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::Read(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER: 
+		return StageAndCopyResource<ID3D11Buffer, D3D11_BUFFER_DESC, ElementType>(static_cast<ID3D11Buffer*>(resource), mipLevel, arrayIndex, results);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D: 
+		return StageAndCopyResource<ID3D11Texture1D, D3D11_TEXTURE1D_DESC, ElementType>(static_cast<ID3D11Texture1D*>(resource), mipLevel, arrayIndex, results);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D: 
+		return StageAndCopyResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, ElementType>(static_cast<ID3D11Texture2D*>(resource), mipLevel, arrayIndex, results);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D: 
+		return StageAndCopyResource<ID3D11Texture3D, D3D11_TEXTURE3D_DESC, ElementType>(static_cast<ID3D11Texture3D*>(resource), mipLevel, arrayIndex, results);
+
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+
+// --- Read functions for views ---------------------------
+//  Reads data of the specified ElementType from a 
+//  specific subresource of the given view and populates
+//  the given vector with results.  Only what the view
+//  covers is copied: mipLevel and arrayIndex count from
+//  the view's most detailed mip and first array slice, 
+//  buffer views read just their window of elements, and
+//  3D UAVs just their depth slices.  See ResolveView().
+// 
+//  ElementType:
+//  - Expected data type to read from the view.  Note that
+//    this must match the size of the view's elements (not
+//    the resource's, which may be typeless) or the 
+//    function will fail.
+// 
+//  Valid view types are: 
+//  - ID3D11ShaderResourceView
+//  - ID3D11UnorderedAccessView
+// 
+//  Parameters:
+//  - view: view of the GPU resource to read
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read, within the view
+//  - arrayIndex: array element to read, within the view
+// 
+// 	Returns:
+//  - E_INVALIDARG if the subresource is outside the view,
+//    or a buffer window is not a whole number of elements
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// -------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::Read(ID3D11View* view, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+{
+	ViewSubresource covered;
+	HRESULT resolve = ResolveView(view, mipLevel, arrayIndex, covered);
+	if (FAILED(resolve))
+		return resolve;
+
+	// Check against the view's format, which for typeless
+	// resources is the only one with a meaning
+	if (!IsElementSizeValid(covered.Format, sizeof(ElementType)))
+		return E_INVALIDARG;
+
+	D3D11_RESOURCE_DIMENSION type;
+	covered.Resource->GetType(&type);
+	if (type == D3D11_RESOURCE_DIMENSION_BUFFER && (covered.Region.right - covered.Region.left) % sizeof(ElementType) != 0)
+		return E_INVALIDARG;
+
+	// Copy just what the view covers into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(covered.Resource.Get(), covered.MipLevel, covered.ArrayIndex, covered.Whole ? nullptr : &covered.Region, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Read it back and hand the staging resource back
+	HRESULT read = ReadStagedCopy(staged, 0, results);
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- Read functions for resources ----------------------
+//  Reads data of the specified ElementType from a 
+//  specific subresource of the given resource and 
+//  returns a new vector with the results.  Note that
+//  ID3D11Buffers do not have explicit subresources and
+//  will always read the entire resource (ignoring mipLevel
+//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
+//  resources do not support arrays, so arrayIndex is ignored.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource.  Note that
+//    this must match the size of the actual elements in the
+//    resource or the function will fail.
+// 
+//  Valid resource types are: 
+//  - ID3D11Buffer
+//  - ID3D11Texture1D
+//  - ID3D11Texture2D
+//  - ID3D11Texture3D
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - A new vector with the read results.  If the read 
+//    fails, the vector will be empty.
+// -------------------------------------------------------
+template<typename ElementType>
+std::vector<ElementType> EZReadback::Read(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex)
+{
+	std::vector<ElementType> data;
+	Read(resource, data, mipLevel, arrayIndex);
+	return data;
+}
+
+
+// --- Read functions for views ---------------------------
+//  Reads data of the specified ElementType from a 
+//  specific subresource of the given view and returns a
+//  new vector with the results.  Only what the view 
+//  covers is copied: mipLevel and arrayIndex count from
+//  the view's most detailed mip and first array slice, 
+//  buffer views read just their window of elements, and
+//  3D UAVs just their depth slices.  See ResolveView().
+// 
+//  ElementType:
+//  - Expected data type to read from the view.  Note that
+//    this must match the size of the view's elements (not
+//    the resource's, which may be typeless) or the 
+//    function will fail.
+// 
+//  Valid view types are: 
+//  - ID3D11ShaderResourceView
+//  - ID3D11UnorderedAccessView
+// 
+//  Parameters:
+//  - view: view of the GPU resource to read
+//  - mipLevel: mip level to read, within the view
+//  - arrayIndex: array element to read, within the view
+// 
+// 	Returns:
+//  - A new vector with the read results.  If the read 
+//    fails, such as for a subresource outside the view,
+//    the vector will be empty.
+// --------------------------------------------------------
+template<typename ElementType>
+std::vector<ElementType> EZReadback::Read(ID3D11View* view, UINT mipLevel, UINT arrayIndex)
+{
+	std::vector<ElementType> data;
+	Read(view, data, mipLevel, arrayIndex);
+	return data;
+}
+
+
+// --- Read function for typed resources ------------------
+//  Reads a specific subresource of a typed resource into
+//  the given vector.  The element type and format were 
+//  checked when the resource was bound, and the resource
+//  type is known at compile time, so this reuses the 
+//  description captured by Bind() instead of calling 
+//  GetDesc() and checking the element size again.
+// 
+//  Parameters:
+//  - resource: typed resource to read, such as an 
+//    EZTypedTexture2D<EZColor4>
+//  - results: filled with the elements read
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG if nothing is bound
+// --------------------------------------------------------
+template<typename ResourceType, typename DescriptionType, typename ElementType>
+HRESULT EZReadback::Read(const EZTypedResource<ResourceType, DescriptionType, ElementType>& resource, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+{
+	if (!resource)
+		return E_INVALIDARG;
+
+	return StageAndCopyResource<ResourceType, DescriptionType, ElementType>(resource.Get(), mipLevel, arrayIndex, results, &resource.GetDesc());
+}
+
+
+
+// --- ReadAsFloat4 ---------------------------------------
+//  Reads a specific subresource of the given texture and
+//  decodes it based on the texture's format, filling the
+//  given vector with one float4 per texel.  The caller 
+//  does not need to know how the format is laid out; see
+//  EZDecodeToFloat4() for how each format is decoded.
+// 
+//  Texels are decoded straight out of the mapped data, so
+//  there is no intermediate copy of the raw texels.  Block
+//  compressed textures are decompressed with 
+//  EZDecodeBCToFloat4(), using every hardware thread.
+// 
+//  Parameters:
+//  - resource: GPU texture to read
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format cannot be decoded (which 
+//    includes all buffers, as they have no format)
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadAsFloat4(ID3D11Resource* resource, std::vector<DirectX::XMFLOAT4>& results, UINT mipLevel, UINT arrayIndex)
+{
+	DXGI_FORMAT format = GetFormat(resource);
+	if (EZIsBlockCompressed(format))
+	{
+		return ReadBlockCompressed(resource, format, mipLevel, arrayIndex, results,
+			[](DXGI_FORMAT format, const void* blocks, size_t rowPitch, UINT width, UINT height, DirectX::XMFLOAT4* output) {
+				return EZDecodeBCToFloat4(format, blocks, rowPitch, width, height, output); });
+	}
+
+	return ReadDecoded(resource, format, mipLevel, arrayIndex, nullptr, results, EZDecodeToFloat4);
+}
+
+
+// --- ReadAsUInt4 ----------------------------------------
+//  Reads a specific subresource of the given texture and
+//  decodes it based on the texture's format, filling the
+//  given vector with one uint4 per texel.  Only integer 
+//  formats are supported; see EZDecodeToUInt4().
+// 
+//  Parameters:
+//  - resource: GPU texture to read
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not an integer format
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadAsUInt4(ID3D11Resource* resource, std::vector<DirectX::XMUINT4>& results, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadDecoded(resource, GetFormat(resource), mipLevel, arrayIndex, nullptr, results, EZDecodeToUInt4);
+}
+
+
+// --- ReadAsFloat4 / ReadAsUInt4 for views ---------------
+//  Same as the overloads above, but read only what the
+//  given SRV or UAV covers and decode it with the view's
+//  format, so typeless textures and typed buffer views 
+//  can be decoded too.  mipLevel and arrayIndex count
+//  from the view's first mip and slice; see ResolveView().
+// 
+//  Parameters:
+//  - view: shader resource or unordered access view
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read, within the view
+//  - arrayIndex: array element to read, within the view
+// 
+// 	Returns:
+//  - E_INVALIDARG if the view's format cannot be decoded
+//    or the subresource is outside the view
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadAsFloat4(ID3D11View* view, std::vector<DirectX::XMFLOAT4>& results, UINT mipLevel, UINT arrayIndex)
+{
+	ViewSubresource covered;
+	HRESULT resolve = ResolveView(view, mipLevel, arrayIndex, covered);
+	if (FAILED(resolve))
+		return resolve;
+
+	if (EZIsBlockCompressed(covered.Format))
+	{
+		return ReadBlockCompressed(covered.Resource.Get(), covered.Format, covered.MipLevel, covered.ArrayIndex, results,
+			[](DXGI_FORMAT format, const void* blocks, size_t rowPitch, UINT width, UINT height, DirectX::XMFLOAT4* output) {
+				return EZDecodeBCToFloat4(format, blocks, rowPitch, width, height, output); });
+	}
+
+	return ReadDecoded(covered.Resource.Get(), covered.Format, covered.MipLevel, covered.ArrayIndex, covered.Whole ? nullptr : &covered.Region, results, EZDecodeToFloat4);
+}
+
+inline HRESULT EZReadback::ReadAsUInt4(ID3D11View* view, std::vector<DirectX::XMUINT4>& results, UINT mipLevel, UINT arrayIndex)
+{
+	ViewSubresource covered;
+	HRESULT resolve = ResolveView(view, mipLevel, arrayIndex, covered);
+	if (FAILED(resolve))
+		return resolve;
+
+	return ReadDecoded(covered.Resource.Get(), covered.Format, covered.MipLevel, covered.ArrayIndex, covered.Whole ? nullptr : &covered.Region, results, EZDecodeToUInt4);
+}
+
+
+// --- ReadDecompressed -----------------------------------
+//  Reads a specific subresource of the given BC1, BC2, 
+//  BC3, BC4, BC5 or BC7 texture and decompresses it into
+//  RGBA8 colors, one per texel; see EZDecodeBC().  The
+//  blocks are decoded straight out of the mapped data,
+//  split across threads by rows of blocks.
+// 
+//  To get the raw blocks instead, use Read() with EZBlock8
+//  (BC1, BC4) or EZBlock16 (all others) as the element type.
+//  BC6H and signed BC4/BC5 can be read with ReadAsFloat4().
+// 
+//  Parameters:
+//  - resource: GPU texture to read (2D or 3D)
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read (for 2D textures)
+//  - threadCount: threads to decode with, or zero to use
+//    every hardware thread
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format cannot be decompressed to
+//    RGBA8 or the resource is not a texture
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadDecompressed(ID3D11Resource* resource, std::vector<EZColor4>& results, UINT mipLevel, UINT arrayIndex, UINT threadCount)
+{
+	return ReadBlockCompressed(resource, GetFormat(resource), mipLevel, arrayIndex, results,
+		[threadCount](DXGI_FORMAT format, const void* blocks, size_t rowPitch, UINT width, UINT height, EZColor4* output) {
+			return EZDecodeBC(format, blocks, rowPitch, width, height, output, threadCount); });
+}
+
+
+// --- ReadDepth / ReadStencil / ReadDepthStencil ---------
+//  Read a subresource of a depth/stencil texture and split
+//  it into a plane of float depth values and/or a plane of
+//  8-bit stencil values, decoding each row straight out of
+//  mapped memory with EZDecodeDepthStencil().  Use
+//  ReadDepthStencil() when both are needed, so the texture
+//  is only copied and mapped once.
+// 
+//  Valid formats are D16, D24S8 and D32 with or without
+//  stencil, including the typeless and SRV formats of
+//  D24S8 and D32S8.  ReadStencil() needs a format with
+//  stencil.
+// 
+//  Parameters:
+//  - resource: the depth/stencil texture to read
+//  - depth: filled with depth, 0-1 or linearized
+//  - stencil: filled with stencil values
+//  - options: linearizing settings
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not a depth/stencil 
+//    format, or stencil was asked for and it has none
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadDepth(ID3D11Resource* resource, std::vector<float>& depth, const EZDepthOptions& options, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadDepthPlanes(resource, &depth, nullptr, options, mipLevel, arrayIndex);
+}
+
+inline HRESULT EZReadback::ReadStencil(ID3D11Resource* resource, std::vector<unsigned char>& stencil, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadDepthPlanes(resource, nullptr, &stencil, EZDepthOptions(), mipLevel, arrayIndex);
+}
+
+inline HRESULT EZReadback::ReadDepthStencil(ID3D11Resource* resource, std::vector<float>& depth, std::vector<unsigned char>& stencil, const EZDepthOptions& options, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadDepthPlanes(resource, &depth, &stencil, options, mipLevel, arrayIndex);
+}
+
+
+// --- ReadDepthPlanes ------------------------------------
+//  Private helper that does the work of ReadDepth(),
+//  ReadStencil() and ReadDepthStencil(); null planes are
+//  skipped
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadDepthPlanes(ID3D11Resource* resource, std::vector<float>* depth, std::vector<unsigned char>* stencil, const EZDepthOptions& options, UINT mipLevel, UINT arrayIndex)
+{
+	DXGI_FORMAT format = GetFormat(resource);
+	EZDepthLayout layout = EZGetDepthLayout(format);
+	if (layout == EZDepthLayoutNone || (stencil && !EZHasStencil(layout)))
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, BitsPerPixel(format) / 8, staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Split one row at a time
+	if (depth)
+		depth->resize(staged.ElementCount);
+	if (stencil)
+		stencil->resize(staged.ElementCount);
+	size_t rowElements = staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount);
+	HRESULT read = ReadStagedRows(staged, 0, [&](const void* row, size_t rowIndex)
+	{
+		EZDecodeDepthStencil(layout, row, rowElements,
+			depth ? depth->data() + rowIndex * rowElements : nullptr,
+			stencil ? stencil->data() + rowIndex * rowElements : nullptr, options);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- ReadPlanes -----------------------------------------
+//  Reads an NV12, P010 or P016 texture and splits it into
+//  its luma plane and its interleaved U/V chroma plane,
+//  each tightly packed.  Use unsigned char samples for 
+//  NV12 and unsigned short samples for P010/P016.  A plain
+//  Read() of these formats returns the same two planes 
+//  one after the other.
+// 
+//  Parameters:
+//  - resource: the video texture to read
+//  - luma: filled with the Y samples
+//  - chroma: filled with the U/V sample pairs
+//  - lumaLayout: filled with the size of the luma plane
+//  - chromaLayout: filled with the size of the chroma plane
+//  - arrayIndex: array element to read
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not NV12, P010 or P016,
+//    its width is odd, or SampleType is the wrong size
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename SampleType>
+HRESULT EZReadback::ReadPlanes(ID3D11Resource* resource, std::vector<SampleType>& luma, std::vector<SampleType>& chroma,
+	EZPlaneLayout& lumaLayout, EZPlaneLayout& chromaLayout, UINT arrayIndex)
+{
+	UINT width, height, depth;
+	CalcMipSize(resource, 0, width, height, depth);
+	if (!EZGetPlaneLayouts(GetFormat(resource), width, height, lumaLayout, chromaLayout) || sizeof(SampleType) != lumaLayout.SampleSize)
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, 0, arrayIndex, nullptr, sizeof(SampleType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// The chroma rows follow the luma rows
+	luma.resize((size_t)lumaLayout.Width * lumaLayout.Height);
+	chroma.resize((size_t)chromaLayout.Width * 2 * chromaLayout.Height);
+	HRESULT read = ReadStagedRows(staged, 0, [&](const void* row, size_t rowIndex)
+	{
+		if (rowIndex < lumaLayout.Height)
+			memcpy(luma.data() + rowIndex * lumaLayout.Width, row, lumaLayout.RowBytes);
+		else
+			memcpy(chroma.data() + (rowIndex - lumaLayout.Height) * chromaLayout.Width * 2, row, chromaLayout.RowBytes);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- ReadYUVAsRGBA8 / ReadYUVAsFloat4 -------------------
+//  Read an NV12, P010 or P016 texture and convert it to
+//  RGBA with EZConvertYUV(), straight out of mapped memory
+//  so the planes are never copied on their own.
+// 
+//  Parameters:
+//  - resource: the video texture to read
+//  - results: filled with width * height texels
+//  - options: color matrix, range and threading
+//  - arrayIndex: array element to read
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format is not NV12, P010 or P016,
+//    or its width is odd
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadYUVAsRGBA8(ID3D11Resource* resource, std::vector<EZColor4>& results, const EZYUVOptions& options, UINT arrayIndex)
+{
+	return ReadYUV(resource, results, options, arrayIndex);
+}
+
+inline HRESULT EZReadback::ReadYUVAsFloat4(ID3D11Resource* resource, std::vector<DirectX::XMFLOAT4>& results, const EZYUVOptions& options, UINT arrayIndex)
+{
+	return ReadYUV(resource, results, options, arrayIndex);
+}
+
+
+// --- ReadYUV --------------------------------------------
+//  Private helper that does the work of ReadYUVAsRGBA8()
+//  and ReadYUVAsFloat4()
+// --------------------------------------------------------
+template<typename OutputType>
+HRESULT EZReadback::ReadYUV(ID3D11Resource* resource, std::vector<OutputType>& results, const EZYUVOptions& options, UINT arrayIndex)
+{
+	DXGI_FORMAT format = GetFormat(resource);
+	UINT width, height, depth;
+	CalcMipSize(resource, 0, width, height, depth);
+	EZPlaneLayout luma, chroma;
+	if (!EZGetPlaneLayouts(format, width, height, luma, chroma))
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, 0, arrayIndex, nullptr, luma.SampleSize, staged);
+	if (FAILED(copy))
+		return copy;
+
+	results.resize((size_t)width * height);
+	HRESULT convert = S_OK;
+	HRESULT read = ReadStagedMapped(staged, 0, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		const unsigned char* planes = static_cast<const unsigned char*>(gpu.pData);
+		convert = EZConvertYUV(format, planes, gpu.RowPitch, planes + (size_t)gpu.RowPitch * luma.Height, gpu.RowPitch, width, height, results.data(), options);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return FAILED(read) ? read : convert;
+}
+
+
+// --- ReadReduced ----------------------------------------
+//  Reads data of the specified ElementType from a specific
+//  subresource of the given resource, gathering statistics
+//  about it on the way.  Each piece of the mapped data is
+//  reduced right after it is copied into the results, so
+//  the data only goes through the cache once; see 
+//  EZCopyAndReduce() and EZReduction for the details.
+// 
+//  Texels are decoded with the resource's format for the
+//  statistics, or options.Format if it is set, which is 
+//  needed for buffers and typeless textures.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - results: vector to fill with data
+//  - reduction: filled with the statistics
+//  - options: histogram, threading and format settings
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG if the format cannot be decoded, does not
+//    match the ElementType or the histogram range is empty
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadReduced(ID3D11Resource* resource, std::vector<ElementType>& results, EZReduction& reduction, const EZReductionOptions& options, UINT mipLevel, UINT arrayIndex)
+{
+	// Make sure the texels can be decoded
+	DXGI_FORMAT format = options.Format != DXGI_FORMAT_UNKNOWN ? options.Format : GetFormat(resource);
+	if (BitsPerPixel(format) != sizeof(ElementType) * 8 || !EZIsReductionValid(format, options))
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Copy and reduce in one pass
+	results.resize(staged.ElementCount);
+	size_t rowElements = staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount);
+	HRESULT read = ReadStagedMapped(staged, 0, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		EZCopyAndReduce(format, results.data(), gpu.pData, gpu.RowPitch, gpu.DepthPitch, rowElements, staged.RowCount, staged.SliceCount, reduction, options);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- ReadDirtyTiles -------------------------------------
+//  Reads a subresource of a 2D texture like Read() and
+//  also runs it through a tile tracker, so the caller
+//  learns which tiles changed since the last frame read
+//  with the same tracker.  Tiles are hashed straight from
+//  mapped memory, and only the ones that changed are 
+//  copied out, each right after it is hashed.
+// 
+//  results holds the whole subresource: pass the same 
+//  vector every frame, since the tiles that did not change
+//  are left as the last frame read into it.  A vector of
+//  the wrong size is resized and filled completely, and 
+//  the tracker starts over.  A changed tile can be pulled
+//  out of results with EZCopyPitched(), using the 
+//  subresource's row size as the source pitch.  
+//  Rectangles are in blocks for block compressed formats.
+// 
+//  Parameters:
+//  - resource: the texture to read
+//  - results: vector to fill with data
+//  - tracker: the tracker that follows this texture
+//  - dirtyTiles: filled with the tiles that changed
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read
+// 
+// 	Returns:
+//  - E_INVALIDARG if the resource is not a 2D texture or
+//    the ElementType does not match its format
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadDirtyTiles(ID3D11Resource* resource, std::vector<ElementType>& results, EZTileTracker& tracker, std::vector<EZDirtyTile>& dirtyTiles, UINT mipLevel, UINT arrayIndex)
+{
+	dirtyTiles.clear();
+
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	if (type != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// results only has the last frame if it is the right size
+	if (results.size() != staged.ElementCount)
+	{
+		results.resize(staged.ElementCount);
+		tracker.Reset();
+	}
+
+	// Hash the tiles in mapped memory, copying out the ones
+	// that changed
+	size_t rowElements = staged.ElementCount / staged.RowCount;
+	HRESULT update = S_OK;
+	HRESULT read = ReadStagedMapped(staged, 0, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		update = tracker.Update(gpu.pData, (UINT)rowElements, staged.RowCount, gpu.RowPitch, sizeof(ElementType), dirtyTiles, results.data(), rowElements * sizeof(ElementType));
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return FAILED(read) ? read : update;
+}
+
+
+// --- ReadToDDS ------------------------------------------
+//  Streams a single subresource of a texture into a DDS
+//  file, with a DX10 header giving the texture's format.
+//  Rows go straight from mapped memory to the writer's 
+//  buffers without their padding.  If the writer's queue
+//  has no room for the whole subresource, this waits for
+//  the disk before mapping rather than while mapped.
+// 
+//  The writer should have just been opened.  The file is
+//  complete once the writer is closed.
+// 
+//  Parameters:
+//  - resource: the texture to read
+//  - writer: an open writer for the DDS file
+//  - mipLevel: mip level to read
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG for buffers, formats with no fixed size 
+//    per texel (such as planar video formats), or a writer
+//    that is not open
+//  - E_FAIL if an earlier write to the file failed
+//  - An HRESULT from any failed D3D calls, or S_OK
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadToDDS(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadToWriter(resource, writer, mipLevel, arrayIndex, true);
+}
+
+
+// --- ReadToRaw ------------------------------------------
+//  Appends a single subresource of any resource to a raw
+//  capture file as one chunk: an EZCaptureChunkHeader and
+//  the tightly packed data.  Meant for capturing every
+//  frame into one file; see ReadToDDS() for how the data
+//  is streamed.
+// 
+// 	Returns:
+//  - E_INVALIDARG for formats with no fixed size per texel
+//    (such as planar video formats) or a writer that is
+//    not open
+//  - E_FAIL if an earlier write to the file failed
+//  - An HRESULT from any failed D3D calls, or S_OK
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadToRaw(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel, UINT arrayIndex)
+{
+	return ReadToWriter(resource, writer, mipLevel, arrayIndex, false);
+}
+
+
+// --- ReadToWriter ---------------------------------------
+//  Private helper that does the work of ReadToDDS() and
+//  ReadToRaw(): copies into a staging resource, writes the
+//  header and then each mapped row
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadToWriter(ID3D11Resource* resource, EZCaptureWriter& writer, UINT mipLevel, UINT arrayIndex, bool dds)
+{
+	if (!writer.IsOpen())
+		return E_INVALIDARG;
+
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	if (dds && type == D3D11_RESOURCE_DIMENSION_BUFFER)
+		return E_INVALIDARG;
+
+	// Read whole texels or blocks, or bytes of buffers
+	DXGI_FORMAT format = GetFormat(resource);
+	size_t bits = BitsPerPixel(format);
+	size_t elementSize = EZIsBlockCompressed(format) ? EZBytesPerBlock(format) : bits / 8;
+	if (type == D3D11_RESOURCE_DIMENSION_BUFFER)
+		elementSize = 1;
+	else if (elementSize == 0 || EZIsPlanar(format) || (!EZIsBlockCompressed(format) && bits % 8 != 0))
+		return E_INVALIDARG;
+
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, elementSize, staged);
+	if (FAILED(copy))
+		return copy;
+
+	UINT width, height, depth;
+	CalcMipSize(resource, mipLevel, width, height, depth);
+	size_t rowBytes = staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount) * elementSize;
+
+	// Wait for the disk now rather than while mapped
+	HRESULT write = writer.Reserve(sizeof(EZDDSHeader) + sizeof(EZCaptureChunkHeader) + rowBytes * staged.RowCount * staged.SliceCount);
+	if (FAILED(write))
+	{
+		stagingPool.Release(staged.Staging.Get());
+		return write;
+	}
+
+	if (dds)
+	{
+		EZDDSHeader header = {};
+		header.Magic = EZDDSMagic;
+		header.Size = 124;
+		header.Flags = 0x1 | 0x2 | 0x4 | 0x1000; // Caps, height, width, pixel format
+		header.Flags |= EZIsBlockCompressed(format) ? 0x80000 : 0x8; // Linear size or pitch
+		header.Height = height;
+		header.Width = width;
+		header.PitchOrLinearSize = (UINT)(EZIsBlockCompressed(format) ? rowBytes * staged.RowCount : rowBytes);
+		header.MipMapCount = 1;
+		header.PixelFormatSize = 32;
+		header.PixelFormatFlags = 0x4; // FourCC
+		header.FourCC = EZDDSFourCCDX10;
+		header.Caps = 0x1000; // Texture
+		if (type == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+		{
+			header.Flags |= 0x800000; // Depth
+			header.Depth = depth;
+			header.Caps |= 0x8;       // Complex
+			header.Caps2 = 0x200000;  // Volume
+		}
+		header.DXGIFormat = format;
+		header.ResourceDimension = type;
+		header.ArraySize = 1;
+		write = writer.Write(&header, sizeof(header));
+	}
+	else
+	{
+		EZCaptureChunkHeader header = {};
+		header.Magic = EZCaptureChunkMagic;
+		header.HeaderSize = sizeof(header);
+		header.Format = format;
+		header.Dimension = type;
+		header.Width = width;
+		header.Height = height;
+		header.Depth = depth;
+		header.MipLevel = mipLevel;
+		header.ArrayIndex = arrayIndex;
+		header.RowBytes = (UINT)rowBytes;
+		header.RowCount = staged.RowCount;
+		header.SliceCount = staged.SliceCount;
+		header.PayloadBytes = (UINT64)rowBytes * staged.RowCount * staged.SliceCount;
+		write = writer.Write(&header, sizeof(header));
+	}
+
+	// Stream the rows, stopping at the first failed write
+	HRESULT read = S_OK;
+	if (SUCCEEDED(write))
+	{
+		read = ReadStagedRows(staged, 0, [&](const void* row, size_t /*rowIndex*/)
+		{
+			if (SUCCEEDED(write))
+				write = writer.Write(row, rowBytes);
+		});
+	}
+
+	stagingPool.Release(staged.Staging.Get());
+	return FAILED(read) ? read : write;
+}
+
+
+// --- ReadInto -------------------------------------------
+//  Reads data of the specified ElementType from a specific
+//  subresource of the given resource into a buffer owned by
+//  the caller, with no vector in between.  Otherwise works
+//  exactly like Read().
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - buffer: memory to fill with data
+//  - bufferCount: number of elements that fit in buffer
+//  - elementCount: set to the number of elements read, or
+//    the number needed if the buffer is too small
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_NOT_SUFFICIENT_BUFFER if the buffer is too small
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadInto(ID3D11Resource* resource, ElementType* buffer, size_t bufferCount, size_t& elementCount, UINT mipLevel, UINT arrayIndex)
+{
+	// Only a buffer found too small before the data is read
+	// turns into E_NOT_SUFFICIENT_BUFFER; real allocation 
+	// failures pass through as they are
+	elementCount = 0;
+	bool tooSmall = false;
+	HRESULT read = ReadInto<ElementType>(resource, [&](size_t count) -> ElementType*
+	{
+		elementCount = count;
+		tooSmall = count > bufferCount;
+		return tooSmall ? nullptr : buffer;
+	}, mipLevel, arrayIndex);
+
+	return tooSmall ? E_NOT_SUFFICIENT_BUFFER : read;
+}
+
+
+// --- ReadInto -------------------------------------------
+//  Reads data of the specified ElementType from a specific
+//  subresource of the given resource into memory handed 
+//  out by the caller's allocate function, which is called
+//  once with the number of elements needed.  Lets results
+//  go straight into pooled or mapped memory elsewhere.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - allocate: returns memory for the given number of
+//    elements, or null to cancel the read
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_OUTOFMEMORY if allocate returns null
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadInto(ID3D11Resource* resource, std::function<ElementType*(size_t)> allocate, UINT mipLevel, UINT arrayIndex)
+{
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	ElementType* destination = allocate(staged.ElementCount);
+	HRESULT read = destination ? ReadStagedCopy(staged, 0, sizeof(ElementType), destination) : E_OUTOFMEMORY;
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- ReadMapped -----------------------------------------
+//  Reads a specific subresource of the given resource and
+//  leaves it mapped in the given view instead of copying
+//  it out, which saves a full copy and allocation when the
+//  data only needs to be looked at once.  Anything the 
+//  view already held is unmapped first.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource.  Note that
+//    this must match the size of the actual elements in the
+//    resource or the function will fail.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - view: view to hold the mapped data
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - An HRESULT from any failed D3D calls or S_OK if all
+//    D3D calls were successful.  The view is only mapped
+//    on success.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadMapped(ID3D11Resource* resource, MappedView<ElementType>& view, UINT mipLevel, UINT arrayIndex)
+{
+	view.Unmap();
+
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	D3D11_MAPPED_SUBRESOURCE gpu = {};
+	HRESULT map = MapStaged(backend.get(), profiler.get(), staged, 0, gpu);
+	if (FAILED(map))
+	{
+		stagingPool.Release(staged.Staging.Get());
+		return map;
+	}
+
+	view.owner = this;
+	view.copy = staged;
+	view.mapped = gpu;
+	view.width = (UINT)(staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount));
+	return S_OK;
+}
+
+
+// --- MappedView::operator= ------------------------------
+//  Takes over another view's mapping, unmapping anything
+//  this view held
+// --------------------------------------------------------
+template<typename ElementType>
+inline EZReadback::MappedView<ElementType>& EZReadback::MappedView<ElementType>::operator=(MappedView&& other)
+{
+	if (this != &other)
+	{
+		Unmap();
+		owner = other.owner;
+		copy = other.copy;
+		mapped = other.mapped;
+		width = other.width;
+		other.owner = nullptr;
+		other.copy = StagedCopy();
+		other.mapped = D3D11_MAPPED_SUBRESOURCE();
+		other.width = 0;
+	}
+	return *this;
+}
+
+
+// --- MappedView::Unmap ----------------------------------
+//  Unmaps the data and hands the staging resource back to
+//  the pool.  Does nothing if the view is not mapped.
+// --------------------------------------------------------
+template<typename ElementType>
+inline void EZReadback::MappedView<ElementType>::Unmap()
+{
+	if (!owner)
+		return;
+
+	owner->backend->Unmap(copy.Staging.Get(), copy.Subresource);
+	owner->stagingPool.Release(copy.Staging.Get());
+	owner = nullptr;
+	copy = StagedCopy();
+	mapped = D3D11_MAPPED_SUBRESOURCE();
+	width = 0;
+}
+
+
+// --- ReadRegion -----------------------------------------
+//  Reads data of the specified ElementType from a box 
+//  within a specific subresource of the given resource 
+//  and populates the given vector with results.  Only the
+//  bytes inside the box are copied off the GPU, which
+//  makes this ideal for reading a tile or a single pixel.
+// 
+//  The box is in elements (texels) of the chosen mip, or
+//  in bytes for ID3D11Buffers.  Unused dimensions must 
+//  still span one unit (e.g. top = 0, bottom = 1 for a 1D
+//  texture).  Results are ordered row by row, then slice
+//  by slice.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource.  Note that
+//    this must match the size of the actual elements in the
+//    resource or the function will fail.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - region: box to read, relative to the chosen mip
+//  - results: vector to fill with data
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - E_INVALIDARG if the box is empty or out of bounds
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadRegion(ID3D11Resource* resource, const D3D11_BOX& region, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
+{
+	// Copy just the region into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, &region, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Read it back and hand the staging resource back
+	HRESULT read = ReadStagedCopy(staged, 0, results);
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- ReadRegion -----------------------------------------
+//  Reads data of the specified ElementType from a box 
+//  within a specific subresource of the given resource 
+//  and returns a new vector with the results.  See the
+//  overload above for details on the box.
+// 
+// 	Returns:
+//  - A new vector with the read results.  If the read 
+//    fails, the vector will be empty.
+// --------------------------------------------------------
+template<typename ElementType>
+std::vector<ElementType> EZReadback::ReadRegion(ID3D11Resource* resource, const D3D11_BOX& region, UINT mipLevel, UINT arrayIndex)
+{
+	std::vector<ElementType> data;
+	ReadRegion(resource, region, data, mipLevel, arrayIndex);
+	return data;
+}
+
+
+// --- ReadBufferRange ------------------------------------
+//  Reads elementCount elements of the specified ElementType
+//  from a buffer, starting byteOffset bytes in.  Only that
+//  range is copied off the GPU, into a staging buffer of 
+//  just the right size, so reading a slice of a huge 
+//  buffer costs no more than the slice.
+// 
+//  Parameters:
+//  - buffer: GPU buffer to read
+//  - byteOffset: where the range starts, in bytes
+//  - elementCount: number of elements to read
+//  - results: vector to fill with the elements
+// 
+// 	Returns:
+//  - E_INVALIDARG if the range is empty or runs past the
+//    end of the buffer
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadBufferRange(ID3D11Buffer* buffer, UINT byteOffset, UINT elementCount, std::vector<ElementType>& results)
+{
+	D3D11_BOX region;
+	if (!CalcBufferRange(byteOffset, elementCount, sizeof(ElementType), region))
+		return E_INVALIDARG;
+	return ReadRegion(buffer, region, results);
+}
+
+
+// --- ReadBufferFields -----------------------------------
+//  Reads a range of a buffer of ElementType structs, as for
+//  ReadBufferRange(), and pulls the given fields out of 
+//  the structs into separate arrays with EZProjectFields(),
+//  straight from the mapped memory.  For example:
+// 
+//    std::vector<float> mass(count);
+//    std::vector<DirectX::XMFLOAT3> velocity(count);
+//    EZBufferField fields[] = {
+//      { offsetof(Particle, Mass), sizeof(float), mass.data() },
+//      { offsetof(Particle, Velocity), sizeof(DirectX::XMFLOAT3), velocity.data() } };
+//    readback.ReadBufferFields<Particle>(particles, 0, count, fields, 2);
+// 
+//  Parameters:
+//  - buffer: GPU buffer to read
+//  - byteOffset: where the range starts, in bytes
+//  - elementCount: number of structs to read
+//  - fields: the fields to pull out, each with room for 
+//    elementCount values
+//  - fieldCount: number of fields
+//  - threadCount: threads to use, or zero for every 
+//    hardware thread
+// 
+// 	Returns:
+//  - E_INVALIDARG if the range is empty or runs past the
+//    end of the buffer, or a field is outside ElementType
+//    or has no destination
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadBufferFields(ID3D11Buffer* buffer, UINT byteOffset, UINT elementCount, const EZBufferField* fields, size_t fieldCount, UINT threadCount)
+{
+	for (size_t f = 0; f < fieldCount; f++)
+	{
+		if (!fields[f].Destination || fields[f].Size == 0 || fields[f].Offset + fields[f].Size > sizeof(ElementType))
+			return E_INVALIDARG;
+	}
+
+	D3D11_BOX region;
+	if (!CalcBufferRange(byteOffset, elementCount, sizeof(ElementType), region))
+		return E_INVALIDARG;
+
+	// Copy just the range into a staging buffer
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(buffer, 0, 0, &region, sizeof(ElementType), staged);
+	if (FAILED(copy))
+		return copy;
+
+	HRESULT read = ReadStagedMapped(staged, 0, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		EZProjectFields(gpu.pData, sizeof(ElementType), elementCount, fields, fieldCount, threadCount);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- CalcBufferRange ------------------------------------
+//  Private helper that turns a range of buffer elements
+//  into a box in bytes.  Returns false if the range is
+//  empty or does not fit in a UINT; the copy checks it
+//  against the size of the buffer.
+// --------------------------------------------------------
+inline bool EZReadback::CalcBufferRange(UINT byteOffset, UINT elementCount, size_t elementSize, D3D11_BOX& region)
+{
+	unsigned long long end = byteOffset + (unsigned long long)elementCount * elementSize;
+	if (elementCount == 0 || end > (std::numeric_limits<UINT>::max)())
+		return false;
+
+	region = { byteOffset, 0, 0, (UINT)end, 1, 1 };
+	return true;
+}
+
+
+// --- ResolveView ----------------------------------------
+//  Private helper that works out which part of its 
+//  resource a view covers.  mipLevel and arrayIndex are
+//  relative to the view's first mip and slice and must 
+//  lie inside it; 3D textures ignore arrayIndex.  Buffer
+//  views cover FirstElement to FirstElement + NumElements,
+//  in elements of the view's format or, for structured
+//  buffers, of the structure stride.  3D UAVs cover their
+//  W slices.  The resource is held in a ComPtr, so the
+//  reference GetResource() adds is always released.
+// 
+// 	Returns:
+//  - E_INVALIDARG for views that are not SRVs or UAVs, 
+//    unknown dimensions and subresources or windows 
+//    outside the view or resource
+// --------------------------------------------------------
+inline HRESULT EZReadback::ResolveView(ID3D11View* view, UINT mipLevel, UINT arrayIndex, ViewSubresource& resolved)
+{
+	if (!view)
+		return E_INVALIDARG;
+
+	view->GetResource(resolved.Resource.ReleaseAndGetAddressOf());
+	if (!resolved.Resource)
+		return E_INVALIDARG;
+
+	// Ranges the view covers; MipLevels and WSize of -1 run
+	// to the end of the resource
+	bool buffer = false;
+	bool volume = false;
+	UINT firstMip = 0, mipCount = 1;
+	UINT firstSlice = 0, sliceCount = 1;
+	UINT firstElement = 0, elementCount = 0;
+	UINT firstW = 0, sizeW = (UINT)-1;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav;
+	if (SUCCEEDED(view->QueryInterface(srv.GetAddressOf())))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC desc;
+		srv->GetDesc(&desc);
+		resolved.Format = desc.Format;
+		switch (desc.ViewDimension)
+		{
+		case D3D11_SRV_DIMENSION_BUFFER: buffer = true; firstElement = desc.Buffer.FirstElement; elementCount = desc.Buffer.NumElements; break;
+		case D3D11_SRV_DIMENSION_BUFFEREX: buffer = true; firstElement = desc.BufferEx.FirstElement; elementCount = desc.BufferEx.NumElements; break;
+		case D3D11_SRV_DIMENSION_TEXTURE1D: firstMip = desc.Texture1D.MostDetailedMip; mipCount = desc.Texture1D.MipLevels; break;
+		case D3D11_SRV_DIMENSION_TEXTURE1DARRAY: firstMip = desc.Texture1DArray.MostDetailedMip; mipCount = desc.Texture1DArray.MipLevels; firstSlice = desc.Texture1DArray.FirstArraySlice; sliceCount = desc.Texture1DArray.ArraySize; break;
+		case D3D11_SRV_DIMENSION_TEXTURE2D: firstMip = desc.Texture2D.MostDetailedMip; mipCount = desc.Texture2D.MipLevels; break;
+		case D3D11_SRV_DIMENSION_TEXTURE2DARRAY: firstMip = desc.Texture2DArray.MostDetailedMip; mipCount = desc.Texture2DArray.MipLevels; firstSlice = desc.Texture2DArray.FirstArraySlice; sliceCount = desc.Texture2DArray.ArraySize; break;
+		case D3D11_SRV_DIMENSION_TEXTURE2DMS: break;
+		case D3D11_SRV_DIMENSION_TEXTURE2DMSARRAY: firstSlice = desc.Texture2DMSArray.FirstArraySlice; sliceCount = desc.Texture2DMSArray.ArraySize; break;
+		case D3D11_SRV_DIMENSION_TEXTURE3D: volume = true; firstMip = desc.Texture3D.MostDetailedMip; mipCount = desc.Texture3D.MipLevels; break;
+		case D3D11_SRV_DIMENSION_TEXTURECUBE: firstMip = desc.TextureCube.MostDetailedMip; mipCount = desc.TextureCube.MipLevels; sliceCount = 6; break;
+		case D3D11_SRV_DIMENSION_TEXTURECUBEARRAY: firstMip = desc.TextureCubeArray.MostDetailedMip; mipCount = desc.TextureCubeArray.MipLevels; firstSlice = desc.TextureCubeArray.First2DArrayFace; sliceCount = desc.TextureCubeArray.NumCubes * 6; break;
+		default: return E_INVALIDARG;
+		}
+	}
+	else if (SUCCEEDED(view->QueryInterface(uav.GetAddressOf())))
+	{
+		D3D11_UNORDERED_ACCESS_VIEW_DESC desc;
+		uav->GetDesc(&desc);
+		resolved.Format = desc.Format;
+		switch (desc.ViewDimension)
+		{
+		case D3D11_UAV_DIMENSION_BUFFER: buffer = true; firstElement = desc.Buffer.FirstElement; elementCount = desc.Buffer.NumElements; break;
+		case D3D11_UAV_DIMENSION_TEXTURE1D: firstMip = desc.Texture1D.MipSlice; break;
+		case D3D11_UAV_DIMENSION_TEXTURE1DARRAY: firstMip = desc.Texture1DArray.MipSlice; firstSlice = desc.Texture1DArray.FirstArraySlice; sliceCount = desc.Texture1DArray.ArraySize; break;
+		case D3D11_UAV_DIMENSION_TEXTURE2D: firstMip = desc.Texture2D.MipSlice; break;
+		case D3D11_UAV_DIMENSION_TEXTURE2DARRAY: firstMip = desc.Texture2DArray.MipSlice; firstSlice = desc.Texture2DArray.FirstArraySlice; sliceCount = desc.Texture2DArray.ArraySize; break;
+		case D3D11_UAV_DIMENSION_TEXTURE3D: volume = true; firstMip = desc.Texture3D.MipSlice; firstW = desc.Texture3D.FirstWSlice; sizeW = desc.Texture3D.WSize; break;
+		default: return E_INVALIDARG;
+		}
+	}
+	else
+	{
+		return E_INVALIDARG;
+	}
+
+	resolved.MipLevel = 0;
+	resolved.ArrayIndex = 0;
+	resolved.Whole = true;
+	resolved.Region = D3D11_BOX();
+
+	// Buffers: turn the element window into bytes
+	if (buffer)
+	{
+		D3D11_BUFFER_DESC desc;
+		static_cast<ID3D11Buffer*>(resolved.Resource.Get())->GetDesc(&desc);
+		size_t stride = resolved.Format != DXGI_FORMAT_UNKNOWN ? BitsPerPixel(resolved.Format) / 8 : desc.StructureByteStride;
+		unsigned long long offset = (unsigned long long)firstElement * stride;
+		if (stride == 0 || offset > (std::numeric_limits<UINT>::max)() || !CalcBufferRange((UINT)offset, elementCount, stride, resolved.Region) || resolved.Region.right > desc.ByteWidth)
+			return E_INVALIDARG;
+
+		resolved.Whole = resolved.Region.left == 0 && resolved.Region.right == desc.ByteWidth;
+		return S_OK;
+	}
+
+	// Textures: pick the subresource within the view
+	if (mipLevel >= mipCount || (!volume && arrayIndex >= sliceCount))
+		return E_INVALIDARG;
+
+	resolved.MipLevel = firstMip + mipLevel;
+	resolved.ArrayIndex = volume ? 0 : firstSlice + arrayIndex;
+
+	// 3D UAVs may only cover some of the depth slices
+	if (volume && (firstW != 0 || sizeW != (UINT)-1))
+	{
+		UINT width, height, depth;
+		CalcMipSize(resolved.Resource.Get(), resolved.MipLevel, width, height, depth);
+		unsigned long long back = sizeW == (UINT)-1 ? depth : (unsigned long long)firstW + sizeW;
+		if (firstW >= back || back > depth)
+			return E_INVALIDARG;
+
+		resolved.Whole = firstW == 0 && back == depth;
+		resolved.Region = { 0, 0, firstW, width, height, (UINT)back };
+	}
+
+	return S_OK;
+}
+
+
+// --- ReadAllSubresources --------------------------------
+//  Reads every mip level and array slice of the given 
+//  resource with a single copy into one staging resource,
+//  mapping each of its subresources in turn.  All of the
+//  data ends up back to back in the results vector, and
+//  layouts gets one entry per subresource saying where 
+//  its data starts and how big it is.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource.  Note that
+//    this must match the size of the actual elements in the
+//    resource or the function will fail.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - results: vector to fill with every subresource
+//  - layouts: vector to fill with one layout per 
+//    subresource, in subresource index order
+// 
+// 	Returns:
+//  - An HRESULT from any failed D3D calls or S_OK if all
+//    D3D calls were successful.  On failure both vectors
+//    are left empty.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadAllSubresources(ID3D11Resource* resource, std::vector<ElementType>& results, std::vector<EZSubresourceLayout>& layouts)
+{
+	results.clear();
+	layouts.clear();
+
+	// Copy everything at once
+	std::vector<StagedCopy> staged;
+	HRESULT copy = CopyAllToStaging(resource, sizeof(ElementType), staged, layouts);
+	if (FAILED(copy))
+	{
+		layouts.clear();
+		return copy;
+	}
+
+	// Read each subresource into its spot in the results; 
+	// only the first map has to wait on the GPU
+	results.resize(layouts.back().Offset + layouts.back().ElementCount);
+	HRESULT read = S_OK;
+	for (size_t i = 0; i < staged.size() && SUCCEEDED(read); i++)
+		read = ReadStagedCopy(staged[i], 0, sizeof(ElementType), results.data() + layouts[i].Offset);
+
+	stagingPool.Release(staged[0].Staging.Get());
+	if (FAILED(read))
+	{
+		results.clear();
+		layouts.clear();
+	}
+	return read;
+}
+
+
+// --- ReadAsync ------------------------------------------
+//  Starts reading data of the specified ElementType from a
+//  specific subresource of the given resource without
+//  waiting for the GPU.  The copy is queued right away and
+//  the results can be picked up a few frames later with
+//  TryGet() or Wait(), by which point the GPU has usually
+//  finished and no stall occurs.
+// 
+//  Reads are held in a small ring (see SetAsyncRingSize())
+//  and a slot stays in use until its results are picked
+//  up, so every ticket should eventually be passed to
+//  TryGet() or Wait().
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - A ticket for the read, or EZReadbackInvalidTicket if
+//    the ring is full or the copy could not be started.
+// --------------------------------------------------------
+template<typename ElementType>
+EZReadbackTicket EZReadback::ReadAsync(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex)
+{
+	AsyncSlot* slot = StartAsyncSlot(resource, mipLevel, arrayIndex, sizeof(ElementType));
+	return slot ? slot->Ticket : EZReadbackInvalidTicket;
+}
+
+
+// --- ReadAsync ------------------------------------------
+//  Starts an asynchronous read exactly like the overload
+//  above, but delivers the results to a callback instead.
+//  Callbacks run inside UpdateAsync() (or Wait()) on the
+//  calling thread once the GPU is done.  The results 
+//  vector is empty if the read failed.
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - callback: function receiving the HRESULT and results
+//  - mipLevel: mip level to read (for texture resources)
+//  - arrayIndex: array element to read (for 1D/2D textures)
+// 
+// 	Returns:
+//  - A ticket for the read, or EZReadbackInvalidTicket if
+//    the ring is full or the copy could not be started.
+// --------------------------------------------------------
+template<typename ElementType>
+EZReadbackTicket EZReadback::ReadAsync(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<ElementType>&)> callback, UINT mipLevel, UINT arrayIndex)
+{
+	AsyncSlot* slot = StartAsyncSlot(resource, mipLevel, arrayIndex, sizeof(ElementType));
+	if (!slot)
+		return EZReadbackInvalidTicket;
+
+	// Capture the copy by value so the callback outlives any
+	// shuffling of the ring
+	StagedCopy copy = slot->Copy;
+	slot->Resolve = [this, copy, callback](UINT mapFlags)
+	{
+		std::vector<ElementType> results;
+		HRESULT hr = ReadStagedCopy(copy, mapFlags, results);
+		if (hr != DXGI_ERROR_WAS_STILL_DRAWING)
+			callback(hr, results);
+		return hr;
+	};
+
+	return slot->Ticket;
+}
+
+
+// --- TryGet ---------------------------------------------
+//  Checks whether an asynchronous read has finished and,
+//  if so, fills the given vector with its results.  This
+//  never waits on the GPU.  Once results are returned the
+//  ticket is no longer valid.
+// 
+//  Parameters:
+//  - ticket: ticket returned by ReadAsync()
+//  - results: vector to fill with data
+// 
+// 	Returns:
+//  - S_OK if results were returned
+//  - DXGI_ERROR_WAS_STILL_DRAWING if the GPU is not done
+//  - E_INVALIDARG if the ticket is unknown, belongs to a
+//    callback read or ElementType does not match
+//  - Any other HRESULT from a failed D3D call
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::TryGet(EZReadbackTicket ticket, std::vector<ElementType>& results)
+{
+	AsyncSlot* slot = FindAsyncSlot(ticket);
+	if (!slot || slot->Resolve || slot->ElementSize != sizeof(ElementType))
+		return E_INVALIDARG;
+
+	return FinishAsyncSlot(slot, ReadStagedCopy(slot->Copy, D3D11_MAP_FLAG_DO_NOT_WAIT, results));
 }
 
 
-// --- Read functions for resources ----------------------
-//  Reads data of the specified ElementType from a 
-//  specific subresource of the given resource and 
-//  returns a new vector with the results.  Note that
-//  ID3D11Buffers do not have explicit subresources and
-//  will always read the entire resource (ignoring mipLevel
-//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
-//  resources do not support arrays, so arrayIndex is ignored.
+// --- Wait -----------------------------------------------
+//  Waits for an asynchronous read to finish and fills the
+//  given vector with its results.  This stalls just like
+//  Read() if the GPU is not done yet.
 // 
-//  ElementType:
-//  - Expected data type to read from the resource.  Note that
-//    this must match the size of the actual elements in the
-//    resource or the function will fail.
+//  Parameters:
+//  - ticket: ticket returned by ReadAsync()
+//  - results: vector to fill with data
 // 
-//  Valid resource types are: 
-//  - ID3D11Buffer
-//  - ID3D11Texture1D
-//  - ID3D11Texture2D
-//  - ID3D11Texture3D
+// 	Returns:
+//  - E_INVALIDARG if the ticket is unknown, belongs to a
+//    callback read or ElementType does not match
+//  - Otherwise an HRESULT from any failed D3D calls or 
+//    S_OK if all D3D calls were successful.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::Wait(EZReadbackTicket ticket, std::vector<ElementType>& results)
+{
+	AsyncSlot* slot = FindAsyncSlot(ticket);
+	if (!slot || slot->Resolve || slot->ElementSize != sizeof(ElementType))
+		return E_INVALIDARG;
+
+	return FinishAsyncSlot(slot, ReadStagedCopy(slot->Copy, 0, results));
+}
+
+
+// --- Wait -----------------------------------------------
+//  Waits for an asynchronous read that was started with a
+//  callback, running the callback before returning.
+// 
+// 	Returns:
+//  - E_INVALIDARG if the ticket is unknown or does not 
+//    belong to a callback read
+//  - Otherwise the HRESULT handed to the callback
+// --------------------------------------------------------
+inline HRESULT EZReadback::Wait(EZReadbackTicket ticket)
+{
+	AsyncSlot* slot = FindAsyncSlot(ticket);
+	if (!slot || !slot->Resolve)
+		return E_INVALIDARG;
+
+	return FinishAsyncSlot(slot, slot->Resolve(0));
+}
+
+
+// --- UpdateAsync ----------------------------------------
+//  Polls every in-flight read that was started with a
+//  callback and runs the callbacks of those that are done.
+//  Never waits on the GPU.  Call this once per frame.  Also
+//  returns staging resources the worker thread is done 
+//  with to the pool.
+// 
+// 	Returns:
+//  - The number of callbacks that ran
+// --------------------------------------------------------
+inline UINT EZReadback::UpdateAsync()
+{
+	ReturnWorkerStaging();
+
+	UINT completed = 0;
+	for (AsyncSlot& slot : asyncRing)
+	{
+		if (slot.Ticket == EZReadbackInvalidTicket || !slot.Resolve)
+			continue;
+
+		if (FinishAsyncSlot(&slot, slot.Resolve(D3D11_MAP_FLAG_DO_NOT_WAIT)) != DXGI_ERROR_WAS_STILL_DRAWING)
+			completed++;
+	}
+	return completed;
+}
+
+
+// --- SetAsyncRingSize -----------------------------------
+//  Sets how many asynchronous reads may be in flight at
+//  once.  A ring of 2-3 slots per resource read each frame
+//  is usually enough for results to arrive without stalls.
+// 
+// 	Returns:
+//  - E_INVALIDARG if slotCount is zero
+//  - E_FAIL if any reads are still in flight
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZReadback::SetAsyncRingSize(UINT slotCount)
+{
+	if (slotCount == 0)
+		return E_INVALIDARG;
+
+	if (GetPendingAsyncCount() > 0)
+		return E_FAIL;
+
+	asyncRing.clear();
+	asyncRing.resize(slotCount);
+	asyncNext = 0;
+	return S_OK;
+}
+
+
+// --- GetPendingAsyncCount -------------------------------
+//  Returns the number of asynchronous reads whose results
+//  have not been picked up yet
+// --------------------------------------------------------
+inline UINT EZReadback::GetPendingAsyncCount()
+{
+	UINT pending = 0;
+	for (AsyncSlot& slot : asyncRing)
+	{
+		if (slot.Ticket != EZReadbackInvalidTicket)
+			pending++;
+	}
+	return pending;
+}
+
+
+// --- EnableProfiling ------------------------------------
+//  Creates the profiler behind GetReadbackStats() and
+//  ExportChromeTrace(), so every read from here on is
+//  timed.  SetTracing(true) calls this too.  Profiling 
+//  stays on for the life of the EZReadback; a running 
+//  worker picks it up with its next read.
+// --------------------------------------------------------
+inline void EZReadback::EnableProfiling()
+{
+#if defined(EZREADBACK_INSTRUMENTATION)
+	if (profiler)
+		return;
+
+	profiler.reset(new EZReadbackProfiler());
+	if (worker)
+		worker->Profiler = profiler.get();
+#endif
+}
+
+
+// --- StartWorker ----------------------------------------
+//  Starts threaded mode, in which a worker thread does the
+//  slow part of reads started with ReadThreaded(): waiting
+//  for the GPU, mapping, copying out of the mapped memory
+//  and any conversion.  The calling (render) thread only
+//  records the copies, so it never stalls.
+// 
+//  The worker maps and unmaps through the same backend the
+//  render thread uses.  With EZD3D11Backend that is the 
+//  immediate context, so the context must be made 
+//  thread-safe with ID3D11Multithread::SetMultithreadProtected()
+//  before starting.  The worker only ever maps with 
+//  D3D11_MAP_FLAG_DO_NOT_WAIT, so it never holds the 
+//  context's lock while the GPU is busy.
+// 
+//  Parameters:
+//  - queueSize: how many threaded reads may be in flight
+//    (submitted but not yet delivered) at once
+// 
+// 	Returns:
+//  - E_INVALIDARG if queueSize is zero
+//  - E_FAIL if the worker is already running, results of 
+//    an earlier worker have not been delivered yet, or the
+//    thread could not be started
+//  - S_OK otherwise
+// --------------------------------------------------------
+inline HRESULT EZReadback::StartWorker(UINT queueSize)
+{
+	if (queueSize == 0)
+		return E_INVALIDARG;
+
+	if (IsWorkerRunning() || GetPendingThreadedCount() > 0)
+		return E_FAIL;
+
+	ReturnWorkerStaging();
+	std::unique_ptr<WorkerState> state(new WorkerState(queueSize));
+	state->Profiler = profiler.get();
+	try { state->Thread = std::thread(RunWorker, state.get(), backend); }
+	catch (...) { return E_FAIL; }
+
+	worker = std::move(state);
+	return S_OK;
+}
+
+
+// --- StopWorker -----------------------------------------
+//  Stops threaded mode after the worker finishes every 
+//  read already submitted.  Their callbacks still run in
+//  the next DeliverThreaded().  Call this from the render
+//  thread, like ReadThreaded().
+// --------------------------------------------------------
+inline void EZReadback::StopWorker()
+{
+	if (!worker)
+		return;
+
+	worker->Stop();
+	ReturnWorkerStaging();
+}
+
+
+// --- ReadThreaded ---------------------------------------
+//  Starts reading data of the specified ElementType from a
+//  specific subresource of the given resource in threaded
+//  mode (see StartWorker()).  The copy is recorded right
+//  away on the calling thread; the worker thread then 
+//  waits for it and copies out the results, which are 
+//  handed to the callback by DeliverThreaded().  The 
+//  results vector is empty if the read failed.
 // 
 //  Parameters:
 //  - resource: GPU resource to read
+//  - callback: function receiving the HRESULT and results
 //  - mipLevel: mip level to read (for texture resources)
 //  - arrayIndex: array element to read (for 1D/2D textures)
 // 
 // 	Returns:
-//  - A new vector with the read results.  If the read 
-//    fails, the vector will be empty.
-// -------------------------------------------------------
+//  - A ticket for the read, or EZReadbackInvalidTicket if
+//    the worker is not running, the queue is full or the 
+//    copy could not be started.
+// --------------------------------------------------------
 template<typename ElementType>
-std::vector<ElementType> EZReadback::Read(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex)
+EZReadbackTicket EZReadback::ReadThreaded(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<ElementType>&)> callback, UINT mipLevel, UINT arrayIndex)
 {
-	std::vector<ElementType> data;
-	Read(resource, data, mipLevel, arrayIndex);
-	return data;
+	// Shared between the worker, which fills it, and the callback
+	std::shared_ptr<std::vector<ElementType>> results = std::make_shared<std::vector<ElementType>>();
+
+	return StartWorkerJob(resource, mipLevel, arrayIndex, sizeof(ElementType),
+		[results](const StagedCopy& copy, const D3D11_MAPPED_SUBRESOURCE& gpu)
+		{
+			results->resize(copy.ElementCount);
+			CopyMapped(copy, gpu, sizeof(ElementType), results->data());
+			return S_OK;
+		},
+		[results, callback](HRESULT result)
+		{
+			if (FAILED(result))
+				results->clear();
+			callback(result, *results);
+		});
 }
 
 
-// --- Read functions for resources -----------------------
-//  Reads data of the specified ElementType from a specific
-//  subresource of the resource in the given view and 
-//  returns a new vector with the results.  Note that
-//  ID3D11Buffers do not have explicit subresources and
-//  will always read the entire resource (ignoring mipLevel
-//  and arrayIndex parameters).  Likewise, ID3D11Texture3D 
-//  resources do not support arrays, so arrayIndex is ignored.
+// --- ReadThreadedAsFloat4 -------------------------------
+//  Threaded version of ReadAsFloat4(), where the worker 
+//  thread also decodes the texels; see ReadThreaded().
+//  Block compressed formats are not supported, but their
+//  blocks can be read with ReadThreaded() and decoded with
+//  EZDecodeBCToFloat4().
 // 
-//  ElementType:
-//  - Expected data type to read from the resource.  Note that
-//    this must match the size of the actual elements in the
-//    resource or the function will fail.
+// 	Returns:
+//  - A ticket for the read, or EZReadbackInvalidTicket if
+//    the format cannot be decoded, the worker is not
+//    running, the queue is full or the copy could not be
+//    started.
+// --------------------------------------------------------
+inline EZReadbackTicket EZReadback::ReadThreadedAsFloat4(ID3D11Resource* resource, std::function<void(HRESULT, std::vector<DirectX::XMFLOAT4>&)> callback, UINT mipLevel, UINT arrayIndex)
+{
+	// Make sure the texels can be decoded
+	DXGI_FORMAT format = GetFormat(resource);
+	size_t bits = BitsPerPixel(format);
+	if (bits == 0 || bits % 8 != 0 || FAILED(EZDecodeToFloat4(format, nullptr, 0, nullptr)))
+		return EZReadbackInvalidTicket;
+
+	std::shared_ptr<std::vector<DirectX::XMFLOAT4>> results = std::make_shared<std::vector<DirectX::XMFLOAT4>>();
+
+	return StartWorkerJob(resource, mipLevel, arrayIndex, bits / 8,
+		[results, format](const StagedCopy& copy, const D3D11_MAPPED_SUBRESOURCE& gpu)
+		{
+			// Decode one row at a time
+			results->resize(copy.ElementCount);
+			size_t rowElements = copy.ElementCount / ((size_t)copy.RowCount * copy.SliceCount);
+			ForEachMappedRow(copy, gpu, [&](const void* row, size_t rowIndex)
+			{
+				EZDecodeToFloat4(format, row, rowElements, results->data() + rowIndex * rowElements);
+			});
+			return S_OK;
+		},
+		[results, callback](HRESULT result)
+		{
+			if (FAILED(result))
+				results->clear();
+			callback(result, *results);
+		});
+}
+
+
+// --- DeliverThreaded ------------------------------------
+//  Runs the callbacks of every threaded read the worker
+//  has finished, on the calling thread.  Never waits.
+//  Results arrive through a lock-free queue with a single
+//  consumer, so only one thread may call this at a time,
+//  but it does not have to be the render thread.
 // 
-//  Valid resource types are: 
-//  - ID3D11Buffer
-//  - ID3D11Texture1D
-//  - ID3D11Texture2D
-//  - ID3D11Texture3D
+// 	Returns:
+//  - The number of callbacks that ran
+// --------------------------------------------------------
+inline UINT EZReadback::DeliverThreaded()
+{
+	if (!worker)
+		return 0;
+
+	UINT delivered = 0;
+	WorkerCompletion completion;
+	while (worker->Completed.Pop(completion))
+	{
+		worker->Pending--;
+		completion.Deliver(completion.Result);
+		delivered++;
+	}
+	return delivered;
+}
+
+
+// --- CreateBatch ----------------------------------------
+//  Creates an empty batch of reads; see EZReadback::Batch
+// --------------------------------------------------------
+inline EZReadback::Batch EZReadback::CreateBatch()
+{
+	return Batch(this);
+}
+
+
+// --- Batch::Add -----------------------------------------
+//  Queues the copy for a read of the specified ElementType
+//  from a specific subresource of the given resource.  The
+//  results vector is filled in by Submit(), so it has to
+//  stay alive until then.
 // 
 //  Parameters:
 //  - resource: GPU resource to read
+//  - results: vector to fill with data during Submit()
 //  - mipLevel: mip level to read (for texture resources)
 //  - arrayIndex: array element to read (for 1D/2D textures)
 // 
 // 	Returns:
-//  - A new vector with the read results.  If the read 
-//    fails, the vector will be empty.
+//  - An HRESULT from the failed validation or D3D call, in
+//    which case nothing is added, or S_OK otherwise.
 // --------------------------------------------------------
 template<typename ElementType>
-std::vector<ElementType> EZReadback::Read(ID3D11View* view, UINT mipLevel, UINT arrayIndex)
+HRESULT EZReadback::Batch::Add(ID3D11Resource* resource, std::vector<ElementType>& results, UINT mipLevel, UINT arrayIndex)
 {
-	std::vector<ElementType> data;
-	Read(view, data, mipLevel, arrayIndex);
-	return data;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// The first read of a new batch starts new stats
+	if (entries.empty())
+		stats = EZReadbackBatchStats();
+
+	Entry entry;
+	HRESULT copy = owner->CopyToStaging(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), entry.Copy);
+	if (FAILED(copy))
+		return copy;
+
+	EZReadback* readback = owner;
+	std::vector<ElementType>* output = &results;
+	entry.ElementSize = sizeof(ElementType);
+	entry.Read = [readback, output](const StagedCopy& staged, UINT mapFlags)
+	{
+		return readback->ReadStagedCopy(staged, mapFlags, *output);
+	};
+	entries.push_back(entry);
+
+	stats.RecordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return S_OK;
+}
+
+
+// --- Batch::Submit --------------------------------------
+//  Waits for every queued copy and fills in all of the 
+//  results vectors, then empties the batch so it can be
+//  reused.  The stats describe the batch just submitted.
+// 
+// 	Returns:
+//  - The first HRESULT from any failed D3D calls or S_OK
+//    if all reads were successful.
+// --------------------------------------------------------
+inline HRESULT EZReadback::Batch::Submit()
+{
+	typedef std::chrono::steady_clock Clock;
+	typedef std::chrono::duration<double, std::milli> Milliseconds;
+	Clock::time_point start = Clock::now();
+
+	HRESULT result = S_OK;
+	if (!entries.empty())
+	{
+		// Make sure every copy is on its way to the GPU, then
+		// wait on the last one, which finishes after the rest
+		owner->backend->Flush();
+		HRESULT last = entries.back().Read(entries.back().Copy, 0);
+		Clock::time_point waited = Clock::now();
+
+		// Everything else is ready now
+		for (size_t i = 0; i + 1 < entries.size(); i++)
+		{
+			HRESULT read = entries[i].Read(entries[i].Copy, 0);
+			if (FAILED(read) && SUCCEEDED(result))
+				result = read;
+		}
+		if (FAILED(last) && SUCCEEDED(result))
+			result = last;
+
+		// The wait includes reading the last entry, which is
+		// small next to the stall itself
+		stats.WaitMilliseconds = Milliseconds(waited - start).count();
+		stats.ReadMilliseconds = Milliseconds(Clock::now() - waited).count();
+	}
+
+	stats.ReadCount = (UINT)entries.size();
+	stats.BytesRead = 0;
+	for (Entry& entry : entries)
+		stats.BytesRead += entry.ElementSize * entry.Copy.ElementCount;
+	stats.TotalMilliseconds = stats.RecordMilliseconds + stats.WaitMilliseconds + stats.ReadMilliseconds;
+
+	Clear();
+	return result;
+}
+
+
+// --- Batch::Clear ---------------------------------------
+//  Drops every queued read without reading it, handing 
+//  the staging resources back to the pool
+// --------------------------------------------------------
+inline void EZReadback::Batch::Clear()
+{
+	for (Entry& entry : entries)
+		owner->stagingPool.Release(entry.Copy.Staging.Get());
+	entries.clear();
+}
+
+
+// --- CreateScheduler ------------------------------------
+//  Creates a scheduler for reads spread over frames; see
+//  EZReadback::Scheduler
+// --------------------------------------------------------
+inline EZReadback::Scheduler EZReadback::CreateScheduler(const EZSchedulerOptions& options)
+{
+	return Scheduler(this, options);
+}
+
+
+// --- Scheduler::Add -------------------------------------
+//  Adds a read of every mip level and array slice of the
+//  given resource.  Nothing is copied until the next 
+//  Update().  The resource is kept alive until the read is
+//  delivered or cancelled.
+// 
+//  ElementType:
+//  - Expected data type to read from the resource, as for
+//    ReadAllSubresources()
+// 
+//  Parameters:
+//  - resource: GPU resource to read
+//  - callback: function receiving the HRESULT, the results
+//    and one layout per subresource.  The results are 
+//    empty if the read failed.
+//  - options: priority and deadline
+// 
+// 	Returns:
+//  - A ticket for the read, or EZReadbackInvalidTicket if
+//    ElementType does not match the resource's format
+// --------------------------------------------------------
+template<typename ElementType>
+EZReadbackTicket EZReadback::Scheduler::Add(ID3D11Resource* resource,
+	std::function<void(HRESULT, std::vector<ElementType>&, const std::vector<EZSubresourceLayout>&)> callback,
+	const EZScheduledReadOptions& options)
+{
+	DXGI_FORMAT format = owner->GetFormat(resource);
+	if (!owner->IsElementSizeValid(format, sizeof(ElementType)))
+		return EZReadbackInvalidTicket;
+
+	// Lay out the results and cut the read into pieces
+	std::shared_ptr<std::vector<EZSubresourceLayout>> layouts = std::make_shared<std::vector<EZSubresourceLayout>>();
+	std::vector<StagedCopy> shapes;
+	if (FAILED(owner->CalcSubresourceLayouts(resource, sizeof(ElementType), shapes, *layouts)) || layouts->empty())
+		return EZReadbackInvalidTicket;
+
+	Job job;
+	size_t maxPieceBytes = this->options.MaxPieceBytes ? EZMin(this->options.MaxPieceBytes, this->options.FrameBudget) : this->options.FrameBudget;
+	EZPlanReadbackPieces(format, sizeof(ElementType), *layouts, maxPieceBytes, job.Pieces);
+
+	std::shared_ptr<std::vector<ElementType>> results = std::make_shared<std::vector<ElementType>>(layouts->back().Offset + layouts->back().ElementCount);
+	job.Ticket = ++owner->lastTicket;
+	job.Resource = resource;
+	job.Priority = options.Priority;
+	job.DueFrame = options.Deadline ? stats.Frame + options.Deadline : 0;
+	job.ElementSize = sizeof(ElementType);
+	job.Results = reinterpret_cast<unsigned char*>(results->data());
+	job.NextPiece = 0;
+	job.PiecesDone = 0;
+	job.InFlight = 0;
+	job.Result = S_OK;
+	job.Deliver = [results, layouts, callback](HRESULT result)
+	{
+		if (FAILED(result))
+			results->clear();
+		callback(result, *results, *layouts);
+	};
+	jobs.push_back(std::move(job));
+	return jobs.back().Ticket;
+}
+
+
+// --- Scheduler::Update ----------------------------------
+//  Runs one frame of the schedule: reads back every copy
+//  the GPU has finished, starts new copies up to the frame
+//  budget, and delivers every read that is complete or
+//  has failed.  Never waits on the GPU.  Call this once 
+//  per frame.
+// 
+// 	Returns:
+//  - The number of callbacks that ran
+// --------------------------------------------------------
+inline UINT EZReadback::Scheduler::Update()
+{
+	stats.Frame++;
+	ReadFinishedCopies();
+	StartCopies();
+
+	// Take the finished reads out before calling back, as
+	// callbacks may add more
+	std::vector<Job> finished;
+	for (size_t i = 0; i < jobs.size();)
+	{
+		Job& job = jobs[i];
+		if (job.InFlight == 0 && (FAILED(job.Result) || job.PiecesDone == job.Pieces.size()))
+		{
+			finished.push_back(std::move(job));
+			jobs.erase(jobs.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	for (Job& job : finished)
+	{
+		stats.CompletedReads++;
+		if (job.DueFrame != 0 && stats.Frame > job.DueFrame)
+			stats.MissedDeadlines++;
+		job.Deliver(job.Result);
+	}
+	return (UINT)finished.size();
+}
+
+
+// --- Scheduler::ReadFinishedCopies ----------------------
+//  Private helper that reads back copies, oldest first, 
+//  until it finds one the GPU has not finished.  The GPU
+//  runs copies in order, so everything after it is still
+//  running too.
+// --------------------------------------------------------
+inline void EZReadback::Scheduler::ReadFinishedCopies()
+{
+	while (!copies.empty())
+	{
+		Copy& copy = copies.front();
+		Job* job = FindJob(copy.Ticket);
+		const EZReadbackPiece& piece = job->Pieces[copy.Piece];
+		unsigned char* results = job->Results;
+		size_t elementSize = job->ElementSize;
+
+		HRESULT read = owner->ReadStagedMapped(copy.Staged, D3D11_MAP_FLAG_DO_NOT_WAIT, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+		{
+			if (piece.Whole)
+			{
+				CopyMapped(copy.Staged, gpu, elementSize, results + piece.Offset * elementSize);
+				return;
+			}
+
+			// Put each row of the box back in its place
+			const StagedCopy& staged = copy.Staged;
+			size_t rowBytes = elementSize * staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount);
+			ForEachMappedRow(staged, gpu, [&](const void* row, size_t rowIndex)
+			{
+				size_t slice = rowIndex / staged.RowCount;
+				size_t element = piece.Offset + slice * piece.SliceStride + (rowIndex % staged.RowCount) * piece.RowStride;
+				memcpy(results + element * elementSize, row, rowBytes);
+			});
+		});
+		if (read == DXGI_ERROR_WAS_STILL_DRAWING)
+			break;
+
+		owner->stagingPool.Release(copy.Staged.Staging.Get());
+		job->InFlight--;
+		if (FAILED(read))
+			job->Result = read;
+		else
+			job->PiecesDone++;
+		copies.pop_front();
+	}
+}
+
+
+// --- Scheduler::StartCopies -----------------------------
+//  Private helper that copies the next pieces of the reads
+//  in priority and deadline order until the frame budget
+//  is spent.  When a read's next piece does not fit, 
+//  smaller pieces of later reads may still use up the 
+//  rest of the budget.  A piece bigger than the whole 
+//  budget is only started as the first copy of a frame.
+// --------------------------------------------------------
+inline void EZReadback::Scheduler::StartCopies()
+{
+	std::vector<size_t> order;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (SUCCEEDED(jobs[i].Result) && jobs[i].NextPiece < jobs[i].Pieces.size())
+			order.push_back(i);
+	}
+
+	// Reads without a deadline (a DueFrame of zero) go after
+	// those with one
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+	{
+		const Job& first = jobs[a];
+		const Job& second = jobs[b];
+		if (first.Priority != second.Priority)
+			return first.Priority > second.Priority;
+		if ((first.DueFrame == 0) != (second.DueFrame == 0))
+			return second.DueFrame == 0;
+		return first.DueFrame < second.DueFrame;
+	});
+
+	size_t spent = 0;
+	UINT started = 0;
+	for (size_t i = 0; i < order.size() && spent < options.FrameBudget; i++)
+	{
+		Job& job = jobs[order[i]];
+		while (job.NextPiece < job.Pieces.size())
+		{
+			const EZReadbackPiece& piece = job.Pieces[job.NextPiece];
+			if (spent > 0 && spent + piece.Bytes > options.FrameBudget)
+				break;
+
+			Copy copy;
+			copy.Ticket = job.Ticket;
+			copy.Piece = job.NextPiece;
+			HRESULT start = owner->CopyToStaging(job.Resource.Get(), piece.MipLevel, piece.ArrayIndex, piece.Whole ? nullptr : &piece.Box, job.ElementSize, copy.Staged);
+			if (FAILED(start))
+			{
+				job.Result = start;
+				break;
+			}
+
+			copies.push_back(copy);
+			job.NextPiece++;
+			job.InFlight++;
+			spent += piece.Bytes;
+			started++;
+		}
+	}
+
+	// Get the copies going
+	if (started > 0)
+		owner->backend->Flush();
+
+	stats.FrameBytes = spent;
+	stats.FramePieces = started;
+	stats.PeakFrameBytes = EZMax(stats.PeakFrameBytes, spent);
+	stats.TotalBytes += spent;
+}
+
+
+// --- Scheduler::Cancel ----------------------------------
+//  Drops a read without calling its callback.  Copies of
+//  it that are still on the GPU go back to the staging 
+//  pool.
+// 
+// 	Returns:
+//  - false if the ticket is not a pending read
+// --------------------------------------------------------
+inline bool EZReadback::Scheduler::Cancel(EZReadbackTicket ticket)
+{
+	Job* job = FindJob(ticket);
+	if (!job)
+		return false;
+
+	for (size_t i = 0; i < copies.size();)
+	{
+		if (copies[i].Ticket == ticket)
+		{
+			owner->stagingPool.Release(copies[i].Staged.Staging.Get());
+			copies.erase(copies.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+	jobs.erase(jobs.begin() + (job - jobs.data()));
+	return true;
 }
 
 
+// --- Scheduler::Clear -----------------------------------
+//  Drops every pending read without calling back, handing
+//  the staging resources back to the pool
+// --------------------------------------------------------
+inline void EZReadback::Scheduler::Clear()
+{
+	for (Copy& copy : copies)
+		owner->stagingPool.Release(copy.Staged.Staging.Get());
+	copies.clear();
+	jobs.clear();
+}
+
+
+// --- Scheduler::GetStats --------------------------------
+//  Returns where the schedule is at
+// --------------------------------------------------------
+inline EZSchedulerStats EZReadback::Scheduler::GetStats()
+{
+	EZSchedulerStats current = stats;
+	current.PendingReads = (UINT)jobs.size();
+	current.PiecesInFlight = (UINT)copies.size();
+	return current;
+}
+
+
+// --- Scheduler::FindJob ---------------------------------
+//  Private helper that finds a pending read by ticket
+// --------------------------------------------------------
+inline EZReadback::Scheduler::Job* EZReadback::Scheduler::FindJob(EZReadbackTicket ticket)
+{
+	for (Job& job : jobs)
+	{
+		if (job.Ticket == ticket)
+			return &job;
+	}
+	return nullptr;
+}
+
 
 // --- StageAndCopyResource -------------------------------
 //  Private helper function to create a staging resource
 //  for CPU readback, copy data from the specified resource
-//  and finally read the data from the GPU.
+//  and finally read the data from the GPU.  bound is the
+//  resource's description if it is already known and 
+//  checked against ElementType (see CopyToStaging()).
 // --------------------------------------------------------
 template<typename ResourceType, typename DescriptionType, typename ElementType>
 HRESULT EZReadback::StageAndCopyResource(
 	ResourceType* resource, 
 	UINT mipLevel,
 	UINT arrayIndex,
-	std::vector<ElementType>& results)
+	std::vector<ElementType>& results,
+	const DescriptionType* bound)
 {
-	// Update description for staging resource
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging<ResourceType, DescriptionType>(resource, mipLevel, arrayIndex, nullptr, sizeof(ElementType), staged, bound);
+	if (FAILED(copy))
+		return copy;
+
+	// Read it back and hand the staging resource back
+	HRESULT read = ReadStagedCopy(staged, 0, results);
+	stagingPool.Release(staged.Staging.Get());
+	return read;
+}
+
+
+// --- CopyToStaging --------------------------------------
+//  Private helper function to grab a staging resource for
+//  CPU readback from the pool and copy data from the 
+//  specified resource into it.  Does not wait on the GPU.
+// 
+//  Only the requested subresource (or the requested 
+//  region of it) is copied, into a staging resource with
+//  a single mip and array slice that is exactly the size
+//  of the data being read.
+// 
+//  When bound is given it is used as the resource's 
+//  description and the element size is not checked again,
+//  as EZTypedResource already did that when binding.
+// --------------------------------------------------------
+template<typename ResourceType, typename DescriptionType>
+HRESULT EZReadback::CopyToStaging(ResourceType* resource, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, size_t elementSize, StagedCopy& staged, const DescriptionType* bound)
+{
+	// Find the subresource to copy using the full description
 	DescriptionType desc;
-	resource->GetDesc(&desc);
-	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-	desc.Usage          = D3D11_USAGE_STAGING;
-	desc.BindFlags      = 0; // No binding for staging resource
-	desc.MiscFlags      &= ~(D3D11_RESOURCE_MISC_GENERATE_MIPS); // No mip gen
-
-	// Calculate the element count and subresource index
-	size_t elementCount = CalcElementCount<DescriptionType>(&desc, sizeof(ElementType), mipLevel);
-	UINT subresourceIndex = CalcSubresourceIndex(&desc, mipLevel, arrayIndex);
-
-	// Create a new texture that is readable by the CPU
-	Microsoft::WRL::ComPtr<ResourceType> readable;
-	HRESULT create = CreateResource(&desc, readable);
+	if (bound)
+		desc = *bound;
+	else
+		resource->GetDesc(&desc);
+	UINT sourceSubresource = CalcSubresourceIndex(&desc, mipLevel, arrayIndex);
+
+	// Catch element types that do not match the format before
+	// they can overrun or misread anything
+	if (!bound && !IsElementSizeValid(GetFormat(&desc), elementSize))
+		return E_INVALIDARG;
+
+	// Shrink the description to just what is being read
+	HRESULT shrink = CalcStagingDesc(&desc, mipLevel, arrayIndex, region);
+	if (FAILED(shrink))
+		return shrink;
+
+	// Update description for staging resource
+	SetStagingFlags(&desc);
+
+	// Calculate the element count; the staging resource
+	// only has a single subresource
+	staged.ElementCount = CalcElementCount<DescriptionType>(&desc, elementSize, 0);
+	staged.ElementSize = elementSize;
+	staged.Subresource = 0;
+	CalcRowAndSliceCount(&desc, 0, staged.RowCount, staged.SliceCount);
+
+	// Grab a CPU-readable resource from the pool, creating
+	// a new one only if nothing matching is available
+	HRESULT create = stagingPool.Acquire(
+		EZStagingKey(desc),
+		CalcResourceSize(&desc),
+		[&](Microsoft::WRL::ComPtr<ID3D11Resource>& created)
+		{
+			EZReadbackStageTimer timer(profiler.get(), EZReadbackStageCreate);
+			timer.SetBytes(CalcResourceSize(&desc));
+			Microsoft::WRL::ComPtr<ResourceType> typed;
+			HRESULT hr = CreateResource(&desc, typed);
+			created = typed;
+			return hr;
+		},
+		staged.Staging);
 	
 	// Make sure the resource was created
 	if (FAILED(create))
 		return create;
 
-	// Copy the resource
-	context->CopyResource(readable.Get(), resource);
+	// Copy just the subresource or region
+	EZReadbackStageTimer timer(profiler.get(), EZReadbackStageCopy);
+	timer.SetBytes(staged.ElementCount * elementSize);
+	backend->CopySubresourceRegion(staged.Staging.Get(), 0, 0, 0, 0, resource, sourceSubresource, region);
+	return S_OK;
+}
+
+
+// --- CopyToStaging --------------------------------------
+//  Private helper that picks the correct CopyToStaging()
+//  based on the type of the given resource
+// --------------------------------------------------------
+inline HRESULT EZReadback::CopyToStaging(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, size_t elementSize, StagedCopy& staged)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER:
+		return CopyToStaging<ID3D11Buffer, D3D11_BUFFER_DESC>(static_cast<ID3D11Buffer*>(resource), mipLevel, arrayIndex, region, elementSize, staged);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+		return CopyToStaging<ID3D11Texture1D, D3D11_TEXTURE1D_DESC>(static_cast<ID3D11Texture1D*>(resource), mipLevel, arrayIndex, region, elementSize, staged);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+		return CopyToStaging<ID3D11Texture2D, D3D11_TEXTURE2D_DESC>(static_cast<ID3D11Texture2D*>(resource), mipLevel, arrayIndex, region, elementSize, staged);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+		return CopyToStaging<ID3D11Texture3D, D3D11_TEXTURE3D_DESC>(static_cast<ID3D11Texture3D*>(resource), mipLevel, arrayIndex, region, elementSize, staged);
+
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+
+// --- CopyAllToStaging -----------------------------------
+//  Private helper function to grab a staging resource 
+//  matching the entire resource from the pool and copy
+//  all of its subresources into it with one CopyResource().
+//  Fills in one StagedCopy and layout per subresource.
+//  Does not wait on the GPU.
+// --------------------------------------------------------
+template<typename ResourceType, typename DescriptionType>
+HRESULT EZReadback::CopyAllToStaging(ResourceType* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts)
+{
+	DescriptionType desc;
+	resource->GetDesc(&desc);
+	if (!IsElementSizeValid(GetFormat(&desc), elementSize))
+		return E_INVALIDARG;
+
+	// Same shape as the original, just CPU readable
+	SetStagingFlags(&desc);
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> staging;
+	HRESULT create = stagingPool.Acquire(
+		EZStagingKey(desc),
+		CalcResourceSize(&desc),
+		[&](Microsoft::WRL::ComPtr<ID3D11Resource>& created)
+		{
+			EZReadbackStageTimer timer(profiler.get(), EZReadbackStageCreate);
+			timer.SetBytes(CalcResourceSize(&desc));
+			Microsoft::WRL::ComPtr<ResourceType> typed;
+			HRESULT hr = CreateResource(&desc, typed);
+			created = typed;
+			return hr;
+		},
+		staging);
+
+	if (FAILED(create))
+		return create;
+
+	{
+		EZReadbackStageTimer timer(profiler.get(), EZReadbackStageCopy);
+		timer.SetBytes(CalcResourceSize(&desc));
+		backend->CopyResource(staging.Get(), resource);
+	}
+
+	CalcSubresourceLayouts(&desc, elementSize, staged, layouts);
+	for (StagedCopy& copy : staged)
+		copy.Staging = staging;
+	return S_OK;
+}
+
+
+// --- CopyAllToStaging -----------------------------------
+//  Private helper that picks the correct CopyAllToStaging()
+//  based on the type of the given resource
+// --------------------------------------------------------
+inline HRESULT EZReadback::CopyAllToStaging(ID3D11Resource* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER:
+		return CopyAllToStaging<ID3D11Buffer, D3D11_BUFFER_DESC>(static_cast<ID3D11Buffer*>(resource), elementSize, staged, layouts);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D:
+		return CopyAllToStaging<ID3D11Texture1D, D3D11_TEXTURE1D_DESC>(static_cast<ID3D11Texture1D*>(resource), elementSize, staged, layouts);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D:
+		return CopyAllToStaging<ID3D11Texture2D, D3D11_TEXTURE2D_DESC>(static_cast<ID3D11Texture2D*>(resource), elementSize, staged, layouts);
+
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D:
+		return CopyAllToStaging<ID3D11Texture3D, D3D11_TEXTURE3D_DESC>(static_cast<ID3D11Texture3D*>(resource), elementSize, staged, layouts);
+
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+
+// --- CalcSubresourceLayouts -----------------------------
+//  Private helper function that works out where every
+//  subresource of a resource with the given description
+//  goes when they are all read back to back, in 
+//  subresource index order.  Also fills in how to read
+//  each one (minus the staging resource itself).
+// --------------------------------------------------------
+template<typename DescriptionType>
+void EZReadback::CalcSubresourceLayouts(DescriptionType* desc, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts)
+{
+	UINT mipLevels = GetMipLevels(desc);
+	UINT arraySize = GetArraySize(desc);
+	staged.resize((size_t)mipLevels * arraySize);
+	layouts.resize((size_t)mipLevels * arraySize);
+
+	size_t offset = 0;
+	for (UINT slice = 0; slice < arraySize; slice++)
+	{
+		for (UINT mip = 0; mip < mipLevels; mip++)
+		{
+			UINT subresource = CalcSubresourceIndex(desc, mip, slice);
+
+			StagedCopy& copy = staged[subresource];
+			copy.Subresource = subresource;
+			copy.ElementCount = CalcElementCount(desc, elementSize, mip);
+			copy.ElementSize = elementSize;
+			CalcRowAndSliceCount(desc, mip, copy.RowCount, copy.SliceCount);
+
+			EZSubresourceLayout& layout = layouts[subresource];
+			layout.MipLevel = mip;
+			layout.ArrayIndex = slice;
+			CalcMipSize(desc, mip, layout.Width, layout.Height, layout.Depth);
+			layout.Offset = offset;
+			layout.ElementCount = copy.ElementCount;
+			offset += copy.ElementCount;
+		}
+	}
+}
+
+
+// --- CalcSubresourceLayouts -----------------------------
+//  Private helper that picks the correct 
+//  CalcSubresourceLayouts() based on the type of the given
+//  resource
+// --------------------------------------------------------
+inline HRESULT EZReadback::CalcSubresourceLayouts(ID3D11Resource* resource, size_t elementSize, std::vector<StagedCopy>& staged, std::vector<EZSubresourceLayout>& layouts)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER: { D3D11_BUFFER_DESC desc; static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc); CalcSubresourceLayouts(&desc, elementSize, staged, layouts); return S_OK; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D: { D3D11_TEXTURE1D_DESC desc; static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc); CalcSubresourceLayouts(&desc, elementSize, staged, layouts); return S_OK; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D: { D3D11_TEXTURE2D_DESC desc; static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc); CalcSubresourceLayouts(&desc, elementSize, staged, layouts); return S_OK; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D: { D3D11_TEXTURE3D_DESC desc; static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc); CalcSubresourceLayouts(&desc, elementSize, staged, layouts); return S_OK; }
+	default:
+		break;
+	}
+
+	return E_INVALIDARG;
+}
+
+
+// --- SetStagingFlags ------------------------------------
+//  Private helper function that turns a description into
+//  one for a CPU-readable staging resource
+// --------------------------------------------------------
+template<typename DescriptionType>
+void EZReadback::SetStagingFlags(DescriptionType* desc)
+{
+	desc->CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc->Usage          = D3D11_USAGE_STAGING;
+	desc->BindFlags      = 0; // No binding for staging resource
+	desc->MiscFlags      &= ~(D3D11_RESOURCE_MISC_GENERATE_MIPS); // No mip gen
+}
+
+
+// --- ReadStagedCopy -------------------------------------
+//  Private helper function to map a staging resource and
+//  read its data into the results vector.  The staging 
+//  resource stays checked out of the pool.
+// 
+//  Passing D3D11_MAP_FLAG_DO_NOT_WAIT as the map flags
+//  returns DXGI_ERROR_WAS_STILL_DRAWING instead of waiting
+//  if the GPU has not finished the copy yet.
+// --------------------------------------------------------
+template<typename ElementType>
+HRESULT EZReadback::ReadStagedCopy(const StagedCopy& staged, UINT mapFlags, std::vector<ElementType>& results)
+{
+	// Resize the vector and read into it
+	results.resize(staged.ElementCount);
+	return ReadStagedCopy(staged, mapFlags, sizeof(ElementType), results.data());
+}
+
 
+// --- ReadStagedCopy -------------------------------------
+//  Private helper function that does the actual work for
+//  the ReadStagedCopy() above, reading into any memory 
+//  large enough for ElementCount elements of the given
+//  size
+// --------------------------------------------------------
+inline HRESULT EZReadback::ReadStagedCopy(const StagedCopy& staged, UINT mapFlags, size_t elementSize, void* destination)
+{
 	// Map the resource
 	D3D11_MAPPED_SUBRESOURCE gpu = {};
-	HRESULT map = context->Map(readable.Get(), subresourceIndex, D3D11_MAP_READ, 0, &gpu);
+	HRESULT map = MapStaged(backend.get(), profiler.get(), staged, mapFlags, gpu);
 	if (FAILED(map))
 		return map;
 
-	// Resize the vector and read into it
-	results.resize(elementCount);
-	memcpy(&results[0], gpu.pData, sizeof(ElementType) * elementCount);
+	{
+		EZReadbackStageTimer timer(profiler.get(), EZReadbackStageRead);
+		timer.SetBytes(staged.ElementCount * elementSize);
+		CopyMapped(staged, gpu, elementSize, destination);
+	}
+
+	// Clean up
+	backend->Unmap(staged.Staging.Get(), staged.Subresource);
+	return S_OK;
+}
+
+
+// --- ReadStagedRows -------------------------------------
+//  Private helper function to map a staging resource and
+//  hand each row of its data, in order, to the given 
+//  function along with the index of the row.  Lets data be
+//  processed straight out of the mapped memory instead of
+//  being copied first.
+// --------------------------------------------------------
+template<typename RowFunction>
+HRESULT EZReadback::ReadStagedRows(const StagedCopy& staged, UINT mapFlags, RowFunction rowFunction)
+{
+	return ReadStagedMapped(staged, mapFlags, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		ForEachMappedRow(staged, gpu, rowFunction);
+	});
+}
+
+
+// --- ReadStagedMapped -----------------------------------
+//  Private helper function to map a staging resource and
+//  hand the mapped subresource to the given function, 
+//  unmapping it afterwards.  For readers that need the 
+//  whole subresource at once, such as parallel decoders.
+// --------------------------------------------------------
+template<typename MappedFunction>
+HRESULT EZReadback::ReadStagedMapped(const StagedCopy& staged, UINT mapFlags, MappedFunction mappedFunction)
+{
+	// Map the resource
+	D3D11_MAPPED_SUBRESOURCE gpu = {};
+	HRESULT map = MapStaged(backend.get(), profiler.get(), staged, mapFlags, gpu);
+	if (FAILED(map))
+		return map;
+
+	{
+		EZReadbackStageTimer timer(profiler.get(), EZReadbackStageRead);
+		timer.SetBytes(staged.ElementCount * staged.ElementSize);
+		mappedFunction(gpu);
+	}
+
+	// Clean up
+	backend->Unmap(staged.Staging.Get(), staged.Subresource);
+	return S_OK;
+}
+
+
+// --- MapStaged ------------------------------------------
+//  Private helper function that maps a staging resource
+//  for reading, timing the map.  Non-blocking maps that
+//  find the GPU busy are only counted, and blocking maps
+//  that take long enough are counted as stalls.
+// --------------------------------------------------------
+inline HRESULT EZReadback::MapStaged(EZReadbackBackend* backend, EZReadbackProfiler* profiler, const StagedCopy& staged, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE& gpu)
+{
+#if defined(EZREADBACK_INSTRUMENTATION)
+	if (profiler)
+	{
+		EZReadbackProfiler::Clock::time_point start = EZReadbackProfiler::Clock::now();
+		HRESULT map = backend->Map(staged.Staging.Get(), staged.Subresource, D3D11_MAP_READ, mapFlags, &gpu);
+		EZReadbackProfiler::Clock::time_point end = EZReadbackProfiler::Clock::now();
+
+		if (map == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			profiler->RecordStillDrawing();
+			return map;
+		}
+
+		profiler->Record(EZReadbackStageMap, start, end, SUCCEEDED(map) ? staged.ElementCount * staged.ElementSize : 0);
+		double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		if ((mapFlags & D3D11_MAP_FLAG_DO_NOT_WAIT) == 0 && milliseconds >= EZReadbackStallMilliseconds)
+			profiler->RecordStall(milliseconds);
+		return map;
+	}
+#else
+	(void)profiler;
+#endif
+
+	return backend->Map(staged.Staging.Get(), staged.Subresource, D3D11_MAP_READ, mapFlags, &gpu);
+}
+
+
+// --- CopyMapped -----------------------------------------
+//  Private helper function that copies the mapped data of
+//  a staging resource into tightly packed memory, skipping
+//  any padding at the end of each row or slice
+// --------------------------------------------------------
+inline void EZReadback::CopyMapped(const StagedCopy& staged, const D3D11_MAPPED_SUBRESOURCE& gpu, size_t elementSize, void* destination)
+{
+	if (staged.ElementCount == 0)
+		return;
+
+	size_t rowBytes = elementSize * staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount);
+	EZCopyPitched(destination, gpu.pData, gpu.RowPitch, gpu.DepthPitch, rowBytes, staged.RowCount, staged.SliceCount);
+}
+
+
+// --- ForEachMappedRow -----------------------------------
+//  Private helper function that hands each row of the 
+//  mapped data of a staging resource, in order, to the
+//  given function along with the index of the row
+// --------------------------------------------------------
+template<typename RowFunction>
+void EZReadback::ForEachMappedRow(const StagedCopy& staged, const D3D11_MAPPED_SUBRESOURCE& gpu, RowFunction rowFunction)
+{
+	// Walk the rows, skipping padding
+	const unsigned char* data = static_cast<const unsigned char*>(gpu.pData);
+	for (UINT slice = 0; slice < staged.SliceCount; slice++)
+	{
+		for (UINT row = 0; row < staged.RowCount; row++)
+			rowFunction(data + (size_t)slice * gpu.DepthPitch + (size_t)row * gpu.RowPitch, (size_t)slice * staged.RowCount + row);
+	}
+}
+
+
+// --- ReadDecoded ----------------------------------------
+//  Private helper function that reads a subresource, or a
+//  region of one, and runs a format decoder over each row
+//  as it is read.  The format is passed in so that views
+//  can decode typeless resources.
+// --------------------------------------------------------
+template<typename OutputType, typename DecodeFunction>
+HRESULT EZReadback::ReadDecoded(ID3D11Resource* resource, DXGI_FORMAT format, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region, std::vector<OutputType>& results, DecodeFunction decode)
+{
+	// Make sure the decoder knows the format
+	size_t bits = BitsPerPixel(format);
+	if (bits == 0 || bits % 8 != 0 || FAILED(decode(format, nullptr, 0, nullptr)))
+		return E_INVALIDARG;
+
+	// Copy into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, region, bits / 8, staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Decode one row at a time
+	results.resize(staged.ElementCount);
+	size_t rowElements = staged.ElementCount / ((size_t)staged.RowCount * staged.SliceCount);
+	HRESULT read = ReadStagedRows(staged, 0, [&](const void* row, size_t rowIndex)
+	{
+		decode(format, row, rowElements, &results[rowIndex * rowElements]);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	if (FAILED(read))
+		results.clear();
+	return read;
+}
+
+
+// --- ReadBlockCompressed --------------------------------
+//  Private helper function that reads a subresource of a
+//  block compressed texture and runs a BC decoder over 
+//  the mapped blocks, one depth slice at a time.  The
+//  format may come from a view of a typeless texture.
+// --------------------------------------------------------
+template<typename OutputType, typename DecodeFunction>
+HRESULT EZReadback::ReadBlockCompressed(ID3D11Resource* resource, DXGI_FORMAT format, UINT mipLevel, UINT arrayIndex, std::vector<OutputType>& results, DecodeFunction decode)
+{
+	// Make sure the decoder knows the format
+	if (!EZIsBlockCompressed(format) || FAILED(decode(format, nullptr, 0, 0, 0, nullptr)))
+		return E_INVALIDARG;
+
+	// Only 2D and 3D textures can be block compressed
+	UINT width, height, depth = 1;
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	if (type == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+		width = desc.Width;
+		height = desc.Height;
+	}
+	else if (type == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+	{
+		D3D11_TEXTURE3D_DESC desc;
+		static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+		width = desc.Width;
+		height = desc.Height;
+		depth = EZMax(desc.Depth >> mipLevel, 1);
+	}
+	else
+	{
+		return E_INVALIDARG;
+	}
+
+	// Copy the blocks into a staging resource
+	StagedCopy staged;
+	HRESULT copy = CopyToStaging(resource, mipLevel, arrayIndex, nullptr, EZBytesPerBlock(format), staged);
+	if (FAILED(copy))
+		return copy;
+
+	// Decode each slice in place
+	width = EZMax(width >> mipLevel, 1);
+	height = EZMax(height >> mipLevel, 1);
+	results.resize((size_t)width * height * depth);
+	HRESULT read = ReadStagedMapped(staged, 0, [&](const D3D11_MAPPED_SUBRESOURCE& gpu)
+	{
+		const unsigned char* data = static_cast<const unsigned char*>(gpu.pData);
+		for (UINT slice = 0; slice < depth; slice++)
+			decode(format, data + (size_t)slice * gpu.DepthPitch, gpu.RowPitch, width, height, &results[(size_t)slice * width * height]);
+	});
+
+	stagingPool.Release(staged.Staging.Get());
+	if (FAILED(read))
+		results.clear();
+	return read;
+}
+
+
+// --- StartWorkerJob -------------------------------------
+//  Private helper that records the copy for a threaded 
+//  read and queues it for the worker thread
+// 
+// 	Returns:
+//  - The ticket, or EZReadbackInvalidTicket if the worker
+//    is not running, the queue is full or the copy could
+//    not be started
+// --------------------------------------------------------
+inline EZReadbackTicket EZReadback::StartWorkerJob(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, size_t elementSize,
+	std::function<HRESULT(const StagedCopy&, const D3D11_MAPPED_SUBRESOURCE&)> read, std::function<void(HRESULT)> deliver)
+{
+	if (!IsWorkerRunning())
+		return EZReadbackInvalidTicket;
+
+	// Recycle staging resources first, since they may be
+	// needed for this copy.  Only this thread increases
+	// Pending and Staged, so the checks cannot go stale.
+	// Both are needed: a read stops counting as pending
+	// when DeliverThreaded() pops it, which may be on 
+	// another thread, while its staging resource can still
+	// be waiting in Returned.
+	ReturnWorkerStaging();
+	if (worker->Pending.load() >= worker->Completed.GetCapacity() || worker->Staged >= worker->Returned.GetCapacity())
+		return EZReadbackInvalidTicket;
+
+	WorkerJob job;
+	if (FAILED(CopyToStaging(resource, mipLevel, arrayIndex, nullptr, elementSize, job.Copy)))
+		return EZReadbackInvalidTicket;
+
+	job.Ticket = ++lastTicket;
+	job.Read = std::move(read);
+	job.Deliver = std::move(deliver);
+	EZReadbackTicket ticket = job.Ticket;
+
+	worker->Pending++;
+	worker->Staged++;
+	{
+		std::lock_guard<std::mutex> lock(worker->Lock);
+		worker->Submitted.push_back(std::move(job));
+	}
+	worker->Wake.notify_one();
+	return ticket;
+}
+
+
+// --- ReturnWorkerStaging --------------------------------
+//  Private helper that hands staging resources the worker
+//  thread is done with back to the pool.  The pool is only
+//  touched by the render thread, so this runs there.
+// --------------------------------------------------------
+inline void EZReadback::ReturnWorkerStaging()
+{
+	if (!worker)
+		return;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> staging;
+	while (worker->Returned.Pop(staging))
+	{
+		stagingPool.Release(staging.Get());
+		worker->Staged--;
+	}
+}
+
+
+// --- RunWorker ------------------------------------------
+//  Body of the worker thread.  Takes reads off the locked
+//  submission queue in order, polls each one until the GPU
+//  is done, copies it out while mapped and hands the 
+//  result and staging resource back through lock-free
+//  queues.  Only returns once stopping and every submitted
+//  read is done.
+// 
+//  Neither lock-free queue can overflow.  Completions are
+//  counted in Pending until DeliverThreaded() pops them,
+//  and staging resources in Staged until 
+//  ReturnWorkerStaging() pops them; StartWorkerJob() keeps
+//  both at or below the capacity of the queues.
+// --------------------------------------------------------
+inline void EZReadback::RunWorker(WorkerState* state, std::shared_ptr<EZReadbackBackend> backend)
+{
+	for (;;)
+	{
+		// Wait for the next read
+		WorkerJob job;
+		{
+			std::unique_lock<std::mutex> lock(state->Lock);
+			state->Wake.wait(lock, [state] { return state->Stopping || !state->Submitted.empty(); });
+			if (state->Submitted.empty())
+				return;
+
+			job = std::move(state->Submitted.front());
+			state->Submitted.pop_front();
+		}
+
+		// Poll without blocking the context, flushing once so
+		// the copy actually reaches the GPU
+		EZReadbackProfiler* profiler = state->Profiler;
+		HRESULT result;
+		bool flushed = false;
+		for (;;)
+		{
+			D3D11_MAPPED_SUBRESOURCE gpu = {};
+			result = MapStaged(backend.get(), profiler, job.Copy, D3D11_MAP_FLAG_DO_NOT_WAIT, gpu);
+			if (result == DXGI_ERROR_WAS_STILL_DRAWING)
+			{
+				if (!flushed)
+				{
+					backend->Flush();
+					flushed = true;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(EZReadbackWorkerPollMicroseconds));
+				continue;
+			}
+
+			if (SUCCEEDED(result))
+			{
+				{
+					EZReadbackStageTimer timer(profiler, EZReadbackStageRead);
+					timer.SetBytes(job.Copy.ElementCount * job.Copy.ElementSize);
+					result = job.Read(job.Copy, gpu);
+				}
+				backend->Unmap(job.Copy.Staging.Get(), job.Copy.Subresource);
+			}
+			break;
+		}
+
+		// Hand everything back
+		bool returned = state->Returned.Push(std::move(job.Copy.Staging));
+		WorkerCompletion completion = { result, std::move(job.Deliver) };
+		bool completed = state->Completed.Push(std::move(completion));
+		assert(returned && completed);
+		(void)returned;
+		(void)completed;
+	}
+}
+
+
+// --- WorkerState::Stop ----------------------------------
+//  Private helper that tells the worker thread to stop 
+//  once its queue is empty and waits for it to exit
+// --------------------------------------------------------
+inline void EZReadback::WorkerState::Stop()
+{
+	if (!Thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Stopping = true;
+	}
+	Wake.notify_one();
+	Thread.join();
+}
+
+
+// --- StartAsyncSlot -------------------------------------
+//  Private helper that claims a free slot in the async
+//  ring and queues the copy for it
+// 
+// 	Returns:
+//  - The slot, or null if the ring is full or the copy
+//    could not be started
+// --------------------------------------------------------
+inline EZReadback::AsyncSlot* EZReadback::StartAsyncSlot(ID3D11Resource* resource, UINT mipLevel, UINT arrayIndex, size_t elementSize)
+{
+	// Find the next free slot, oldest first
+	for (size_t i = 0; i < asyncRing.size(); i++)
+	{
+		size_t index = (asyncNext + i) % asyncRing.size();
+		AsyncSlot& slot = asyncRing[index];
+		if (slot.Ticket != EZReadbackInvalidTicket)
+			continue;
+
+		if (FAILED(CopyToStaging(resource, mipLevel, arrayIndex, nullptr, elementSize, slot.Copy)))
+			return nullptr;
+
+		slot.Ticket = ++lastTicket;
+		slot.ElementSize = elementSize;
+		slot.Flushed = false;
+		slot.Resolve = nullptr;
+		asyncNext = (index + 1) % asyncRing.size();
+		return &slot;
+	}
+
+	// Ring is full
+	return nullptr;
+}
+
+
+// --- FindAsyncSlot --------------------------------------
+//  Private helper that finds the slot holding a ticket
+// --------------------------------------------------------
+inline EZReadback::AsyncSlot* EZReadback::FindAsyncSlot(EZReadbackTicket ticket)
+{
+	if (ticket == EZReadbackInvalidTicket)
+		return nullptr;
+
+	for (AsyncSlot& slot : asyncRing)
+	{
+		if (slot.Ticket == ticket)
+			return &slot;
+	}
+	return nullptr;
+}
+
+
+// --- FinishAsyncSlot ------------------------------------
+//  Private helper that frees a slot once its read has 
+//  completed (or failed).  If the GPU was still busy, the
+//  slot is left in flight and the context is flushed once
+//  so the copy is guaranteed to actually get submitted.
+// 
+// 	Returns:
+//  - The given result
+// --------------------------------------------------------
+inline HRESULT EZReadback::FinishAsyncSlot(AsyncSlot* slot, HRESULT result)
+{
+	if (result == DXGI_ERROR_WAS_STILL_DRAWING)
+	{
+		if (!slot->Flushed)
+		{
+			backend->Flush();
+			slot->Flushed = true;
+		}
+		return result;
+	}
 
-	// Clean up
-	context->Unmap(readable.Get(), subresourceIndex);
-	return S_OK;
+	stagingPool.Release(slot->Copy.Staging.Get());
+	*slot = AsyncSlot();
+	return result;
 }
 
 // --- CalcElementCount ----------------------------------
@@ -413,23 +10249,79 @@ template<> inline UINT EZReadback::CalcElementCount<D3D11_BUFFER_DESC>(D3D11_BUF
 // --------------------------------------------------------
 template<> inline UINT EZReadback::CalcElementCount<D3D11_TEXTURE1D_DESC>(D3D11_TEXTURE1D_DESC* desc, size_t elementSize, UINT mipLevel)
 {
-	return max(desc->Width >> mipLevel, 1);
+	return EZMax(desc->Width >> mipLevel, 1);
 }
 
 // --- CalcElementCount ----------------------------------
-//  Calculates the element count the specified mip of a 2D texture
+//  Calculates the element count the specified mip of a 2D texture.
+//  Block compressed formats have one element per 4x4 block.
+//  Planar formats count both planes, in elementSize units.
 // --------------------------------------------------------
 template<> inline UINT EZReadback::CalcElementCount<D3D11_TEXTURE2D_DESC>(D3D11_TEXTURE2D_DESC* desc, size_t elementSize, UINT mipLevel)
 {
-	return max(desc->Width >> mipLevel, 1) * max(desc->Height >> mipLevel, 1);
+	UINT width = EZMax(desc->Width >> mipLevel, 1);
+	UINT height = EZMax(desc->Height >> mipLevel, 1);
+	EZPlaneLayout luma, chroma;
+	if (EZGetPlaneLayouts(desc->Format, width, height, luma, chroma))
+		return (UINT)(((size_t)luma.RowBytes * (luma.Height + chroma.Height)) / elementSize);
+	if (EZIsBlockCompressed(desc->Format))
+		return ((width + 3) / 4) * ((height + 3) / 4);
+	return width * height;
 }
 
 // --- CalcElementCount ----------------------------------
-//  Calculates the element count the specified mip of a 3D texture
+//  Calculates the element count the specified mip of a 3D texture.
+//  Block compressed formats have one element per 4x4 block.
 // --------------------------------------------------------
 template<> inline UINT EZReadback::CalcElementCount<D3D11_TEXTURE3D_DESC>(D3D11_TEXTURE3D_DESC* desc, size_t elementSize, UINT mipLevel)
 {
-	return max(desc->Width >> mipLevel, 1) * max(desc->Height >> mipLevel, 1) * max(desc->Depth >> mipLevel, 1);
+	UINT width = EZMax(desc->Width >> mipLevel, 1);
+	UINT height = EZMax(desc->Height >> mipLevel, 1);
+	UINT depth = EZMax(desc->Depth >> mipLevel, 1);
+	if (EZIsBlockCompressed(desc->Format))
+		return ((width + 3) / 4) * ((height + 3) / 4) * depth;
+	return width * height * depth;
+}
+
+
+// --- CalcRowAndSliceCount -------------------------------
+//  Calculates how many rows and slices make up the given
+//  mip, which is how mapped data is laid out in memory.
+//  Buffers and 1D textures are always a single row.
+// --------------------------------------------------------
+template<typename DescriptionType>
+inline void EZReadback::CalcRowAndSliceCount(DescriptionType* /*desc*/, UINT /*mipLevel*/, UINT& rowCount, UINT& sliceCount)
+{
+	rowCount = 1;
+	sliceCount = 1;
+}
+
+// --- CalcRowAndSliceCount -------------------------------
+//  Calculates the rows of the specified mip of a 2D texture.
+//  Block compressed formats are laid out in rows of blocks,
+//  and planar formats have the chroma rows after the luma.
+// --------------------------------------------------------
+template<> inline void EZReadback::CalcRowAndSliceCount<D3D11_TEXTURE2D_DESC>(D3D11_TEXTURE2D_DESC* desc, UINT mipLevel, UINT& rowCount, UINT& sliceCount)
+{
+	rowCount = EZMax(desc->Height >> mipLevel, 1);
+	EZPlaneLayout luma, chroma;
+	if (EZGetPlaneLayouts(desc->Format, EZMax(desc->Width >> mipLevel, 1), rowCount, luma, chroma))
+		rowCount = luma.Height + chroma.Height;
+	else if (EZIsBlockCompressed(desc->Format))
+		rowCount = (rowCount + 3) / 4;
+	sliceCount = 1;
+}
+
+// --- CalcRowAndSliceCount -------------------------------
+//  Calculates the rows and slices of the specified mip of
+//  a 3D texture
+// --------------------------------------------------------
+template<> inline void EZReadback::CalcRowAndSliceCount<D3D11_TEXTURE3D_DESC>(D3D11_TEXTURE3D_DESC* desc, UINT mipLevel, UINT& rowCount, UINT& sliceCount)
+{
+	rowCount = EZMax(desc->Height >> mipLevel, 1);
+	if (EZIsBlockCompressed(desc->Format))
+		rowCount = (rowCount + 3) / 4;
+	sliceCount = EZMax(desc->Depth >> mipLevel, 1);
 }
 
 
@@ -453,151 +10345,313 @@ template<> inline UINT EZReadback::CalcSubresourceIndex<D3D11_BUFFER_DESC>(D3D11
 }
 
 
-// --- BitsPerPixel ---------------------------------------
-//  Returns the bits per pixel of the specified format
+// --- GetFormat ------------------------------------------
+//  Gets the format from a resource description
 // --------------------------------------------------------
-inline size_t EZReadback::BitsPerPixel(DXGI_FORMAT format)
+template<typename DescriptionType>
+inline DXGI_FORMAT EZReadback::GetFormat(DescriptionType* desc)
 {
-	switch (format)
+	return desc->Format;
+}
+
+// --- GetFormat ------------------------------------------
+//  Buffers do not have a format
+// --------------------------------------------------------
+template<> inline DXGI_FORMAT EZReadback::GetFormat<D3D11_BUFFER_DESC>(D3D11_BUFFER_DESC* /*desc*/)
+{
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+// --- GetFormat ------------------------------------------
+//  Gets the format of any type of resource
+// --------------------------------------------------------
+inline DXGI_FORMAT EZReadback::GetFormat(ID3D11Resource* resource)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
 	{
-	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-	case DXGI_FORMAT_R32G32B32A32_FLOAT:
-	case DXGI_FORMAT_R32G32B32A32_UINT:
-	case DXGI_FORMAT_R32G32B32A32_SINT:
-		return 128;
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D: { D3D11_TEXTURE1D_DESC desc; static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc); return desc.Format; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D: { D3D11_TEXTURE2D_DESC desc; static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc); return desc.Format; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D: { D3D11_TEXTURE3D_DESC desc; static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc); return desc.Format; }
+	default:
+		break;
+	}
 
-	case DXGI_FORMAT_R32G32B32_TYPELESS:
-	case DXGI_FORMAT_R32G32B32_FLOAT:
-	case DXGI_FORMAT_R32G32B32_UINT:
-	case DXGI_FORMAT_R32G32B32_SINT:
-		return 96;
+	return DXGI_FORMAT_UNKNOWN;
+}
 
-	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-	case DXGI_FORMAT_R16G16B16A16_FLOAT:
-	case DXGI_FORMAT_R16G16B16A16_UNORM:
-	case DXGI_FORMAT_R16G16B16A16_UINT:
-	case DXGI_FORMAT_R16G16B16A16_SNORM:
-	case DXGI_FORMAT_R16G16B16A16_SINT:
-	case DXGI_FORMAT_R32G32_TYPELESS:
-	case DXGI_FORMAT_R32G32_FLOAT:
-	case DXGI_FORMAT_R32G32_UINT:
-	case DXGI_FORMAT_R32G32_SINT:
-	case DXGI_FORMAT_R32G8X24_TYPELESS:
-	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-	case DXGI_FORMAT_Y416:
-	case DXGI_FORMAT_Y210:
-	case DXGI_FORMAT_Y216:
-		return 64;
 
-	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
-	case DXGI_FORMAT_R10G10B10A2_UNORM:
-	case DXGI_FORMAT_R10G10B10A2_UINT:
-	case DXGI_FORMAT_R11G11B10_FLOAT:
-	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-	case DXGI_FORMAT_R8G8B8A8_UNORM:
-	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-	case DXGI_FORMAT_R8G8B8A8_UINT:
-	case DXGI_FORMAT_R8G8B8A8_SNORM:
-	case DXGI_FORMAT_R8G8B8A8_SINT:
-	case DXGI_FORMAT_R16G16_TYPELESS:
-	case DXGI_FORMAT_R16G16_FLOAT:
-	case DXGI_FORMAT_R16G16_UNORM:
-	case DXGI_FORMAT_R16G16_UINT:
-	case DXGI_FORMAT_R16G16_SNORM:
-	case DXGI_FORMAT_R16G16_SINT:
-	case DXGI_FORMAT_R32_TYPELESS:
-	case DXGI_FORMAT_D32_FLOAT:
-	case DXGI_FORMAT_R32_FLOAT:
-	case DXGI_FORMAT_R32_UINT:
-	case DXGI_FORMAT_R32_SINT:
-	case DXGI_FORMAT_R24G8_TYPELESS:
-	case DXGI_FORMAT_D24_UNORM_S8_UINT:
-	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-	case DXGI_FORMAT_R8G8_B8G8_UNORM:
-	case DXGI_FORMAT_G8R8_G8B8_UNORM:
-	case DXGI_FORMAT_B8G8R8A8_UNORM:
-	case DXGI_FORMAT_B8G8R8X8_UNORM:
-	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
-	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
-	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
-	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-	case DXGI_FORMAT_AYUV:
-	case DXGI_FORMAT_Y410:
-	case DXGI_FORMAT_YUY2:
-		return 32;
+// --- CalcMipSize ----------------------------------------
+//  Calculates the size of a mip of any resource
+// --------------------------------------------------------
+inline void EZReadback::CalcMipSize(ID3D11Resource* resource, UINT mipLevel, UINT& width, UINT& height, UINT& depth)
+{
+	D3D11_RESOURCE_DIMENSION type;
+	resource->GetType(&type);
+	switch (type)
+	{
+	case D3D11_RESOURCE_DIMENSION_BUFFER: { D3D11_BUFFER_DESC desc; static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc); CalcMipSize(&desc, mipLevel, width, height, depth); return; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE1D: { D3D11_TEXTURE1D_DESC desc; static_cast<ID3D11Texture1D*>(resource)->GetDesc(&desc); CalcMipSize(&desc, mipLevel, width, height, depth); return; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE2D: { D3D11_TEXTURE2D_DESC desc; static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc); CalcMipSize(&desc, mipLevel, width, height, depth); return; }
+	case D3D11_RESOURCE_DIMENSION_TEXTURE3D: { D3D11_TEXTURE3D_DESC desc; static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc); CalcMipSize(&desc, mipLevel, width, height, depth); return; }
+	default:
+		break;
+	}
 
-	case DXGI_FORMAT_P010:
-	case DXGI_FORMAT_P016:
-		return 24;
+	width = height = depth = 0;
+}
 
-	case DXGI_FORMAT_R8G8_TYPELESS:
-	case DXGI_FORMAT_R8G8_UNORM:
-	case DXGI_FORMAT_R8G8_UINT:
-	case DXGI_FORMAT_R8G8_SNORM:
-	case DXGI_FORMAT_R8G8_SINT:
-	case DXGI_FORMAT_R16_TYPELESS:
-	case DXGI_FORMAT_R16_FLOAT:
-	case DXGI_FORMAT_D16_UNORM:
-	case DXGI_FORMAT_R16_UNORM:
-	case DXGI_FORMAT_R16_UINT:
-	case DXGI_FORMAT_R16_SNORM:
-	case DXGI_FORMAT_R16_SINT:
-	case DXGI_FORMAT_B5G6R5_UNORM:
-	case DXGI_FORMAT_B5G5R5A1_UNORM:
-	case DXGI_FORMAT_A8P8:
-	case DXGI_FORMAT_B4G4R4A4_UNORM:
-		return 16;
 
-	case DXGI_FORMAT_NV12:
-	case DXGI_FORMAT_420_OPAQUE:
-	case DXGI_FORMAT_NV11:
-		return 12;
+// --- CalcStagingDesc ------------------------------------
+//  Shrinks a resource description down to a description
+//  of only the data being read: a single mip and array 
+//  slice, or a region of one.  Also validates that the 
+//  subresource and region actually exist.
+// 
+//  The default implementation rejects everything as each
+//  resource type handles this in different ways.
+// --------------------------------------------------------
+template<typename DescriptionType>
+inline HRESULT EZReadback::CalcStagingDesc(DescriptionType* desc, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region)
+{
+	return E_INVALIDARG;
+}
 
-	case DXGI_FORMAT_R8_TYPELESS:
-	case DXGI_FORMAT_R8_UNORM:
-	case DXGI_FORMAT_R8_UINT:
-	case DXGI_FORMAT_R8_SNORM:
-	case DXGI_FORMAT_R8_SINT:
-	case DXGI_FORMAT_A8_UNORM:
-	case DXGI_FORMAT_AI44:
-	case DXGI_FORMAT_IA44:
-	case DXGI_FORMAT_P8:
-		return 8;
+// --- CalcStagingDesc ------------------------------------
+//  Buffers have no subresources, so only a region (in 
+//  bytes) shrinks them.  Partial copies go into a plain
+//  buffer since a structured stride may not divide the
+//  region evenly.
+// --------------------------------------------------------
+template<> inline HRESULT EZReadback::CalcStagingDesc<D3D11_BUFFER_DESC>(D3D11_BUFFER_DESC* desc, UINT /*mipLevel*/, UINT /*arrayIndex*/, const D3D11_BOX* region)
+{
+	if (!region)
+		return S_OK;
 
-	case DXGI_FORMAT_R1_UNORM:
-		return 1;
+	if (!IsRegionInside(region, desc->ByteWidth, 1, 1))
+		return E_INVALIDARG;
 
-	case DXGI_FORMAT_BC1_TYPELESS:
-	case DXGI_FORMAT_BC1_UNORM:
-	case DXGI_FORMAT_BC1_UNORM_SRGB:
-	case DXGI_FORMAT_BC4_TYPELESS:
-	case DXGI_FORMAT_BC4_UNORM:
-	case DXGI_FORMAT_BC4_SNORM:
-		return 4;
+	desc->ByteWidth = region->right - region->left;
+	desc->MiscFlags = 0;
+	desc->StructureByteStride = 0;
+	return S_OK;
+}
+
+// --- CalcStagingDesc ------------------------------------
+//  Shrinks a 1D texture description to one mip and slice
+// --------------------------------------------------------
+template<> inline HRESULT EZReadback::CalcStagingDesc<D3D11_TEXTURE1D_DESC>(D3D11_TEXTURE1D_DESC* desc, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region)
+{
+	if (mipLevel >= desc->MipLevels || arrayIndex >= desc->ArraySize)
+		return E_INVALIDARG;
+
+	UINT width = EZMax(desc->Width >> mipLevel, 1);
+	if (region)
+	{
+		if (!IsRegionInside(region, width, 1, 1))
+			return E_INVALIDARG;
+		width = region->right - region->left;
+	}
+
+	desc->Width = width;
+	desc->MipLevels = 1;
+	desc->ArraySize = 1;
+	return S_OK;
+}
+
+// --- CalcStagingDesc ------------------------------------
+//  Shrinks a 2D texture description to one mip and slice.
+//  A single face of a cube is just a 2D texture, so the
+//  cube flag is dropped as well.  Block compressed regions
+//  must line up with blocks, and block compressed staging
+//  textures are padded out to whole blocks.  Planar video
+//  textures are read whole, and only as NV12, P010 or P016
+//  with an even width, so both planes share a row size.
+// --------------------------------------------------------
+template<> inline HRESULT EZReadback::CalcStagingDesc<D3D11_TEXTURE2D_DESC>(D3D11_TEXTURE2D_DESC* desc, UINT mipLevel, UINT arrayIndex, const D3D11_BOX* region)
+{
+	if (mipLevel >= desc->MipLevels || arrayIndex >= desc->ArraySize)
+		return E_INVALIDARG;
+
+	UINT width = EZMax(desc->Width >> mipLevel, 1);
+	UINT height = EZMax(desc->Height >> mipLevel, 1);
+	if (EZIsPlanar(desc->Format))
+	{
+		EZPlaneLayout luma, chroma;
+		if (region || !EZGetPlaneLayouts(desc->Format, width, height, luma, chroma) || luma.RowBytes != chroma.RowBytes)
+			return E_INVALIDARG;
+	}
+
+	bool blocks = EZIsBlockCompressed(desc->Format);
+	if (region)
+	{
+		if (!IsRegionInside(region, width, height, 1) || (blocks && !IsRegionBlockAligned(region, width, height)))
+			return E_INVALIDARG;
+		width = region->right - region->left;
+		height = region->bottom - region->top;
+	}
+
+	desc->Width = blocks ? (width + 3) & ~3u : width;
+	desc->Height = blocks ? (height + 3) & ~3u : height;
+	desc->MipLevels = 1;
+	desc->ArraySize = 1;
+	desc->MiscFlags &= ~(D3D11_RESOURCE_MISC_TEXTURECUBE);
+	return S_OK;
+}
+
+// --- CalcStagingDesc ------------------------------------
+//  Shrinks a 3D texture description to one mip.  3D 
+//  textures have no array slices, so arrayIndex is ignored.
+//  Block compressed data is handled as for 2D textures.
+// --------------------------------------------------------
+template<> inline HRESULT EZReadback::CalcStagingDesc<D3D11_TEXTURE3D_DESC>(D3D11_TEXTURE3D_DESC* desc, UINT mipLevel, UINT /*arrayIndex*/, const D3D11_BOX* region)
+{
+	if (mipLevel >= desc->MipLevels)
+		return E_INVALIDARG;
+
+	UINT width = EZMax(desc->Width >> mipLevel, 1);
+	UINT height = EZMax(desc->Height >> mipLevel, 1);
+	UINT depth = EZMax(desc->Depth >> mipLevel, 1);
+	bool blocks = EZIsBlockCompressed(desc->Format);
+	if (region)
+	{
+		if (!IsRegionInside(region, width, height, depth) || (blocks && !IsRegionBlockAligned(region, width, height)))
+			return E_INVALIDARG;
+		width = region->right - region->left;
+		height = region->bottom - region->top;
+		depth = region->back - region->front;
+	}
+
+	desc->Width = blocks ? (width + 3) & ~3u : width;
+	desc->Height = blocks ? (height + 3) & ~3u : height;
+	desc->Depth = depth;
+	desc->MipLevels = 1;
+	return S_OK;
+}
+
+// --- IsRegionInside -------------------------------------
+//  Checks that a box is non-empty and fits within a
+//  subresource of the given size
+// --------------------------------------------------------
+inline bool EZReadback::IsRegionInside(const D3D11_BOX* region, UINT width, UINT height, UINT depth)
+{
+	return
+		region->left < region->right && region->right <= width &&
+		region->top < region->bottom && region->bottom <= height &&
+		region->front < region->back && region->back <= depth;
+}
+
+// --- IsRegionBlockAligned -------------------------------
+//  Checks that a box starts on a 4x4 block boundary and
+//  ends on one or at the edge of the subresource, which
+//  is required for copying block compressed data
+// --------------------------------------------------------
+inline bool EZReadback::IsRegionBlockAligned(const D3D11_BOX* region, UINT width, UINT height)
+{
+	return
+		region->left % 4 == 0 && (region->right % 4 == 0 || region->right == width) &&
+		region->top % 4 == 0 && (region->bottom % 4 == 0 || region->bottom == height);
+}
+
+
+// --- CalcResourceSize ----------------------------------
+//  Estimates the total size in bytes of every subresource
+//  of a resource with the given description.  Used for 
+//  staging pool budgeting, so it only needs to be close.
+// 
+//  The default implementation returns zero as each
+//  resource type calculates this in different ways.
+// --------------------------------------------------------
+template<typename DescriptionType>
+inline size_t EZReadback::CalcResourceSize(DescriptionType* desc)
+{
+	return 0;
+}
+
+// --- CalcResourceSize ----------------------------------
+//  Calculates the size of a buffer
+// --------------------------------------------------------
+template<> inline size_t EZReadback::CalcResourceSize<D3D11_BUFFER_DESC>(D3D11_BUFFER_DESC* desc)
+{
+	return desc->ByteWidth;
+}
+
+// --- CalcResourceSize ----------------------------------
+//  Calculates the size of all mips and array slices of a 
+//  1D texture
+// --------------------------------------------------------
+template<> inline size_t EZReadback::CalcResourceSize<D3D11_TEXTURE1D_DESC>(D3D11_TEXTURE1D_DESC* desc)
+{
+	size_t bits = 0;
+	for (UINT mip = 0; mip < desc->MipLevels; mip++)
+		bits += (size_t)EZMax(desc->Width >> mip, 1) * BitsPerPixel(desc->Format);
+	return (bits + 7) / 8 * desc->ArraySize;
+}
+
+// --- CalcResourceSize ----------------------------------
+//  Calculates the size of all mips and array slices of a 
+//  2D texture
+// --------------------------------------------------------
+template<> inline size_t EZReadback::CalcResourceSize<D3D11_TEXTURE2D_DESC>(D3D11_TEXTURE2D_DESC* desc)
+{
+	size_t bits = 0;
+	for (UINT mip = 0; mip < desc->MipLevels; mip++)
+		bits += (size_t)EZMax(desc->Width >> mip, 1) * EZMax(desc->Height >> mip, 1) * BitsPerPixel(desc->Format);
+	return (bits + 7) / 8 * desc->ArraySize;
+}
+
+// --- CalcResourceSize ----------------------------------
+//  Calculates the size of all mips of a 3D texture
+// --------------------------------------------------------
+template<> inline size_t EZReadback::CalcResourceSize<D3D11_TEXTURE3D_DESC>(D3D11_TEXTURE3D_DESC* desc)
+{
+	size_t bits = 0;
+	for (UINT mip = 0; mip < desc->MipLevels; mip++)
+		bits += (size_t)EZMax(desc->Width >> mip, 1) * EZMax(desc->Height >> mip, 1) * EZMax(desc->Depth >> mip, 1) * BitsPerPixel(desc->Format);
+	return (bits + 7) / 8;
+}
 
-	case DXGI_FORMAT_BC2_TYPELESS:
-	case DXGI_FORMAT_BC2_UNORM:
-	case DXGI_FORMAT_BC2_UNORM_SRGB:
-	case DXGI_FORMAT_BC3_TYPELESS:
-	case DXGI_FORMAT_BC3_UNORM:
-	case DXGI_FORMAT_BC3_UNORM_SRGB:
-	case DXGI_FORMAT_BC5_TYPELESS:
-	case DXGI_FORMAT_BC5_UNORM:
-	case DXGI_FORMAT_BC5_SNORM:
-	case DXGI_FORMAT_BC6H_TYPELESS:
-	case DXGI_FORMAT_BC6H_UF16:
-	case DXGI_FORMAT_BC6H_SF16:
-	case DXGI_FORMAT_BC7_TYPELESS:
-	case DXGI_FORMAT_BC7_UNORM:
-	case DXGI_FORMAT_BC7_UNORM_SRGB:
-		return 8;
 
+// --- IsElementSizeValid ---------------------------------
+//  Checks that an element type of the given size matches
+//  a texel of the given format, or a whole 4x4 block of a
+//  block compressed format.  NV12, P010 and P016 are read
+//  as raw samples: bytes for NV12, and bytes or 16-bit 
+//  values for the others.  Other formats whose elements
+//  are not single texels (packed 4:2:2 and the remaining
+//  planar formats), as well as unknown formats and 
+//  buffers, are not checked.
+// --------------------------------------------------------
+inline bool EZReadback::IsElementSizeValid(DXGI_FORMAT format, size_t elementSize)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_NV12:
+		return elementSize == 1;
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		return elementSize == 1 || elementSize == 2;
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_YUY2:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+	case DXGI_FORMAT_NV11:
+	case DXGI_FORMAT_420_OPAQUE:
+	case DXGI_FORMAT_R1_UNORM:
+		return true;
 	default:
-		return 0;
+		break;
 	}
-}
\ No newline at end of file
+
+	// Block compressed formats are read one block at a time
+	if (EZIsBlockCompressed(format))
+		return elementSize == EZBytesPerBlock(format);
+
+	size_t bits = BitsPerPixel(format);
+	if (bits < 8)
+		return true;
+
+	return elementSize * 8 == bits;
+}
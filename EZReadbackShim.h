@@ -0,0 +1,536 @@
+#pragma once
+
+// --- EZReadbackShim -------------------------------------
+//  The few Windows, D3D11, WRL and DirectXMath types that
+//  EZReadback.h needs when it is built without the Windows
+//  SDK, so that EZReferenceBackend and every CPU-side
+//  decoder can be used on Linux and macOS, for example on
+//  CI machines with no GPU.
+//
+//  EZReadback.h includes this file by itself whenever
+//  EZREADBACK_NO_D3D11 is defined, which it is by default
+//  everywhere but Windows; keep it next to EZReadback.h.
+//  Only the parts of each type that EZReadback uses are
+//  declared, with the same names, values and layouts as
+//  the real headers.  EZD3D11Backend and the EZReadback
+//  constructor that takes a device and context are not
+//  available in this configuration.
+// --------------------------------------------------------
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// --- Basic types and HRESULTs ---------------------------
+typedef unsigned int UINT;
+typedef float FLOAT;
+typedef unsigned long ULONG;
+typedef uint64_t UINT64;
+typedef int32_t HRESULT;
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001)
+#define E_NOINTERFACE ((HRESULT)0x80004002)
+#define E_POINTER ((HRESULT)0x80004003)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_NOT_SUFFICIENT_BUFFER ((HRESULT)0x8007007A)
+#define DXGI_ERROR_WAS_STILL_DRAWING ((HRESULT)0x887A000A)
+
+#define STDMETHODCALLTYPE
+
+inline unsigned long GetCurrentProcessId()
+{
+#if defined(_WIN32)
+	return (unsigned long)_getpid();
+#else
+	return (unsigned long)getpid();
+#endif
+}
+
+// --- GUIDs ----------------------------------------------
+//  __uuidof() hands out a distinct GUID per interface,
+//  which is all QueryInterface() needs to tell them apart
+// --------------------------------------------------------
+struct GUID
+{
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+typedef GUID IID;
+typedef const GUID& REFGUID;
+typedef const IID& REFIID;
+
+inline bool operator==(const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator!=(const GUID& a, const GUID& b) { return !(a == b); }
+
+inline uint32_t EZShimNextInterfaceId()
+{
+	static std::atomic<uint32_t> last{ 0 };
+	return ++last;
+}
+
+template<typename InterfaceType>
+inline const GUID& EZShimUuidOf()
+{
+	static const GUID id = { EZShimNextInterfaceId(), 0, 0, { 0 } };
+	return id;
+}
+
+#define __uuidof(type) EZShimUuidOf<type>()
+
+// --- DXGI_FORMAT ----------------------------------------
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_TYPELESS = 1,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+	DXGI_FORMAT_R32G32B32A32_UINT = 3,
+	DXGI_FORMAT_R32G32B32A32_SINT = 4,
+	DXGI_FORMAT_R32G32B32_TYPELESS = 5,
+	DXGI_FORMAT_R32G32B32_FLOAT = 6,
+	DXGI_FORMAT_R32G32B32_UINT = 7,
+	DXGI_FORMAT_R32G32B32_SINT = 8,
+	DXGI_FORMAT_R16G16B16A16_TYPELESS = 9,
+	DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+	DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+	DXGI_FORMAT_R16G16B16A16_UINT = 12,
+	DXGI_FORMAT_R16G16B16A16_SNORM = 13,
+	DXGI_FORMAT_R16G16B16A16_SINT = 14,
+	DXGI_FORMAT_R32G32_TYPELESS = 15,
+	DXGI_FORMAT_R32G32_FLOAT = 16,
+	DXGI_FORMAT_R32G32_UINT = 17,
+	DXGI_FORMAT_R32G32_SINT = 18,
+	DXGI_FORMAT_R32G8X24_TYPELESS = 19,
+	DXGI_FORMAT_D32_FLOAT_S8X24_UINT = 20,
+	DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS = 21,
+	DXGI_FORMAT_X32_TYPELESS_G8X24_UINT = 22,
+	DXGI_FORMAT_R10G10B10A2_TYPELESS = 23,
+	DXGI_FORMAT_R10G10B10A2_UNORM = 24,
+	DXGI_FORMAT_R10G10B10A2_UINT = 25,
+	DXGI_FORMAT_R11G11B10_FLOAT = 26,
+	DXGI_FORMAT_R8G8B8A8_TYPELESS = 27,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DXGI_FORMAT_R8G8B8A8_UINT = 30,
+	DXGI_FORMAT_R8G8B8A8_SNORM = 31,
+	DXGI_FORMAT_R8G8B8A8_SINT = 32,
+	DXGI_FORMAT_R16G16_TYPELESS = 33,
+	DXGI_FORMAT_R16G16_FLOAT = 34,
+	DXGI_FORMAT_R16G16_UNORM = 35,
+	DXGI_FORMAT_R16G16_UINT = 36,
+	DXGI_FORMAT_R16G16_SNORM = 37,
+	DXGI_FORMAT_R16G16_SINT = 38,
+	DXGI_FORMAT_R32_TYPELESS = 39,
+	DXGI_FORMAT_D32_FLOAT = 40,
+	DXGI_FORMAT_R32_FLOAT = 41,
+	DXGI_FORMAT_R32_UINT = 42,
+	DXGI_FORMAT_R32_SINT = 43,
+	DXGI_FORMAT_R24G8_TYPELESS = 44,
+	DXGI_FORMAT_D24_UNORM_S8_UINT = 45,
+	DXGI_FORMAT_R24_UNORM_X8_TYPELESS = 46,
+	DXGI_FORMAT_X24_TYPELESS_G8_UINT = 47,
+	DXGI_FORMAT_R8G8_TYPELESS = 48,
+	DXGI_FORMAT_R8G8_UNORM = 49,
+	DXGI_FORMAT_R8G8_UINT = 50,
+	DXGI_FORMAT_R8G8_SNORM = 51,
+	DXGI_FORMAT_R8G8_SINT = 52,
+	DXGI_FORMAT_R16_TYPELESS = 53,
+	DXGI_FORMAT_R16_FLOAT = 54,
+	DXGI_FORMAT_D16_UNORM = 55,
+	DXGI_FORMAT_R16_UNORM = 56,
+	DXGI_FORMAT_R16_UINT = 57,
+	DXGI_FORMAT_R16_SNORM = 58,
+	DXGI_FORMAT_R16_SINT = 59,
+	DXGI_FORMAT_R8_TYPELESS = 60,
+	DXGI_FORMAT_R8_UNORM = 61,
+	DXGI_FORMAT_R8_UINT = 62,
+	DXGI_FORMAT_R8_SNORM = 63,
+	DXGI_FORMAT_R8_SINT = 64,
+	DXGI_FORMAT_A8_UNORM = 65,
+	DXGI_FORMAT_R1_UNORM = 66,
+	DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
+	DXGI_FORMAT_R8G8_B8G8_UNORM = 68,
+	DXGI_FORMAT_G8R8_G8B8_UNORM = 69,
+	DXGI_FORMAT_BC1_TYPELESS = 70,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+	DXGI_FORMAT_BC2_TYPELESS = 73,
+	DXGI_FORMAT_BC2_UNORM = 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+	DXGI_FORMAT_BC3_TYPELESS = 76,
+	DXGI_FORMAT_BC3_UNORM = 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+	DXGI_FORMAT_BC4_TYPELESS = 79,
+	DXGI_FORMAT_BC4_UNORM = 80,
+	DXGI_FORMAT_BC4_SNORM = 81,
+	DXGI_FORMAT_BC5_TYPELESS = 82,
+	DXGI_FORMAT_BC5_UNORM = 83,
+	DXGI_FORMAT_BC5_SNORM = 84,
+	DXGI_FORMAT_B5G6R5_UNORM = 85,
+	DXGI_FORMAT_B5G5R5A1_UNORM = 86,
+	DXGI_FORMAT_B8G8R8A8_UNORM = 87,
+	DXGI_FORMAT_B8G8R8X8_UNORM = 88,
+	DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM = 89,
+	DXGI_FORMAT_B8G8R8A8_TYPELESS = 90,
+	DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DXGI_FORMAT_B8G8R8X8_TYPELESS = 92,
+	DXGI_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+	DXGI_FORMAT_BC6H_TYPELESS = 94,
+	DXGI_FORMAT_BC6H_UF16 = 95,
+	DXGI_FORMAT_BC6H_SF16 = 96,
+	DXGI_FORMAT_BC7_TYPELESS = 97,
+	DXGI_FORMAT_BC7_UNORM = 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB = 99,
+	DXGI_FORMAT_AYUV = 100,
+	DXGI_FORMAT_Y410 = 101,
+	DXGI_FORMAT_Y416 = 102,
+	DXGI_FORMAT_NV12 = 103,
+	DXGI_FORMAT_P010 = 104,
+	DXGI_FORMAT_P016 = 105,
+	DXGI_FORMAT_420_OPAQUE = 106,
+	DXGI_FORMAT_YUY2 = 107,
+	DXGI_FORMAT_Y210 = 108,
+	DXGI_FORMAT_Y216 = 109,
+	DXGI_FORMAT_NV11 = 110,
+	DXGI_FORMAT_AI44 = 111,
+	DXGI_FORMAT_IA44 = 112,
+	DXGI_FORMAT_P8 = 113,
+	DXGI_FORMAT_A8P8 = 114,
+	DXGI_FORMAT_B4G4R4A4_UNORM = 115
+};
+
+// --- D3D11 enums ----------------------------------------
+enum D3D11_RESOURCE_DIMENSION
+{
+	D3D11_RESOURCE_DIMENSION_UNKNOWN = 0,
+	D3D11_RESOURCE_DIMENSION_BUFFER = 1,
+	D3D11_RESOURCE_DIMENSION_TEXTURE1D = 2,
+	D3D11_RESOURCE_DIMENSION_TEXTURE2D = 3,
+	D3D11_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+
+enum D3D11_USAGE
+{
+	D3D11_USAGE_DEFAULT = 0,
+	D3D11_USAGE_IMMUTABLE = 1,
+	D3D11_USAGE_DYNAMIC = 2,
+	D3D11_USAGE_STAGING = 3
+};
+
+enum D3D11_BIND_FLAG
+{
+	D3D11_BIND_VERTEX_BUFFER = 0x1,
+	D3D11_BIND_INDEX_BUFFER = 0x2,
+	D3D11_BIND_CONSTANT_BUFFER = 0x4,
+	D3D11_BIND_SHADER_RESOURCE = 0x8,
+	D3D11_BIND_RENDER_TARGET = 0x20,
+	D3D11_BIND_DEPTH_STENCIL = 0x40,
+	D3D11_BIND_UNORDERED_ACCESS = 0x80
+};
+
+enum D3D11_CPU_ACCESS_FLAG
+{
+	D3D11_CPU_ACCESS_WRITE = 0x10000,
+	D3D11_CPU_ACCESS_READ = 0x20000
+};
+
+enum D3D11_RESOURCE_MISC_FLAG
+{
+	D3D11_RESOURCE_MISC_GENERATE_MIPS = 0x1,
+	D3D11_RESOURCE_MISC_TEXTURECUBE = 0x4,
+	D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS = 0x20,
+	D3D11_RESOURCE_MISC_BUFFER_STRUCTURED = 0x40
+};
+
+enum D3D11_MAP
+{
+	D3D11_MAP_READ = 1,
+	D3D11_MAP_WRITE = 2,
+	D3D11_MAP_READ_WRITE = 3,
+	D3D11_MAP_WRITE_DISCARD = 4,
+	D3D11_MAP_WRITE_NO_OVERWRITE = 5
+};
+
+enum D3D11_MAP_FLAG
+{
+	D3D11_MAP_FLAG_DO_NOT_WAIT = 0x100000
+};
+
+enum D3D11_SRV_DIMENSION
+{
+	D3D11_SRV_DIMENSION_UNKNOWN = 0,
+	D3D11_SRV_DIMENSION_BUFFER = 1,
+	D3D11_SRV_DIMENSION_TEXTURE1D = 2,
+	D3D11_SRV_DIMENSION_TEXTURE1DARRAY = 3,
+	D3D11_SRV_DIMENSION_TEXTURE2D = 4,
+	D3D11_SRV_DIMENSION_TEXTURE2DARRAY = 5,
+	D3D11_SRV_DIMENSION_TEXTURE2DMS = 6,
+	D3D11_SRV_DIMENSION_TEXTURE2DMSARRAY = 7,
+	D3D11_SRV_DIMENSION_TEXTURE3D = 8,
+	D3D11_SRV_DIMENSION_TEXTURECUBE = 9,
+	D3D11_SRV_DIMENSION_TEXTURECUBEARRAY = 10,
+	D3D11_SRV_DIMENSION_BUFFEREX = 11
+};
+
+enum D3D11_UAV_DIMENSION
+{
+	D3D11_UAV_DIMENSION_UNKNOWN = 0,
+	D3D11_UAV_DIMENSION_BUFFER = 1,
+	D3D11_UAV_DIMENSION_TEXTURE1D = 2,
+	D3D11_UAV_DIMENSION_TEXTURE1DARRAY = 3,
+	D3D11_UAV_DIMENSION_TEXTURE2D = 4,
+	D3D11_UAV_DIMENSION_TEXTURE2DARRAY = 5,
+	D3D11_UAV_DIMENSION_TEXTURE3D = 8
+};
+
+// --- D3D11 structures -----------------------------------
+struct DXGI_SAMPLE_DESC
+{
+	UINT Count;
+	UINT Quality;
+};
+
+struct D3D11_BUFFER_DESC
+{
+	UINT ByteWidth;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+	UINT StructureByteStride;
+};
+
+struct D3D11_TEXTURE1D_DESC
+{
+	UINT Width;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_TEXTURE2D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT MipLevels;
+	UINT ArraySize;
+	DXGI_FORMAT Format;
+	DXGI_SAMPLE_DESC SampleDesc;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_TEXTURE3D_DESC
+{
+	UINT Width;
+	UINT Height;
+	UINT Depth;
+	UINT MipLevels;
+	DXGI_FORMAT Format;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+};
+
+struct D3D11_BOX
+{
+	UINT left;
+	UINT top;
+	UINT front;
+	UINT right;
+	UINT bottom;
+	UINT back;
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+	const void* pSysMem;
+	UINT SysMemPitch;
+	UINT SysMemSlicePitch;
+};
+
+struct D3D11_MAPPED_SUBRESOURCE
+{
+	void* pData;
+	UINT RowPitch;
+	UINT DepthPitch;
+};
+
+inline UINT D3D11CalcSubresource(UINT mipSlice, UINT arraySlice, UINT mipLevels) { return mipSlice + arraySlice * mipLevels; }
+
+// View descriptions
+struct D3D11_BUFFER_SRV { union { UINT FirstElement; UINT ElementOffset; }; union { UINT NumElements; UINT ElementWidth; }; };
+struct D3D11_BUFFEREX_SRV { UINT FirstElement; UINT NumElements; UINT Flags; };
+struct D3D11_TEX1D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEX1D_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEX2D_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2DMS_SRV { UINT UnusedField_NothingToDefine; };
+struct D3D11_TEX2DMS_ARRAY_SRV { UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX3D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEXCUBE_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_TEXCUBE_ARRAY_SRV { UINT MostDetailedMip; UINT MipLevels; UINT First2DArrayFace; UINT NumCubes; };
+
+struct D3D11_SHADER_RESOURCE_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_SRV_DIMENSION ViewDimension;
+	union
+	{
+		D3D11_BUFFER_SRV Buffer;
+		D3D11_TEX1D_SRV Texture1D;
+		D3D11_TEX1D_ARRAY_SRV Texture1DArray;
+		D3D11_TEX2D_SRV Texture2D;
+		D3D11_TEX2D_ARRAY_SRV Texture2DArray;
+		D3D11_TEX2DMS_SRV Texture2DMS;
+		D3D11_TEX2DMS_ARRAY_SRV Texture2DMSArray;
+		D3D11_TEX3D_SRV Texture3D;
+		D3D11_TEXCUBE_SRV TextureCube;
+		D3D11_TEXCUBE_ARRAY_SRV TextureCubeArray;
+		D3D11_BUFFEREX_SRV BufferEx;
+	};
+};
+
+struct D3D11_BUFFER_UAV { UINT FirstElement; UINT NumElements; UINT Flags; };
+struct D3D11_TEX1D_UAV { UINT MipSlice; };
+struct D3D11_TEX1D_ARRAY_UAV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX2D_UAV { UINT MipSlice; };
+struct D3D11_TEX2D_ARRAY_UAV { UINT MipSlice; UINT FirstArraySlice; UINT ArraySize; };
+struct D3D11_TEX3D_UAV { UINT MipSlice; UINT FirstWSlice; UINT WSize; };
+
+struct D3D11_UNORDERED_ACCESS_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_UAV_DIMENSION ViewDimension;
+	union
+	{
+		D3D11_BUFFER_UAV Buffer;
+		D3D11_TEX1D_UAV Texture1D;
+		D3D11_TEX1D_ARRAY_UAV Texture1DArray;
+		D3D11_TEX2D_UAV Texture2D;
+		D3D11_TEX2D_ARRAY_UAV Texture2DArray;
+		D3D11_TEX3D_UAV Texture3D;
+	};
+};
+
+// --- Interfaces -----------------------------------------
+//  Just the methods EZReadback calls or EZReferenceBackend
+//  implements
+// --------------------------------------------------------
+struct IUnknown
+{
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID id, void** object) = 0;
+	virtual ULONG STDMETHODCALLTYPE AddRef() = 0;
+	virtual ULONG STDMETHODCALLTYPE Release() = 0;
+
+	template<typename Q>
+	HRESULT STDMETHODCALLTYPE QueryInterface(Q** object) { return QueryInterface(__uuidof(Q), (void**)object); }
+};
+
+struct ID3D11Device;
+
+struct ID3D11DeviceChild : IUnknown
+{
+	virtual void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) = 0;
+	virtual HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* dataSize, void* data) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT dataSize, const void* data) = 0;
+	virtual HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* data) = 0;
+};
+
+struct ID3D11Resource : ID3D11DeviceChild
+{
+	virtual void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) = 0;
+	virtual void STDMETHODCALLTYPE SetEvictionPriority(UINT evictionPriority) = 0;
+	virtual UINT STDMETHODCALLTYPE GetEvictionPriority() = 0;
+};
+
+struct ID3D11Buffer : ID3D11Resource { virtual void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* desc) = 0; };
+struct ID3D11Texture1D : ID3D11Resource { virtual void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE1D_DESC* desc) = 0; };
+struct ID3D11Texture2D : ID3D11Resource { virtual void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC* desc) = 0; };
+struct ID3D11Texture3D : ID3D11Resource { virtual void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE3D_DESC* desc) = 0; };
+
+struct ID3D11View : ID3D11DeviceChild { virtual void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource) = 0; };
+struct ID3D11ShaderResourceView : ID3D11View { virtual void STDMETHODCALLTYPE GetDesc(D3D11_SHADER_RESOURCE_VIEW_DESC* desc) = 0; };
+struct ID3D11UnorderedAccessView : ID3D11View { virtual void STDMETHODCALLTYPE GetDesc(D3D11_UNORDERED_ACCESS_VIEW_DESC* desc) = 0; };
+
+// --- Microsoft::WRL::ComPtr -----------------------------
+//  Reference counting smart pointer with the subset of the
+//  WRL interface that EZReadback uses
+// --------------------------------------------------------
+namespace Microsoft { namespace WRL {
+
+template<typename T>
+class ComPtr
+{
+public:
+	typedef T InterfaceType;
+
+	ComPtr() : pointer{ nullptr } {}
+	ComPtr(decltype(nullptr)) : pointer{ nullptr } {}
+	ComPtr(T* other) : pointer{ other } { InternalAddRef(); }
+	ComPtr(const ComPtr& other) : pointer{ other.pointer } { InternalAddRef(); }
+	template<typename U> ComPtr(const ComPtr<U>& other) : pointer{ other.Get() } { InternalAddRef(); }
+	ComPtr(ComPtr&& other) : pointer{ other.pointer } { other.pointer = nullptr; }
+	~ComPtr() { InternalRelease(); }
+
+	ComPtr& operator=(ComPtr other) { T* swapped = pointer; pointer = other.pointer; other.pointer = swapped; return *this; }
+	ComPtr& operator=(decltype(nullptr)) { Reset(); return *this; }
+
+	T* Get() const { return pointer; }
+	T* operator->() const { return pointer; }
+	T* const* GetAddressOf() const { return &pointer; }
+	T** GetAddressOf() { return &pointer; }
+	T** ReleaseAndGetAddressOf() { InternalRelease(); return &pointer; }
+	T* Detach() { T* detached = pointer; pointer = nullptr; return detached; }
+	void Attach(T* other) { InternalRelease(); pointer = other; }
+	void Reset() { InternalRelease(); }
+	explicit operator bool() const { return pointer != nullptr; }
+
+	template<typename U> HRESULT As(ComPtr<U>* other) const { return pointer->QueryInterface(__uuidof(U), (void**)other->ReleaseAndGetAddressOf()); }
+	HRESULT CopyTo(T** other) const { InternalAddRef(); *other = pointer; return S_OK; }
+
+private:
+	void InternalAddRef() const { if (pointer) pointer->AddRef(); }
+	void InternalRelease() { T* released = pointer; pointer = nullptr; if (released) released->Release(); }
+
+	T* pointer;
+};
+
+template<typename T, typename U> bool operator==(const ComPtr<T>& a, const ComPtr<U>& b) { return a.Get() == b.Get(); }
+template<typename T> bool operator==(const ComPtr<T>& a, decltype(nullptr)) { return a.Get() == nullptr; }
+template<typename T> bool operator!=(const ComPtr<T>& a, decltype(nullptr)) { return a.Get() != nullptr; }
+
+}}
+
+// --- DirectXMath storage types --------------------------
+namespace DirectX {
+
+struct XMFLOAT2 { float x, y; XMFLOAT2() = default; constexpr XMFLOAT2(float x, float y) : x(x), y(y) {} };
+struct XMFLOAT3 { float x, y, z; XMFLOAT3() = default; constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {} };
+struct XMFLOAT4 { float x, y, z, w; XMFLOAT4() = default; constexpr XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {} };
+struct XMINT2 { int32_t x, y; XMINT2() = default; constexpr XMINT2(int32_t x, int32_t y) : x(x), y(y) {} };
+struct XMINT3 { int32_t x, y, z; XMINT3() = default; constexpr XMINT3(int32_t x, int32_t y, int32_t z) : x(x), y(y), z(z) {} };
+struct XMINT4 { int32_t x, y, z, w; XMINT4() = default; constexpr XMINT4(int32_t x, int32_t y, int32_t z, int32_t w) : x(x), y(y), z(z), w(w) {} };
+struct XMUINT2 { uint32_t x, y; XMUINT2() = default; constexpr XMUINT2(uint32_t x, uint32_t y) : x(x), y(y) {} };
+struct XMUINT3 { uint32_t x, y, z; XMUINT3() = default; constexpr XMUINT3(uint32_t x, uint32_t y, uint32_t z) : x(x), y(y), z(z) {} };
+struct XMUINT4 { uint32_t x, y, z, w; XMUINT4() = default; constexpr XMUINT4(uint32_t x, uint32_t y, uint32_t z, uint32_t w) : x(x), y(y), z(z), w(w) {} };
+
+}
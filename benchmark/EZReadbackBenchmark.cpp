@@ -0,0 +1,544 @@
+// --- EZReadbackBenchmark --------------------------------
+//  Measures read throughput across resource types,
+//  formats, sizes, mip levels and element types, running
+//  against an EZReferenceBackend so no GPU is needed and
+//  results only depend on the CPU side of each read.
+//
+//  Every case is reported in GB/s of data handed back,
+//  along with the average time of each instrumented stage
+//  (see EZReadbackStats).  "cold" cases empty the staging
+//  pool before every read so they include allocation;
+//  the rest reuse pooled staging resources.  "capture"
+//  cases write temporary files to the working directory.
+//
+//  Building (C++14 or later) on Windows, with the Windows
+//  SDK:
+//    cl /O2 /EHsc /std:c++14 /I.. EZReadbackBenchmark.cpp
+//  and elsewhere, where EZReadback.h takes its D3D11 types
+//  from EZReadbackShim.h next to it, so nothing else is
+//  needed:
+//    g++ -O2 -std=c++14 -I.. EZReadbackBenchmark.cpp -lpthread
+//
+//  Usage:
+//    EZReadbackBenchmark [--out results.csv]
+//      [--baseline baseline.csv] [--tolerance 0.10]
+//      [--filter text] [--quick]
+//
+//  Results are written as CSV, one case per line, keyed by
+//  case name.  With --baseline, every case that is slower
+//  than the baseline by more than the tolerance is listed
+//  and the exit code is 1, so a stored baseline can gate
+//  changes.  Baselines are only comparable on the same
+//  machine and build settings.
+// --------------------------------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include "EZReadback.h"
+
+// Each case runs for at least this long, and at least
+// BenchmarkMinIterations times, after one warm-up read
+const double BenchmarkMinSeconds = 0.25;
+const int BenchmarkMinIterations = 5;
+const int BenchmarkMaxIterations = 10000;
+
+// Temporary files of the capture cases
+const char* BenchmarkRawPath = "EZReadbackBenchmark.raw";
+const char* BenchmarkEncodePath = "EZReadbackBenchmark.ezc";
+
+// --- BenchmarkCase --------------------------------------
+//  One measured read.  Run() does the read and returns the
+//  bytes it handed back, or zero on failure.
+// --------------------------------------------------------
+struct BenchmarkCase
+{
+	std::string Name;
+	bool Cold; // Empty the staging pool before each read
+	std::function<size_t()> Run;
+	double IntervalMilliseconds; // Time from the start of one read to the next, as in a frame loop, or zero
+};
+
+// --- BenchmarkResult ------------------------------------
+//  Timings of one case; stage times are averages per read
+// --------------------------------------------------------
+struct BenchmarkResult
+{
+	std::string Name;
+	size_t Bytes;
+	int Iterations;
+	double MedianMilliseconds;
+	double GBPerSecond;
+	double StageMilliseconds[EZReadbackStageCount];
+};
+
+
+// --- Resources ------------------------------------------
+//  Helpers that create reference resources filled with
+//  random bytes, so compressed and float data is not all
+//  zeros
+// --------------------------------------------------------
+static std::vector<unsigned char> RandomBytes(size_t count)
+{
+	std::mt19937 random(1234);
+	std::vector<unsigned char> bytes(count);
+	for (size_t i = 0; i < count; i++)
+		bytes[i] = (unsigned char)random();
+	return bytes;
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateBuffer(EZReferenceBackend& backend, UINT byteWidth)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = byteWidth;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+
+	std::vector<unsigned char> data = RandomBytes(byteWidth);
+	D3D11_SUBRESOURCE_DATA initial = { data.data(), byteWidth, byteWidth };
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	backend.CreateBuffer(&desc, &initial, buffer.GetAddressOf());
+	return buffer;
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture(EZReferenceBackend& backend, D3D11_TEXTURE1D_DESC& desc, const D3D11_SUBRESOURCE_DATA* initial)
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture1D> texture;
+	backend.CreateTexture1D(&desc, initial, texture.GetAddressOf());
+	return texture;
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture(EZReferenceBackend& backend, D3D11_TEXTURE2D_DESC& desc, const D3D11_SUBRESOURCE_DATA* initial)
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	backend.CreateTexture2D(&desc, initial, texture.GetAddressOf());
+	return texture;
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture(EZReferenceBackend& backend, D3D11_TEXTURE3D_DESC& desc, const D3D11_SUBRESOURCE_DATA* initial)
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+	backend.CreateTexture3D(&desc, initial, texture.GetAddressOf());
+	return texture;
+}
+
+// Creates a texture of any dimension, ignoring height and
+// depth for the dimensions that do not have them.  Zero
+// mip levels means the full chain.
+template<typename DescriptionType>
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture(EZReferenceBackend& backend, DescriptionType desc, UINT width, UINT height, UINT depth, UINT mipLevels)
+{
+	if (mipLevels == 0)
+	{
+		for (UINT largest = EZMax(EZMax(width, height), depth); largest > 0; largest >>= 1)
+			mipLevels++;
+	}
+
+	// Initial data for every mip, pitched tightly
+	size_t blockSize = EZIsBlockCompressed(desc.Format) ? 4 : 1;
+	size_t bitsPerBlock = EZBitsPerPixel(desc.Format) * blockSize * blockSize;
+	std::vector<std::vector<unsigned char>> data;
+	std::vector<D3D11_SUBRESOURCE_DATA> initial;
+	for (UINT mip = 0; mip < mipLevels; mip++)
+	{
+		size_t columns = (EZMax(width >> mip, 1u) + blockSize - 1) / blockSize;
+		size_t rows = (EZMax(height >> mip, 1u) + blockSize - 1) / blockSize;
+		size_t rowBytes = columns * bitsPerBlock / 8;
+		data.push_back(RandomBytes(rowBytes * rows * EZMax(depth >> mip, 1u)));
+		D3D11_SUBRESOURCE_DATA subresource = { data.back().data(), (UINT)rowBytes, (UINT)(rowBytes * rows) };
+		initial.push_back(subresource);
+	}
+
+	desc.MipLevels = mipLevels;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	return CreateTexture(backend, desc, initial.data());
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture1D(EZReferenceBackend& backend, DXGI_FORMAT format, UINT width, UINT mipLevels)
+{
+	D3D11_TEXTURE1D_DESC desc = {};
+	desc.Width = width;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	return CreateTexture(backend, desc, width, 1, 1, mipLevels);
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture2D(EZReferenceBackend& backend, DXGI_FORMAT format, UINT width, UINT height, UINT mipLevels)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	desc.SampleDesc.Count = 1;
+	return CreateTexture(backend, desc, width, height, 1, mipLevels);
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Resource> CreateTexture3D(EZReferenceBackend& backend, DXGI_FORMAT format, UINT width, UINT height, UINT depth, UINT mipLevels)
+{
+	D3D11_TEXTURE3D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.Depth = depth;
+	desc.Format = format;
+	return CreateTexture(backend, desc, width, height, depth, mipLevels);
+}
+
+
+// --- Case builders --------------------------------------
+//  Helpers that wrap each kind of read up as a case.  The
+//  results vector is kept between reads, as a caller
+//  reading every frame would.
+// --------------------------------------------------------
+template<typename ElementType>
+static BenchmarkCase ReadCase(const std::string& name, EZReadback& readback, Microsoft::WRL::ComPtr<ID3D11Resource> resource, UINT mipLevel = 0, bool cold = false)
+{
+	std::shared_ptr<std::vector<ElementType>> results = std::make_shared<std::vector<ElementType>>();
+	return { name, cold, [=, &readback]()
+	{
+		HRESULT hr = readback.Read(resource.Get(), *results, mipLevel);
+		return SUCCEEDED(hr) ? results->size() * sizeof(ElementType) : 0;
+	} };
+}
+
+template<typename ElementType>
+static BenchmarkCase ReadAllCase(const std::string& name, EZReadback& readback, Microsoft::WRL::ComPtr<ID3D11Resource> resource)
+{
+	std::shared_ptr<std::vector<ElementType>> results = std::make_shared<std::vector<ElementType>>();
+	std::shared_ptr<std::vector<EZSubresourceLayout>> layouts = std::make_shared<std::vector<EZSubresourceLayout>>();
+	return { name, false, [=, &readback]()
+	{
+		HRESULT hr = readback.ReadAllSubresources(resource.Get(), *results, *layouts);
+		return SUCCEEDED(hr) ? results->size() * sizeof(ElementType) : 0;
+	} };
+}
+
+static BenchmarkCase ReadAsFloat4Case(const std::string& name, EZReadback& readback, Microsoft::WRL::ComPtr<ID3D11Resource> resource)
+{
+	std::shared_ptr<std::vector<DirectX::XMFLOAT4>> results = std::make_shared<std::vector<DirectX::XMFLOAT4>>();
+	return { name, false, [=, &readback]()
+	{
+		HRESULT hr = readback.ReadAsFloat4(resource.Get(), *results);
+		return SUCCEEDED(hr) ? results->size() * sizeof(DirectX::XMFLOAT4) : 0;
+	} };
+}
+
+// Streams a subresource into a raw capture that stays
+// open from one read to the next
+static BenchmarkCase CaptureCase(const std::string& name, EZReadback& readback, Microsoft::WRL::ComPtr<ID3D11Resource> resource, double intervalMilliseconds)
+{
+	std::shared_ptr<EZCaptureWriter> writer = std::make_shared<EZCaptureWriter>();
+	if (FAILED(writer->Open(BenchmarkRawPath)))
+		return { name, false, [] { return (size_t)0; } };
+
+	return { name, false, [=, &readback]()
+	{
+		unsigned long long start = writer->GetBytesWritten();
+		HRESULT hr = readback.ReadToRaw(resource.Get(), *writer);
+		return SUCCEEDED(hr) ? (size_t)(writer->GetBytesWritten() - start) : 0;
+	}, intervalMilliseconds };
+}
+
+// Adds frames of RGBA8 to a compressed capture, changing a
+// few texels each time so the delta filter has work to do
+static BenchmarkCase EncodeCase(const std::string& name, UINT width, UINT height, EZCaptureFilter filter)
+{
+	std::shared_ptr<std::vector<EZColor4>> frame = std::make_shared<std::vector<EZColor4>>((size_t)width * height);
+	for (size_t i = 0; i < frame->size(); i++)
+		(*frame)[i] = EZColor4((unsigned char)(i % width * 255 / width), (unsigned char)(i / width * 255 / height), (unsigned char)(i & 3), 255);
+
+	EZCaptureEncoderOptions options;
+	options.Filter = filter;
+	std::shared_ptr<EZCaptureEncoder> encoder = std::make_shared<EZCaptureEncoder>();
+	if (FAILED(encoder->Open(BenchmarkEncodePath, options)))
+		return { name, false, [] { return (size_t)0; } };
+
+	std::shared_ptr<std::mt19937> random = std::make_shared<std::mt19937>(1234);
+	return { name, false, [=]()
+	{
+		for (int i = 0; i < 256; i++)
+			(*frame)[(*random)() % frame->size()].RedInt = (unsigned char)(*random)();
+		HRESULT hr = encoder->AddFrame(*frame, width, height, DXGI_FORMAT_R8G8B8A8_UNORM);
+		return SUCCEEDED(hr) ? frame->size() * sizeof(EZColor4) : 0;
+	} };
+}
+
+static BenchmarkCase ReadDecompressedCase(const std::string& name, EZReadback& readback, Microsoft::WRL::ComPtr<ID3D11Resource> resource)
+{
+	std::shared_ptr<std::vector<EZColor4>> results = std::make_shared<std::vector<EZColor4>>();
+	return { name, false, [=, &readback]()
+	{
+		HRESULT hr = readback.ReadDecompressed(resource.Get(), *results);
+		return SUCCEEDED(hr) ? results->size() * sizeof(EZColor4) : 0;
+	} };
+}
+
+
+// --- BuildCases -----------------------------------------
+//  The sweep.  Names are stable, since they key the
+//  baseline: type/format/size/subresources/read.
+// --------------------------------------------------------
+static std::vector<BenchmarkCase> BuildCases(EZReferenceBackend& backend, EZReadback& readback, bool quick)
+{
+	std::vector<BenchmarkCase> cases;
+	UINT large = quick ? 512 : 2048;
+	UINT volume = quick ? 32 : 128;
+	std::string largeName = std::to_string(large);
+	std::string volumeName = std::to_string(volume);
+
+	// Buffers
+	Microsoft::WRL::ComPtr<ID3D11Resource> buffer = CreateBuffer(backend, large * large * 4);
+	cases.push_back(ReadCase<float>("buffer/raw/" + largeName + "x" + largeName + "x4/mip0/float", readback, buffer));
+	cases.push_back(ReadCase<float>("buffer/raw/" + largeName + "x" + largeName + "x4/mip0/float-cold", readback, buffer, 0, true));
+
+	// 1D textures
+	Microsoft::WRL::ComPtr<ID3D11Resource> line = CreateTexture1D(backend, DXGI_FORMAT_R8G8B8A8_UNORM, large * 8, 1);
+	cases.push_back(ReadCase<EZColor4>("1d/rgba8/" + std::to_string(large * 8) + "/mip0/color4", readback, line));
+
+	// 2D textures, small and large, in the common formats
+	for (UINT size : { 256u, large })
+	{
+		std::string sizeName = std::to_string(size) + "x" + std::to_string(size);
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> rgba8 = CreateTexture2D(backend, DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1);
+		cases.push_back(ReadCase<EZColor4>("2d/rgba8/" + sizeName + "/mip0/color4", readback, rgba8));
+		cases.push_back(ReadCase<EZColor4>("2d/rgba8/" + sizeName + "/mip0/color4-cold", readback, rgba8, 0, true));
+		cases.push_back(ReadAsFloat4Case("2d/rgba8/" + sizeName + "/mip0/float4", readback, rgba8));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> bgra8 = CreateTexture2D(backend, DXGI_FORMAT_B8G8R8A8_UNORM_SRGB, size, size, 1);
+		cases.push_back(ReadAsFloat4Case("2d/bgra8srgb/" + sizeName + "/mip0/float4", readback, bgra8));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> r32 = CreateTexture2D(backend, DXGI_FORMAT_R32_FLOAT, size, size, 1);
+		cases.push_back(ReadCase<float>("2d/r32f/" + sizeName + "/mip0/float", readback, r32));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> rgba16f = CreateTexture2D(backend, DXGI_FORMAT_R16G16B16A16_FLOAT, size, size, 1);
+		cases.push_back(ReadCase<unsigned long long>("2d/rgba16f/" + sizeName + "/mip0/raw64", readback, rgba16f));
+		cases.push_back(ReadAsFloat4Case("2d/rgba16f/" + sizeName + "/mip0/float4", readback, rgba16f));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> rgba32f = CreateTexture2D(backend, DXGI_FORMAT_R32G32B32A32_FLOAT, size, size, 1);
+		cases.push_back(ReadCase<DirectX::XMFLOAT4>("2d/rgba32f/" + sizeName + "/mip0/float4", readback, rgba32f));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> bc1 = CreateTexture2D(backend, DXGI_FORMAT_BC1_UNORM, size, size, 1);
+		cases.push_back(ReadCase<EZBlock8>("2d/bc1/" + sizeName + "/mip0/blocks", readback, bc1));
+		cases.push_back(ReadDecompressedCase("2d/bc1/" + sizeName + "/mip0/color4", readback, bc1));
+
+		Microsoft::WRL::ComPtr<ID3D11Resource> bc7 = CreateTexture2D(backend, DXGI_FORMAT_BC7_UNORM, size, size, 1);
+		cases.push_back(ReadCase<EZBlock16>("2d/bc7/" + sizeName + "/mip0/blocks", readback, bc7));
+		cases.push_back(ReadDecompressedCase("2d/bc7/" + sizeName + "/mip0/color4", readback, bc7));
+	}
+
+	// Mip chains: a single small mip and the whole chain
+	Microsoft::WRL::ComPtr<ID3D11Resource> mipped = CreateTexture2D(backend, DXGI_FORMAT_R8G8B8A8_UNORM, large, large, 0);
+	cases.push_back(ReadCase<EZColor4>("2d/rgba8/" + largeName + "x" + largeName + "/mip3/color4", readback, mipped, 3));
+	cases.push_back(ReadAllCase<EZColor4>("2d/rgba8/" + largeName + "x" + largeName + "/allmips/color4", readback, mipped));
+
+	// 3D textures
+	std::string volumeSize = volumeName + "x" + volumeName + "x" + volumeName;
+	Microsoft::WRL::ComPtr<ID3D11Resource> rgba8Volume = CreateTexture3D(backend, DXGI_FORMAT_R8G8B8A8_UNORM, volume, volume, volume, 1);
+	cases.push_back(ReadCase<EZColor4>("3d/rgba8/" + volumeSize + "/mip0/color4", readback, rgba8Volume));
+	cases.push_back(ReadAsFloat4Case("3d/rgba8/" + volumeSize + "/mip0/float4", readback, rgba8Volume));
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> r32Volume = CreateTexture3D(backend, DXGI_FORMAT_R32_FLOAT, volume, volume, volume, 1);
+	cases.push_back(ReadCase<float>("3d/r32f/" + volumeSize + "/mip0/float", readback, r32Volume));
+
+	// Captures: a frame streamed to disk at 60 fps, which
+	// should take no longer than copying it since the read
+	// never waits for the disk, and compressing frames
+	UINT frameWidth = quick ? 1024 : 3840;
+	UINT frameHeight = quick ? 1024 : 2160;
+	std::string frameName = std::to_string(frameWidth) + "x" + std::to_string(frameHeight);
+	Microsoft::WRL::ComPtr<ID3D11Resource> frame = CreateTexture2D(backend, DXGI_FORMAT_R8G8B8A8_UNORM, frameWidth, frameHeight, 1);
+	cases.push_back(CaptureCase("capture/rgba8/" + frameName + "/mip0/raw-60fps", readback, frame, 1000.0 / 60));
+	cases.push_back(EncodeCase("capture/rgba8/" + frameName + "/mip0/encode-delta", frameWidth, frameHeight, EZCaptureFilterDelta));
+
+	return cases;
+}
+
+
+// --- RunCase --------------------------------------------
+//  Runs one case until it has enough samples and works
+//  out its median time and stage averages
+// --------------------------------------------------------
+static bool RunCase(const BenchmarkCase& benchmarkCase, EZReadback& readback, BenchmarkResult& result)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	// Warm up, which also fills the staging pool
+	if (benchmarkCase.Cold)
+		readback.ClearStagingPool();
+	result.Name = benchmarkCase.Name;
+	result.Bytes = benchmarkCase.Run();
+	if (result.Bytes == 0)
+		return false;
+
+	readback.ResetReadbackStats();
+	std::vector<double> samples;
+	Clock::time_point begin = Clock::now();
+	Clock::time_point start = begin;
+	while ((int)samples.size() < BenchmarkMinIterations ||
+		((int)samples.size() < BenchmarkMaxIterations && std::chrono::duration<double>(Clock::now() - begin).count() < BenchmarkMinSeconds))
+	{
+		if (benchmarkCase.Cold)
+			readback.ClearStagingPool();
+
+		// Wait for the next frame, outside the measurement
+		if (benchmarkCase.IntervalMilliseconds > 0)
+			std::this_thread::sleep_until(start + std::chrono::duration<double, std::milli>(benchmarkCase.IntervalMilliseconds));
+
+		start = Clock::now();
+		if (benchmarkCase.Run() != result.Bytes)
+			return false;
+		samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+
+	std::sort(samples.begin(), samples.end());
+	result.Iterations = (int)samples.size();
+	result.MedianMilliseconds = samples[samples.size() / 2];
+	result.GBPerSecond = result.Bytes / (result.MedianMilliseconds * 1e6);
+
+	EZReadbackStats stats = readback.GetReadbackStats();
+	for (int stage = 0; stage < EZReadbackStageCount; stage++)
+		result.StageMilliseconds[stage] = stats.Stages[stage].TotalMilliseconds / result.Iterations;
+	return true;
+}
+
+
+// --- CSV ------------------------------------------------
+//  Writing results and reading back the name and GB/s of
+//  each case of a baseline
+// --------------------------------------------------------
+static const char* CSVHeader = "name,bytes,iterations,median_ms,gb_per_s,create_ms,copy_ms,map_ms,read_ms\n";
+
+static void WriteCSV(FILE* file, const std::vector<BenchmarkResult>& results)
+{
+	fputs(CSVHeader, file);
+	for (const BenchmarkResult& result : results)
+	{
+		fprintf(file, "%s,%zu,%d,%.6f,%.4f,%.6f,%.6f,%.6f,%.6f\n",
+			result.Name.c_str(), result.Bytes, result.Iterations, result.MedianMilliseconds, result.GBPerSecond,
+			result.StageMilliseconds[EZReadbackStageCreate], result.StageMilliseconds[EZReadbackStageCopy],
+			result.StageMilliseconds[EZReadbackStageMap], result.StageMilliseconds[EZReadbackStageRead]);
+	}
+}
+
+static bool ReadBaseline(const char* path, std::map<std::string, double>& baseline)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	char line[1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		// name,bytes,iterations,median_ms,gb_per_s,...
+		char* fields[5] = {};
+		char* cursor = line;
+		int count = 0;
+		for (; count < 5 && cursor; count++)
+		{
+			fields[count] = cursor;
+			cursor = strchr(cursor, ',');
+			if (cursor)
+				*cursor++ = 0;
+		}
+		if (count == 5 && strcmp(fields[0], "name") != 0)
+			baseline[fields[0]] = atof(fields[4]);
+	}
+
+	fclose(file);
+	return true;
+}
+
+
+// --- main -----------------------------------------------
+int main(int argc, char** argv)
+{
+	const char* outPath = nullptr;
+	const char* baselinePath = nullptr;
+	const char* filter = nullptr;
+	double tolerance = 0.10;
+	bool quick = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			outPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--quick") == 0)
+			quick = true;
+		else
+		{
+			fprintf(stderr, "Usage: %s [--out results.csv] [--baseline baseline.csv] [--tolerance 0.10] [--filter text] [--quick]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::map<std::string, double> baseline;
+	if (baselinePath && !ReadBaseline(baselinePath, baseline))
+	{
+		fprintf(stderr, "Could not read baseline %s\n", baselinePath);
+		return 2;
+	}
+
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+	readback.EnableProfiling();
+	std::vector<BenchmarkCase> cases = BuildCases(*backend, readback, quick);
+
+	// Run everything, printing as we go
+	std::vector<BenchmarkResult> results;
+	int failures = 0;
+	int regressions = 0;
+	printf("%-44s %10s %10s %9s\n", "case", "MB", "median ms", "GB/s");
+	for (const BenchmarkCase& benchmarkCase : cases)
+	{
+		if (filter && benchmarkCase.Name.find(filter) == std::string::npos)
+			continue;
+
+		BenchmarkResult result = {};
+		if (!RunCase(benchmarkCase, readback, result))
+		{
+			printf("%-44s FAILED\n", benchmarkCase.Name.c_str());
+			failures++;
+			continue;
+		}
+
+		printf("%-44s %10.2f %10.4f %9.3f", result.Name.c_str(), result.Bytes / 1e6, result.MedianMilliseconds, result.GBPerSecond);
+		auto previous = baseline.find(result.Name);
+		if (previous != baseline.end() && previous->second > 0)
+		{
+			double change = result.GBPerSecond / previous->second - 1;
+			bool regressed = change < -tolerance;
+			printf("  %+6.1f%%%s", change * 100, regressed ? "  REGRESSION" : "");
+			regressions += regressed;
+		}
+		printf("\n");
+		results.push_back(result);
+	}
+
+	if (outPath)
+	{
+		FILE* file = fopen(outPath, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Could not write %s\n", outPath);
+			return 2;
+		}
+		WriteCSV(file, results);
+		fclose(file);
+	}
+
+	// Close the captures before removing them
+	cases.clear();
+	remove(BenchmarkRawPath);
+	remove(BenchmarkEncodePath);
+
+	if (baselinePath)
+		printf("%d regression(s) beyond %.0f%% against %s\n", regressions, tolerance * 100, baselinePath);
+	return failures || regressions ? 1 : 0;
+}
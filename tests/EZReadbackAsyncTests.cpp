@@ -0,0 +1,224 @@
+// --- EZReadbackAsyncTests -------------------------------
+//  Reads that do not block the caller: the async ring,
+//  batches, the worker thread (including a two-thread
+//  stress run of submitting and delivering), and the
+//  profiler that times all of them.
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+
+// Copies on the reference backend take this long to finish,
+// so non-blocking maps right after a copy always find the
+// GPU busy
+const std::chrono::milliseconds TestCopyLatency(100);
+
+static void TestAsyncRing()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_UINT, 19, 7, data);
+
+	// Without latency results are ready right away
+	std::vector<unsigned int> results;
+	EZReadbackTicket ticket = readback.ReadAsync<unsigned int>(texture.Get());
+	EZ_CHECK(ticket != EZReadbackInvalidTicket && readback.GetPendingAsyncCount() == 1);
+	std::vector<unsigned short> halves;
+	EZ_CHECK(readback.TryGet(ticket, halves) == E_INVALIDARG);
+	EZ_CHECK(readback.TryGet(ticket, results) == S_OK && EZTestEqual(results, data));
+	EZ_CHECK(readback.TryGet(ticket, results) == E_INVALIDARG && readback.GetPendingAsyncCount() == 0);
+
+	// With latency TryGet never waits, and Wait does
+	backend->SetCopyLatency(TestCopyLatency);
+	backend->ResetStats();
+	ticket = readback.ReadAsync<unsigned int>(texture.Get());
+	EZ_CHECK(readback.TryGet(ticket, results) == DXGI_ERROR_WAS_STILL_DRAWING);
+	EZ_CHECK(readback.Wait(ticket, results) == S_OK && EZTestEqual(results, data));
+	EZReferenceBackendStats stats = backend->GetStats();
+	EZ_CHECK(stats.StillDrawingCount == 1 && stats.Copies == 1 && stats.BytesCopied == data.size());
+
+	// The ring only holds as many reads as it has slots, and
+	// cannot be resized while any are in flight
+	EZ_CHECK(readback.SetAsyncRingSize(0) == E_INVALIDARG);
+	EZ_CHECK(readback.SetAsyncRingSize(2) == S_OK && readback.GetAsyncRingSize() == 2);
+	EZReadbackTicket first = readback.ReadAsync<unsigned int>(texture.Get());
+	EZReadbackTicket second = readback.ReadAsync<unsigned int>(texture.Get());
+	EZ_CHECK(first != EZReadbackInvalidTicket && second != EZReadbackInvalidTicket && first != second);
+	EZ_CHECK(readback.ReadAsync<unsigned int>(texture.Get()) == EZReadbackInvalidTicket);
+	EZ_CHECK(readback.SetAsyncRingSize(4) == E_FAIL);
+	EZ_CHECK(readback.Wait(second, results) == S_OK && readback.Wait(first, results) == S_OK && EZTestEqual(results, data));
+
+	// Callbacks run from UpdateAsync() once the copy is done
+	int calls = 0;
+	ticket = readback.ReadAsync<unsigned int>(texture.Get(), [&](HRESULT hr, std::vector<unsigned int>& values)
+	{
+		EZ_CHECK(hr == S_OK && EZTestEqual(values, data));
+		calls++;
+	});
+	EZ_CHECK(readback.TryGet(ticket, results) == E_INVALIDARG);
+	EZ_CHECK(readback.UpdateAsync() == 0 && calls == 0);
+	std::this_thread::sleep_for(TestCopyLatency * 2);
+	EZ_CHECK(readback.UpdateAsync() == 1 && calls == 1 && readback.GetPendingAsyncCount() == 0);
+
+	ticket = readback.ReadAsync<unsigned int>(texture.Get(), [&](HRESULT, std::vector<unsigned int>&) { calls++; });
+	EZ_CHECK(readback.Wait(ticket) == S_OK && calls == 2);
+}
+
+static void TestBatch()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> textureData, bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 31, 15, textureData);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 256, bufferData);
+
+	std::vector<EZColor4> colors;
+	std::vector<unsigned int> values;
+	std::vector<unsigned short> mismatched;
+	EZReadback::Batch batch = readback.CreateBatch();
+	EZ_CHECK(batch.Add(texture.Get(), colors) == S_OK);
+	EZ_CHECK(batch.Add(buffer.Get(), values) == S_OK);
+	EZ_CHECK(FAILED(batch.Add(texture.Get(), mismatched)) && batch.GetCount() == 2);
+
+	// Nothing is read until Submit()
+	EZ_CHECK(colors.empty() && values.empty());
+	EZ_CHECK(batch.Submit() == S_OK && batch.GetCount() == 0);
+	EZ_CHECK(EZTestEqual(colors, textureData) && EZTestEqual(values, bufferData));
+	EZReadbackBatchStats stats = batch.GetStats();
+	EZ_CHECK(stats.ReadCount == 2 && stats.BytesRead == textureData.size() + bufferData.size());
+
+	// Cleared reads hand their staging resources back
+	EZ_CHECK(batch.Add(texture.Get(), colors) == S_OK);
+	batch.Clear();
+	EZ_CHECK(batch.GetCount() == 0 && readback.GetStagingPoolStats().BytesInUse == 0);
+}
+
+static void TestThreaded()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	backend->SetCopyLatency(std::chrono::milliseconds(5));
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 16, 16, data);
+
+	// Without a worker threaded reads are refused
+	EZ_CHECK(readback.ReadThreaded<EZColor4>(texture.Get(), [](HRESULT, std::vector<EZColor4>&) {}) == EZReadbackInvalidTicket);
+
+	EZ_CHECK(readback.StartWorker() == S_OK && readback.IsWorkerRunning());
+	int delivered = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		EZ_CHECK(readback.ReadThreaded<EZColor4>(texture.Get(), [&](HRESULT hr, std::vector<EZColor4>& colors)
+		{
+			EZ_CHECK(hr == S_OK && EZTestEqual(colors, data));
+			delivered++;
+		}) != EZReadbackInvalidTicket);
+	}
+	EZ_CHECK(readback.ReadThreadedAsFloat4(texture.Get(), [&](HRESULT hr, std::vector<DirectX::XMFLOAT4>& colors)
+	{
+		EZ_CHECK(hr == S_OK && colors.size() == 256 && colors[5].y == data[5 * 4 + 1] / 255.0f);
+		delivered++;
+	}) != EZReadbackInvalidTicket);
+
+	// Callbacks only run inside DeliverThreaded()
+	while (delivered < 4)
+	{
+		readback.DeliverThreaded();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EZ_CHECK(readback.GetPendingThreadedCount() == 0);
+	readback.StopWorker();
+	EZ_CHECK(!readback.IsWorkerRunning());
+	EZ_CHECK(backend->GetStats().StillDrawingCount > 0);
+}
+
+// One thread submits as fast as the queue allows while
+// another delivers, with a queue small enough that both
+// sides keep running into it.  Every read has to arrive
+// and every staging resource has to make it back.
+static void TestThreadedStress()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_UINT, 8, 8, data);
+
+	const int readCount = 20000;
+	EZ_CHECK(readback.StartWorker(2) == S_OK);
+	std::atomic<int> delivered{ 0 };
+	std::atomic<int> failed{ 0 };
+	std::atomic<bool> submitting{ true };
+	std::thread deliverer([&]()
+	{
+		while (submitting || readback.GetPendingThreadedCount() > 0)
+		{
+			if (readback.DeliverThreaded() == 0)
+				std::this_thread::yield();
+		}
+	});
+
+	int submitted = 0;
+	while (submitted < readCount)
+	{
+		EZReadbackTicket ticket = readback.ReadThreaded<unsigned int>(texture.Get(), [&](HRESULT hr, std::vector<unsigned int>& values)
+		{
+			if (FAILED(hr) || !EZTestEqual(values, data))
+				failed++;
+			delivered++;
+		});
+		if (ticket != EZReadbackInvalidTicket)
+			submitted++;
+		else
+			std::this_thread::yield();
+	}
+	submitting = false;
+	deliverer.join();
+	readback.StopWorker();
+	readback.UpdateAsync();
+
+	EZ_CHECK(delivered == readCount && failed == 0);
+	EZStagingPoolStats stats = readback.GetStagingPoolStats();
+	EZ_CHECK(stats.BytesInUse == 0 && stats.ResourceCount <= 3);
+}
+
+static void TestProfiling()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_FLOAT, 64, 32, data);
+	std::vector<float> results;
+
+	EZ_CHECK(!readback.IsProfiling() && readback.GetReadbackStats().Stages[EZReadbackStageRead].Count == 0);
+	readback.EnableProfiling();
+	EZ_CHECK(readback.Read(texture.Get(), results) == S_OK && readback.Read(texture.Get(), results) == S_OK);
+
+#if defined(EZREADBACK_INSTRUMENTATION)
+	EZReadbackStats stats = readback.GetReadbackStats();
+	EZ_CHECK(stats.Stages[EZReadbackStageCreate].Count == 1);
+	EZ_CHECK(stats.Stages[EZReadbackStageCopy].Count == 2 && stats.Stages[EZReadbackStageMap].Count == 2);
+	EZ_CHECK(stats.Stages[EZReadbackStageRead].Count == 2 && stats.Stages[EZReadbackStageRead].Bytes == 2 * data.size());
+
+	readback.SetTracing(true);
+	EZ_CHECK(readback.Read(texture.Get(), results) == S_OK);
+	std::string trace = readback.ExportChromeTrace();
+	EZ_CHECK(trace.find("\"traceEvents\"") != std::string::npos && trace.find("\"Read\"") != std::string::npos);
+
+	readback.ResetReadbackStats();
+	EZ_CHECK(readback.GetReadbackStats().Stages[EZReadbackStageRead].Count == 0);
+#endif
+}
+
+int main()
+{
+	TestAsyncRing();
+	TestBatch();
+	TestThreaded();
+	TestThreadedStress();
+	TestProfiling();
+	return EZTestResult("EZReadbackAsyncTests");
+}
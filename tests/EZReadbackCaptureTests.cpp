@@ -0,0 +1,267 @@
+// --- EZReadbackCaptureTests -----------------------------
+//  Captures: DDS and raw files written through the queue
+//  of EZCaptureWriter, and the compressed capture format
+//  round-tripping through EZCaptureEncoder and Decoder.
+//  Files are written to the working directory and removed
+//  afterwards.
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+
+const char* TestDDSPath = "EZReadbackCaptureTests.dds";
+const char* TestRawPath = "EZReadbackCaptureTests.raw";
+const char* TestEncodedPath = "EZReadbackCaptureTests.ezc";
+
+static std::vector<unsigned char> ReadFile(const char* path)
+{
+	std::vector<unsigned char> bytes;
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return bytes;
+
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		bytes.insert(bytes.end(), buffer, buffer + read);
+	fclose(file);
+	return bytes;
+}
+
+static void TestDDS()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	backend->SetRowPitchAlignment(256);
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 37, 9, data);
+
+	EZCaptureWriter writer;
+	EZ_CHECK(readback.ReadToDDS(texture.Get(), writer) == E_INVALIDARG);
+	EZ_CHECK(writer.Open(TestDDSPath) == S_OK && writer.Open(TestDDSPath) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadToDDS(texture.Get(), writer) == S_OK);
+	EZ_CHECK(writer.Close() == S_OK && !writer.IsOpen());
+
+	// Rows are written without their padding
+	std::vector<unsigned char> file = ReadFile(TestDDSPath);
+	EZDDSHeader header;
+	EZ_CHECK(file.size() == sizeof(header) + data.size());
+	if (file.size() == sizeof(header) + data.size())
+	{
+		memcpy(&header, file.data(), sizeof(header));
+		EZ_CHECK(memcmp(file.data(), "DDS ", 4) == 0 && memcmp(&header.FourCC, "DX10", 4) == 0);
+		EZ_CHECK(header.Width == 37 && header.Height == 9 && header.PitchOrLinearSize == 37 * 4 && header.DXGIFormat == DXGI_FORMAT_R8G8B8A8_UNORM);
+		EZ_CHECK(memcmp(file.data() + sizeof(header), data.data(), data.size()) == 0);
+	}
+	remove(TestDDSPath);
+}
+
+// Raw chunks of several resources through a queue much
+// smaller than what is captured, so reads keep waiting on
+// the writing thread, and one chunk is larger than the
+// whole queue
+static void TestRawQueue()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> textureData, bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_FLOAT, 64, 48, textureData);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 1000, bufferData);
+
+	const int frames = 50;
+	EZCaptureWriter writer;
+	EZ_CHECK(writer.Open(TestRawPath, 256, 4096) == S_OK);
+	for (int frame = 0; frame < frames; frame++)
+	{
+		EZ_CHECK(readback.ReadToRaw(texture.Get(), writer) == S_OK);
+		EZ_CHECK(readback.ReadToRaw(buffer.Get(), writer) == S_OK);
+	}
+	EZ_CHECK(readback.ReadToDDS(buffer.Get(), writer) == E_INVALIDARG);
+	unsigned long long written = writer.GetBytesWritten();
+	EZ_CHECK(writer.Close() == S_OK);
+
+	std::vector<unsigned char> file = ReadFile(TestRawPath);
+	EZ_CHECK(file.size() == written && file.size() == frames * (2 * sizeof(EZCaptureChunkHeader) + textureData.size() + bufferData.size()));
+
+	// Every chunk arrives whole and in order
+	size_t offset = 0;
+	int chunks = 0;
+	while (offset + sizeof(EZCaptureChunkHeader) <= file.size())
+	{
+		EZCaptureChunkHeader chunk;
+		memcpy(&chunk, file.data() + offset, sizeof(chunk));
+		const std::vector<unsigned char>& expected = chunks % 2 ? bufferData : textureData;
+		EZ_CHECK(chunk.Magic == EZCaptureChunkMagic && chunk.HeaderSize == sizeof(chunk) && chunk.PayloadBytes == expected.size());
+		if (chunk.PayloadBytes != expected.size() || offset + chunk.HeaderSize + expected.size() > file.size())
+			break;
+
+		EZ_CHECK(memcmp(file.data() + offset + chunk.HeaderSize, expected.data(), expected.size()) == 0);
+		offset += chunk.HeaderSize + expected.size();
+		chunks++;
+	}
+	EZ_CHECK(chunks == 2 * frames && offset == file.size());
+	remove(TestRawPath);
+
+	// Writes past a failed open are refused
+	EZ_CHECK(writer.Open("missing-directory/EZReadbackCaptureTests.raw") == E_FAIL);
+	EZ_CHECK(writer.Write(bufferData.data(), bufferData.size()) == E_INVALIDARG);
+}
+
+// Compression round trips data of every kind, and damaged
+// data never makes decompression leave its buffers
+static void TestLZ()
+{
+	std::mt19937 random(7);
+	std::vector<unsigned int> table(EZLZTableSize);
+	for (int iteration = 0; iteration < 500; iteration++)
+	{
+		size_t size = iteration < 40 ? iteration : random() % 5000;
+		std::vector<unsigned char> source(size);
+		int kind = iteration % 4;
+		for (size_t i = 0; i < size; i++)
+			source[i] = kind == 0 ? (unsigned char)random() : kind == 1 ? 0 : kind == 2 ? (unsigned char)(i % (1 + iteration % 13)) : (unsigned char)(random() % 8 ? 0 : random());
+
+		std::vector<unsigned char> compressed(EZLZBound(size));
+		size_t compressedSize = EZLZCompress(source.data(), size, compressed.data(), compressed.size(), table.data());
+		EZ_CHECK(compressedSize > 0);
+
+		std::vector<unsigned char> decompressed(size + 1);
+		EZ_CHECK(EZLZDecompress(compressed.data(), compressedSize, decompressed.data(), size));
+		EZ_CHECK(size == 0 || memcmp(decompressed.data(), source.data(), size) == 0);
+		EZ_CHECK(!EZLZDecompress(compressed.data(), compressedSize, decompressed.data(), size + 1));
+
+		// Random data does not fit in less than its own size
+		if (kind == 0 && size > 100)
+			EZ_CHECK(EZLZCompress(source.data(), size, compressed.data(), size - 1, table.data()) == 0);
+
+		// Damaged data fails or decodes to garbage
+		if (compressedSize > 0)
+		{
+			compressed[random() % compressedSize] ^= (unsigned char)(1 + random() % 255);
+			EZLZDecompress(compressed.data(), compressedSize, decompressed.data(), size);
+		}
+	}
+}
+
+// Filters undo exactly, in place too, and the AVX2 version
+// matches the scalar one
+static void TestCaptureFilters()
+{
+	std::vector<unsigned char> source = EZTestRandomBytes(1003, 1), previous = EZTestRandomBytes(1003, 2);
+	for (EZCaptureFilter filter : { EZCaptureFilterNone, EZCaptureFilterDelta, EZCaptureFilterXor })
+	{
+		for (size_t channelSize : { (size_t)1, (size_t)2, (size_t)3, (size_t)4 })
+		{
+			std::vector<unsigned char> filtered(source.size()), restored(source.size());
+			EZCaptureFilterData(filter, false, channelSize, filtered.data(), source.data(), previous.data(), source.size());
+			EZCaptureFilterData(filter, true, channelSize, restored.data(), filtered.data(), previous.data(), source.size());
+			EZ_CHECK(restored == source);
+			EZCaptureFilterData(filter, true, channelSize, filtered.data(), filtered.data(), previous.data(), source.size());
+			EZ_CHECK(filtered == source);
+		}
+	}
+
+	std::vector<unsigned char> delta(source.size());
+	EZCaptureFilterData(EZCaptureFilterDelta, false, 2, delta.data(), source.data(), previous.data(), source.size());
+	unsigned short value, reference, result;
+	memcpy(&value, &source[400], 2);
+	memcpy(&reference, &previous[400], 2);
+	memcpy(&result, &delta[400], 2);
+	EZ_CHECK(result == (unsigned short)(value - reference));
+
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		std::vector<unsigned char> expected(1000), results(1000);
+		EZCaptureFilterScalar<unsigned int>(EZCaptureFilterDelta, false, expected.data(), source.data(), previous.data(), 250);
+		EZCaptureFilterAVX2<unsigned int>(EZCaptureFilterDelta, false, results.data(), source.data(), previous.data(), 250);
+		EZ_CHECK(results == expected);
+		EZCaptureFilterScalar<unsigned short>(EZCaptureFilterDelta, true, expected.data(), source.data(), previous.data(), 500);
+		EZCaptureFilterAVX2<unsigned short>(EZCaptureFilterDelta, true, results.data(), source.data(), previous.data(), 500);
+		EZ_CHECK(results == expected);
+		EZCaptureFilterScalar<unsigned char>(EZCaptureFilterXor, false, expected.data(), source.data(), previous.data(), 1000);
+		EZCaptureFilterAVX2<unsigned char>(EZCaptureFilterXor, false, results.data(), source.data(), previous.data(), 1000);
+		EZ_CHECK(results == expected);
+	}
+#endif
+}
+
+// Frames come back exactly, in any order, across
+// keyframes, a change of size and an empty frame, with
+// every filter
+static void TestCodec()
+{
+	const UINT width = 320, height = 200;
+	std::mt19937 random(11);
+	for (EZCaptureFilter filter : { EZCaptureFilterNone, EZCaptureFilterDelta, EZCaptureFilterXor })
+	{
+		EZCaptureEncoderOptions options;
+		options.Filter = filter;
+		options.KeyframeInterval = 7;
+		options.ChunkSize = 10000;
+		options.ThreadCount = 3;
+		EZCaptureEncoder encoder;
+		EZ_CHECK(encoder.Open(TestEncodedPath, options) == S_OK && encoder.Open(TestEncodedPath) == E_INVALIDARG);
+
+		std::vector<std::vector<EZColor4>> frames;
+		std::vector<EZColor4> frame(width * height);
+		for (size_t i = 0; i < frame.size(); i++)
+			frame[i] = EZColor4((unsigned char)(i % width), (unsigned char)(i / width), (unsigned char)(random() & 3), 255);
+		for (int k = 0; k < 20; k++)
+		{
+			for (int j = 0; j < 100; j++)
+				frame[random() % frame.size()].RedInt = (unsigned char)random();
+			if (k == 12)
+				frame.resize(width * height / 2);
+			frames.push_back(frame);
+			EZ_CHECK(encoder.AddFrame(frame, width, k >= 12 ? height / 2 : height, DXGI_FORMAT_R8G8B8A8_UNORM) == S_OK);
+
+			// The next frame may change the caller's data as soon
+			// as AddFrame() returns
+			std::fill(frame.begin(), frame.begin() + 10, EZColor4());
+		}
+		EZ_CHECK(encoder.AddFrame(nullptr, 0, 1) == S_OK);
+		frames.push_back(std::vector<EZColor4>());
+		EZ_CHECK(encoder.GetFrameCount() == 21 && encoder.Close() == S_OK);
+
+		EZCaptureDecoder decoder(2);
+		EZ_CHECK(decoder.Open(TestEncodedPath) == S_OK && decoder.GetFrameCount() == 21);
+		if (decoder.GetFrameCount() != 21)
+			continue;
+		EZ_CHECK(decoder.GetFrameInfo(3).Width == width && decoder.GetFrameInfo(13).Height == height / 2);
+		EZ_CHECK(decoder.GetFrameInfo(7).Filter == EZCaptureFilterNone && decoder.GetFrameInfo(12).Filter == EZCaptureFilterNone);
+		EZ_CHECK(decoder.GetFrameInfo(8).Filter == (UINT)filter);
+
+		std::vector<EZColor4> results;
+		for (UINT i = 0; i < 21; i++)
+			EZ_CHECK(decoder.ReadFrame(i, results) == S_OK && results.size() == frames[i].size() && (results.empty() || memcmp(results.data(), frames[i].data(), results.size() * 4) == 0));
+		for (int i = 0; i < 10; i++)
+		{
+			UINT index = random() % 21;
+			EZ_CHECK(decoder.ReadFrame(index, results) == S_OK && results.size() == frames[index].size() && (results.empty() || memcmp(results.data(), frames[index].data(), results.size() * 4) == 0));
+		}
+		EZ_CHECK(decoder.ReadFrame(21, results) == E_INVALIDARG);
+		decoder.Close();
+		EZ_CHECK(decoder.ReadFrame(0, results) == E_INVALIDARG);
+	}
+
+	// A truncated file is refused
+	std::vector<unsigned char> file = ReadFile(TestEncodedPath);
+	FILE* truncated = fopen(TestEncodedPath, "wb");
+	EZ_CHECK(truncated && fwrite(file.data(), 1, file.size() - 3, truncated) == file.size() - 3);
+	if (truncated)
+		fclose(truncated);
+	EZCaptureDecoder decoder;
+	EZ_CHECK(decoder.Open(TestEncodedPath) == E_FAIL);
+	remove(TestEncodedPath);
+}
+
+int main()
+{
+	TestDDS();
+	TestRawQueue();
+	TestLZ();
+	TestCaptureFilters();
+	TestCodec();
+	return EZTestResult("EZReadbackCaptureTests");
+}
@@ -0,0 +1,499 @@
+// --- EZReadbackDecodeTests ------------------------------
+//  CPU kernels: every SIMD version against its scalar
+//  version, depth/stencil splitting, YUV conversion, field
+//  projection, block decompression, reductions, and the
+//  thread pool that spreads them over threads.  SIMD
+//  versions the CPU lacks are skipped.
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+
+static bool SameBits(const void* a, const void* b, size_t bytes)
+{
+	return memcmp(a, b, bytes) == 0;
+}
+
+static void TestUNorm8()
+{
+	// Every value, with counts that leave a scalar tail
+	std::vector<unsigned char> values(1000);
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = (unsigned char)(i * 7);
+
+	std::vector<float> expected(values.size()), results(values.size());
+	EZConvertUNorm8ToFloatScalar(values.data(), values.size(), expected.data());
+	for (size_t i = 0; i < values.size(); i++)
+		EZ_CHECK(expected[i] == EZColor4(values[i], 0, 0, 0).AsFloat1());
+
+#if defined(EZREADBACK_X86)
+	for (size_t count : { (size_t)1000, (size_t)999, (size_t)17, (size_t)3 })
+	{
+		std::fill(results.begin(), results.end(), -1.0f);
+		EZConvertUNorm8ToFloatSSE2(values.data(), count, results.data());
+		EZ_CHECK(SameBits(results.data(), expected.data(), count * 4) && results[count - 1] >= 0.0f);
+
+		if (EZCpuFeatures::Get().AVX2)
+		{
+			std::fill(results.begin(), results.end(), -1.0f);
+			EZConvertUNorm8ToFloatAVX2(values.data(), count, results.data());
+			EZ_CHECK(SameBits(results.data(), expected.data(), count * 4));
+		}
+	}
+#endif
+}
+
+static void TestHalf()
+{
+	// Every half, including denormals, infinities and NaNs
+	std::vector<unsigned short> halves(65536);
+	for (size_t i = 0; i < halves.size(); i++)
+		halves[i] = (unsigned short)i;
+
+	std::vector<DirectX::XMFLOAT4> expected(halves.size() / 4), results(halves.size() / 4);
+	float* out = &expected[0].x;
+	for (size_t i = 0; i < halves.size(); i++)
+		out[i] = EZHalfToFloat(halves[i]);
+
+	EZ_CHECK(EZHalfToFloat(0x3C00) == 1.0f && EZHalfToFloat(0xC000) == -2.0f && EZHalfToFloat(0x0001) == 5.9604645e-8f);
+	EZ_CHECK(EZHalfToFloat(0x7C00) == std::numeric_limits<float>::infinity());
+
+	EZDecodeHalf4(halves.data(), results.size(), results.data());
+	EZ_CHECK(SameBits(results.data(), expected.data(), results.size() * 16));
+
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().F16C)
+	{
+		std::fill(results.begin(), results.end(), DirectX::XMFLOAT4());
+		EZDecodeHalf4F16C(halves.data(), results.size(), results.data());
+		EZ_CHECK(SameBits(results.data(), expected.data(), results.size() * 16));
+	}
+#endif
+}
+
+static void TestBGRA8()
+{
+	std::vector<unsigned char> bytes = EZTestRandomBytes(4 * 101);
+	const unsigned int* texels = reinterpret_cast<const unsigned int*>(bytes.data());
+
+	for (unsigned int alphaMask : { 0u, 0xFF000000u })
+	{
+		std::vector<unsigned int> expected(101), results(101);
+		for (size_t i = 0; i < expected.size(); i++)
+		{
+			const unsigned char* bgra = &bytes[i * 4];
+			expected[i] = (bgra[2] | bgra[1] << 8 | bgra[0] << 16 | (unsigned int)bgra[3] << 24) | alphaMask;
+		}
+
+		EZSwizzleBGRA8(texels, results.size(), results.data(), alphaMask);
+		EZ_CHECK(results == expected);
+#if defined(EZREADBACK_X86)
+		if (EZCpuFeatures::Get().AVX2)
+		{
+			std::fill(results.begin(), results.end(), 0);
+			EZSwizzleBGRA8AVX2(texels, results.size(), results.data(), alphaMask);
+			EZ_CHECK(results == expected);
+		}
+#endif
+	}
+
+	// Decoded BGRA matches decoded RGBA with the bytes swapped
+	std::vector<unsigned char> swapped(bytes);
+	for (size_t i = 0; i < swapped.size(); i += 4)
+		std::swap(swapped[i], swapped[i + 2]);
+	std::vector<DirectX::XMFLOAT4> rgba(101), bgra(101);
+	EZ_CHECK(EZDecodeToFloat4(DXGI_FORMAT_R8G8B8A8_UNORM, swapped.data(), 101, rgba.data()) == S_OK);
+	EZ_CHECK(EZDecodeToFloat4(DXGI_FORMAT_B8G8R8A8_UNORM, bytes.data(), 101, bgra.data()) == S_OK);
+	EZ_CHECK(SameBits(rgba.data(), bgra.data(), 101 * 16));
+}
+
+static void TestR11G11B10()
+{
+	std::vector<unsigned char> bytes = EZTestRandomBytes(4 * 1003);
+	const unsigned int* texels = reinterpret_cast<const unsigned int*>(bytes.data());
+
+	std::vector<DirectX::XMFLOAT4> expected(1003), results(1003);
+	EZDecodeR11G11B10Scalar(texels, expected.size(), expected.data());
+
+	// 1.0 in each channel
+	unsigned int one = 0x3C0u << 0 | 0x3C0u << 11 | 0x1E0u << 22;
+	DirectX::XMFLOAT4 decoded;
+	EZDecodeR11G11B10Scalar(&one, 1, &decoded);
+	EZ_CHECK(decoded.x == 1.0f && decoded.y == 1.0f && decoded.z == 1.0f && decoded.w == 1.0f);
+
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		EZDecodeR11G11B10AVX2(texels, results.size(), results.data());
+		EZ_CHECK(SameBits(results.data(), expected.data(), results.size() * 16));
+	}
+#endif
+}
+
+static void TestDepthStencil()
+{
+	const EZDepthLayout layouts[] = { EZDepthLayoutD16, EZDepthLayoutD24S8, EZDepthLayoutD32, EZDepthLayoutD32S8 };
+	const DXGI_FORMAT formats[] = { DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_D24_UNORM_S8_UINT, DXGI_FORMAT_D32_FLOAT, DXGI_FORMAT_D32_FLOAT_S8X24_UINT };
+	const size_t texelSizes[] = { 2, 4, 4, 8 };
+	const size_t count = 1003;
+
+	for (int layout = 0; layout < 4; layout++)
+	{
+		// Float depth between 0 and 1, so linearizing stays finite
+		std::vector<unsigned char> texels = EZTestRandomBytes(count * texelSizes[layout]);
+		if (layouts[layout] == EZDepthLayoutD32 || layouts[layout] == EZDepthLayoutD32S8)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float value = (i * 7919 % 10007) / 10007.0f;
+				memcpy(&texels[i * texelSizes[layout]], &value, 4);
+			}
+		}
+		std::vector<DirectX::XMFLOAT4> colors(count);
+		EZDecodeToFloat4(formats[layout], texels.data(), count, colors.data());
+
+		for (bool linearize : { false, true })
+		{
+			EZDepthOptions options;
+			options.Linearize = linearize;
+			options.NearPlane = 0.5f;
+			options.FarPlane = 300.0f;
+			std::vector<float> expected(count), depth(count + 1, -1.0f);
+			std::vector<unsigned char> expectedStencil(count), stencil(count + 1, 77);
+			EZDecodeDepthStencilScalar(layouts[layout], texels.data(), count, expected.data(), expectedStencil.data(), options);
+
+			// Without linearizing, depth and stencil match the
+			// x and y of EZDecodeToFloat4()
+			for (size_t i = 0; i < count; i++)
+			{
+				if (!linearize)
+					EZ_CHECK(expected[i] == colors[i].x);
+				else
+					EZ_CHECK(fabsf(expected[i] - 150.0f / (300.0f - colors[i].x * 299.5f)) <= 1e-3f * expected[i]);
+				if (EZHasStencil(layouts[layout]))
+					EZ_CHECK(expectedStencil[i] == colors[i].y);
+			}
+
+			EZDecodeDepthStencil(layouts[layout], texels.data(), count, depth.data(), stencil.data(), options);
+			EZ_CHECK(SameBits(depth.data(), expected.data(), count * 4) && depth[count] == -1.0f);
+			EZ_CHECK(SameBits(stencil.data(), expectedStencil.data(), count) && stencil[count] == 77);
+#if defined(EZREADBACK_X86)
+			if (EZCpuFeatures::Get().AVX2)
+			{
+				std::fill(depth.begin(), depth.end(), -1.0f);
+				EZDecodeDepthStencilAVX2(layouts[layout], texels.data(), count, depth.data(), nullptr, options);
+				EZ_CHECK(SameBits(depth.data(), expected.data(), count * 4) && depth[count] == -1.0f);
+				EZDecodeDepthStencilAVX2(layouts[layout], texels.data(), count, nullptr, stencil.data(), options);
+				EZ_CHECK(SameBits(stencil.data(), expectedStencil.data(), count));
+			}
+#endif
+		}
+	}
+
+	// Reversed Z swaps the planes
+	EZDepthOptions options;
+	options.Linearize = true;
+	options.NearPlane = 1.0f;
+	options.FarPlane = 100.0f;
+	unsigned int texels[2] = { 0, 0xFFFFFF };
+	float depth[2];
+	EZDecodeDepthStencil(EZDepthLayoutD24S8, texels, 2, depth, nullptr, options);
+	EZ_CHECK(depth[0] == 1.0f && fabsf(depth[1] - 100.0f) < 1e-3f);
+	std::swap(options.NearPlane, options.FarPlane);
+	EZDecodeDepthStencil(EZDepthLayoutD24S8, texels, 2, depth, nullptr, options);
+	EZ_CHECK(fabsf(depth[0] - 100.0f) < 1e-3f && depth[1] == 1.0f);
+
+	EZ_CHECK(EZGetDepthLayout(DXGI_FORMAT_R24G8_TYPELESS) == EZDepthLayoutD24S8);
+	EZ_CHECK(EZGetDepthLayout(DXGI_FORMAT_R32_FLOAT) == EZDepthLayoutNone);
+}
+
+template<typename SampleType, typename OutputType>
+static void CheckYUVRow(const EZYUVCoefficients& k)
+{
+	// Rows of 4:2:0 samples have one U/V pair per two pixels
+	const size_t count = 1002;
+	std::vector<unsigned char> bytes = EZTestRandomBytes(count * 2 * sizeof(SampleType));
+	const SampleType* luma = reinterpret_cast<const SampleType*>(bytes.data());
+	const SampleType* chroma = luma + count;
+
+	std::vector<OutputType> expected(count), results(count);
+	EZConvertYUVRowScalar(luma, chroma, 0, count, expected.data(), k);
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		for (size_t width : { count, (size_t)18, (size_t)6 })
+		{
+			std::fill(results.begin(), results.end(), OutputType());
+			EZConvertYUVRowAVX2(luma, chroma, width, results.data(), k);
+			EZ_CHECK(SameBits(results.data(), expected.data(), width * sizeof(OutputType)));
+		}
+	}
+#endif
+}
+
+static void TestYUV()
+{
+	for (EZYUVMatrix matrix : { EZYUVMatrixBT601, EZYUVMatrixBT709, EZYUVMatrixBT2020 })
+	{
+		for (bool fullRange : { false, true })
+		{
+			EZYUVOptions options;
+			options.Matrix = matrix;
+			options.FullRange = fullRange;
+			CheckYUVRow<unsigned char, EZColor4>(EZGetYUVCoefficients(options, 1));
+			CheckYUVRow<unsigned char, DirectX::XMFLOAT4>(EZGetYUVCoefficients(options, 1));
+			CheckYUVRow<unsigned short, EZColor4>(EZGetYUVCoefficients(options, 2));
+			CheckYUVRow<unsigned short, DirectX::XMFLOAT4>(EZGetYUVCoefficients(options, 2));
+		}
+	}
+
+	// Limited range BT.709 white, black and red
+	EZYUVCoefficients k = EZGetYUVCoefficients(EZYUVOptions(), 1);
+	unsigned char luma[2] = { 235, 16 }, chroma[2] = { 128, 128 };
+	EZColor4 colors[2];
+	EZConvertYUVRowScalar(luma, chroma, 0, 2, colors, k);
+	EZ_CHECK(colors[0].RedInt == 255 && colors[0].GreenInt == 255 && colors[0].BlueInt == 255 && colors[0].AlphaInt == 255);
+	EZ_CHECK(colors[1].RedInt == 0 && colors[1].GreenInt == 0 && colors[1].BlueInt == 0 && colors[1].AlphaInt == 255);
+	unsigned char redLuma[2] = { 63, 63 }, redChroma[2] = { 102, 240 };
+	EZConvertYUVRowScalar(redLuma, redChroma, 0, 2, colors, k);
+	EZ_CHECK(colors[0].RedInt >= 253 && colors[0].GreenInt <= 2 && colors[0].BlueInt <= 2);
+
+	// 16-bit samples use the same ranges scaled by 256
+	unsigned short luma16[2] = { 235 * 256, 16 * 256 }, chroma16[2] = { 32768, 32768 };
+	DirectX::XMFLOAT4 values[2];
+	EZConvertYUVRowScalar(luma16, chroma16, 0, 2, values, EZGetYUVCoefficients(EZYUVOptions(), 2));
+	EZ_CHECK(fabsf(values[0].x - 1.0f) < 1e-5f && fabsf(values[1].y) < 1e-5f);
+
+	// Threaded conversion of pitched planes matches row by row
+	const UINT width = 38, height = 10, pitch = 48;
+	std::vector<unsigned char> planes = EZTestRandomBytes(pitch * (height + height / 2));
+	std::vector<EZColor4> expected(width * height), results(width * height);
+	for (UINT row = 0; row < height; row++)
+		EZConvertYUVRowScalar(planes.data() + row * pitch, planes.data() + (height + row / 2) * pitch, 0, width, expected.data() + row * width, k);
+	EZYUVOptions threaded;
+	threaded.ThreadCount = 3;
+	EZ_CHECK(EZConvertYUV(DXGI_FORMAT_NV12, planes.data(), pitch, planes.data() + height * pitch, pitch, width, height, results.data(), threaded) == S_OK);
+	EZ_CHECK(SameBits(results.data(), expected.data(), results.size() * 4));
+	EZ_CHECK(EZConvertYUV(DXGI_FORMAT_NV11, planes.data(), pitch, planes.data(), pitch, 2, 2, results.data()) == E_INVALIDARG);
+}
+
+static void TestProjectFields()
+{
+	// An odd stride puts fields at every alignment
+	const size_t stride = 13, count = 1001;
+	std::vector<unsigned char> elements = EZTestRandomBytes(stride * count);
+	std::vector<unsigned char> expected(count * 8), results(count * 8 + 1);
+	for (size_t offset : { (size_t)0, (size_t)1, (size_t)5 })
+	{
+		for (size_t size : { (size_t)1, (size_t)4, (size_t)8 })
+		{
+			EZBufferField field = { offset, size, expected.data() };
+			EZProjectFieldScalar(elements.data(), stride, 0, count, field);
+			for (size_t i = 0; i < count; i++)
+				EZ_CHECK(memcmp(&expected[i * size], &elements[i * stride + offset], size) == 0);
+#if defined(EZREADBACK_X86)
+			if (EZCpuFeatures::Get().AVX2)
+			{
+				std::fill(results.begin(), results.end(), (unsigned char)0xCD);
+				field.Destination = results.data();
+				EZProjectFieldAVX2(elements.data(), stride, 0, count, field);
+				EZ_CHECK(SameBits(results.data(), expected.data(), count * size) && results[count * size] == 0xCD);
+			}
+#endif
+		}
+	}
+
+	// Threaded, several fields at once, sizes of every kind
+	std::vector<unsigned int> middles(count);
+	std::vector<unsigned long long> ends(count);
+	std::vector<unsigned char> firsts(count), triples(count * 3);
+	EZBufferField fields[] = { { 1, 4, middles.data() }, { 5, 8, ends.data() }, { 0, 1, firsts.data() }, { 10, 3, triples.data() } };
+	EZProjectFields(elements.data(), stride, count, fields, 4, 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char* element = &elements[i * stride];
+		EZ_CHECK(memcmp(&middles[i], element + 1, 4) == 0 && memcmp(&ends[i], element + 5, 8) == 0);
+		EZ_CHECK(firsts[i] == element[0] && memcmp(&triples[i * 3], element + 10, 3) == 0);
+	}
+}
+
+static void TestCopyRow()
+{
+	std::vector<unsigned char> source = EZTestRandomBytes(1024 + 64);
+	std::vector<void (*)(unsigned char*, const unsigned char*, size_t)> kernels = { EZCopyRowScalar };
+#if defined(EZREADBACK_X86)
+	kernels.push_back(EZCopyRowSSE2);
+	kernels.push_back(EZCopyRowStreamSSE2);
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		kernels.push_back(EZCopyRowAVX2);
+		kernels.push_back(EZCopyRowStreamAVX2);
+	}
+#endif
+
+	// Every kernel, at odd lengths and misaligned on both ends
+	for (auto copyRow : kernels)
+	{
+		for (size_t bytes : { (size_t)1, (size_t)15, (size_t)64, (size_t)333, (size_t)1024 })
+		{
+			for (size_t offset : { (size_t)0, (size_t)3 })
+			{
+				std::vector<unsigned char> destination(source.size(), 0xCD);
+				copyRow(destination.data() + offset, source.data() + 5, bytes);
+				EZ_CHECK(memcmp(destination.data() + offset, source.data() + 5, bytes) == 0);
+				EZ_CHECK(destination[offset + bytes] == 0xCD && (offset == 0 || destination[offset - 1] == 0xCD));
+			}
+		}
+	}
+#if defined(EZREADBACK_X86)
+	_mm_sfence();
+#endif
+
+	// Pitched copies, both ways
+	std::vector<unsigned char> pitched(64 * 7 * 2), back(30 * 7 * 2);
+	EZCopyPitched(pitched.data(), 64, 64 * 7, source.data(), 30, 30 * 7, 30, 7, 2);
+	EZCopyPitched(back.data(), 30, 30 * 7, pitched.data(), 64, 64 * 7, 30, 7, 2);
+	EZ_CHECK(memcmp(back.data(), source.data(), back.size()) == 0 && memcmp(&pitched[64 * 8], &source[30 * 8], 30) == 0);
+}
+
+static void TestReduceFloat4()
+{
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> distribution(-0.5f, 1.5f);
+	std::vector<DirectX::XMFLOAT4> values(1001);
+	for (DirectX::XMFLOAT4& value : values)
+		value = DirectX::XMFLOAT4(distribution(random), distribution(random), distribution(random), distribution(random));
+	values[7].x = std::numeric_limits<float>::quiet_NaN();
+	values[8].y = std::numeric_limits<float>::infinity();
+	values[1000].z = -std::numeric_limits<float>::infinity();
+
+	const UINT bins = 16;
+	std::vector<size_t> expectedCounts(bins * 4), counts(bins * 4);
+	EZHistogramRange range = { expectedCounts.data(), bins, 0.0f, (float)bins };
+	EZReduction expected;
+	EZReduceFloat4Scalar(values.data(), values.size(), expected, range);
+	EZ_CHECK(expected.Count == 1001 && expected.NaNCount[0] == 1 && expected.InfCount[1] == 1 && expected.InfCount[2] == 1);
+	EZ_CHECK(expected.Min[2] == -std::numeric_limits<float>::infinity() && expected.Max[1] == std::numeric_limits<float>::infinity());
+
+#if defined(EZREADBACK_X86)
+	if (EZCpuFeatures::Get().AVX2)
+	{
+		// Sums may only differ in the order they are added
+		range.Counts = counts.data();
+		EZReduction result;
+		EZReduceFloat4AVX2(values.data(), values.size(), result, range);
+		EZ_CHECK(result.Count == expected.Count && counts == expectedCounts);
+		for (int c = 0; c < 4; c++)
+		{
+			EZ_CHECK(result.Min[c] == expected.Min[c] && result.Max[c] == expected.Max[c]);
+			EZ_CHECK(result.NaNCount[c] == expected.NaNCount[c] && result.InfCount[c] == expected.InfCount[c]);
+			EZ_CHECK(std::fabs(result.Sum[c] - expected.Sum[c]) < 1e-3);
+		}
+	}
+#endif
+
+	// Threaded reductions match a single thread
+	std::vector<unsigned char> texels = EZTestRandomBytes(4 * 100000);
+	EZReductionOptions options;
+	options.HistogramBins = 8;
+	options.ThreadCount = 1;
+	EZReduction single, threaded;
+	EZ_CHECK(EZReduce(DXGI_FORMAT_R8G8B8A8_UNORM, texels.data(), 100000, single, options) == S_OK);
+	options.ThreadCount = 4;
+	EZ_CHECK(EZReduce(DXGI_FORMAT_R8G8B8A8_UNORM, texels.data(), 100000, threaded, options) == S_OK);
+	EZ_CHECK(single.Count == 100000 && threaded.Count == single.Count && threaded.Checksum == single.Checksum && threaded.Histogram == single.Histogram);
+	for (int c = 0; c < 4; c++)
+		EZ_CHECK(threaded.Min[c] == single.Min[c] && threaded.Max[c] == single.Max[c] && std::fabs(threaded.Sum[c] - single.Sum[c]) < 1e-3);
+}
+
+static void TestBlockCompressed()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	// Random blocks decode the same on one thread or several,
+	// and through ReadDecompressed()
+	for (DXGI_FORMAT format : { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC2_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC7_UNORM })
+	{
+		std::vector<unsigned char> blocks;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, format, 70, 45, blocks);
+		size_t rowPitch = blocks.size() / 12;
+
+		std::vector<EZColor4> single(70 * 45), threaded(70 * 45), read;
+		EZ_CHECK(EZDecodeBC(format, blocks.data(), rowPitch, 70, 45, single.data(), 1) == S_OK);
+		EZ_CHECK(EZDecodeBC(format, blocks.data(), rowPitch, 70, 45, threaded.data(), 4) == S_OK);
+		EZ_CHECK(SameBits(single.data(), threaded.data(), single.size() * 4));
+		EZ_CHECK(readback.ReadDecompressed(texture.Get(), read, 0, 0, 2) == S_OK && read.size() == single.size() && SameBits(read.data(), single.data(), single.size() * 4));
+	}
+
+	// Formats only EZDecodeBCToFloat4() takes
+	for (DXGI_FORMAT format : { DXGI_FORMAT_BC5_SNORM, DXGI_FORMAT_BC6H_UF16, DXGI_FORMAT_BC6H_SF16 })
+	{
+		std::vector<unsigned char> blocks = EZTestRandomBytes(16 * 3 * 2);
+		std::vector<DirectX::XMFLOAT4> single(10 * 7), threaded(10 * 7);
+		std::vector<EZColor4> colors(10 * 7);
+		EZ_CHECK(EZDecodeBC(format, blocks.data(), 0, 10, 7, colors.data()) == E_INVALIDARG);
+		EZ_CHECK(EZDecodeBCToFloat4(format, blocks.data(), 0, 10, 7, single.data(), 1) == S_OK);
+		EZ_CHECK(EZDecodeBCToFloat4(format, blocks.data(), 0, 10, 7, threaded.data(), 2) == S_OK);
+		EZ_CHECK(SameBits(single.data(), threaded.data(), single.size() * 16));
+	}
+
+	// A BC1 block of a single opaque color
+	unsigned char block[8] = { 0x00, 0xF8, 0x00, 0xF8, 0, 0, 0, 0 };
+	EZColor4 texels[16];
+	EZDecodeBC1Block(block, texels, true);
+	EZ_CHECK(texels[0].RedInt == 255 && texels[0].GreenInt == 0 && texels[0].BlueInt == 0 && texels[0].AlphaInt == 255 && SameBits(&texels[0], &texels[15], 4));
+	EZ_CHECK(EZDecodeBC(DXGI_FORMAT_R8G8B8A8_UNORM, block, 8, 4, 4, texels) == E_INVALIDARG);
+}
+
+static void TestThreadPool()
+{
+	EZThreadPool& pool = EZThreadPool::Get();
+	pool.Reserve(3);
+	EZ_CHECK(pool.GetThreadCount() >= 3);
+
+	// Tasks may wait on tasks of their own
+	std::atomic<size_t> pending{ 0 };
+	std::atomic<int> sum{ 0 };
+	for (int i = 0; i < 8; i++)
+	{
+		pool.Submit([&pool, &sum, i]
+		{
+			std::atomic<size_t> inner{ 0 };
+			for (int j = 0; j < 4; j++)
+				pool.Submit([&sum, i] { sum += i; }, inner);
+			pool.Wait(inner);
+		}, pending);
+	}
+	pool.Wait(pending);
+	EZ_CHECK(pending == 0 && sum == 4 * 28);
+
+	// Every item is visited exactly once, and small ranges
+	// stay on the calling thread
+	std::vector<int> visits(1000);
+	EZParallelFor(visits.size(), 4, 1, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			visits[i]++;
+	});
+	EZ_CHECK(std::count(visits.begin(), visits.end(), 1) == 1000);
+
+	std::thread::id caller = std::this_thread::get_id();
+	bool onCaller = true;
+	EZParallelFor(10, 4, 100, [&](size_t, size_t) { onCaller = std::this_thread::get_id() == caller; });
+	EZ_CHECK(onCaller);
+}
+
+int main()
+{
+	TestUNorm8();
+	TestHalf();
+	TestBGRA8();
+	TestR11G11B10();
+	TestDepthStencil();
+	TestYUV();
+	TestProjectFields();
+	TestCopyRow();
+	TestReduceFloat4();
+	TestBlockCompressed();
+	TestThreadPool();
+	return EZTestResult("EZReadbackDecodeTests");
+}
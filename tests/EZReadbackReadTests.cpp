@@ -0,0 +1,440 @@
+// --- EZReadbackReadTests --------------------------------
+//  Blocking reads: every resource type, subresources and
+//  regions, pitched rows, reads into caller memory and
+//  mapped views, the staging pool, depth and stencil,
+//  video planes, dirty tiles, and the reference backend
+//  refusing resources it did not create.
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+
+// Reads every mip and array slice of a texture whose rows
+// are padded, alone, as a region and all at once
+static void TestSubresources()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	backend->SetRowPitchAlignment(64);
+	EZReadback readback(backend);
+
+	// 37x9, full mip chain of 6, 3 slices, unique values
+	const UINT width = 37, height = 9, mips = 6, slices = 3;
+	std::vector<std::vector<unsigned int>> expected;
+	std::vector<D3D11_SUBRESOURCE_DATA> initial;
+	for (UINT slice = 0; slice < slices; slice++)
+	{
+		for (UINT mip = 0; mip < mips; mip++)
+		{
+			UINT mipWidth = EZMax(width >> mip, 1u);
+			std::vector<unsigned int> values(mipWidth * EZMax(height >> mip, 1u));
+			for (size_t i = 0; i < values.size(); i++)
+				values[i] = slice * 100000 + mip * 10000 + (unsigned int)i;
+			expected.push_back(values);
+		}
+	}
+	for (UINT slice = 0, index = 0; slice < slices; slice++)
+	{
+		for (UINT mip = 0; mip < mips; mip++, index++)
+		{
+			D3D11_SUBRESOURCE_DATA data = { expected[index].data(), EZMax(width >> mip, 1u) * 4, 0 };
+			initial.push_back(data);
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.ArraySize = slices;
+	desc.Format = DXGI_FORMAT_R32_UINT;
+	desc.SampleDesc.Count = 1;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	EZ_CHECK(backend->CreateTexture2D(&desc, initial.data(), texture.GetAddressOf()) == S_OK);
+	texture->GetDesc(&desc);
+	EZ_CHECK(desc.MipLevels == mips);
+
+	std::vector<unsigned int> results;
+	EZ_CHECK(readback.Read(texture.Get(), results, 1, 2) == S_OK && results == expected[2 * mips + 1]);
+	EZ_CHECK(readback.Read(texture.Get(), results, 5, 0) == S_OK && results == expected[5]);
+	EZ_CHECK(readback.Read<unsigned int>(texture.Get(), 0, 1) == expected[mips]);
+
+	std::vector<EZSubresourceLayout> layouts;
+	EZ_CHECK(readback.ReadAllSubresources(texture.Get(), results, layouts) == S_OK && layouts.size() == mips * slices);
+	for (size_t i = 0; i < layouts.size() && i < expected.size(); i++)
+		EZ_CHECK(layouts[i].Offset + expected[i].size() <= results.size() && memcmp(results.data() + layouts[i].Offset, expected[i].data(), expected[i].size() * 4) == 0);
+
+	D3D11_BOX region = { 3, 2, 0, 10, 7, 1 };
+	EZ_CHECK(readback.ReadRegion(texture.Get(), region, results, 0, 1) == S_OK && results.size() == 35);
+	for (UINT y = 0; y < 5 && results.size() == 35; y++)
+		for (UINT x = 0; x < 7; x++)
+			EZ_CHECK(results[y * 7 + x] == 100000 + (y + 2) * width + x + 3);
+
+	D3D11_BOX outside = { 30, 0, 0, 40, 1, 1 };
+	EZ_CHECK(FAILED(readback.ReadRegion(texture.Get(), outside, results)));
+
+	// Out of range subresources and mismatched elements fail
+	EZ_CHECK(FAILED(readback.Read(texture.Get(), results, mips, 0)));
+	EZ_CHECK(FAILED(readback.Read(texture.Get(), results, 0, slices)));
+	std::vector<unsigned short> halves;
+	EZ_CHECK(FAILED(readback.Read(texture.Get(), halves)));
+
+	// Updates show up in the next read
+	std::vector<unsigned int> update(width * height, 7);
+	EZ_CHECK(backend->UpdateSubresource(texture.Get(), 0, update.data(), width * 4, 0) == S_OK);
+	EZ_CHECK(readback.Read(texture.Get(), results) == S_OK && results == update);
+
+	// Mapped views see the padded rows
+	EZReadback::MappedView<unsigned int> view;
+	EZ_CHECK(readback.ReadMapped(texture.Get(), view) == S_OK && view.GetRowPitch() == 192 && view.At(36, 8) == 7);
+}
+
+// Buffers, 1D and 3D textures
+static void TestResourceTypes()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 400, data);
+	std::vector<float> floats;
+	EZ_CHECK(readback.Read(buffer.Get(), floats) == S_OK && EZTestEqual(floats, data));
+	// Buffers are not checked against the element size, and
+	// a partial last element is left out
+	std::vector<DirectX::XMFLOAT3> float3s;
+	EZ_CHECK(readback.Read(buffer.Get(), float3s) == S_OK && float3s.size() == 400 / 12 && memcmp(float3s.data(), data.data(), 396) == 0);
+
+	D3D11_TEXTURE1D_DESC desc1D = {};
+	desc1D.Width = 100;
+	desc1D.MipLevels = 1;
+	desc1D.ArraySize = 2;
+	desc1D.Format = DXGI_FORMAT_R16G16_UINT;
+	std::vector<unsigned char> slice0 = EZTestRandomBytes(400, 1), slice1 = EZTestRandomBytes(400, 2);
+	D3D11_SUBRESOURCE_DATA initial1D[2] = { { slice0.data(), 400, 400 }, { slice1.data(), 400, 400 } };
+	Microsoft::WRL::ComPtr<ID3D11Texture1D> texture1D;
+	EZ_CHECK(backend->CreateTexture1D(&desc1D, initial1D, texture1D.GetAddressOf()) == S_OK);
+	std::vector<unsigned int> texels;
+	EZ_CHECK(readback.Read(texture1D.Get(), texels, 0, 1) == S_OK && EZTestEqual(texels, slice1));
+
+	D3D11_TEXTURE3D_DESC desc3D = {};
+	desc3D.Width = 5;
+	desc3D.Height = 4;
+	desc3D.Depth = 3;
+	desc3D.MipLevels = 1;
+	desc3D.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	data = EZTestRandomBytes(5 * 4 * 3 * 4);
+	D3D11_SUBRESOURCE_DATA initial3D = { data.data(), 20, 80 };
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> texture3D;
+	EZ_CHECK(backend->CreateTexture3D(&desc3D, &initial3D, texture3D.GetAddressOf()) == S_OK);
+	std::vector<EZColor4> colors;
+	EZ_CHECK(readback.Read(texture3D.Get(), colors) == S_OK && EZTestEqual(colors, data));
+
+	D3D11_BOX region = { 1, 1, 1, 3, 2, 3 };
+	EZ_CHECK(readback.ReadRegion(texture3D.Get(), region, colors) == S_OK && colors.size() == 4);
+	for (UINT z = 0; z < 2 && colors.size() == 4; z++)
+		for (UINT x = 0; x < 2; x++)
+			EZ_CHECK(memcmp(&colors[z * 2 + x], &data[((z + 1) * 20 + 5 + x + 1) * 4], 4) == 0);
+
+	// Raw blocks of compressed textures, and block aligned regions
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> compressed = EZTestCreateTexture2D(*backend, DXGI_FORMAT_BC7_UNORM, 10, 6, data);
+	std::vector<EZBlock16> blocks;
+	EZ_CHECK(readback.Read(compressed.Get(), blocks) == S_OK && EZTestEqual(blocks, data));
+	D3D11_BOX blockRegion = { 4, 0, 0, 8, 4, 1 };
+	EZ_CHECK(readback.ReadRegion(compressed.Get(), blockRegion, blocks) == S_OK && blocks.size() == 1 && memcmp(&blocks[0], &data[16], 16) == 0);
+	D3D11_BOX unaligned = { 1, 0, 0, 8, 4, 1 };
+	EZ_CHECK(FAILED(readback.ReadRegion(compressed.Get(), unaligned, blocks)));
+}
+
+// Reads into caller memory and decoded reads
+static void TestReadInto()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	backend->SetRowPitchAlignment(256);
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 33, 17, data);
+
+	std::vector<EZColor4> colors(33 * 17);
+	size_t count = 0;
+	EZ_CHECK(readback.ReadInto(texture.Get(), colors.data(), colors.size() - 1, count) == E_NOT_SUFFICIENT_BUFFER && count == colors.size());
+	EZ_CHECK(readback.ReadInto(texture.Get(), colors.data(), colors.size(), count) == S_OK && count == colors.size() && EZTestEqual(colors, data));
+
+	std::vector<EZColor4> allocated;
+	EZ_CHECK(readback.ReadInto<EZColor4>(texture.Get(), [&](size_t needed) { allocated.resize(needed); return allocated.data(); }) == S_OK && EZTestEqual(allocated, data));
+	EZ_CHECK(readback.ReadInto<EZColor4>(texture.Get(), [](size_t) -> EZColor4* { return nullptr; }) == E_OUTOFMEMORY);
+
+	std::vector<DirectX::XMFLOAT4> decoded;
+	EZ_CHECK(readback.ReadAsFloat4(texture.Get(), decoded) == S_OK && decoded.size() == 33 * 17);
+	for (size_t i = 0; i < decoded.size(); i++)
+		EZ_CHECK(decoded[i].x == data[i * 4] / 255.0f && decoded[i].w == data[i * 4 + 3] / 255.0f);
+
+	std::vector<DirectX::XMUINT4> integers;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> uints = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R16G16_UINT, 9, 5, data);
+	EZ_CHECK(readback.ReadAsUInt4(uints.Get(), integers) == S_OK && integers.size() == 45);
+	for (size_t i = 0; i < integers.size(); i++)
+		EZ_CHECK(integers[i].y == (UINT)(data[i * 4 + 2] | data[i * 4 + 3] << 8) && integers[i].z == 0);
+}
+
+// Staging resources are reused, and evicted over budget
+static void TestStagingPool()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_FLOAT, 64, 64, data);
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> other = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R32_FLOAT, 32, 32, data);
+
+	std::vector<float> results;
+	for (int i = 0; i < 4; i++)
+		EZ_CHECK(readback.Read(texture.Get(), results) == S_OK);
+	EZStagingPoolStats stats = readback.GetStagingPoolStats();
+	EZ_CHECK(stats.Misses == 1 && stats.Hits == 3 && stats.ResourceCount == 1 && stats.BytesInUse == 0);
+
+	// A budget that only fits the larger resource evicts it
+	// once the smaller one is pooled too
+	readback.SetStagingBudget(64 * 64 * 4);
+	EZ_CHECK(readback.Read(other.Get(), results) == S_OK && EZTestEqual(results, data));
+	stats = readback.GetStagingPoolStats();
+	EZ_CHECK(stats.Evictions == 1 && stats.ResourceCount == 1 && stats.BytesPooled == 32 * 32 * 4);
+
+	readback.ClearStagingPool();
+	EZ_CHECK(readback.GetStagingPoolStats().ResourceCount == 0);
+
+	// No pooling at all with a zero budget
+	readback.SetStagingBudget(0);
+	unsigned long long creates = backend->GetStats().Creates;
+	EZ_CHECK(readback.Read(texture.Get(), results) == S_OK && readback.Read(texture.Get(), results) == S_OK);
+	EZ_CHECK(backend->GetStats().Creates == creates + 2 && readback.GetStagingPoolStats().ResourceCount == 0);
+}
+
+// Tile hashes, the tracker, and reads that only copy the
+// tiles that changed
+static void TestDepthStencilReads()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	// Depth and stencil agree with ReadAsFloat4()
+	for (DXGI_FORMAT format : { DXGI_FORMAT_D16_UNORM, DXGI_FORMAT_D24_UNORM_S8_UINT, DXGI_FORMAT_D32_FLOAT, DXGI_FORMAT_D32_FLOAT_S8X24_UINT })
+	{
+		std::vector<unsigned char> data;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, format, 45, 13, data);
+		std::vector<DirectX::XMFLOAT4> colors;
+		std::vector<float> depth, bothDepth;
+		std::vector<unsigned char> stencil, bothStencil;
+		EZ_CHECK(readback.ReadAsFloat4(texture.Get(), colors) == S_OK && colors.size() == 45 * 13);
+		EZ_CHECK(readback.ReadDepth(texture.Get(), depth) == S_OK && depth.size() == colors.size());
+		for (size_t i = 0; i < depth.size() && i < colors.size(); i++)
+			EZ_CHECK(memcmp(&depth[i], &colors[i].x, 4) == 0);
+
+		if (EZHasStencil(EZGetDepthLayout(format)))
+		{
+			EZ_CHECK(readback.ReadStencil(texture.Get(), stencil) == S_OK && stencil.size() == colors.size());
+			for (size_t i = 0; i < stencil.size() && i < colors.size(); i++)
+				EZ_CHECK(stencil[i] == colors[i].y);
+			EZ_CHECK(readback.ReadDepthStencil(texture.Get(), bothDepth, bothStencil) == S_OK && bothStencil == stencil);
+			EZ_CHECK(bothDepth.size() == depth.size() && memcmp(bothDepth.data(), depth.data(), depth.size() * 4) == 0);
+		}
+		else
+		{
+			EZ_CHECK(readback.ReadStencil(texture.Get(), stencil) == E_INVALIDARG);
+		}
+	}
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> color = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, data);
+	std::vector<float> depth;
+	EZ_CHECK(readback.ReadDepth(color.Get(), depth) == E_INVALIDARG);
+}
+
+// NV12 and P010 read whole, as planes, and converted to RGBA
+static void TestVideoReads()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	const UINT width = 38, height = 10;
+	for (DXGI_FORMAT format : { DXGI_FORMAT_NV12, DXGI_FORMAT_P010 })
+	{
+		EZPlaneLayout lumaLayout = {}, chromaLayout = {};
+		EZ_CHECK(EZGetPlaneLayouts(format, width, height, lumaLayout, chromaLayout));
+		std::vector<unsigned char> data = EZTestRandomBytes((size_t)lumaLayout.RowBytes * (height + chromaLayout.Height));
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		D3D11_SUBRESOURCE_DATA initial = { data.data(), lumaLayout.RowBytes, 0 };
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		EZ_CHECK(backend->CreateTexture2D(&desc, &initial, texture.GetAddressOf()) == S_OK);
+
+		// A plain read returns both planes one after the other
+		size_t lumaBytes = (size_t)lumaLayout.RowBytes * height;
+		EZPlaneLayout readLuma, readChroma;
+		if (format == DXGI_FORMAT_NV12)
+		{
+			std::vector<unsigned char> raw, luma, chroma;
+			std::vector<unsigned short> mismatched;
+			EZ_CHECK(readback.Read(texture.Get(), raw) == S_OK && raw == data);
+			EZ_CHECK(readback.ReadPlanes(texture.Get(), luma, chroma, readLuma, readChroma) == S_OK);
+			EZ_CHECK(luma.size() == lumaBytes && memcmp(luma.data(), data.data(), lumaBytes) == 0);
+			EZ_CHECK(chroma.size() == data.size() - lumaBytes && memcmp(chroma.data(), data.data() + lumaBytes, chroma.size()) == 0);
+			EZ_CHECK(readback.ReadPlanes(texture.Get(), mismatched, mismatched, readLuma, readChroma) == E_INVALIDARG);
+		}
+		else
+		{
+			std::vector<unsigned short> raw, luma, chroma;
+			EZ_CHECK(readback.Read(texture.Get(), raw) == S_OK && EZTestEqual(raw, data));
+			EZ_CHECK(readback.ReadPlanes(texture.Get(), luma, chroma, readLuma, readChroma) == S_OK);
+			EZ_CHECK(luma.size() * 2 == lumaBytes && memcmp(luma.data(), data.data(), lumaBytes) == 0);
+			EZ_CHECK(chroma.size() * 2 == data.size() - lumaBytes && memcmp(chroma.data(), data.data() + lumaBytes, chroma.size() * 2) == 0);
+		}
+
+		std::vector<EZColor4> colors, expected(width * height);
+		std::vector<DirectX::XMFLOAT4> values;
+		EZ_CHECK(EZConvertYUV(format, data.data(), lumaLayout.RowBytes, data.data() + lumaBytes, lumaLayout.RowBytes, width, height, expected.data()) == S_OK);
+		EZ_CHECK(readback.ReadYUVAsRGBA8(texture.Get(), colors) == S_OK && colors.size() == expected.size());
+		EZ_CHECK(colors.size() == expected.size() && memcmp(colors.data(), expected.data(), colors.size() * 4) == 0);
+		EZ_CHECK(readback.ReadYUVAsFloat4(texture.Get(), values) == S_OK && values.size() == expected.size());
+
+		// Regions would cut through the planes
+		D3D11_BOX box = { 0, 0, 0, 2, 2, 1 };
+		std::vector<unsigned char> region;
+		EZ_CHECK(FAILED(readback.ReadRegion(texture.Get(), box, region)));
+	}
+
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> color = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, data);
+	std::vector<EZColor4> colors;
+	EZ_CHECK(readback.ReadYUVAsRGBA8(color.Get(), colors) == E_INVALIDARG);
+}
+
+static void TestDirtyTiles()
+{
+	std::vector<unsigned char> bytes = EZTestRandomBytes(300 * 40);
+	for (size_t rowBytes = 1; rowBytes <= 130; rowBytes += 7)
+	{
+		for (size_t rowCount = 1; rowCount <= 9; rowCount += 4)
+		{
+			unsigned long long hash = EZTileHashScalar(bytes.data() + 3, rowBytes, rowCount, 300);
+			EZ_CHECK(EZTileHash(bytes.data() + 3, rowBytes, rowCount, 300) == hash);
+#if defined(EZREADBACK_X86)
+			if (EZCpuFeatures::Get().AVX2)
+				EZ_CHECK(EZTileHashAVX2(bytes.data() + 3, rowBytes, rowCount, 300) == hash);
+#endif
+		}
+	}
+
+	// Any flipped bit changes the hash, padding does not
+	unsigned long long hash = EZTileHash(bytes.data(), 100, 6, 300);
+	bytes[2 * 300 + 50] ^= 4;
+	EZ_CHECK(EZTileHash(bytes.data(), 100, 6, 300) != hash);
+	bytes[2 * 300 + 50] ^= 4;
+	bytes[150] ^= 1;
+	EZ_CHECK(EZTileHash(bytes.data(), 100, 6, 300) == hash);
+
+	// Every tile is dirty at first, or after a change of size
+	EZTileTracker tracker(16, 8, 3);
+	std::vector<EZDirtyTile> dirtyTiles;
+	const UINT width = 70, height = 30;
+	std::vector<unsigned int> frame(width * height);
+	for (UINT i = 0; i < width * height; i++)
+		frame[i] = i * 2654435761u;
+	EZ_CHECK(tracker.Update(frame.data(), width, height, width * 4, 4, dirtyTiles) == S_OK && dirtyTiles.size() == 5 * 4);
+	EZ_CHECK(tracker.GetTilesWide() == 5 && tracker.GetTilesHigh() == 4);
+	EZ_CHECK(dirtyTiles.back().Left == 64 && dirtyTiles.back().Top == 24 && dirtyTiles.back().Right == 70 && dirtyTiles.back().Bottom == 30);
+	EZ_CHECK(tracker.Update(frame.data(), width, height, width * 4, 4, dirtyTiles) == S_OK && dirtyTiles.empty());
+	frame[17 * width + 33] ^= 1;
+	EZ_CHECK(tracker.Update(frame.data(), width, height, width * 4, 4, dirtyTiles) == S_OK && dirtyTiles.size() == 1);
+	EZ_CHECK(dirtyTiles.size() == 1 && dirtyTiles[0].TileX == 2 && dirtyTiles[0].TileY == 2 && dirtyTiles[0].Left == 32 && dirtyTiles[0].Bottom == 24);
+	EZ_CHECK(tracker.Update(frame.data(), width, height, 4, 4, dirtyTiles) == E_INVALIDARG);
+	EZ_CHECK(tracker.Update(frame.data(), width, height - 1, width * 4, 4, dirtyTiles) == S_OK && dirtyTiles.size() == 5 * 4);
+
+	// Reads keep the results of clean tiles from the last read
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = EZTestCreateTexture2D(*backend, DXGI_FORMAT_R8G8B8A8_UNORM, 200, 100, data);
+	EZTileTracker readTracker(64, 64);
+	std::vector<unsigned int> results;
+	EZ_CHECK(readback.ReadDirtyTiles(texture.Get(), results, readTracker, dirtyTiles) == S_OK && dirtyTiles.size() == 4 * 2 && EZTestEqual(results, data));
+	EZ_CHECK(readback.ReadDirtyTiles(texture.Get(), results, readTracker, dirtyTiles) == S_OK && dirtyTiles.empty() && EZTestEqual(results, data));
+
+	results[0] = ~results[0];
+	data[(70 * 200 + 150) * 4] ^= 0xFF;
+	EZ_CHECK(backend->UpdateSubresource(texture.Get(), 0, data.data(), 200 * 4, 0) == S_OK);
+	EZ_CHECK(readback.ReadDirtyTiles(texture.Get(), results, readTracker, dirtyTiles) == S_OK && dirtyTiles.size() == 1);
+	EZ_CHECK(dirtyTiles.size() == 1 && dirtyTiles[0].TileX == 2 && dirtyTiles[0].TileY == 1);
+	EZ_CHECK(memcmp(&results[70 * 200 + 150], &data[(70 * 200 + 150) * 4], 4) == 0);
+	EZ_CHECK(memcmp(&results[0], &data[0], 4) != 0);
+
+	std::vector<unsigned short> mismatched;
+	EZ_CHECK(FAILED(readback.ReadDirtyTiles(texture.Get(), mismatched, readTracker, dirtyTiles)));
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 64, data);
+	EZ_CHECK(readback.ReadDirtyTiles(buffer.Get(), results, readTracker, dirtyTiles) == E_INVALIDARG);
+}
+
+// --- ForeignBuffer --------------------------------------
+//  A buffer the reference backend did not create, which
+//  answers nothing but the usual interfaces
+// --------------------------------------------------------
+struct ForeignBuffer : ID3D11Buffer
+{
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID id, void** object) override
+	{
+		*object = nullptr;
+		if (!(id == __uuidof(IUnknown) || id == __uuidof(ID3D11DeviceChild) || id == __uuidof(ID3D11Resource) || id == __uuidof(ID3D11Buffer)))
+			return E_NOINTERFACE;
+		*object = this;
+		return S_OK;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return 1; }
+	ULONG STDMETHODCALLTYPE Release() override { return 1; }
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override { *device = nullptr; }
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+	void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* dimension) override { *dimension = D3D11_RESOURCE_DIMENSION_BUFFER; }
+	void STDMETHODCALLTYPE SetEvictionPriority(UINT) override {}
+	UINT STDMETHODCALLTYPE GetEvictionPriority() override { return 0; }
+	void STDMETHODCALLTYPE GetDesc(D3D11_BUFFER_DESC* desc) override
+	{
+		*desc = D3D11_BUFFER_DESC();
+		desc->ByteWidth = 64;
+		desc->Usage = D3D11_USAGE_STAGING;
+		desc->CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	}
+};
+
+static void TestForeignResource()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	ForeignBuffer foreign;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	unsigned char bytes[64] = {};
+	EZ_CHECK(backend->Map(&foreign, 0, D3D11_MAP_READ, 0, &mapped) == E_INVALIDARG);
+	EZ_CHECK(backend->UpdateSubresource(&foreign, 0, bytes, 64, 64) == E_INVALIDARG);
+
+	// Copies from it are dropped, like mismatched copies
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 64, data);
+	backend->CopyResource(buffer.Get(), &foreign);
+	EZ_CHECK(backend->GetStats().Copies == 0);
+
+	// Non-staging reference resources cannot be mapped either
+	EZ_CHECK(backend->Map(buffer.Get(), 0, D3D11_MAP_READ, 0, &mapped) == E_INVALIDARG);
+}
+
+int main()
+{
+	TestSubresources();
+	TestResourceTypes();
+	TestReadInto();
+	TestStagingPool();
+	TestDepthStencilReads();
+	TestVideoReads();
+	TestDirtyTiles();
+	TestForeignResource();
+	return EZTestResult("EZReadbackReadTests");
+}
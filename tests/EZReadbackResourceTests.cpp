@@ -0,0 +1,371 @@
+// --- EZReadbackResourceTests ----------------------------
+//  Reads of part of a resource: ranges of a buffer, fields
+//  pulled out of a buffer of structs, and what a view
+//  covers.  Also typed resource handles along with the
+//  element/format rules they are checked by (which hold
+//  at compile time).
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+#include <cstddef>
+
+static_assert(EZIsElementCompatible<EZColor4>(DXGI_FORMAT_R8G8B8A8_UNORM) && EZIsElementCompatible<EZColor4>(DXGI_FORMAT_B8G8R8A8_UNORM_SRGB), "EZColor4 reads RGBA8");
+static_assert(!EZIsElementCompatible<EZColor4>(DXGI_FORMAT_R8G8B8A8_SNORM) && !EZIsElementCompatible<float>(DXGI_FORMAT_R8G8B8A8_UNORM), "Signs and kinds must match");
+static_assert(EZIsElementCompatible<DirectX::XMFLOAT4>(DXGI_FORMAT_R32G32B32A32_TYPELESS) && !EZIsElementCompatible<DirectX::XMUINT4>(DXGI_FORMAT_R32G32B32A32_FLOAT), "TYPELESS takes any channels");
+static_assert(EZIsElementCompatible<unsigned short>(DXGI_FORMAT_R16_FLOAT) && EZIsElementCompatible<unsigned int>(DXGI_FORMAT_D24_UNORM_S8_UINT), "Halves and packed formats read raw");
+static_assert(EZIsElementCompatible<EZBlock8>(DXGI_FORMAT_BC1_UNORM) && !EZIsElementCompatible<EZBlock8>(DXGI_FORMAT_BC7_UNORM), "Blocks must match in size");
+static_assert(EZIsElementCompatible<EZColor2>(DXGI_FORMAT_R8G8_UINT) && !EZIsElementCompatible<EZColor2>(DXGI_FORMAT_R16_UNORM), "Channels must match, not just size");
+static_assert(EZIsElementCompatible<DirectX::XMINT3>(DXGI_FORMAT_R32G32B32_SINT) && !EZIsElementCompatible<DirectX::XMUINT3>(DXGI_FORMAT_R32G32B32_SINT), "Signed and unsigned differ");
+static_assert(!EZIsElementCompatible<unsigned char>(DXGI_FORMAT_NV12) && !EZIsElementCompatible<EZColor4>(DXGI_FORMAT_UNKNOWN), "Planar and unknown formats have no element type");
+
+// Types without traits only have to match in size
+struct TestPair { float First; unsigned int Second; };
+static_assert(EZIsElementCompatible<TestPair>(DXGI_FORMAT_R32G32_FLOAT) && !EZIsElementCompatible<TestPair>(DXGI_FORMAT_R32_FLOAT), "Other types match by size");
+
+struct TestParticle
+{
+	DirectX::XMFLOAT3 Position;
+	float Mass;
+	double Age;
+	unsigned short Flags;
+	unsigned char Padding[6];
+};
+
+static Microsoft::WRL::ComPtr<ID3D11Buffer> CreateParticles(EZReferenceBackend& backend, UINT count, std::vector<TestParticle>& particles)
+{
+	std::vector<unsigned char> data;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(backend, count * (UINT)sizeof(TestParticle), data, sizeof(TestParticle));
+	particles.resize(count);
+	memcpy(particles.data(), data.data(), data.size());
+	return buffer;
+}
+
+static void TestBufferRange()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+	const UINT count = 10007;
+	std::vector<TestParticle> particles;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = CreateParticles(*backend, count, particles);
+
+	// Only the range is copied off the GPU
+	std::vector<TestParticle> results;
+	for (UINT first : { 0u, 1u, 500u, count - 1 })
+	{
+		for (UINT rangeCount : { 1u, 7u, 300u })
+		{
+			if (first + rangeCount > count)
+				continue;
+			backend->ResetStats();
+			EZ_CHECK(readback.ReadBufferRange(buffer.Get(), first * (UINT)sizeof(TestParticle), rangeCount, results) == S_OK);
+			EZ_CHECK(results.size() == rangeCount && memcmp(results.data(), &particles[first], rangeCount * sizeof(TestParticle)) == 0);
+			EZ_CHECK(backend->GetStats().BytesCopied == rangeCount * sizeof(TestParticle));
+		}
+	}
+
+	EZ_CHECK(readback.ReadBufferRange(buffer.Get(), 0, count + 1, results) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadBufferRange(buffer.Get(), 0, 0, results) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadBufferRange(buffer.Get(), 0xFFFFFFF0u, 100, results) == E_INVALIDARG);
+
+	// Offsets need not fall on a struct
+	std::vector<unsigned int> values;
+	EZ_CHECK(readback.ReadBufferRange(buffer.Get(), 3, 5, values) == S_OK);
+	EZ_CHECK(values.size() == 5 && memcmp(values.data(), reinterpret_cast<const unsigned char*>(particles.data()) + 3, 20) == 0);
+}
+
+static void TestBufferFields()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+	std::vector<TestParticle> particles;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = CreateParticles(*backend, 6000, particles);
+
+	const UINT first = 17;
+	for (UINT count : { 1u, 3u, 8u, 9u, 100u, 5000u })
+	{
+		std::vector<DirectX::XMFLOAT3> positions(count);
+		std::vector<float> masses(count);
+		std::vector<double> ages(count);
+		std::vector<unsigned short> flags(count);
+		EZBufferField fields[] = {
+			{ offsetof(TestParticle, Position), sizeof(DirectX::XMFLOAT3), positions.data() },
+			{ offsetof(TestParticle, Mass), sizeof(float), masses.data() },
+			{ offsetof(TestParticle, Age), sizeof(double), ages.data() },
+			{ offsetof(TestParticle, Flags), sizeof(unsigned short), flags.data() } };
+		EZ_CHECK(readback.ReadBufferFields<TestParticle>(buffer.Get(), first * (UINT)sizeof(TestParticle), count, fields, 4) == S_OK);
+		for (UINT i = 0; i < count; i++)
+		{
+			const TestParticle& particle = particles[first + i];
+			EZ_CHECK(memcmp(&positions[i], &particle.Position, 12) == 0 && memcmp(&masses[i], &particle.Mass, 4) == 0);
+			EZ_CHECK(memcmp(&ages[i], &particle.Age, 8) == 0 && flags[i] == particle.Flags);
+		}
+	}
+
+	// Fields have to lie inside the struct and have somewhere to go
+	float mass;
+	EZBufferField outside = { sizeof(TestParticle) - 2, 4, &mass };
+	EZBufferField nowhere = { 0, 4, nullptr };
+	EZ_CHECK(readback.ReadBufferFields<TestParticle>(buffer.Get(), 0, 1, &outside, 1) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadBufferFields<TestParticle>(buffer.Get(), 0, 1, &nowhere, 1) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadBufferFields<TestParticle>(buffer.Get(), 0, 6001, &nowhere, 0) == E_INVALIDARG);
+	EZ_CHECK(readback.GetStagingPoolStats().BytesInUse == 0);
+}
+
+static void TestTypedResources()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 37;
+	desc.Height = 19;
+	desc.MipLevels = 2;
+	desc.ArraySize = 2;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	EZ_CHECK(backend->CreateTexture2D(&desc, nullptr, texture.GetAddressOf()) == S_OK);
+	std::vector<unsigned char> data = EZTestRandomBytes(18 * 9 * 4);
+	EZ_CHECK(backend->UpdateSubresource(texture.Get(), D3D11CalcSubresource(1, 1, 2), data.data(), 18 * 4, 0) == S_OK);
+
+	// Unbound handles read nothing
+	EZTypedTexture2D<EZColor4> typed;
+	std::vector<EZColor4> colors;
+	EZ_CHECK(!typed && readback.Read(typed, colors) == E_INVALIDARG);
+
+	EZ_CHECK(typed.Bind(texture.Get()) == S_OK && typed && typed.GetDesc().Width == 37);
+	EZ_CHECK(readback.Read(typed, colors, 1, 1) == S_OK && EZTestEqual(colors, data));
+	EZ_CHECK(FAILED(readback.Read(typed, colors, 5, 0)));
+	typed.Reset();
+	EZ_CHECK(!typed);
+
+	// Binding checks the format once
+	EZTypedTexture2D<DirectX::XMFLOAT4> floats;
+	EZ_CHECK(floats.Bind(texture.Get()) == E_INVALIDARG && !floats);
+	EZ_CHECK(floats.Bind(nullptr) == E_INVALIDARG);
+	EZTypedTexture2D<float> constructed(texture.Get());
+	EZ_CHECK(!constructed);
+
+	// Buffers need a whole number of elements, and
+	// structured ones a stride of exactly one
+	std::vector<unsigned char> bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 64, bufferData, 16);
+	EZTypedBuffer<DirectX::XMUINT4> elements;
+	std::vector<DirectX::XMUINT4> values;
+	EZ_CHECK(elements.Bind(buffer.Get()) == S_OK);
+	EZ_CHECK(readback.Read(elements, values) == S_OK && EZTestEqual(values, bufferData));
+	EZTypedBuffer<DirectX::XMUINT2> halves;
+	EZTypedBuffer<DirectX::XMFLOAT3> partial;
+	EZ_CHECK(halves.Bind(buffer.Get()) == E_INVALIDARG && partial.Bind(buffer.Get()) == E_INVALIDARG);
+
+	// The same rules hold at run time
+	EZ_CHECK(EZIsElementCompatible<EZColor4>(desc.Format));
+	EZ_CHECK(EZGetFormatChannels(DXGI_FORMAT_R16G16_SNORM).Kind == EZChannelSigned && EZGetFormatChannels(DXGI_FORMAT_BC1_UNORM).Bits == 64);
+}
+
+// --- TestView -------------------------------------------
+//  A shader resource or unordered access view of the given
+//  resource, standing in for the ones a device creates.
+//  Counts its own references so tests can check none leak.
+// --------------------------------------------------------
+template<typename Interface, typename DescriptionType>
+struct TestView : Interface
+{
+	ID3D11Resource* Resource;
+	DescriptionType Desc;
+	ULONG References;
+
+	TestView(ID3D11Resource* resource, const DescriptionType& desc) : Resource{ resource }, Desc(desc), References{ 1 } {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID id, void** object) override
+	{
+		*object = nullptr;
+		if (!(id == __uuidof(IUnknown) || id == __uuidof(ID3D11DeviceChild) || id == __uuidof(ID3D11View) || id == __uuidof(Interface)))
+			return E_NOINTERFACE;
+		*object = this;
+		AddRef();
+		return S_OK;
+	}
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++References; }
+	ULONG STDMETHODCALLTYPE Release() override { return --References; }
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) override { *device = nullptr; }
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return E_NOTIMPL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return E_NOTIMPL; }
+	void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource) override { Resource->AddRef(); *resource = Resource; }
+	void STDMETHODCALLTYPE GetDesc(DescriptionType* desc) override { *desc = Desc; }
+};
+
+typedef TestView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC> TestShaderResourceView;
+typedef TestView<ID3D11UnorderedAccessView, D3D11_UNORDERED_ACCESS_VIEW_DESC> TestUnorderedAccessView;
+
+static ULONG CountReferences(IUnknown* object)
+{
+	object->AddRef();
+	return object->Release();
+}
+
+static void TestTextureViews()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	// A typeless array whose texels say where they are:
+	// slice * 1000 + mip * 100 + index
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 16;
+	desc.Height = 8;
+	desc.MipLevels = 3;
+	desc.ArraySize = 4;
+	desc.Format = DXGI_FORMAT_R32G32B32A32_TYPELESS;
+	desc.SampleDesc.Count = 1;
+	std::vector<std::vector<float>> data;
+	std::vector<D3D11_SUBRESOURCE_DATA> initial;
+	for (UINT slice = 0; slice < desc.ArraySize; slice++)
+	{
+		for (UINT mip = 0; mip < desc.MipLevels; mip++)
+		{
+			UINT width = desc.Width >> mip, height = desc.Height >> mip;
+			data.emplace_back(width * height * 4);
+			for (size_t i = 0; i < data.back().size(); i++)
+				data.back()[i] = slice * 1000.0f + mip * 100.0f + i;
+		}
+	}
+	for (size_t i = 0; i < data.size(); i++)
+		initial.push_back({ data[i].data(), (desc.Width >> (i % desc.MipLevels)) * 16, 0 });
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	EZ_CHECK(backend->CreateTexture2D(&desc, initial.data(), texture.GetAddressOf()) == S_OK);
+	ULONG references = CountReferences(texture.Get());
+
+	// Mips and slices count from the view's first ones
+	D3D11_SHADER_RESOURCE_VIEW_DESC shaderDesc = {};
+	shaderDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	shaderDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	shaderDesc.Texture2DArray.MostDetailedMip = 1;
+	shaderDesc.Texture2DArray.MipLevels = (UINT)-1;
+	shaderDesc.Texture2DArray.FirstArraySlice = 2;
+	shaderDesc.Texture2DArray.ArraySize = 2;
+	TestShaderResourceView shaderView(texture.Get(), shaderDesc);
+	std::vector<DirectX::XMFLOAT4> values;
+	EZ_CHECK(readback.Read(&shaderView, values, 0, 1) == S_OK && values.size() == 8 * 4 && values[0].x == 3100 && values[5].y == 3100 + 21);
+	EZ_CHECK(readback.Read(&shaderView, values, 1, 0) == S_OK && values.size() == 4 * 2 && values[0].x == 2200);
+	EZ_CHECK(readback.Read(&shaderView, values, 0, 2) == E_INVALIDARG);
+	EZ_CHECK(FAILED(readback.Read(&shaderView, values, 2, 0)));
+
+	// Element sizes and decoding follow the view's format,
+	// which a typeless resource alone cannot
+	std::vector<float> floats;
+	EZ_CHECK(readback.Read(&shaderView, floats) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadAsFloat4(&shaderView, values, 0, 1) == S_OK && values.size() == 32 && values[0].x == 3100);
+	EZ_CHECK(readback.ReadAsFloat4(texture.Get(), values) == E_INVALIDARG);
+	EZ_CHECK(CountReferences(texture.Get()) == references && shaderView.References == 1);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc = {};
+	accessDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+	accessDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2DARRAY;
+	accessDesc.Texture2DArray.MipSlice = 2;
+	accessDesc.Texture2DArray.FirstArraySlice = 1;
+	accessDesc.Texture2DArray.ArraySize = 3;
+	TestUnorderedAccessView accessView(texture.Get(), accessDesc);
+	std::vector<DirectX::XMUINT4> texels;
+	float first;
+	EZ_CHECK(readback.Read(&accessView, texels, 0, 2) == S_OK && texels.size() == 8);
+	memcpy(&first, texels.data(), 4);
+	EZ_CHECK(first == 3200);
+	EZ_CHECK(readback.Read(&accessView, texels, 1, 0) == E_INVALIDARG);
+	EZ_CHECK(readback.ReadAsUInt4(&accessView, texels) == S_OK && texels.size() == 8);
+	EZ_CHECK(CountReferences(texture.Get()) == references && accessView.References == 1);
+
+	// 3D views cover only their W slices
+	D3D11_TEXTURE3D_DESC volumeDesc = {};
+	volumeDesc.Width = 4;
+	volumeDesc.Height = 2;
+	volumeDesc.Depth = 8;
+	volumeDesc.MipLevels = 1;
+	volumeDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	std::vector<float> volumeData(64);
+	for (size_t i = 0; i < volumeData.size(); i++)
+		volumeData[i] = (float)i;
+	D3D11_SUBRESOURCE_DATA volumeInitial = { volumeData.data(), 16, 32 };
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> volume;
+	EZ_CHECK(backend->CreateTexture3D(&volumeDesc, &volumeInitial, volume.GetAddressOf()) == S_OK);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC sliceDesc = {};
+	sliceDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	sliceDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE3D;
+	sliceDesc.Texture3D.FirstWSlice = 3;
+	sliceDesc.Texture3D.WSize = 2;
+	TestUnorderedAccessView sliceView(volume.Get(), sliceDesc);
+	EZ_CHECK(readback.Read(&sliceView, floats) == S_OK && floats.size() == 16 && floats[0] == 24 && floats[15] == 39);
+	sliceDesc.Texture3D.WSize = (UINT)-1;
+	TestUnorderedAccessView restView(volume.Get(), sliceDesc);
+	EZ_CHECK(readback.Read(&restView, floats) == S_OK && floats.size() == 40 && floats[0] == 24);
+	sliceDesc.Texture3D.FirstWSlice = 7;
+	sliceDesc.Texture3D.WSize = 0xFFFFFFF0u;
+	TestUnorderedAccessView pastView(volume.Get(), sliceDesc);
+	EZ_CHECK(readback.Read(&pastView, floats) == E_INVALIDARG);
+	EZ_CHECK(readback.Read((ID3D11View*)nullptr, floats) == E_INVALIDARG);
+}
+
+static void TestBufferViews()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	// Elements of three floats: index, -index, 1
+	const UINT count = 100000;
+	std::vector<DirectX::XMFLOAT3> elements(count);
+	for (UINT i = 0; i < count; i++)
+		elements[i] = DirectX::XMFLOAT3((float)i, -(float)i, 1.0f);
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = count * sizeof(DirectX::XMFLOAT3);
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = sizeof(DirectX::XMFLOAT3);
+	D3D11_SUBRESOURCE_DATA initial = { elements.data(), 0, 0 };
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	EZ_CHECK(backend->CreateBuffer(&desc, &initial, buffer.GetAddressOf()) == S_OK);
+
+	// Only the view's window is copied off the GPU
+	D3D11_UNORDERED_ACCESS_VIEW_DESC accessDesc = {};
+	accessDesc.Format = DXGI_FORMAT_UNKNOWN;
+	accessDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	accessDesc.Buffer.FirstElement = 5000;
+	accessDesc.Buffer.NumElements = 64;
+	TestUnorderedAccessView window(buffer.Get(), accessDesc);
+	std::vector<DirectX::XMFLOAT3> results;
+	backend->ResetStats();
+	EZ_CHECK(readback.Read(&window, results) == S_OK && results.size() == 64 && results[0].x == 5000 && results[63].y == -5063);
+	EZ_CHECK(backend->GetStats().BytesCopied == 64 * sizeof(DirectX::XMFLOAT3));
+	std::vector<float> floats;
+	EZ_CHECK(readback.Read(&window, floats) == S_OK && floats.size() == 64 * 3);
+	struct Odd { unsigned char Bytes[7]; };
+	std::vector<Odd> mismatched;
+	EZ_CHECK(readback.Read(&window, mismatched) == E_INVALIDARG);
+	EZ_CHECK(window.References == 1);
+
+	accessDesc.Buffer.FirstElement = count - 10;
+	TestUnorderedAccessView past(buffer.Get(), accessDesc);
+	EZ_CHECK(readback.Read(&past, results) == E_INVALIDARG);
+
+	// Typed views of a buffer decode with the view's format
+	D3D11_SHADER_RESOURCE_VIEW_DESC shaderDesc = {};
+	shaderDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	shaderDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	shaderDesc.Buffer.FirstElement = 10;
+	shaderDesc.Buffer.NumElements = 3;
+	TestShaderResourceView typed(buffer.Get(), shaderDesc);
+	std::vector<DirectX::XMFLOAT4> values;
+	EZ_CHECK(readback.ReadAsFloat4(&typed, values) == S_OK && values.size() == 3);
+	EZ_CHECK(values.size() == 3 && values[2].x == 12 && values[2].y == -12 && values[2].z == 1 && values[2].w == 1);
+	EZ_CHECK(readback.Read(&typed, values) == E_INVALIDARG);
+	EZ_CHECK(typed.References == 1);
+}
+
+int main()
+{
+	TestBufferRange();
+	TestBufferFields();
+	TestTypedResources();
+	TestTextureViews();
+	TestBufferViews();
+	return EZTestResult("EZReadbackResourceTests");
+}
@@ -0,0 +1,288 @@
+// --- EZReadbackSchedulerTests ---------------------------
+//  Reads spread over frames: how reads are cut into
+//  pieces, the frame budget, priorities and deadlines, and
+//  copies still on the GPU.  Latency is counted in frames
+//  of the reference backend, so every schedule here is
+//  the same from run to run.
+// --------------------------------------------------------
+#include "EZReadbackTests.h"
+
+typedef std::function<void(HRESULT, std::vector<unsigned int>&, const std::vector<EZSubresourceLayout>&)> ScheduledCallback;
+
+// Checks that the pieces cover every element of every
+// subresource exactly once, and stay under the limit
+static void CheckPieces(DXGI_FORMAT format, size_t elementSize, const std::vector<EZSubresourceLayout>& layouts, size_t maxPieceBytes)
+{
+	std::vector<EZReadbackPiece> pieces;
+	EZPlanReadbackPieces(format, elementSize, layouts, maxPieceBytes, pieces);
+
+	bool buffer = format == DXGI_FORMAT_UNKNOWN;
+	size_t blockSize = EZIsBlockCompressed(format) ? 4 : 1;
+	std::vector<int> covered(layouts.back().Offset + layouts.back().ElementCount, 0);
+	for (const EZReadbackPiece& piece : pieces)
+	{
+		const EZSubresourceLayout& layout = layouts[piece.Subresource];
+		if (piece.Whole)
+		{
+			EZ_CHECK(piece.Bytes == layout.ElementCount * elementSize);
+			for (size_t i = 0; i < layout.ElementCount; i++)
+				covered[layout.Offset + i]++;
+			continue;
+		}
+
+		size_t columns = buffer ? (piece.Box.right - piece.Box.left) / elementSize : (piece.Box.right - piece.Box.left + blockSize - 1) / blockSize;
+		size_t rows = buffer ? 1 : (piece.Box.bottom - piece.Box.top + blockSize - 1) / blockSize;
+		size_t slices = piece.Box.back - piece.Box.front;
+		EZ_CHECK(piece.Bytes <= EZMax(maxPieceBytes, elementSize) && piece.Bytes == columns * rows * slices * elementSize);
+		if (!buffer)
+			EZ_CHECK(piece.Box.left % blockSize == 0 && piece.Box.top % blockSize == 0 && piece.Box.right <= layout.Width && piece.Box.bottom <= layout.Height);
+		for (size_t z = 0; z < slices; z++)
+			for (size_t y = 0; y < rows; y++)
+				for (size_t x = 0; x < columns; x++)
+					covered[piece.Offset + z * piece.SliceStride + y * piece.RowStride + x]++;
+	}
+	EZ_CHECK(std::all_of(covered.begin(), covered.end(), [](int count) { return count == 1; }));
+}
+
+static Microsoft::WRL::ComPtr<ID3D11Texture3D> CreateVolume(EZReferenceBackend& backend, std::vector<std::vector<unsigned char>>& data)
+{
+	D3D11_TEXTURE3D_DESC desc = {};
+	desc.Width = 40;
+	desc.Height = 24;
+	desc.Depth = 10;
+	desc.MipLevels = 3;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> initial;
+	data.clear();
+	for (UINT mip = 0; mip < desc.MipLevels; mip++)
+	{
+		UINT width = desc.Width >> mip, height = desc.Height >> mip, depth = EZMax(desc.Depth >> mip, 1u);
+		data.push_back(EZTestRandomBytes((size_t)width * height * depth * 4, mip));
+		initial.push_back({ data.back().data(), width * 4, width * height * 4 });
+	}
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> texture;
+	EZ_CHECK(backend.CreateTexture3D(&desc, initial.data(), texture.GetAddressOf()) == S_OK);
+	return texture;
+}
+
+static void TestPieces()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<std::vector<unsigned char>> volumeData;
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> volume = CreateVolume(*backend, volumeData);
+	std::vector<unsigned int> results;
+	std::vector<EZSubresourceLayout> layouts;
+	EZ_CHECK(readback.ReadAllSubresources(volume.Get(), results, layouts) == S_OK);
+	for (size_t maxPieceBytes : { 4, 8, 100, 160, 161, 3840, 4000, 8000, 1 << 20 })
+		CheckPieces(DXGI_FORMAT_R8G8B8A8_UNORM, 4, layouts, maxPieceBytes);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 30;
+	desc.Height = 18;
+	desc.ArraySize = 2;
+	desc.Format = DXGI_FORMAT_BC1_UNORM;
+	desc.SampleDesc.Count = 1;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> blocks;
+	std::vector<unsigned long long> blockResults;
+	EZ_CHECK(backend->CreateTexture2D(&desc, nullptr, blocks.GetAddressOf()) == S_OK);
+	EZ_CHECK(readback.ReadAllSubresources(blocks.Get(), blockResults, layouts) == S_OK);
+	for (size_t maxPieceBytes : { 8, 16, 64, 100, 1000 })
+		CheckPieces(DXGI_FORMAT_BC1_UNORM, 8, layouts, maxPieceBytes);
+
+	std::vector<unsigned char> bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 1000, bufferData);
+	EZ_CHECK(readback.ReadAllSubresources(buffer.Get(), results, layouts) == S_OK);
+	for (size_t maxPieceBytes : { 1, 4, 7, 100, 2000 })
+		CheckPieces(DXGI_FORMAT_UNKNOWN, 4, layouts, maxPieceBytes);
+
+	// The same inputs always give the same pieces
+	std::vector<EZReadbackPiece> first, second;
+	EZPlanReadbackPieces(DXGI_FORMAT_UNKNOWN, 4, layouts, 100, first);
+	EZPlanReadbackPieces(DXGI_FORMAT_UNKNOWN, 4, layouts, 100, second);
+	EZ_CHECK(first.size() == 10 && second.size() == first.size());
+	for (size_t i = 0; i < first.size() && i < second.size(); i++)
+		EZ_CHECK(first[i].Box.left == second[i].Box.left && first[i].Box.right == second[i].Box.right && first[i].Offset == second[i].Offset);
+}
+
+static void TestBudget()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+
+	std::vector<std::vector<unsigned char>> volumeData;
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> volume = CreateVolume(*backend, volumeData);
+	std::vector<unsigned int> expected;
+	std::vector<EZSubresourceLayout> expectedLayouts;
+	EZ_CHECK(readback.ReadAllSubresources(volume.Get(), expected, expectedLayouts) == S_OK);
+
+	for (size_t budget : { 4, 64, 1000, 5000, 100000 })
+	{
+		EZSchedulerOptions options;
+		options.FrameBudget = budget;
+		EZReadback::Scheduler scheduler = readback.CreateScheduler(options);
+		std::vector<unsigned int> results;
+		bool done = false;
+		EZ_CHECK(scheduler.Add<unsigned int>(volume.Get(), [&](HRESULT hr, std::vector<unsigned int>& values, const std::vector<EZSubresourceLayout>& layouts)
+		{
+			EZ_CHECK(hr == S_OK && layouts.size() == expectedLayouts.size());
+			results = values;
+			done = true;
+		}) != EZReadbackInvalidTicket);
+
+		int frames = 0;
+		while (!done && frames < 100000)
+		{
+			scheduler.Update();
+			frames++;
+			EZ_CHECK(scheduler.GetStats().FrameBytes <= budget);
+		}
+		EZ_CHECK(results == expected);
+		EZSchedulerStats stats = scheduler.GetStats();
+		EZ_CHECK(stats.PendingReads == 0 && stats.PiecesInFlight == 0 && stats.CompletedReads == 1);
+		EZ_CHECK(stats.TotalBytes == expected.size() * 4 && stats.PeakFrameBytes <= budget);
+	}
+
+	// Copies are read back the frame after they are made,
+	// so 10 pieces take 11 frames
+	std::vector<unsigned char> bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 1000, bufferData);
+	EZSchedulerOptions options;
+	options.FrameBudget = 100;
+	EZReadback::Scheduler scheduler = readback.CreateScheduler(options);
+	UINT delivered = 0;
+	scheduler.Add<unsigned int>(buffer.Get(), [&](HRESULT hr, std::vector<unsigned int>& values, const std::vector<EZSubresourceLayout>&)
+	{
+		EZ_CHECK(hr == S_OK && EZTestEqual(values, bufferData));
+	});
+	for (int frame = 1; frame <= 11; frame++)
+	{
+		delivered += scheduler.Update();
+		EZ_CHECK(delivered == (frame == 11 ? 1u : 0u));
+		EZ_CHECK(scheduler.GetStats().FrameBytes == (frame <= 10 ? 100u : 0u));
+	}
+
+	// Planar video cannot be cut, so it goes whole even
+	// when bigger than the budget
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 64;
+	desc.Height = 32;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_NV12;
+	desc.SampleDesc.Count = 1;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> video;
+	EZ_CHECK(backend->CreateTexture2D(&desc, nullptr, video.GetAddressOf()) == S_OK);
+	bool done = false;
+	scheduler.Add<unsigned char>(video.Get(), [&](HRESULT hr, std::vector<unsigned char>& values, const std::vector<EZSubresourceLayout>&)
+	{
+		done = hr == S_OK && values.size() == 64 * 48;
+	});
+	scheduler.Update();
+	EZ_CHECK(scheduler.GetStats().FrameBytes == 64 * 48);
+	scheduler.Update();
+	EZ_CHECK(done);
+
+	// ElementType has to match the format
+	EZ_CHECK(scheduler.Add<unsigned short>(volume.Get(), [](HRESULT, std::vector<unsigned short>&, const std::vector<EZSubresourceLayout>&) {}) == EZReadbackInvalidTicket);
+}
+
+static void TestPriorities()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	EZReadback readback(backend);
+	std::vector<std::vector<unsigned char>> volumeData;
+	Microsoft::WRL::ComPtr<ID3D11Texture3D> volume = CreateVolume(*backend, volumeData);
+
+	EZSchedulerOptions options;
+	options.FrameBudget = 4000;
+	EZReadback::Scheduler scheduler = readback.CreateScheduler(options);
+	std::vector<int> order;
+	auto record = [&order](int id)
+	{
+		return ScheduledCallback([&order, id](HRESULT, std::vector<unsigned int>&, const std::vector<EZSubresourceLayout>&) { order.push_back(id); });
+	};
+
+	// Highest priority first, then earliest deadline, then
+	// no deadline, then in the order added
+	EZScheduledReadOptions lowest, urgent, later, highest;
+	lowest.Priority = -1;
+	urgent.Deadline = 2;
+	later.Deadline = 50;
+	highest.Priority = 5;
+	scheduler.Add<unsigned int>(volume.Get(), record(1), lowest);
+	scheduler.Add<unsigned int>(volume.Get(), record(2));
+	scheduler.Add<unsigned int>(volume.Get(), record(3), later);
+	scheduler.Add<unsigned int>(volume.Get(), record(4), urgent);
+	scheduler.Add<unsigned int>(volume.Get(), record(5));
+	scheduler.Add<unsigned int>(volume.Get(), record(6), highest);
+	EZReadbackTicket cancelled = scheduler.Add<unsigned int>(volume.Get(), record(7), highest);
+
+	// Cancelled reads never call back, even with copies made
+	scheduler.Update();
+	EZ_CHECK(scheduler.GetStats().PiecesInFlight > 0);
+	EZ_CHECK(scheduler.Cancel(cancelled) && !scheduler.Cancel(cancelled));
+	for (int frame = 0; frame < 10000 && order.size() < 6; frame++)
+		scheduler.Update();
+	EZ_CHECK((order == std::vector<int>{ 6, 4, 3, 2, 5, 1 }));
+
+	// Only the read due by frame 2 was late
+	EZSchedulerStats stats = scheduler.GetStats();
+	EZ_CHECK(stats.CompletedReads == 6 && stats.MissedDeadlines == 1);
+	EZ_CHECK(readback.GetStagingPoolStats().BytesInUse == 0);
+
+	// Clear drops everything without calling back
+	scheduler.Add<unsigned int>(volume.Get(), record(8));
+	scheduler.Update();
+	scheduler.Clear();
+	scheduler.Update();
+	EZ_CHECK(order.size() == 6 && scheduler.GetStats().PendingReads == 0 && readback.GetStagingPoolStats().BytesInUse == 0);
+}
+
+// With a latency in frames, copies stay on the GPU until
+// the backend's frame clock has passed it, and Update()
+// never waits for them
+static void TestStillDrawing()
+{
+	std::shared_ptr<EZReferenceBackend> backend = std::make_shared<EZReferenceBackend>();
+	backend->SetCopyLatencyFrames(2);
+	EZReadback readback(backend);
+	std::vector<unsigned char> bufferData;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer = EZTestCreateBuffer(*backend, 1000, bufferData);
+
+	EZSchedulerOptions options;
+	options.FrameBudget = 400;
+	EZReadback::Scheduler scheduler = readback.CreateScheduler(options);
+	EZScheduledReadOptions deadline;
+	deadline.Deadline = 4;
+	bool done = false;
+	scheduler.Add<unsigned int>(buffer.Get(), [&](HRESULT hr, std::vector<unsigned int>& values, const std::vector<EZSubresourceLayout>&)
+	{
+		done = hr == S_OK && EZTestEqual(values, bufferData);
+	}, deadline);
+
+	// Frames 1-3 each copy a piece of 400, 400 and 200 bytes;
+	// each is back two frames later, so the last is read
+	// in frame 5
+	const UINT inFlight[] = { 1, 2, 2, 1, 0 };
+	for (int frame = 1; frame <= 5; frame++)
+	{
+		EZ_CHECK(scheduler.Update() == (frame == 5 ? 1u : 0u));
+		EZ_CHECK(scheduler.GetStats().PiecesInFlight == inFlight[frame - 1]);
+		backend->AdvanceFrame();
+	}
+	EZ_CHECK(done);
+	EZ_CHECK(scheduler.GetStats().MissedDeadlines == 1);
+	EZ_CHECK(backend->GetStats().StillDrawingCount > 0);
+}
+
+int main()
+{
+	TestPieces();
+	TestBudget();
+	TestPriorities();
+	TestStillDrawing();
+	return EZTestResult("EZReadbackSchedulerTests");
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+// --- EZReadback tests -----------------------------------
+//  Helpers shared by the tests, which all run against an
+//  EZReferenceBackend so they need no GPU.  Every test
+//  executable calls its test functions from main() and
+//  returns EZTestResult(), which is non-zero if any
+//  EZ_CHECK failed.  Failed checks are printed but do not
+//  stop the test, so one run lists every failure.
+// --------------------------------------------------------
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "EZReadback.h"
+
+inline int& EZTestFailureCount()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define EZ_CHECK(condition) \
+	do { if (!(condition)) { std::printf("%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); EZTestFailureCount()++; } } while (0)
+
+inline int EZTestResult(const char* name)
+{
+	int failures = EZTestFailureCount();
+	std::printf("%s: %s (%d failed checks)\n", name, failures ? "FAILED" : "passed", failures);
+	return failures ? 1 : 0;
+}
+
+// --- Test resources -------------------------------------
+//  Create reference resources filled with random bytes and
+//  hand those bytes back, tightly packed, so reads can be
+//  compared against them
+// --------------------------------------------------------
+inline std::vector<unsigned char> EZTestRandomBytes(size_t count, unsigned int seed = 1234)
+{
+	std::mt19937 random(seed);
+	std::vector<unsigned char> bytes(count);
+	for (size_t i = 0; i < count; i++)
+		bytes[i] = (unsigned char)random();
+	return bytes;
+}
+
+inline Microsoft::WRL::ComPtr<ID3D11Buffer> EZTestCreateBuffer(EZReferenceBackend& backend, UINT byteWidth, std::vector<unsigned char>& data, UINT structureStride = 0)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = byteWidth;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.StructureByteStride = structureStride;
+
+	data = EZTestRandomBytes(byteWidth);
+	D3D11_SUBRESOURCE_DATA initial = { data.data(), byteWidth, byteWidth };
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	EZ_CHECK(backend.CreateBuffer(&desc, &initial, buffer.GetAddressOf()) == S_OK);
+	return buffer;
+}
+
+// Creates a single-mip 2D texture of an uncompressed
+// format, or of a block compressed one with data given
+// per block row
+inline Microsoft::WRL::ComPtr<ID3D11Texture2D> EZTestCreateTexture2D(EZReferenceBackend& backend, DXGI_FORMAT format, UINT width, UINT height, std::vector<unsigned char>& data, unsigned int seed = 1234)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+
+	UINT blockSize = EZIsBlockCompressed(format) ? 4 : 1;
+	UINT rowBytes = (width + blockSize - 1) / blockSize * EZBitsPerPixel(format) * blockSize * blockSize / 8;
+	UINT rowCount = (height + blockSize - 1) / blockSize;
+	data = EZTestRandomBytes((size_t)rowBytes * rowCount, seed);
+	D3D11_SUBRESOURCE_DATA initial = { data.data(), rowBytes, rowBytes * rowCount };
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	EZ_CHECK(backend.CreateTexture2D(&desc, &initial, texture.GetAddressOf()) == S_OK);
+	return texture;
+}
+
+template<typename ElementType>
+bool EZTestEqual(const std::vector<ElementType>& results, const std::vector<unsigned char>& expected)
+{
+	return results.size() * sizeof(ElementType) == expected.size() &&
+		(expected.empty() || memcmp(results.data(), expected.data(), expected.size()) == 0);
+}